@@ -21,12 +21,11 @@
 #include <click/args.hh>
 #include <click/error.hh>
 #include <click/packet_anno.hh>
-#include <click/integers.hh>	// for first_bit_set
 #include <click/router.hh>
 CLICK_DECLS
 
 AggregateCounter::AggregateCounter()
-    : _root(0), _free(0), _call_nnz_h(0), _call_count_h(0)
+    : _call_nnz_h(0), _call_count_h(0)
 {
 }
 
@@ -34,22 +33,6 @@ AggregateCounter::~AggregateCounter()
 {
 }
 
-AggregateCounter::Node *
-AggregateCounter::new_node_block()
-{
-    assert(!_free);
-    int block_size = 1024;
-    Node *block = new Node[block_size];
-    if (!block)
-	return 0;
-    _blocks.push_back(block);
-    for (int i = 1; i < block_size - 1; i++)
-	block[i].child[0] = &block[i+1];
-    block[block_size - 1].child[0] = 0;
-    _free = &block[1];
-    return &block[0];
-}
-
 int
 AggregateCounter::configure(Vector<String> &conf, ErrorHandler *errh)
 {
@@ -132,84 +115,24 @@ AggregateCounter::initialize(ErrorHandler *errh)
 void
 AggregateCounter::cleanup(CleanupStage)
 {
-    for (int i = 0; i < _blocks.size(); i++)
-	delete[] _blocks[i];
-    _blocks.clear();
+    _trie.clear();
     delete _call_nnz_h;
     delete _call_count_h;
     _call_nnz_h = _call_count_h = 0;
 }
 
-AggregateCounter::Node *
-AggregateCounter::make_peer(uint32_t a, Node *n, bool frozen)
+inline MultibitTrie::Leaf *
+AggregateCounter::find_leaf(uint32_t a, bool frozen)
 {
-    /*
-     * become a peer
-     * algo: create two nodes, the two peers.  leave orig node as
-     * the parent of the two new ones.
-     */
-
-    if (frozen)
-	return 0;
-
-    Node *down[2];
-    if (!(down[0] = new_node()))
-	return 0;
-    if (!(down[1] = new_node())) {
-	free_node(down[0]);
+    if (frozen) {
+	MultibitTrie::Leaf *l = _trie.find(a);
+	return (l && l->value ? l : 0);
+    } else if (MultibitTrie::Leaf *l = _trie.find_insert(a))
+	return l;
+    else {
+	click_chatter("AggregateCounter: out of memory!");
 	return 0;
     }
-
-    // swivel is first bit 'a' and 'old->input' differ
-    int swivel = ffs_msb(a ^ n->aggregate);
-    // bitvalue is the value of that bit of 'a'
-    int bitvalue = (a >> (32 - swivel)) & 1;
-    // mask masks off all bits before swivel
-    uint32_t mask = (swivel == 1 ? 0 : (0xFFFFFFFFU << (33 - swivel)));
-
-    down[bitvalue]->aggregate = a;
-    down[bitvalue]->count = 0;
-    down[bitvalue]->child[0] = down[bitvalue]->child[1] = 0;
-
-    *down[1 - bitvalue] = *n;	/* copy orig node down one level */
-
-    n->aggregate = (down[0]->aggregate & mask);
-    if (down[0]->aggregate == n->aggregate) {
-	n->count = down[0]->count;
-	down[0]->count = 0;
-    } else
-	n->count = 0;
-    n->child[0] = down[0];	/* point to children */
-    n->child[1] = down[1];
-
-    return (n->aggregate == a ? n : down[bitvalue]);
-}
-
-AggregateCounter::Node *
-AggregateCounter::find_node(uint32_t a, bool frozen)
-{
-    // straight outta tcpdpriv
-    Node *n = _root;
-    while (n) {
-	if (n->aggregate == a)
-	    return (n->count || !frozen ? n : 0);
-	if (!n->child[0])
-	    n = make_peer(a, n, frozen);
-	else {
-	    // swivel is the first bit in which the two children differ
-	    int swivel = ffs_msb(n->child[0]->aggregate ^ n->child[1]->aggregate);
-	    if (ffs_msb(a ^ n->aggregate) < swivel) // input differs earlier
-		n = make_peer(a, n, frozen);
-	    else if (a & (1 << (32 - swivel)))
-		n = n->child[1];
-	    else
-		n = n->child[0];
-	}
-    }
-
-    if (!frozen)
-	click_chatter("AggregateCounter: out of memory!");
-    return 0;
 }
 
 inline bool
@@ -220,8 +143,8 @@ AggregateCounter::update(Packet *p, bool frozen)
 
     // AGGREGATE_ANNO is already in host byte order!
     uint32_t agg = AGGREGATE_ANNO(p);
-    Node *n = find_node(agg, frozen);
-    if (!n)
+    MultibitTrie::Leaf *l = find_leaf(agg, frozen);
+    if (!l)
 	return false;
 
     uint32_t amount;
@@ -234,7 +157,7 @@ AggregateCounter::update(Packet *p, bool frozen)
     }
 
     // update _num_nonzero; possibly call handler
-    if (amount && !n->count) {
+    if (amount && !l->value) {
 	if (_num_nonzero >= _call_nnz) {
 	    _call_nnz = (uint32_t)(-1);
 	    _call_nnz_h->call_write();
@@ -244,7 +167,7 @@ AggregateCounter::update(Packet *p, bool frozen)
 	_num_nonzero++;
     }
 
-    n->count += amount;
+    l->value += amount;
     _count += amount;
     if (_count >= _call_count) {
 	_call_count = (uint64_t)(-1);
@@ -272,63 +195,29 @@ AggregateCounter::pull(int port)
 
 // CLEAR, REAGGREGATE
 
-void
-AggregateCounter::clear_node(Node *n)
-{
-    if (n->child[0]) {
-	clear_node(n->child[0]);
-	clear_node(n->child[1]);
-    }
-    free_node(n);
-}
-
 int
-AggregateCounter::clear(ErrorHandler *errh)
+AggregateCounter::clear(ErrorHandler *)
 {
-    if (_root)
-	clear_node(_root);
-
-    if (!(_root = new_node())) {
-	if (errh)
-	    errh->error("out of memory!");
-	return -1;
-    }
-    _root->aggregate = 0;
-    _root->count = 0;
-    _root->child[0] = _root->child[1] = 0;
+    _trie.clear();
     _num_nonzero = 0;
     _count = 0;
     return 0;
 }
 
-
-void
-AggregateCounter::reaggregate_node(Node *n)
-{
-    Node *l = n->child[0], *r = n->child[1];
-    uint32_t count = n->count;
-    free_node(n);
-
-    if ((n = find_node(count, false))) {
-	if (!n->count)
-	    _num_nonzero++;
-	n->count++;
-	_count++;
-    }
-
-    if (l) {
-	reaggregate_node(l);
-	reaggregate_node(r);
-    }
-}
-
 void
 AggregateCounter::reaggregate_counts()
 {
-    Node *old_root = _root;
-    _root = 0;
+    MultibitTrie old_trie;
+    _trie.swap(old_trie);
     clear();
-    reaggregate_node(old_root);
+    for (MultibitTrie::const_iterator it = old_trie.begin(); it; ++it)
+	if (it->value)
+	    if (MultibitTrie::Leaf *l = find_leaf(it->value, false)) {
+		if (!l->value)
+		    _num_nonzero++;
+		l->value++;
+		_count++;
+	    }
 }
 
 
@@ -351,26 +240,6 @@ write_batch(FILE *f, AggregateCounter::WriteFormat format,
 	    fprintf(f, "%u %u\n", buffer[i], buffer[i+1]);
 }
 
-void
-AggregateCounter::write_nodes(Node *n, FILE *f, WriteFormat format,
-			      uint32_t *buffer, int &pos, int len,
-			      ErrorHandler *errh) const
-{
-    if (n->count > 0) {
-	buffer[pos++] = n->aggregate;
-	buffer[pos++] = n->count;
-	if (pos == len) {
-	    write_batch(f, format, buffer, pos, _count, errh);
-	    pos = 0;
-	}
-    }
-
-    if (n->child[0])
-	write_nodes(n->child[0], f, format, buffer, pos, len, errh);
-    if (n->child[1])
-	write_nodes(n->child[1], f, format, buffer, pos, len, errh);
-}
-
 int
 AggregateCounter::write_file(String where, WriteFormat format,
 			     ErrorHandler *errh) const
@@ -401,7 +270,15 @@ AggregateCounter::write_file(String where, WriteFormat format,
 
     uint32_t buf[1024];
     int pos = 0;
-    write_nodes(_root, f, format, buf, pos, 1024, errh);
+    for (MultibitTrie::const_iterator it = _trie.begin(); it; ++it)
+	if (it->value) {
+	    buf[pos++] = it->key;
+	    buf[pos++] = it->value;
+	    if (pos == 1024) {
+		write_batch(f, format, buf, pos, _count, errh);
+		pos = 0;
+	    }
+	}
     if (pos)
 	write_batch(f, format, buf, pos, _count, errh);
 
@@ -545,6 +422,6 @@ AggregateCounter::add_handlers()
     add_read_handler("nagg", read_handler, AC_NAGG);
 }
 
-ELEMENT_REQUIRES(userlevel int64)
+ELEMENT_REQUIRES(userlevel int64 MultibitTrie)
 EXPORT_ELEMENT(AggregateCounter)
 CLICK_ENDDECLS
@@ -1,6 +1,7 @@
 #ifndef CLICK_AGGCOUNTER_HH
 #define CLICK_AGGCOUNTER_HH
 #include <click/element.hh>
+#include "multibittrie.hh"
 CLICK_DECLS
 class HandlerCall;
 
@@ -214,12 +215,6 @@ class AggregateCounter : public Element { public:
 
   private:
 
-    struct Node {
-	uint32_t aggregate;
-	uint32_t count;
-	Node *child[2];
-    };
-
     bool _bytes : 1;
     bool _ip_bytes : 1;
     bool _use_packet_count : 1;
@@ -227,9 +222,7 @@ class AggregateCounter : public Element { public:
     bool _frozen;
     bool _active;
 
-    Node *_root;
-    Node *_free;
-    Vector<Node *> _blocks;
+    MultibitTrie _trie;
     uint32_t _num_nonzero;
     uint64_t _count;
 
@@ -240,39 +233,13 @@ class AggregateCounter : public Element { public:
 
     String _output_banner;
 
-    Node *new_node();
-    Node *new_node_block();
-    void free_node(Node *);
-
-    Node *make_peer(uint32_t, Node *, bool frozen);
-    Node *find_node(uint32_t, bool frozen = false);
-    void reaggregate_node(Node *);
-    void clear_node(Node *);
+    inline MultibitTrie::Leaf *find_leaf(uint32_t, bool frozen);
 
-    void write_nodes(Node *, FILE *, WriteFormat, uint32_t *, int &, int, ErrorHandler *) const;
     static int write_file_handler(const String &, Element *, void *, ErrorHandler *);
     static String read_handler(Element *, void *) CLICK_COLD;
     static int write_handler(const String &, Element *, void *, ErrorHandler *) CLICK_COLD;
 
 };
 
-inline AggregateCounter::Node *
-AggregateCounter::new_node()
-{
-    if (_free) {
-	Node *n = _free;
-	_free = n->child[0];
-	return n;
-    } else
-	return new_node_block();
-}
-
-inline void
-AggregateCounter::free_node(Node *n)
-{
-    n->child[0] = _free;
-    _free = n;
-}
-
 CLICK_ENDDECLS
 #endif
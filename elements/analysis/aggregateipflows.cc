@@ -72,8 +72,9 @@ flip_ports(uint32_t ports)
 // actual AggregateIPFlows operations
 
 AggregateIPFlows::AggregateIPFlows()
+    : _flow_memory(0), _flow_alloc(0), _burst_pos(0)
 #if CLICK_USERLEVEL
-    : _traceinfo_file(0), _packet_source(0), _filepos_h(0)
+    , _traceinfo_file(0), _packet_source(0), _filepos_h(0)
 #endif
 {
 }
@@ -105,6 +106,8 @@ AggregateIPFlows::configure(Vector<String> &conf, ErrorHandler *errh)
     bool handle_icmp_errors = false;
     bool fragments_parsed;
     bool fragments = true;
+    _capacity = 0;
+    _burst = 1;
 
     if (Args(conf, this, errh)
 	.read("TCP_TIMEOUT", _tcp_timeout)
@@ -113,6 +116,8 @@ AggregateIPFlows::configure(Vector<String> &conf, ErrorHandler *errh)
 	.read("FRAGMENT_TIMEOUT", SecondsArg(), _fragment_timeout)
 	.read("REAP", SecondsArg(), _gc_interval)
 	.read("ICMP", handle_icmp_errors)
+	.read("CAPACITY", _capacity)
+	.read("BURST", _burst)
 #if CLICK_USERLEVEL
 	.read("TRACEINFO", FilenameArg(), _traceinfo_filename)
 	.read("SOURCE", ElementArg(), _packet_source)
@@ -121,6 +126,15 @@ AggregateIPFlows::configure(Vector<String> &conf, ErrorHandler *errh)
 	.complete() < 0)
 	return -1;
 
+    if (_burst < 1)
+	return errh->error("BURST must be at least 1");
+#if CLICK_USERLEVEL
+    // SOURCE reads the source's file position as each flow starts, which
+    // pulling ahead would get wrong
+    if (_burst > 1 && _packet_source)
+	return errh->error("BURST is incompatible with SOURCE");
+#endif
+
     _smallest_timeout = (_tcp_timeout < _tcp_done_timeout ? _tcp_timeout : _tcp_done_timeout);
     _smallest_timeout = (_smallest_timeout < _udp_timeout ? _smallest_timeout : _udp_timeout);
     _handle_icmp_errors = handle_icmp_errors;
@@ -135,6 +149,10 @@ AggregateIPFlows::initialize(ErrorHandler *errh)
     _next = 1;
     _active_sec = _gc_sec = 0;
     _timestamp_warning = false;
+    _nflows = _evictions = 0;
+    _free_flows = 0;
+    _clock_hand = 0;
+    _burst_pos = 0;
 
 #if CLICK_USERLEVEL
     if (_traceinfo_filename == "-")
@@ -158,6 +176,30 @@ AggregateIPFlows::initialize(ErrorHandler *errh)
     else if (_fragments == 1 && input_is_pull(0))
 	return errh->error("'FRAGMENTS true' is incompatible with pull; run this element in a push context");
 
+    // TRACEINFO needs the larger StatFlowInfo
+#if CLICK_USERLEVEL
+    _slot_size = (stats() ? sizeof(StatFlowInfo) : sizeof(FlowInfo));
+#else
+    _slot_size = sizeof(FlowInfo);
+#endif
+
+    // preallocate flow records, or draw them from a shared slab allocator
+    if (!_capacity) {
+	if (!(_flow_alloc = SlabAllocator::shared(_slot_size)))
+	    return errh->error("out of memory");
+    } else {
+	_flow_memory = new char[_capacity * _slot_size];
+	_slots.resize(_capacity);
+	if (!_flow_memory || _slots.size() != (int) _capacity)
+	    return errh->error("out of memory");
+	for (uint32_t i = _capacity; i > 0; --i) {
+	    _slots[i - 1].state = slot_free;
+	    FlowInfo *f = slot_flow(i - 1);
+	    f->_next = _free_flows;
+	    _free_flows = f;
+	}
+    }
+
     return 0;
 }
 
@@ -166,6 +208,10 @@ AggregateIPFlows::cleanup(CleanupStage)
 {
     clean_map(_tcp_map);
     clean_map(_udp_map);
+    delete[] _flow_memory;
+    _flow_memory = 0;
+    for (; _burst_pos < _burst_q.size(); ++_burst_pos)
+	_burst_q[_burst_pos]->kill();
 #if CLICK_USERLEVEL
     if (_traceinfo_file && _traceinfo_file != stdout) {
 	fprintf(_traceinfo_file, "</trace>\n");
@@ -198,12 +244,25 @@ AggregateIPFlows::delete_flowinfo(const HostPair &hp, FlowInfo *finfo, bool real
   <stream dir='0' packets='%d' /><stream dir='1' packets='%d' />\n\
 </flow>\n",
 		sinfo->_packets[0], sinfo->_packets[1]);
-	if (really_delete)
-	    delete sinfo;
+	if (really_delete && !_flow_memory) {
+	    sinfo->~StatFlowInfo();
+	    _flow_alloc->deallocate(sinfo);
+	}
     } else
 #endif
-	if (really_delete)
-	    delete finfo;
+	if (really_delete && !_flow_memory) {
+	    finfo->~FlowInfo();
+	    _flow_alloc->deallocate(finfo);
+	}
+
+    if (really_delete) {
+	if (_flow_memory) {
+	    _slots[slot_index(finfo)].state = slot_free;
+	    finfo->_next = _free_flows;
+	    _free_flows = finfo;
+	}
+	_nflows--;
+    }
 }
 
 void
@@ -266,14 +325,14 @@ AggregateIPFlows::packet_emit_hook(const Packet *p, const click_ip *iph, FlowInf
 }
 
 void
-AggregateIPFlows::reap_map(Map &table, uint32_t timeout, uint32_t done_timeout)
+AggregateIPFlows::reap_map(Map &table, uint32_t timeout, uint32_t done_timeout, bool flows)
 {
     timeout = _active_sec - timeout;
     done_timeout = _active_sec - done_timeout;
     int frag_timeout = _active_sec - _fragment_timeout;
 
     // free completed flows and emit fragments
-    for (Map::iterator iter = table.begin(); iter.live(); iter++) {
+    for (Map::iterator iter = table.begin(); iter.live(); ) {
 	HostPairInfo *hpinfo = &iter.value();
 	Packet *head;
 	// fragments
@@ -283,8 +342,13 @@ AggregateIPFlows::reap_map(Map &table, uint32_t timeout, uint32_t done_timeout)
 	    emit_fragment_head(hpinfo);
 
 	// can't delete any flows if there are fragments
-	if (hpinfo->_fragment_head)
+	if (hpinfo->_fragment_head || !flows) {
+	    if (_flow_memory && !hpinfo->_fragment_head && !hpinfo->_flows)
+		iter = table.erase(iter);
+	    else
+		iter++;
 	    continue;
+	}
 
 	// completed flows
 	FlowInfo **pprev = &hpinfo->_flows;
@@ -299,20 +363,108 @@ AggregateIPFlows::reap_map(Map &table, uint32_t timeout, uint32_t done_timeout)
 		pprev = &f->_next;
 	    f = *pprev;
 	}
-	// XXX never free host pairs
+
+	// XXX never free host pairs, unless flow records are preallocated
+	if (_flow_memory && !hpinfo->_flows)
+	    iter = table.erase(iter);
+	else
+	    iter++;
     }
 }
 
 void
-AggregateIPFlows::reap()
+AggregateIPFlows::reap(bool flows)
 {
     if (_gc_sec) {
-	reap_map(_tcp_map, _tcp_timeout, _tcp_done_timeout);
-	reap_map(_udp_map, _udp_timeout, _udp_timeout);
+	reap_map(_tcp_map, _tcp_timeout, _tcp_done_timeout, flows);
+	reap_map(_udp_map, _udp_timeout, _udp_timeout, flows);
     }
     _gc_sec = _active_sec + _gc_interval;
 }
 
+inline void
+AggregateIPFlows::forget_empty_host_pair(Map &m, const HostPair &hosts, HostPairInfo *hpinfo)
+{
+    // with preallocated flows, the host pair table must stay bounded too
+    if (_flow_memory && !hpinfo->_flows && !hpinfo->_fragment_head)
+	m.erase(hosts);
+}
+
+bool
+AggregateIPFlows::release_flow(Map &m, const HostPair &hosts, FlowInfo *finfo, HostPairInfo *current)
+{
+    // Remove a flow found by the CLOCK hand.  Fragments may refer to the
+    // flow's aggregate, so flows with waiting fragments stay.
+    Map::iterator it = m.find(hosts);
+    HostPairInfo *hpinfo = &it.value();
+    if (hpinfo->_fragment_head)
+	return false;
+
+    FlowInfo **pprev = &hpinfo->_flows;
+    while (*pprev != finfo)
+	pprev = &(*pprev)->_next;
+    *pprev = finfo->_next;
+
+    notify(finfo->_aggregate, AggregateListener::DELETE_AGG, 0);
+    delete_flowinfo(hosts, finfo);
+    if (!hpinfo->_flows && hpinfo != current)
+	m.erase(it);
+    return true;
+}
+
+void
+AggregateIPFlows::clock_step()
+{
+    // check a few flow records for timeouts; this replaces reap_map's sweep
+    // (reference bits are left for alloc_flow_slot)
+    for (int n = clock_batch; n > 0; --n) {
+	uint32_t i = _clock_hand;
+	if (++_clock_hand == _capacity)
+	    _clock_hand = 0;
+	if (_slots[i].state == slot_free)
+	    continue;
+
+	FlowInfo *f = slot_flow(i);
+	Map &m = (_slots[i].state == slot_udp ? _udp_map : _tcp_map);
+	uint32_t timeout = _active_sec - relevant_timeout(f, m);
+	if (SEC_OLDER(f->_last_timestamp.sec(), timeout)) {
+	    HostPairInfo *hpinfo = &m.find(_slots[i].hosts).value();
+	    int frag_timeout = _active_sec - _fragment_timeout;
+	    Packet *head;
+	    while ((head = hpinfo->_fragment_head)
+		   && (head->timestamp_anno().sec() < frag_timeout
+		       || !IP_ISFRAG(good_ip_header(head))))
+		emit_fragment_head(hpinfo);
+	    release_flow(m, _slots[i].hosts, f, 0);
+	}
+    }
+}
+
+void *
+AggregateIPFlows::alloc_flow_slot(HostPairInfo *current)
+{
+    // CLOCK replacement: give recently used flows a second chance, and
+    // evict the first flow whose reference bit is already clear
+    for (uint32_t n = 2 * _capacity; n > 0 && !_free_flows; --n) {
+	uint32_t i = _clock_hand;
+	if (++_clock_hand == _capacity)
+	    _clock_hand = 0;
+	FlowInfo *f = slot_flow(i);
+	if (_slots[i].state == slot_free)
+	    continue;
+	else if (f->_referenced)
+	    f->_referenced = false;
+	else if (release_flow(_slots[i].state == slot_udp ? _udp_map : _tcp_map,
+			      _slots[i].hosts, f, current))
+	    _evictions++;
+    }
+
+    FlowInfo *f = _free_flows;
+    if (f)
+	_free_flows = f->_next;
+    return f;
+}
+
 const click_ip *
 AggregateIPFlows::icmp_encapsulated_header(const Packet *p)
 {
@@ -346,7 +498,7 @@ AggregateIPFlows::relevant_timeout(const FlowInfo *f, const Map &m) const
 // XXX timing when fragments are merged back in?
 
 AggregateIPFlows::FlowInfo *
-AggregateIPFlows::find_flow_info(Map &m, HostPairInfo *hpinfo, uint32_t ports, bool flipped, const Packet *p)
+AggregateIPFlows::find_flow_info(Map &m, const HostPair &hosts, HostPairInfo *hpinfo, uint32_t ports, bool flipped, const Packet *p)
 {
     FlowInfo **pprev = &hpinfo->_flows;
     for (FlowInfo *finfo = *pprev; finfo; pprev = &finfo->_next, finfo = finfo->_next)
@@ -363,9 +515,7 @@ AggregateIPFlows::find_flow_info(Map &m, HostPairInfo *hpinfo, uint32_t ports, b
 		    && (p->tcp_header()->th_flags & TH_SYN))) {
 		// old aggregate has died
 		notify(finfo->aggregate(), AggregateListener::DELETE_AGG, 0);
-		const click_ip *iph = good_ip_header(p);
-		HostPair hp(iph->ip_src.s_addr, iph->ip_dst.s_addr);
-		delete_flowinfo(hp, finfo, false);
+		delete_flowinfo(hosts, finfo, false);
 
 		// make a new aggregate
 		finfo->_aggregate = _next;
@@ -383,18 +533,34 @@ AggregateIPFlows::find_flow_info(Map &m, HostPairInfo *hpinfo, uint32_t ports, b
 	    *pprev = finfo->_next;
 	    finfo->_next = hpinfo->_flows;
 	    hpinfo->_flows = finfo;
+	    finfo->_referenced = true;
 	    return finfo;
 	}
 
     // make and install new FlowInfo pair
+    void *slot;
+    if (_flow_memory)
+	slot = alloc_flow_slot(hpinfo);
+    else
+	slot = _flow_alloc->allocate();
+    if (!slot)
+	return 0;
+
     FlowInfo *finfo;
 #if CLICK_USERLEVEL
     if (stats()) {
-	finfo = new StatFlowInfo(ports, hpinfo->_flows, _next);
+	finfo = new(slot) StatFlowInfo(ports, hpinfo->_flows, _next);
 	stat_new_flow_hook(p, finfo);
     } else
 #endif
-	finfo = new FlowInfo(ports, hpinfo->_flows, _next);
+	finfo = new(slot) FlowInfo(ports, hpinfo->_flows, _next);
+
+    if (_flow_memory) {
+	FlowSlot &fs = _slots[slot_index(finfo)];
+	fs.hosts = hosts;
+	fs.state = (&m == &_udp_map ? slot_udp : slot_tcp);
+    }
+    _nflows++;
 
     finfo->_reverse = flipped;
     hpinfo->_flows = finfo;
@@ -508,9 +674,11 @@ AggregateIPFlows::handle_packet(Packet *p)
     FlowInfo *finfo;
     if (IP_FIRSTFRAG(iph)) {
 	const uint8_t *udp_ptr = reinterpret_cast<const uint8_t *>(iph) + (iph->ip_hl << 2);
-	if (udp_ptr + 4 > p->end_data())
+	if (udp_ptr + 4 > p->end_data()) {
 	    // packet not big enough
+	    forget_empty_host_pair(m, hosts, hpinfo);
 	    return ACT_DROP;
+	}
 
 	uint32_t ports = *reinterpret_cast<const uint32_t *>(udp_ptr);
 	// 1.Jan.08: handle connections where IP addresses are the same (John
@@ -520,9 +688,11 @@ AggregateIPFlows::handle_packet(Packet *p)
 	if (paint & 1)
 	    ports = flip_ports(ports);
 
-	finfo = find_flow_info(m, hpinfo, ports, paint & 1, p);
+	finfo = find_flow_info(m, hosts, hpinfo, ports, paint & 1, p);
 	if (!finfo) {
-	    click_chatter("out of memory!");
+	    if (!_flow_memory)
+		click_chatter("out of memory!");
+	    forget_empty_host_pair(m, hosts, hpinfo);
 	    return ACT_DROP;
 	}
 	if (finfo->reverse())
@@ -540,8 +710,10 @@ AggregateIPFlows::handle_packet(Packet *p)
     // check for fragment
     if ((_fragments && IP_ISFRAG(iph)) || hpinfo->_fragment_head)
 	return handle_fragment(p, hpinfo);
-    else if (!finfo)
+    else if (!finfo) {
+	forget_empty_host_pair(m, hosts, hpinfo);
 	return ACT_DROP;
+    }
 
     // packet emit hook
     _active_sec = p->timestamp_anno().sec();
@@ -556,8 +728,10 @@ AggregateIPFlows::push(int, Packet *p)
     int action = handle_packet(p);
 
     // GC if necessary
+    if (_flow_memory)
+	clock_step();
     if (_active_sec >= _gc_sec)
-	reap();
+	reap(!_flow_memory);
 
     if (action == ACT_EMIT)
 	output(0).push(p);
@@ -565,15 +739,44 @@ AggregateIPFlows::push(int, Packet *p)
 	checked_output_push(1, p);
 }
 
+Packet *
+AggregateIPFlows::pull_burst()
+{
+    if (_burst_pos == _burst_q.size()) {
+	_burst_q.clear();
+	_burst_pos = 0;
+	while (_burst_q.size() < _burst) {
+	    Packet *p = input(0).pull();
+	    if (!p)
+		break;
+	    if (p->has_network_header())
+		click_prefetch0(p->network_header());
+	    _burst_q.push_back(p);
+	}
+	// Prefetch every packet's host pair bucket before processing any.
+	for (int i = 0; i < _burst_q.size(); ++i)
+	    if (_burst_q[i]->has_network_header()) {
+		const click_ip *iph = _burst_q[i]->ip_header();
+		Map &m = (iph->ip_p == IP_PROTO_TCP ? _tcp_map : _udp_map);
+		m.prefetch(HostPair(iph->ip_src.s_addr, iph->ip_dst.s_addr));
+	    }
+	if (!_burst_q.size())
+	    return 0;
+    }
+    return _burst_q[_burst_pos++];
+}
+
 Packet *
 AggregateIPFlows::pull(int)
 {
-    Packet *p = input(0).pull();
+    Packet *p = (_burst > 1 ? pull_burst() : input(0).pull());
     int action = (p ? handle_packet(p) : ACT_NONE);
 
     // GC if necessary
+    if (_flow_memory && p)
+	clock_step();
     if (_active_sec >= _gc_sec)
-	reap();
+	reap(!_flow_memory);
 
     if (action == ACT_EMIT)
 	return p;
@@ -582,7 +785,23 @@ AggregateIPFlows::pull(int)
     return 0;
 }
 
-enum { H_CLEAR };
+enum { H_CLEAR, H_FLOW_COUNT, H_CAPACITY, H_EVICTIONS };
+
+String
+AggregateIPFlows::read_handler(Element *e, void *thunk)
+{
+    AggregateIPFlows *af = static_cast<AggregateIPFlows *>(e);
+    switch ((intptr_t)thunk) {
+      case H_FLOW_COUNT:
+	return String(af->_nflows);
+      case H_CAPACITY:
+	return String(af->_capacity);
+      case H_EVICTIONS:
+	return String(af->_evictions);
+      default:
+	return String();
+    }
+}
 
 int
 AggregateIPFlows::write_handler(const String &, Element *e, void *thunk, ErrorHandler *)
@@ -592,7 +811,7 @@ AggregateIPFlows::write_handler(const String &, Element *e, void *thunk, ErrorHa
       case H_CLEAR: {
 	  int active_sec = af->_active_sec, gc_sec = af->_gc_sec;
 	  af->_active_sec = af->_gc_sec = 0x7FFFFFFF;
-	  af->reap();
+	  af->reap(true);
 	  af->_active_sec = active_sec, af->_gc_sec = gc_sec;
 	  return 0;
       }
@@ -604,6 +823,9 @@ AggregateIPFlows::write_handler(const String &, Element *e, void *thunk, ErrorHa
 void
 AggregateIPFlows::add_handlers()
 {
+    add_read_handler("flow_count", read_handler, H_FLOW_COUNT);
+    add_read_handler("capacity", read_handler, H_CAPACITY);
+    add_read_handler("evictions", read_handler, H_EVICTIONS);
     add_write_handler("clear", write_handler, H_CLEAR);
 }
 
@@ -4,6 +4,8 @@
 #include <click/element.hh>
 #include <click/ipflowid.hh>
 #include <click/hashtable.hh>
+#include <click/vector.hh>
+#include <click/slaballocator.hh>
 #include "aggregatenotifier.hh"
 CLICK_DECLS
 class HandlerCall;
@@ -97,6 +99,28 @@ The timeout for fragments, in seconds, Default is 30 seconds.
 
 The garbage collection interval. Default is 20 minutes of packet time.
 
+=item CAPACITY
+
+Unsigned integer. If nonzero, then AggregateIPFlows tracks at most CAPACITY
+flows at a time, in flow records allocated at initialization. Instead of
+periodically sweeping the whole flow table, AggregateIPFlows then checks a few
+flow records for timeouts per packet. When all records are in use, a new flow
+evicts an old flow that has not seen packets recently (CLOCK replacement).
+Evicted flows are reported to AggregateListeners just like timed-out flows,
+and a later packet on an evicted flow starts a new aggregate. Flows whose
+host pair has fragments waiting are never evicted; if no flow can be
+evicted, the packet is treated like a non-TCP/UDP packet. Default is 0,
+meaning no limit.
+
+=item BURST
+
+Unsigned integer. In a pull context, AggregateIPFlows pulls up to BURST
+packets from its input at a time and prefetches their flow table buckets, so
+that the table lookups for a burst overlap rather than wait on one another.
+Packets are still processed and emitted one per pull. Packets pulled ahead
+are lost if the driver stops while they are waiting, as with packets in a
+Queue. BURST may not be used with SOURCE. Default is 1.
+
 =item ICMP
 
 Boolean. If true, then mark ICMP errors relating to a connection with an
@@ -115,6 +139,18 @@ Default is true in a push context and false in a pull context.
 AggregateIPFlows is an AggregateNotifier, so AggregateListeners can request
 notifications when new aggregates are created and old ones are deleted.
 
+=h flow_count read-only
+
+Returns the number of flows currently tracked.
+
+=h capacity read-only
+
+Returns the CAPACITY setting (0 means no limit).
+
+=h evictions read-only
+
+Returns the number of flows evicted because the flow table was full.
+
 =h clear write-only
 
 Clears all flow information. Future packets will get new aggregate annotation
@@ -183,10 +219,11 @@ class AggregateIPFlows : public Element, public AggregateNotifier { public:
 	Timestamp _last_timestamp;
 	unsigned _flow_over : 2;
 	bool _reverse : 1;
+	bool _referenced : 1;	// CLOCK bit, used only with CAPACITY
 	FlowInfo *_next;
 	// have 24 bytes; statistics would double
 	// + 8 + 8 = 16 bytes
-	FlowInfo(uint32_t ports, FlowInfo *next, uint32_t agg) : _ports(ports), _aggregate(agg), _flow_over(0), _next(next) { }
+	FlowInfo(uint32_t ports, FlowInfo *next, uint32_t agg) : _ports(ports), _aggregate(agg), _flow_over(0), _referenced(true), _next(next) { }
 	uint32_t aggregate() const { return _aggregate; }
 	bool reverse() const	{ return _reverse; }
     };
@@ -208,10 +245,38 @@ class AggregateIPFlows : public Element, public AggregateNotifier { public:
 	FlowInfo *find_force(uint32_t ports);
     };
 
+#if CLICK_USERLEVEL
+    // Open addressing keeps each host pair lookup to about one cache miss.
+    typedef HashTable<HostPair, HostPairInfo, OpenHashContainer> Map;
+#else
     typedef HashTable<HostPair, HostPairInfo> Map;
+#endif
     Map _tcp_map;
     Map _udp_map;
 
+    // With CAPACITY, flow records live in _flow_memory, one per slot.
+    // _slots records each slot's host pair so the CLOCK hand can find the
+    // HostPairInfo that lists the flow.
+    enum { slot_free = 0, slot_tcp = 1, slot_udp = 2, clock_batch = 4 };
+    struct FlowSlot {
+	HostPair hosts;
+	int state;
+    };
+    uint32_t _capacity;
+    char *_flow_memory;
+    size_t _slot_size;
+    SlabAllocator *_flow_alloc;	// without CAPACITY
+    Vector<FlowSlot> _slots;
+    FlowInfo *_free_flows;
+    uint32_t _clock_hand;
+    uint32_t _nflows;
+    uint32_t _evictions;
+
+    // BURST: packets pulled ahead of processing, next is _burst_q[_burst_pos]
+    Vector<Packet *> _burst_q;
+    int _burst_pos;
+    int _burst;
+
     uint32_t _next;
     unsigned _active_sec;
     unsigned _gc_sec;
@@ -239,8 +304,19 @@ class AggregateIPFlows : public Element, public AggregateNotifier { public:
     static const click_ip *icmp_encapsulated_header(const Packet *);
 
     void clean_map(Map &);
-    void reap_map(Map &, uint32_t, uint32_t);
-    void reap();
+    void reap_map(Map &, uint32_t, uint32_t, bool);
+    void reap(bool);
+
+    FlowInfo *slot_flow(uint32_t i) const {
+	return reinterpret_cast<FlowInfo *>(_flow_memory + i * _slot_size);
+    }
+    uint32_t slot_index(const FlowInfo *f) const {
+	return (reinterpret_cast<const char *>(f) - _flow_memory) / _slot_size;
+    }
+    void *alloc_flow_slot(HostPairInfo *);
+    bool release_flow(Map &, const HostPair &, FlowInfo *, HostPairInfo *);
+    inline void forget_empty_host_pair(Map &, const HostPair &, HostPairInfo *);
+    void clock_step();
 
     inline int relevant_timeout(const FlowInfo *, const Map &) const;
 #if CLICK_USERLEVEL
@@ -249,14 +325,16 @@ class AggregateIPFlows : public Element, public AggregateNotifier { public:
     inline void packet_emit_hook(const Packet *, const click_ip *, FlowInfo *);
     inline void delete_flowinfo(const HostPair &, FlowInfo *, bool really_delete = true);
     void emit_fragment_head(HostPairInfo *hpinfo);
-    FlowInfo *find_flow_info(Map &, HostPairInfo *, uint32_t ports, bool flipped, const Packet *);
+    FlowInfo *find_flow_info(Map &, const HostPair &, HostPairInfo *, uint32_t ports, bool flipped, const Packet *);
 
     FlowInfo *uncommon_case(FlowInfo *finfo, const click_ip *iph);
 
     enum { ACT_EMIT, ACT_DROP, ACT_NONE };
     int handle_fragment(Packet *, HostPairInfo *);
     int handle_packet(Packet *);
+    Packet *pull_burst();
 
+    static String read_handler(Element *, void *) CLICK_COLD;
     static int write_handler(const String &, Element *, void *, ErrorHandler *) CLICK_COLD;
 
 };
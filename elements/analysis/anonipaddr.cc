@@ -33,7 +33,6 @@
 CLICK_DECLS
 
 AnonymizeIPAddr::AnonymizeIPAddr()
-    : _root(0), _free(0)
 {
 }
 
@@ -41,22 +40,6 @@ AnonymizeIPAddr::~AnonymizeIPAddr()
 {
 }
 
-AnonymizeIPAddr::Node *
-AnonymizeIPAddr::new_node_block()
-{
-    assert(!_free);
-    int block_size = 1024;
-    Node *block = new Node[block_size];
-    if (!block)
-	return 0;
-    _blocks.push_back(block);
-    for (int i = 1; i < block_size - 1; i++)
-	block[i].child[0] = &block[i+1];
-    block[block_size - 1].child[0] = 0;
-    _free = &block[1];
-    return &block[0];
-}
-
 static inline uint32_t
 rand32()
 {
@@ -101,39 +84,41 @@ AnonymizeIPAddr::configure(Vector<String> &conf, ErrorHandler *errh)
 int
 AnonymizeIPAddr::initialize(ErrorHandler *errh)
 {
-    if (!(_root = new_node()))
-	return errh->error("out of memory!");
-    _root->input = 1;		// use 1 instead of 0 b/c 0.0.0.0 is special
-    _root->output = rand32();
-    _root->child[0] = _root->child[1] = 0;
-    bool root_touched = false;
+    // the first address in the trie seeds the anonymization
+    uint32_t seed = 1;		// use 1 instead of 0 b/c 0.0.0.0 is special
+    uint32_t seed_output = rand32();
+    int preserve_8_start = 0;
 
     // preserve classes
     if (_preserve_class > 0) {
 	assert((0xFFFFFFFFU >> 1) == 0x7FFFFFFFU);
 	uint32_t class_mask = ~(0xFFFFFFFFU >> _preserve_class);
-	_root->input = class_mask;
-	_root->output |= class_mask;
-	root_touched = true;
+	seed = class_mask;
+	seed_output |= class_mask;
+    } else if (_preserve_8.size()) {
+	seed = (_preserve_8[0] << 24);
+	seed_output = (seed_output & 0x00FFFFFF) | seed;
+	preserve_8_start = 1;
     }
 
+    _trie.clear();
+    MultibitTrie::Leaf *l = _trie.find_insert(seed);
+    if (!l)
+	return errh->error("out of memory!");
+    l->value = seed_output;
+
     // preserve requested /8s
-    for (int i = 0; i < _preserve_8.size(); i++) {
+    for (int i = preserve_8_start; i < _preserve_8.size(); i++) {
 	uint32_t addr = (_preserve_8[i] << 24);
-	if (!root_touched) {
-	    _root->input = addr;
-	    _root->output = (_root->output & 0x00FFFFFF) | addr;
-	    root_touched = true;
-	} else if (Node *n = find_node(addr))
-	    n->output = (n->output & 0x00FFFFFF) | addr;
+	if (MultibitTrie::Leaf *n = find_leaf(addr))
+	    n->value = (n->value & 0x00FFFFFF) | addr;
 	else
 	    return errh->error("out of memory!");
     }
 
-    // prepare special nodes for 0.0.0.0 and 255.255.255.255
-    memset(&_special_nodes[0], 0, sizeof(_special_nodes));
-    _special_nodes[0].input = _special_nodes[0].output = 0;
-    _special_nodes[1].input = _special_nodes[1].output = 0xFFFFFFFF;
+    // prepare special leaves for 0.0.0.0 and 255.255.255.255
+    _special_leaves[0].key = _special_leaves[0].value = 0;
+    _special_leaves[1].key = _special_leaves[1].value = 0xFFFFFFFF;
 
     return 0;
 }
@@ -141,9 +126,7 @@ AnonymizeIPAddr::initialize(ErrorHandler *errh)
 void
 AnonymizeIPAddr::cleanup(CleanupStage)
 {
-    for (int i = 0; i < _blocks.size(); i++)
-	delete[] _blocks[i];
-    _blocks.clear();
+    _trie.clear();
 }
 
 uint32_t
@@ -161,77 +144,33 @@ AnonymizeIPAddr::make_output(uint32_t old_output, int swivel) const
     }
 }
 
-AnonymizeIPAddr::Node *
-AnonymizeIPAddr::make_peer(uint32_t a, Node *n)
+MultibitTrie::Leaf *
+AnonymizeIPAddr::find_leaf(uint32_t a)
 {
-    // watch out for special IP addresses, which never make it into the tree
-    if (a == 0 || a == 0xFFFFFFFFU)
-	return &_special_nodes[a & 1];
-
-    /*
-     * become a peer
-     * algo: create two nodes, the two peers.  leave orig node as
-     * the parent of the two new ones.
-     */
-
-    Node *down[2];
-    if (!(down[0] = new_node()))
-	return 0;
-    if (!(down[1] = new_node())) {
-	free_node(down[0]);
+    // Like tcpdpriv: a new address's output copies the output bits of the
+    // existing address with the longest common prefix, up to the first bit
+    // where the addresses differ.
+    MultibitTrie::Leaf *nearest;
+    if (a == 0 || a == 0xFFFFFFFFU) {
+	// special IP addresses never make it into the trie
+	if (MultibitTrie::Leaf *l = _trie.find(a))
+	    return l;
+	return &_special_leaves[a & 1];
+    } else if (MultibitTrie::Leaf *l = _trie.find_insert(a, &nearest)) {
+	if (nearest)
+	    l->value = make_output(nearest->value, ffs_msb(a ^ nearest->key));
+	return l;
+    } else {
+	click_chatter("AnonymizeIPAddr: out of memory!");
 	return 0;
     }
-
-    // swivel is first bit 'a' and 'old->input' differ
-    int swivel = ffs_msb(a ^ n->input);
-    // bitvalue is the value of that bit of 'a'
-    int bitvalue = (a >> (32 - swivel)) & 1;
-
-    down[bitvalue]->input = a;
-    down[bitvalue]->output = make_output(n->output, swivel);
-    down[bitvalue]->child[0] = down[bitvalue]->child[1] = 0;
-
-    *down[1 - bitvalue] = *n;	/* copy orig node down one level */
-
-    n->input = down[1]->input;	/* NB: 1s to the right (0s to the left) */
-    n->output = down[1]->output;
-    n->child[0] = down[0];	/* point to children */
-    n->child[1] = down[1];
-
-    return down[bitvalue];
-}
-
-AnonymizeIPAddr::Node *
-AnonymizeIPAddr::find_node(uint32_t a)
-{
-    // straight outta tcpdpriv
-    Node *n = _root;
-    while (n) {
-	if (n->input == a)
-	    return n;
-	if (!n->child[0])
-	    n = make_peer(a, n);
-	else {
-	    // swivel is the first bit in which the two children differ
-	    int swivel = ffs_msb(n->child[0]->input ^ n->child[1]->input);
-	    if (ffs_msb(a ^ n->input) < swivel) // input differs earlier
-		n = make_peer(a, n);
-	    else if (a & (1 << (32 - swivel)))
-		n = n->child[1];
-	    else
-		n = n->child[0];
-	}
-    }
-
-    click_chatter("AnonymizeIPAddr: out of memory!");
-    return 0;
 }
 
 inline uint32_t
 AnonymizeIPAddr::anonymize_addr(uint32_t a)
 {
-    if (Node *n = find_node(ntohl(a)))
-	return htonl(n->output);
+    if (MultibitTrie::Leaf *l = find_leaf(ntohl(a)))
+	return htonl(l->value);
     else
 	return 0;
 }
@@ -279,6 +218,8 @@ AnonymizeIPAddr::simple_action(Packet *p)
     } else if (WritablePacket *q = p->uniqueify()) {
 	click_ip *iph = q->ip_header();
 	uint32_t src = iph->ip_src.s_addr, dst = iph->ip_dst.s_addr;
+	_trie.prefetch(ntohl(src));
+	_trie.prefetch(ntohl(dst));
 
 	// incrementally update IP checksum according to RFC1624:
 	// new_sum = ~(~old_sum + ~old_halfword + new_halfword)
@@ -315,4 +256,5 @@ AnonymizeIPAddr::llrpc(unsigned command, void *data)
 }
 
 CLICK_ENDDECLS
+ELEMENT_REQUIRES(MultibitTrie)
 EXPORT_ELEMENT(AnonymizeIPAddr)
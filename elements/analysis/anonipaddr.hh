@@ -2,6 +2,7 @@
 #ifndef CLICK_ANONIPADDR_HH
 #define CLICK_ANONIPADDR_HH
 #include <click/element.hh>
+#include "multibittrie.hh"
 CLICK_DECLS
 
 /*
@@ -109,50 +110,19 @@ class AnonymizeIPAddr : public Element { public:
 
   private:
 
-    struct Node {
-	uint32_t input;
-	uint32_t output;
-	Node *child[2];
-    };
-
-    Node *_root;
-    Node *_free;
-    Vector<Node *> _blocks;
-    Node _special_nodes[2];
+    MultibitTrie _trie;
+    MultibitTrie::Leaf _special_leaves[2];
 
     int _preserve_class;
     Vector<uint32_t> _preserve_8;
 
-    Node *new_node();
-    Node *new_node_block();
-    void free_node(Node *);
-
     uint32_t make_output(uint32_t, int) const;
-    Node *make_peer(uint32_t, Node *);
-    Node *find_node(uint32_t);
+    MultibitTrie::Leaf *find_leaf(uint32_t);
     inline uint32_t anonymize_addr(uint32_t);
 
     void handle_icmp(WritablePacket *);
 
 };
 
-inline AnonymizeIPAddr::Node *
-AnonymizeIPAddr::new_node()
-{
-    if (_free) {
-	Node *n = _free;
-	_free = n->child[0];
-	return n;
-    } else
-	return new_node_block();
-}
-
-inline void
-AnonymizeIPAddr::free_node(Node *n)
-{
-    n->child[0] = _free;
-    _free = n;
-}
-
 CLICK_ENDDECLS
 #endif
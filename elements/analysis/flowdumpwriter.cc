@@ -0,0 +1,433 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * flowdumpwriter.{cc,hh} -- background writer threads for per-flow traces
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "flowdumpwriter.hh"
+#include <click/error.hh>
+#include <click/hashtable.hh>
+#include <click/list.hh>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <fcntl.h>
+CLICK_DECLS
+
+namespace {
+struct OpenFile {
+    String filename;
+    int fd;
+    StringAccum buf;
+    List_member<OpenFile> link;
+};
+}
+
+struct FlowDumpWriter::Shard {
+
+    enum { ring_capacity = 1024, write_size = 16384 };
+
+    Ring<Job> jobs;
+    Ring<Result> results;
+    Deque<Job> overflow;	// producer side; writer's once stop is set
+    volatile bool stop;
+    volatile bool sleeping;	// writer waits on wake_cond
+#if HAVE_MULTITHREAD
+    pthread_t thread;
+    pthread_mutex_t wake_lock;
+    pthread_cond_t wake_cond;
+#endif
+
+    // writer side
+    int max_open;
+    HashTable<String, OpenFile *> files;
+    List<OpenFile, &OpenFile::link> lru;	// most recently used first
+    Deque<Result> pending;
+    uint32_t nopens;
+    uint32_t nevictions;
+
+    Shard(int max_open_)
+	: stop(false), sleeping(false), max_open(max_open_), nopens(0),
+	  nevictions(0) {
+	jobs.initialize(ring_capacity);
+	results.initialize(ring_capacity);
+#if HAVE_MULTITHREAD
+	pthread_mutex_init(&wake_lock, 0);
+	pthread_cond_init(&wake_cond, 0);
+#endif
+    }
+    ~Shard() {
+#if HAVE_MULTITHREAD
+	pthread_cond_destroy(&wake_cond);
+	pthread_mutex_destroy(&wake_lock);
+#endif
+    }
+
+    inline void wake();
+    void sleep();
+    void run();
+    void process(Job &j);
+    OpenFile *open(const String &filename, bool truncate);
+    void write_out(OpenFile *of, const char *data, int len);
+    void flush(OpenFile *of);
+    void close(OpenFile *of);
+    void report(const String &filename, const String &error);
+
+};
+
+static String
+create_directories(const String &n)
+{
+    int slash = n.find_right('/');
+    if (slash <= 0)
+	return String();
+    String component = n.substring(0, slash);
+    if (access(component.c_str(), F_OK) >= 0)
+	return String();
+    String err = create_directories(component);
+    if (!err && mkdir(component.c_str(), 0777) < 0 && errno != EEXIST)
+	err = "making directory " + component + ": " + strerror(errno);
+    return err;
+}
+
+void
+FlowDumpWriter::Shard::report(const String &filename, const String &error)
+{
+    Result r;
+    r.filename = filename;
+    r.error = error;
+    if (pending.empty() && results.push(r))
+	return;
+    pending.push_back(r);
+}
+
+OpenFile *
+FlowDumpWriter::Shard::open(const String &filename, bool truncate)
+{
+    if (HashTable<String, OpenFile *>::iterator it = files.find(filename)) {
+	OpenFile *of = it.value();
+	// Flows share standard output, so truncating it must keep their data.
+	if (!truncate || filename == "-") {
+	    lru.erase(of);
+	    lru.push_front(of);
+	    return of;
+	}
+	// a new flow reuses an old flow's filename
+	of->buf.clear();
+	close(of);
+    }
+
+    int fd;
+    if (filename == "-")
+	fd = STDOUT_FILENO;
+    else if (!truncate)
+	fd = ::open(filename.c_str(), O_WRONLY | O_APPEND);
+    else {
+	String err = create_directories(filename);
+	if (err) {
+	    report(filename, err);
+	    return 0;
+	}
+	fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    }
+    if (fd < 0) {
+	report(filename, filename + ": " + strerror(errno));
+	return 0;
+    }
+    ++nopens;
+
+    if (files.size() >= (size_t) max_open) {
+	++nevictions;
+	close(lru.back());
+    }
+
+    OpenFile *of = new OpenFile;
+    of->filename = filename;
+    of->fd = fd;
+    files[filename] = of;
+    lru.push_front(of);
+    return of;
+}
+
+void
+FlowDumpWriter::Shard::write_out(OpenFile *of, const char *data, int len)
+{
+    int pos = 0;
+    while (pos < len) {
+	ssize_t w = ::write(of->fd, data + pos, len - pos);
+	if (w < 0 && errno != EINTR) {
+	    report(of->filename, of->filename + ": " + strerror(errno));
+	    break;
+	} else if (w > 0)
+	    pos += w;
+    }
+}
+
+void
+FlowDumpWriter::Shard::flush(OpenFile *of)
+{
+    write_out(of, of->buf.data(), of->buf.length());
+    of->buf.clear();
+}
+
+void
+FlowDumpWriter::Shard::close(OpenFile *of)
+{
+    if (of->buf.length())
+	flush(of);
+    if (of->fd != STDOUT_FILENO)
+	::close(of->fd);
+    lru.erase(of);
+    files.erase(of->filename);
+    delete of;
+}
+
+void
+FlowDumpWriter::Shard::process(Job &j)
+{
+    if (j.flags & W_UNLINK) {
+	HashTable<String, OpenFile *>::iterator it = files.find(j.filename);
+	if (it) {
+	    it.value()->buf.clear();
+	    close(it.value());
+	}
+	if (::unlink(j.filename.c_str()) < 0)
+	    report(j.filename, j.filename + ": " + strerror(errno));
+	return;
+    }
+
+    OpenFile *of = open(j.filename, j.flags & W_TRUNCATE);
+    if (!of)
+	return;
+    if (!of->buf.length() && j.data.length() >= write_size)
+	write_out(of, j.data.data(), j.data.length());
+    else {
+	of->buf.append(j.data.data(), j.data.length());
+	if (of->buf.length() >= write_size)
+	    flush(of);
+    }
+    if (j.flags & W_CLOSE) {
+	close(of);
+	if (j.flags & W_NOTIFY)
+	    report(j.filename, String());
+    }
+}
+
+/* The producer calls wake() after making work available; the writer
+   sleeps only after announcing it in sleeping and finding no work.  The
+   full fences on both sides mean at least one of them sees the other's
+   write, so a wakeup is never lost, and the producer takes the lock only
+   when the writer is asleep. */
+inline void
+FlowDumpWriter::Shard::wake()
+{
+    click_fence();
+#if HAVE_MULTITHREAD
+    if (sleeping) {
+	pthread_mutex_lock(&wake_lock);
+	pthread_cond_signal(&wake_cond);
+	pthread_mutex_unlock(&wake_lock);
+    }
+#endif
+}
+
+void
+FlowDumpWriter::Shard::sleep()
+{
+#if HAVE_MULTITHREAD
+    pthread_mutex_lock(&wake_lock);
+    sleeping = true;
+    click_fence();
+    // Results waiting for room in their ring wake us via collect().
+    if (jobs.empty() && !stop)
+	pthread_cond_wait(&wake_cond, &wake_lock);
+    sleeping = false;
+    pthread_mutex_unlock(&wake_lock);
+#endif
+}
+
+void
+FlowDumpWriter::Shard::run()
+{
+    Job j;
+    while (1) {
+	while (pending.size() && results.push(pending.front()))
+	    pending.pop_front();
+
+	bool any = false;
+	for (int n = 0; n < ring_capacity && jobs.pop(j); ++n) {
+	    process(j);
+	    any = true;
+	}
+	j = Job();
+	if (any)
+	    continue;
+
+	// Out of work: write everything buffered.
+	for (OpenFile *of = lru.front(); of; of = of->link.next())
+	    if (of->buf.length())
+		flush(of);
+	if (stop) {
+	    click_read_fence();
+	    if (jobs.empty())
+		break;
+	}
+	sleep();
+    }
+
+    // The producer left the jobs that did not fit in the ring.
+    for (; overflow.size(); overflow.pop_front())
+	process(overflow.front());
+    while (OpenFile *of = lru.front())
+	close(of);
+}
+
+
+FlowDumpWriter::FlowDumpWriter()
+    : _nstalls(0)
+{
+}
+
+FlowDumpWriter::~FlowDumpWriter()
+{
+    if (running()) {
+	Vector<String> closed;
+	stop(closed, ErrorHandler::default_handler());
+    }
+}
+
+#if HAVE_MULTITHREAD
+void *
+FlowDumpWriter::thread_main(void *thunk)
+{
+    static_cast<Shard *>(thunk)->run();
+    return 0;
+}
+#endif
+
+int
+FlowDumpWriter::start(int nthreads, int max_open, ErrorHandler *errh)
+{
+#if HAVE_MULTITHREAD
+    assert(!running() && nthreads > 0);
+    int per_thread = (max_open + nthreads - 1) / nthreads;
+    for (int i = 0; i < nthreads; ++i) {
+	Shard *s = new Shard(per_thread > 0 ? per_thread : 1);
+	int err = pthread_create(&s->thread, 0, thread_main, s);
+	if (err) {
+	    delete s;
+	    Vector<String> closed;
+	    stop(closed, errh);
+	    return errh->error("pthread_create: %s", strerror(err));
+	}
+	_shards.push_back(s);
+    }
+    return 0;
+#else
+    (void) nthreads, (void) max_open;
+    return errh->error("writer threads require multithreading support");
+#endif
+}
+
+void
+FlowDumpWriter::stop(Vector<String> &closed, ErrorHandler *errh)
+{
+    // Each writer drains its ring, then takes over the overflow queue.
+    for (int i = 0; i < _shards.size(); ++i) {
+	Shard *s = _shards[i];
+	click_write_fence();
+	s->stop = true;
+	s->wake();
+    }
+#if HAVE_MULTITHREAD
+    for (int i = 0; i < _shards.size(); ++i)
+	pthread_join(_shards[i]->thread, 0);
+#endif
+    // The threads are gone, so their leftover results are safe to read.
+    collect(closed, errh);
+    for (int i = 0; i < _shards.size(); ++i) {
+	Shard *s = _shards[i];
+	for (; s->pending.size(); s->pending.pop_front())
+	    if (s->pending.front().error)
+		errh->error("%s", s->pending.front().error.c_str());
+	    else
+		closed.push_back(s->pending.front().filename);
+	delete s;
+    }
+    _shards.clear();
+}
+
+void
+FlowDumpWriter::write(uint32_t key, const String &filename, const String &data,
+		      int flags)
+{
+    // Writes to standard output all go through one thread, so that flows
+    // do not interleave there.
+    Shard *s = _shards[filename == "-" ? 0 : key % _shards.size()];
+
+    // Copy the filename so that the writer's c_str() never touches memory
+    // the router thread shares.
+    Job j;
+    j.filename = String(filename.data(), filename.length());
+    j.data = data;
+    j.flags = flags;
+
+    while (s->overflow.size() && s->jobs.push(s->overflow.front()))
+	s->overflow.pop_front();
+    if (s->overflow.size() || !s->jobs.push(j)) {
+	s->overflow.push_back(j);
+	++_nstalls;
+    }
+    s->wake();
+}
+
+void
+FlowDumpWriter::collect(Vector<String> &closed, ErrorHandler *errh)
+{
+    Result r;
+    for (int i = 0; i < _shards.size(); ++i) {
+	bool any = false;
+	while (_shards[i]->results.pop(r)) {
+	    if (r.error)
+		errh->error("%s", r.error.c_str());
+	    else
+		closed.push_back(r.filename);
+	    any = true;
+	}
+	// The writer may hold more results that did not fit.
+	if (any)
+	    _shards[i]->wake();
+    }
+}
+
+uint32_t
+FlowDumpWriter::nopens() const
+{
+    uint32_t n = 0;
+    for (int i = 0; i < _shards.size(); ++i)
+	n += _shards[i]->nopens;
+    return n;
+}
+
+uint32_t
+FlowDumpWriter::nevictions() const
+{
+    uint32_t n = 0;
+    for (int i = 0; i < _shards.size(); ++i)
+	n += _shards[i]->nevictions;
+    return n;
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel)
+ELEMENT_PROVIDES(FlowDumpWriter)
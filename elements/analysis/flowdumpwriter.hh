@@ -0,0 +1,136 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_FLOWDUMPWRITER_HH
+#define CLICK_FLOWDUMPWRITER_HH
+#include <click/string.hh>
+#include <click/straccum.hh>
+#include <click/vector.hh>
+#include <click/deque.hh>
+#include <click/atomic.hh>
+#include <click/machine.hh>
+#if HAVE_MULTITHREAD
+# include <pthread.h>
+#endif
+CLICK_DECLS
+class ErrorHandler;
+
+/** @class FlowDumpWriter
+ * @brief Pool of background threads that write per-flow trace files.
+ *
+ * Writes are sharded by key (normally an aggregate annotation), so all
+ * writes to one file are handled in order by the same thread.  Each shard is
+ * fed by a single-producer, single-consumer ring; the producer never blocks.
+ * If a ring is full, jobs wait in a producer-side overflow queue and move to
+ * the ring on later calls.
+ *
+ * Writer threads keep recently used files open, up to a per-thread limit,
+ * and close the least recently used file when they need another.  Small
+ * writes are collected in a per-file buffer and written when the buffer
+ * fills, when the file is closed, or when the thread runs out of work.
+ *
+ * Errors and files closed with W_NOTIFY are reported back to the producer
+ * through a second ring per shard; collect() fetches them.
+ *
+ * Only available if Click was built with multithreading support. */
+class FlowDumpWriter { public:
+
+    enum {
+	W_TRUNCATE = 1,		///< Create or truncate the file first
+	W_CLOSE = 2,		///< Close the file after writing
+	W_UNLINK = 4,		///< Remove the file instead of writing
+	W_NOTIFY = 8		///< Report the file to collect() once closed
+    };
+
+    FlowDumpWriter();
+    ~FlowDumpWriter();
+
+    /** @brief Start @a nthreads writer threads.
+     * @param max_open maximum number of open files, across all threads */
+    int start(int nthreads, int max_open, ErrorHandler *errh);
+
+    /** @brief Write everything queued, then stop the threads.
+     *
+     * Also collects any remaining results, as with collect(). */
+    void stop(Vector<String> &closed, ErrorHandler *errh);
+
+    bool running() const		{ return _shards.size() != 0; }
+
+    /** @brief Queue a write of @a data to @a filename.
+     * @param key sharding key
+     * @param flags W_ flags */
+    void write(uint32_t key, const String &filename, const String &data,
+	       int flags);
+
+    /** @brief Report writer errors to @a errh and append files closed with
+     * W_NOTIFY to @a closed. */
+    void collect(Vector<String> &closed, ErrorHandler *errh);
+
+    uint32_t nstalls() const		{ return _nstalls; }
+    uint32_t nopens() const;
+    uint32_t nevictions() const;
+
+  private:
+
+    struct Job {
+	String filename;
+	String data;
+	int flags;
+    };
+
+    struct Result {
+	String filename;
+	String error;
+    };
+
+    // Single-producer, single-consumer ring.  The producer only writes
+    // _tail, the consumer only writes _head.
+    template <typename T> class Ring { public:
+	Ring()				: _q(0), _head(0), _tail(0) { }
+	~Ring()				{ delete[] _q; }
+	void initialize(uint32_t capacity) {
+	    _q = new T[capacity];
+	    _capacity = capacity;
+	}
+	bool empty() const		{ return _head == _tail; }
+	bool push(const T &x) {
+	    uint32_t t = _tail;
+	    if (t - _head == _capacity)
+		return false;
+	    _q[t % _capacity] = x;
+	    click_write_fence();
+	    _tail = t + 1;
+	    return true;
+	}
+	bool pop(T &x) {
+	    uint32_t h = _head;
+	    if (h == _tail)
+		return false;
+	    click_read_fence();
+	    x = _q[h % _capacity];
+	    _q[h % _capacity] = T();
+	    click_write_fence();
+	    _head = h + 1;
+	    return true;
+	}
+      private:
+	T *_q;
+	uint32_t _capacity;
+	volatile uint32_t _head CLICK_ALIGNED(CLICK_CACHE_LINE_SIZE);
+	volatile uint32_t _tail CLICK_ALIGNED(CLICK_CACHE_LINE_SIZE);
+    };
+
+    struct Shard;
+
+    Vector<Shard *> _shards;
+    uint32_t _nstalls;
+
+#if HAVE_MULTITHREAD
+    static void *thread_main(void *);
+#endif
+
+    FlowDumpWriter(const FlowDumpWriter &);
+    FlowDumpWriter &operator=(const FlowDumpWriter &);
+
+};
+
+CLICK_ENDDECLS
+#endif
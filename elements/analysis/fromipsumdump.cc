@@ -42,9 +42,11 @@ CLICK_DECLS
 #ifdef i386
 # define GET4(p)	ntohl(*reinterpret_cast<const uint32_t *>((p)))
 # define GET2(p)	ntohs(*reinterpret_cast<const uint16_t *>((p)))
+# define PUT4(p, d)	*reinterpret_cast<uint32_t *>((p)) = htonl((d))
 #else
 # define GET4(p)	(((p)[0]<<24) | ((p)[1]<<16) | ((p)[2]<<8) | (p)[3])
 # define GET2(p)	(((p)[0]<<8) | (p)[1])
+# define PUT4(p, d)	do { (p)[0] = (d)>>24; (p)[1] = (d)>>16; (p)[2] = (d)>>8; (p)[3] = (d); } while (0)
 #endif
 #define GET1(p)		((p)[0])
 
@@ -110,7 +112,9 @@ FromIPSummaryDump::configure(Vector<String> &conf, ErrorHandler *errh)
     _allow_nonexistent = allow_nonexistent;
     _have_timing = false;
     _multipacket = multipacket;
-    _have_flowid = _have_aggregate = _binary = false;
+    _have_flowid = _have_aggregate = _binary = _columnar = false;
+    _chunk = String();
+    _chunk_pos = _chunk_record_size = 0;
     if (default_contents)
 	bang_data(default_contents, errh);
     if (default_flowid)
@@ -129,6 +133,15 @@ FromIPSummaryDump::read_binary(String &result, ErrorHandler *errh)
 {
     assert(_binary);
 
+    // records from the current columnar chunk come first
+  again:
+    if (_chunk_pos < _chunk.length()) {
+	result = _chunk.substring(_chunk_pos, _chunk_record_size);
+	_chunk_pos += _chunk_record_size;
+	_ff.set_lineno(_ff.lineno() + 1);
+	return 1;
+    }
+
     uint8_t record_storage[4];
     const uint8_t *record = _ff.get_unaligned(4, record_storage, errh);
     if (!record)
@@ -146,11 +159,86 @@ FromIPSummaryDump::read_binary(String &result, ErrorHandler *errh)
 	    e--;
 	if (e != result.end())
 	    result = result.substring(s, e);
+    } else if (_columnar) {
+	if (read_chunk(result, errh) < 0)
+	    return 0;
+	goto again;
     }
     _ff.set_lineno(_ff.lineno() + 1);
     return (textual ? 2 : 1);
 }
 
+static bool
+decode_delta(uint8_t *rows, int stride, uint32_t n, int width,
+	     const uint8_t *s, const uint8_t *end)
+{
+    for (int w = 0; w < width; w += 4) {
+	uint8_t *x = rows + w;
+	uint32_t prev = 0;
+	for (uint32_t i = 0; i < n; ++i, x += stride) {
+	    uint32_t z = 0;
+	    for (int shift = 0; ; shift += 7) {
+		if (s == end || shift > 28)
+		    return false;
+		z |= (uint32_t) (*s & 0x7F) << shift;
+		if (!(*s++ & 0x80))
+		    break;
+	    }
+	    prev += (z >> 1) ^ -(z & 1);
+	    PUT4(x, prev);
+	}
+    }
+    return s == end;
+}
+
+int
+FromIPSummaryDump::read_chunk(const String &body, ErrorHandler *errh)
+{
+    // Decode the chunk's columns back into consecutive binary records.
+    const uint8_t *s = reinterpret_cast<const uint8_t *>(body.data());
+    const uint8_t *end = s + body.length();
+    if (end - s < 8)
+	return _ff.error(errh, "columnar chunk too short");
+    uint32_t n = GET4(s), ncolumns = GET4(s + 4);
+    s += 8;
+    if ((uint64_t) ncolumns * 8 > (uint64_t) (end - s))
+	return _ff.error(errh, "columnar chunk too short");
+    const uint8_t *column = s;
+    s += ncolumns * 8;
+
+    uint32_t record_size = 0;
+    for (uint32_t i = 0; i < ncolumns; ++i)
+	record_size += column[8 * i + 1];
+    if (n && (record_size == 0 || (uint64_t) n * record_size >= 0x80000000U))
+	return _ff.error(errh, "bad columnar chunk");
+
+    StringAccum sa;
+    uint8_t *rows = reinterpret_cast<uint8_t *>(sa.extend(n * record_size));
+    if (n && !rows)
+	return _ff.error(errh, strerror(ENOMEM));
+    int offset = 0;
+    for (uint32_t i = 0; i < ncolumns; ++i, column += 8) {
+	int width = column[1];
+	uint32_t length = GET4(column + 4);
+	if (length > (uint32_t) (end - s))
+	    return _ff.error(errh, "columnar chunk too short");
+	if (column[0] == IPSummaryDump::C_RAW && length == n * width) {
+	    for (uint32_t j = 0; j < n; ++j)
+		memcpy(rows + j * record_size + offset, s + j * width, width);
+	} else if (column[0] != IPSummaryDump::C_DELTA
+		   || width % 4 != 0
+		   || !decode_delta(rows + offset, record_size, n, width, s, s + length))
+	    return _ff.error(errh, "bad columnar chunk");
+	s += length;
+	offset += width;
+    }
+
+    _chunk = sa.take_string();
+    _chunk_pos = 0;
+    _chunk_record_size = record_size;
+    return 0;
+}
+
 int
 FromIPSummaryDump::initialize(ErrorHandler *errh)
 {
@@ -200,6 +288,8 @@ void
 FromIPSummaryDump::cleanup(CleanupStage)
 {
     _ff.cleanup();
+    _chunk = String();
+    _chunk_pos = 0;
     if (_work_packet)
 	_work_packet->kill();
     _work_packet = 0;
@@ -229,6 +319,7 @@ FromIPSummaryDump::bang_data(const String &line, ErrorHandler *errh)
 
     _fields.clear();
     _field_order.clear();
+    _field_fast.clear();
     for (int i = 0; i < words.size(); i++) {
 	String word = cp_unquote(words[i]);
 	if (i == 0 && (word == "!data" || word == "!contents"))
@@ -243,6 +334,7 @@ FromIPSummaryDump::bang_data(const String &line, ErrorHandler *errh)
 	}
 	_fields.push_back(f);
 	_field_order.push_back(_fields.size() - 1);
+	_field_fast.push_back(fast_kind(f));
     }
 
     if (_fields.size() == 0)
@@ -325,6 +417,109 @@ FromIPSummaryDump::bang_binary(const String &line, ErrorHandler *errh)
     _ff.set_lineno(1);
 }
 
+void
+FromIPSummaryDump::bang_columnar(const String &line, ErrorHandler *errh)
+{
+    bang_binary(String::make_stable("!binary", 7), errh);
+    Vector<String> words;
+    cp_spacevec(line, words);
+    if (words.size() != 1)
+	_ff.error(errh, "bad !columnar specification");
+    _columnar = true;
+}
+
+int
+FromIPSummaryDump::fast_kind(const IPSummaryDump::FieldReader *f)
+{
+    if (f->ina == IPSummaryDump::num_ina && f->type != IPSummaryDump::B_8)
+	return fast_uint;
+    else if (strcmp(f->name, "ip_src") == 0 || strcmp(f->name, "ip_dst") == 0)
+	return fast_ip_addr;
+    else if (strcmp(f->name, "ip_proto") == 0)
+	return fast_ip_proto;
+    else if (strcmp(f->name, "timestamp") == 0
+	     || strcmp(f->name, "first_timestamp") == 0)
+	return fast_timestamp;
+    else
+	return fast_none;
+}
+
+// Parse a decimal number of at most 10 digits, stopping at the first
+// nondigit.  Returns the end of the digits, or null on overflow or if there
+// are no digits.
+static inline const char *
+fast_decimal(const char *s, const char *end, uint32_t &v)
+{
+    const char *first = s;
+    uint64_t x = 0;
+    for (; s != end && (unsigned char) (*s - '0') <= 9; ++s)
+	x = x * 10 + (*s - '0');
+    if (s == first || s - first > 10 || x > 0xFFFFFFFFU)
+	return 0;
+    v = x;
+    return s;
+}
+
+/* Parse the common numeric forms of frequently used fields in place.  Other
+   spellings, such as hexadecimal or octal numbers (a leading zero means
+   octal to IntArg), host names, or timestamps with exponents, return false;
+   the caller then uses the field's own parser. */
+bool
+FromIPSummaryDump::fast_ina(int kind, IPSummaryDump::PacketOdesc &d,
+			    const char *s, const char *end,
+			    const IPSummaryDump::FieldReader *f)
+{
+    switch (kind) {
+    case fast_uint: {
+	const char *n = fast_decimal(s, end, d.v);
+	if (n != end || (*s == '0' && n != s + 1))
+	    return false;
+	return !((f->type == IPSummaryDump::B_1 && d.v > 255)
+		 || (f->type == IPSummaryDump::B_2 && d.v > 65535));
+    }
+    case fast_ip_addr: {
+	uint8_t *a = d.u8;
+	for (int i = 0; i < 4; ++i) {
+	    uint32_t x;
+	    const char *n = fast_decimal(s, end, x);
+	    if (!n || x > 255 || (*s == '0' && n != s + 1)
+		|| (i < 3 ? n == end || *n != '.' : n != end))
+		return false;
+	    a[i] = x;
+	    s = n + 1;
+	}
+	return true;
+    }
+    case fast_ip_proto:
+	if (end == s + 1 && (*s == 'T' || *s == 'U' || *s == 'I')) {
+	    d.v = (*s == 'T' ? IP_PROTO_TCP : (*s == 'U' ? IP_PROTO_UDP : IP_PROTO_ICMP));
+	    return true;
+	}
+	if (fast_decimal(s, end, d.v) != end || (*s == '0' && end != s + 1))
+	    return false;
+	return d.v < 256;
+    case fast_timestamp: {
+	if (!(s = fast_decimal(s, end, d.u32[0])))
+	    return false;
+	d.u32[1] = 0;
+	if (s == end)
+	    return true;
+	else if (*s != '.' || end - s > 10)
+	    return false;
+	const char *frac = s + 1;
+	if (frac == end)
+	    return true;
+	if (fast_decimal(frac, end, d.u32[1]) != end)
+	    return false;
+	for (int i = end - frac; i < 9; ++i)
+	    d.u32[1] *= 10;
+	return true;
+    }
+    default:
+	return false;
+    }
+}
+
 static void
 set_checksums(WritablePacket *q, click_ip *iph)
 {
@@ -395,6 +590,8 @@ FromIPSummaryDump::read_packet(ErrorHandler *errh)
 		bang_aggregate(line, errh);
 	    else if (data + 8 <= end && memcmp(data, "!binary", 7) == 0 && isspace((unsigned char) data[7]))
 		bang_binary(line, errh);
+	    else if (data + 10 <= end && memcmp(data, "!columnar", 9) == 0 && isspace((unsigned char) data[9]))
+		bang_columnar(line, errh);
 	    else if (data + 10 <= end && memcmp(data, "!contents", 9) == 0 && isspace((unsigned char) data[9]))
 		bang_data(line, errh);
 	}
@@ -477,9 +674,11 @@ FromIPSummaryDump::read_packet(ErrorHandler *errh)
 	}
 
     } else {
-	Vector<String> args;
-	while (args.size() < _fields.size()) {
-	    const char *original_data = data;
+	// split the line in place: field i is [_field_text[2*i], _field_text[2*i+1])
+	_field_text.resize(_fields.size() * 2);
+	const char **tp = _field_text.begin();
+	for (int i = 0; i < _fields.size(); ++i) {
+	    *tp++ = data;
 	    while (data < end)
 		if (isspace((unsigned char) *data))
 		    break;
@@ -487,7 +686,7 @@ FromIPSummaryDump::read_packet(ErrorHandler *errh)
 		    data = cp_skip_double_quote(data, end);
 		else
 		    ++data;
-	    args.push_back(line.substring(original_data, data));
+	    *tp++ = data;
 	    while (data < end && isspace((unsigned char) *data))
 		++data;
 	}
@@ -496,10 +695,12 @@ FromIPSummaryDump::read_packet(ErrorHandler *errh)
 	     fip != _field_order.end() && d.p;
 	     ++fip) {
 	    const IPSummaryDump::FieldReader *f = _fields[*fip];
-	    if (!args[*fip] || args[*fip].equals("-", 1) || !f->inject)
+	    const char *s = _field_text[2 * *fip], *e = _field_text[2 * *fip + 1];
+	    if (s == e || (e == s + 1 && *s == '-') || !f->inject)
 		continue;
 	    d.clear_values();
-	    if (f->ina(d, args[*fip], f)) {
+	    if (fast_ina(_field_fast[*fip], d, s, e, f)
+		|| f->ina(d, line.substring(s, e), f)) {
 		f->inject(d, f);
 		nfields++;
 	    }
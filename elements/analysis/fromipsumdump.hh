@@ -28,6 +28,9 @@ output. Optionally stops the driver when there are no more packets.
 The file may be compressed with gzip(1) or bzip2(1); FromIPSummaryDump will
 run zcat(1) or bzcat(1) to uncompress it.
 
+FromIPSummaryDump reads ASCII, binary, and columnar dumps (see
+ToIPSummaryDump for the formats).
+
 FromIPSummaryDump reads from the file named FILENAME unless FILENAME is a
 single dash 'C<->', in which case it reads from the standard input. It will
 not uncompress the standard input, however.
@@ -181,6 +184,8 @@ class FromIPSummaryDump : public Element, public IPSummaryDumpInfo { public:
 
     Vector<const IPSummaryDump::FieldReader *> _fields;
     Vector<int> _field_order;
+    Vector<int> _field_fast;
+    Vector<const char *> _field_text;
     uint16_t _default_proto;
     uint32_t _sampling_prob;
     IPFlowID _flowid;
@@ -195,6 +200,7 @@ class FromIPSummaryDump : public Element, public IPSummaryDumpInfo { public:
     bool _have_flowid : 1;
     bool _have_aggregate : 1;
     bool _binary : 1;
+    bool _columnar : 1;
     bool _timing : 1;
     bool _have_timing : 1;
     bool _allow_nonexistent : 1;
@@ -204,6 +210,10 @@ class FromIPSummaryDump : public Element, public IPSummaryDumpInfo { public:
     Timestamp _multipacket_end_timestamp;
     Timestamp _timing_offset;
 
+    String _chunk;
+    int _chunk_pos;
+    int _chunk_record_size;
+
     Task _task;
     ActiveNotifier _notifier;
     Timer _timer;
@@ -212,6 +222,11 @@ class FromIPSummaryDump : public Element, public IPSummaryDumpInfo { public:
     IPFlowID _given_flowid;
 
     int read_binary(String &, ErrorHandler *);
+    int read_chunk(const String &, ErrorHandler *);
+
+    enum { fast_none, fast_uint, fast_ip_addr, fast_ip_proto, fast_timestamp };
+    static int fast_kind(const IPSummaryDump::FieldReader *);
+    static bool fast_ina(int, IPSummaryDump::PacketOdesc &, const char *, const char *, const IPSummaryDump::FieldReader *);
 
     static int sort_fields_compare(const void *, const void *, void *);
     void bang_data(const String &, ErrorHandler *);
@@ -219,6 +234,7 @@ class FromIPSummaryDump : public Element, public IPSummaryDumpInfo { public:
     void bang_flowid(const String &, ErrorHandler *);
     void bang_aggregate(const String &, ErrorHandler *);
     void bang_binary(const String &, ErrorHandler *);
+    void bang_columnar(const String &, ErrorHandler *);
     void check_defaults();
     bool check_timing(Packet *p);
     Packet *read_packet(ErrorHandler *);
@@ -106,6 +106,13 @@ enum {
     B_NOTALLOWED = -1
 };
 
+// column encodings in columnar dumps
+enum {
+    C_RAW = 0,			// field bytes, one record after another
+    C_DELTA = 1			// each 4-byte word as a varint of the zigzag
+				// delta from the previous record's word
+};
+
 struct FieldWriter {
     const char *name;           // must come first
     int type;
@@ -0,0 +1,303 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * latencyhistogram.{cc,hh} -- collect a histogram of packet latencies
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "latencyhistogram.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/integers.hh>
+#include <click/master.hh>
+#include <click/straccum.hh>
+CLICK_DECLS
+
+LatencyHistogram::LatencyHistogram()
+    : _threads(0), _nthreads(0)
+{
+}
+
+LatencyHistogram::~LatencyHistogram()
+{
+}
+
+int
+LatencyHistogram::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    Timestamp max(60);
+    String percentiles = "50 90 99 99.9 99.99";
+    _precision = 7;
+    _reset_on_read = false;
+    if (Args(conf, this, errh)
+	.read("PRECISION", _precision)
+	.read("MAX", max)
+	.read("PERCENTILES", AnyArg(), percentiles)
+	.read("RESET_ON_READ", _reset_on_read)
+	.complete() < 0)
+	return -1;
+    if (_precision < 2 || _precision > 12)
+	return errh->error("PRECISION must be between 2 and 12");
+    if (max.sec() < 0 || !max)
+	return errh->error("MAX must be positive");
+    _max_value = max.nsecval();
+
+    Vector<String> words;
+    cp_spacevec(percentiles, words);
+    _percentiles.clear();
+    for (String *w = words.begin(); w != words.end(); ++w) {
+	double p;
+	if (!DoubleArg().parse(*w, p) || p < 0 || p > 100)
+	    return errh->error("bad percentile %<%s%>", w->c_str());
+	_percentiles.push_back(p);
+    }
+    return 0;
+}
+
+int
+LatencyHistogram::initialize(ErrorHandler *errh)
+{
+    _nbuckets = bucket(_max_value) + 1;
+#if HAVE_MULTITHREAD
+    _nthreads = click_max_cpu_ids() + 1;
+#else
+    _nthreads = 2;
+#endif
+    _generation = 0;
+    if (!(_threads = new Thread[_nthreads]))
+	return errh->error("out of memory");
+    memset(_threads, 0, sizeof(Thread) * _nthreads);
+    for (int i = 0; i < _nthreads; ++i) {
+	_threads[i].buckets = new uint64_t[_nbuckets];
+	_threads[i].base_buckets = new uint64_t[_nbuckets];
+	if (!_threads[i].buckets || !_threads[i].base_buckets)
+	    return errh->error("out of memory");
+	memset(_threads[i].buckets, 0, sizeof(uint64_t) * _nbuckets);
+	memset(_threads[i].base_buckets, 0, sizeof(uint64_t) * _nbuckets);
+    }
+    return 0;
+}
+
+void
+LatencyHistogram::cleanup(CleanupStage)
+{
+    for (int i = 0; _threads && i < _nthreads; ++i) {
+	delete[] _threads[i].buckets;
+	delete[] _threads[i].base_buckets;
+    }
+    delete[] _threads;
+    _threads = 0;
+}
+
+/* Values below 2^PRECISION have their own buckets.  A larger value with
+   b significant bits is shifted right by e = b - PRECISION, leaving a
+   mantissa m in [2^(PRECISION-1), 2^PRECISION); its bucket is
+   e * 2^(PRECISION-1) + m, which continues the exact range without gaps. */
+inline uint32_t
+LatencyHistogram::bucket(uint64_t value) const
+{
+    if (value > _max_value)
+	value = _max_value;
+    if (value < ((uint64_t) 1 << _precision))
+	return value;
+    int e = 64 - ffs_msb(value) - (_precision - 1);
+    return (e << (_precision - 1)) + (uint32_t) (value >> e);
+}
+
+uint64_t
+LatencyHistogram::bucket_low(uint32_t i) const
+{
+    if (i < (1U << _precision))
+	return i;
+    int e = (i >> (_precision - 1)) - 1;
+    return (uint64_t) (i - (e << (_precision - 1))) << e;
+}
+
+/* Returns the running thread's own histogram index, or -1 if it has none,
+   since two threads must never count into the same unlocked histogram. */
+inline unsigned
+LatencyHistogram::thread_slot()
+{
+#if CLICK_USERLEVEL && HAVE_MULTITHREAD && HAVE___THREAD_STORAGE_CLASS
+    // Threads other than router threads have no identifier of their own.
+    if (!(click_current_thread_id & 0x40000000))
+	return (unsigned) -1;
+#elif CLICK_USERLEVEL && HAVE_MULTITHREAD
+    // sched_getcpu() can name the same CPU in two threads at once.
+    return (unsigned) -1;
+#endif
+    return click_current_cpu_id();
+}
+
+inline void
+LatencyHistogram::record(Thread &t, uint64_t v)
+{
+    ++t.buckets[bucket(v)];
+    t.sum += v;
+    // A maximum from before the last reset does not count.
+    uint32_t generation = _generation;
+    if (v > t.max || t.max_generation != generation) {
+	t.max = v;
+	t.max_generation = generation;
+    }
+}
+
+Packet *
+LatencyHistogram::simple_action(Packet *p)
+{
+    const Timestamp &ts = p->timestamp_anno();
+    if (ts) {
+	Timestamp::value_type d = (Timestamp::now() - ts).nsecval();
+	uint64_t v = d > 0 ? d : 0;
+	unsigned slot = thread_slot();
+	if (slot < (unsigned) _nthreads - 1)
+	    record(_threads[slot], v);
+	else {
+	    _shared_lock.acquire();
+	    record(_threads[_nthreads - 1], v);
+	    _shared_lock.release();
+	}
+    }
+    return p;
+}
+
+void
+LatencyHistogram::snapshot(Snapshot &s) const
+{
+    s.count = s.sum = s.max = 0;
+    s.buckets.assign(_nbuckets, 0);
+    uint32_t generation = _generation;
+    for (int i = 0; i < _nthreads; ++i) {
+	const Thread &t = _threads[i];
+	s.sum += t.sum - t.base_sum;
+	if (t.max_generation == generation && t.max > s.max)
+	    s.max = t.max;
+	for (uint32_t b = 0; b < _nbuckets; ++b)
+	    s.buckets[b] += t.buckets[b] - t.base_buckets[b];
+    }
+    // Count from the buckets, so that percentiles are consistent even as
+    // packets arrive.
+    for (uint32_t b = 0; b < _nbuckets; ++b)
+	s.count += s.buckets[b];
+}
+
+uint64_t
+LatencyHistogram::percentile(const Snapshot &s, double p) const
+{
+    if (!s.count)
+	return 0;
+    uint64_t rank = (uint64_t) (s.count * p / 100);
+    if (rank < s.count * p / 100 || rank == 0)
+	++rank;
+    uint64_t seen = 0;
+    for (uint32_t b = 0; b < _nbuckets; ++b)
+	if ((seen += s.buckets[b]) >= rank) {
+	    uint64_t high = bucket_low(b + 1) - 1;
+	    return high < s.max ? high : s.max;
+	}
+    return s.max;
+}
+
+void
+LatencyHistogram::reset()
+{
+    ++_generation;
+    for (int i = 0; i < _nthreads; ++i) {
+	Thread &t = _threads[i];
+	t.base_sum = t.sum;
+	memcpy(t.base_buckets, t.buckets, sizeof(uint64_t) * _nbuckets);
+    }
+}
+
+enum { h_count, h_mean, h_max, h_percentiles, h_summary, h_histogram };
+
+String
+LatencyHistogram::read_handler(Element *e, void *thunk)
+{
+    LatencyHistogram *lh = static_cast<LatencyHistogram *>(e);
+    Snapshot s;
+    lh->snapshot(s);
+    StringAccum sa;
+    switch ((intptr_t) thunk) {
+    case h_count:
+	sa << s.count;
+	break;
+    case h_mean:
+	sa << (s.count ? int_divide(s.sum, s.count) : 0);
+	break;
+    case h_max:
+	sa << s.max;
+	break;
+    case h_percentiles:
+	for (int i = 0; i < lh->_percentiles.size(); ++i)
+	    sa << lh->_percentiles[i] << ' '
+	       << lh->percentile(s, lh->_percentiles[i]) << '\n';
+	break;
+    case h_summary:
+	sa << "count " << s.count << '\n'
+	   << "mean " << (s.count ? int_divide(s.sum, s.count) : 0) << '\n'
+	   << "max " << s.max << '\n';
+	for (int i = 0; i < lh->_percentiles.size(); ++i)
+	    sa << 'p' << lh->_percentiles[i] << ' '
+	       << lh->percentile(s, lh->_percentiles[i]) << '\n';
+	if (lh->_reset_on_read)
+	    lh->reset();
+	break;
+    case h_histogram:
+	for (uint32_t b = 0; b < lh->_nbuckets; ++b)
+	    if (s.buckets[b])
+		sa << lh->bucket_low(b) << ' ' << lh->bucket_low(b + 1) - 1
+		   << ' ' << s.buckets[b] << '\n';
+	if (lh->_reset_on_read)
+	    lh->reset();
+	break;
+    }
+    return sa.take_string();
+}
+
+int
+LatencyHistogram::percentile_handler(int, String &str, Element *e, const Handler *, ErrorHandler *errh)
+{
+    LatencyHistogram *lh = static_cast<LatencyHistogram *>(e);
+    double p;
+    if (!DoubleArg().parse(cp_uncomment(str), p) || p < 0 || p > 100)
+	return errh->error("expected percentile between 0 and 100");
+    Snapshot s;
+    lh->snapshot(s);
+    str = String(lh->percentile(s, p));
+    return 0;
+}
+
+int
+LatencyHistogram::reset_handler(const String &, Element *e, void *, ErrorHandler *)
+{
+    static_cast<LatencyHistogram *>(e)->reset();
+    return 0;
+}
+
+void
+LatencyHistogram::add_handlers()
+{
+    add_read_handler("count", read_handler, h_count);
+    add_read_handler("mean", read_handler, h_mean);
+    add_read_handler("max", read_handler, h_max);
+    add_read_handler("percentiles", read_handler, h_percentiles);
+    add_read_handler("summary", read_handler, h_summary);
+    add_read_handler("histogram", read_handler, h_histogram);
+    set_handler("percentile", Handler::f_read | Handler::f_read_param, percentile_handler);
+    add_write_handler("reset", reset_handler, 0, Handler::f_button);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(int64)
+EXPORT_ELEMENT(LatencyHistogram)
+ELEMENT_MT_SAFE(LatencyHistogram)
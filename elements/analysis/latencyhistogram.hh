@@ -0,0 +1,178 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_LATENCYHISTOGRAM_HH
+#define CLICK_LATENCYHISTOGRAM_HH
+#include <click/element.hh>
+#include <click/timestamp.hh>
+#include <click/sync.hh>
+CLICK_DECLS
+
+/*
+=c
+
+LatencyHistogram([I<keywords> PRECISION, MAX, PERCENTILES, RESET_ON_READ])
+
+=s timestamps
+
+collects a histogram of packet latencies
+
+=d
+
+For each passing packet, measures the elapsed time since the packet's
+timestamp annotation, in nanoseconds, and counts it in a histogram.
+Packets whose timestamp annotation is zero are not counted.  Elapsed times
+less than zero count as zero.
+
+The histogram has HDR-style buckets: a value with I<b> significant bits
+falls in a bucket of width 1 if I<b> is at most PRECISION, and of width
+2^(I<b> - PRECISION) otherwise.  Every value is thus recorded with a
+relative error below 2^(1 - PRECISION), however large it is, in a few
+kilobytes of counters.  Percentiles are reported as the highest value in
+their bucket, so they never understate the latency, but never exceed the
+maximum recorded value.
+
+Each router thread counts into its own histogram, without locks or atomic
+operations, so LatencyHistogram costs only a clock read and a few
+increments per packet.  Other threads share one histogram under a lock.
+Handlers merge the histograms.  Resetting does not
+touch the counters packets update: it records their current values, and
+later reports count from there.
+
+Keyword arguments are:
+
+=over 8
+
+=item PRECISION
+
+Integer between 2 and 12.  The number of significant bits kept per value.
+Default is 7, for errors below 1.6%.
+
+=item MAX
+
+Time value.  Elapsed times greater than MAX count as MAX, though the C<max>
+handler still reports the largest time exactly.  Default is 60 seconds.
+
+=item PERCENTILES
+
+Space-separated list of the percentiles reported by the C<percentiles> and
+C<summary> handlers.  Default is "50 90 99 99.9 99.99".
+
+=item RESET_ON_READ
+
+Boolean.  If true, reading the C<summary> or C<histogram> handler resets
+the histogram, so each read covers the packets since the previous one.
+Default is false.
+
+=back
+
+All times reported by handlers are in nanoseconds, and cover the packets
+since the last reset.
+
+=h count read-only
+
+Returns the number of packets counted.
+
+=h mean read-only
+
+Returns the mean latency.
+
+=h max read-only
+
+Returns the largest latency.
+
+=h percentile read-only
+
+Takes a percentile between 0 and 100 as a parameter and returns the
+latency at that percentile.  For example, reading "percentile 99.9"
+returns the latency that 99.9% of packets did not exceed.
+
+=h percentiles read-only
+
+Returns one line per PERCENTILES value, "PERCENTILE LATENCY".
+
+=h summary read-only
+
+Returns lines "count N", "mean LATENCY", "max LATENCY", and then
+"pPERCENTILE LATENCY" for each PERCENTILES value.  Resets the histogram if
+RESET_ON_READ is true.
+
+=h histogram read-only
+
+Returns one line per nonempty bucket, "LOW HIGH COUNT": COUNT packets had
+latencies between LOW and HIGH inclusive.  Resets the histogram if
+RESET_ON_READ is true.
+
+=h reset write-only
+
+Resets the histogram.
+
+=e
+
+Report forwarding latency percentiles every second:
+
+  FromDevice(eth0) -> ... -> lh :: LatencyHistogram(RESET_ON_READ true)
+      -> Queue -> ToDevice(eth1);
+  Script(TYPE ACTIVE, wait 1s, print $(lh.summary), loop);
+
+=a SetTimestamp, TimestampAccum, StoreTimestamp */
+
+class LatencyHistogram : public Element { public:
+
+    LatencyHistogram() CLICK_COLD;
+    ~LatencyHistogram() CLICK_COLD;
+
+    const char *class_name() const	{ return "LatencyHistogram"; }
+    const char *port_count() const	{ return PORTS_1_1; }
+
+    int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
+    int initialize(ErrorHandler *) CLICK_COLD;
+    void cleanup(CleanupStage) CLICK_COLD;
+    void add_handlers() CLICK_COLD;
+
+    Packet *simple_action(Packet *);
+
+  private:
+
+    struct Thread {
+	// written by the thread's packets
+	uint64_t sum;
+	uint64_t max;
+	uint32_t max_generation;
+	uint64_t *buckets;
+	// written on reset
+	uint64_t base_sum;
+	uint64_t *base_buckets;
+    } CLICK_ALIGNED(CLICK_CACHE_LINE_SIZE);
+
+    struct Snapshot {
+	uint64_t count;
+	uint64_t sum;
+	uint64_t max;
+	Vector<uint64_t> buckets;
+    };
+
+    Thread *_threads;
+    int _nthreads;			// the last is shared by other threads
+    SimpleSpinlock _shared_lock;
+    int _precision;
+    uint32_t _nbuckets;
+    uint64_t _max_value;
+    volatile uint32_t _generation;
+    bool _reset_on_read;
+    Vector<double> _percentiles;
+
+    static inline unsigned thread_slot();
+    inline void record(Thread &t, uint64_t v);
+    inline uint32_t bucket(uint64_t value) const;
+    uint64_t bucket_low(uint32_t i) const;
+    void snapshot(Snapshot &s) const;
+    uint64_t percentile(const Snapshot &s, double p) const;
+    void reset();
+
+    static String read_handler(Element *, void *) CLICK_COLD;
+    static int percentile_handler(int, String &, Element *, const Handler *, ErrorHandler *);
+    static int reset_handler(const String &, Element *, void *, ErrorHandler *);
+
+};
+
+CLICK_ENDDECLS
+#endif
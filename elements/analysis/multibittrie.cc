@@ -0,0 +1,191 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * multibittrie.{cc,hh} -- multibit trie mapping 32-bit keys to values
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "multibittrie.hh"
+#include <click/integers.hh>	// for ffs_msb
+CLICK_DECLS
+
+MultibitTrie::MultibitTrie()
+{
+    clear();
+}
+
+MultibitTrie::~MultibitTrie()
+{
+    for (int i = 0; i < _node_memory.size(); ++i)
+	delete[] _node_memory[i];
+    for (int i = 0; i < _leaf_chunks.size(); ++i)
+	delete[] _leaf_chunks[i];
+}
+
+void
+MultibitTrie::clear()
+{
+    memset(_root, 0, sizeof(_root));
+    _nnodes = 1;		// node 0 is never used
+    _nleaves = 0;
+}
+
+void
+MultibitTrie::swap(MultibitTrie &x)
+{
+    for (int i = 0; i < root_width; ++i) {
+	uint32_t s = _root[i];
+	_root[i] = x._root[i];
+	x._root[i] = s;
+    }
+    _node_chunks.swap(x._node_chunks);
+    _node_memory.swap(x._node_memory);
+    _leaf_chunks.swap(x._leaf_chunks);
+    uint32_t n = _nnodes;
+    _nnodes = x._nnodes;
+    x._nnodes = n;
+    n = _nleaves;
+    _nleaves = x._nleaves;
+    x._nleaves = n;
+}
+
+bool
+MultibitTrie::reserve(uint32_t nnodes)
+{
+    while (_nnodes + nnodes > (uint32_t) _node_chunks.size() * chunk_size) {
+	// align chunks so that every node occupies exactly one cache line
+	char *mem = new char[chunk_size * sizeof(Node) + CLICK_CACHE_LINE_SIZE - 1];
+	if (!mem)
+	    return false;
+	uintptr_t x = reinterpret_cast<uintptr_t>(mem) + CLICK_CACHE_LINE_SIZE - 1;
+	x -= x % CLICK_CACHE_LINE_SIZE;
+	_node_memory.push_back(mem);
+	_node_chunks.push_back(reinterpret_cast<Node *>(x));
+    }
+    if (_nleaves + 1 > (uint32_t) _leaf_chunks.size() * chunk_size) {
+	Leaf *chunk = new Leaf[chunk_size];
+	if (!chunk)
+	    return false;
+	_leaf_chunks.push_back(chunk);
+    }
+    return true;
+}
+
+MultibitTrie::Leaf *
+MultibitTrie::nearest_leaf(const uint32_t *slots, int bits, int index) const
+{
+    // The sibling slot whose index shares the most leading bits with
+    // 'index' leads to keys sharing the longest prefix; any leaf below it
+    // will do.
+    int best = -1, best_msb = 0;
+    for (int i = 0; i < (1 << bits); ++i)
+	if (slots[i] && i != index) {
+	    int msb = ffs_msb((uint32_t) (i ^ index));
+	    if (msb > best_msb)
+		best = i, best_msb = msb;
+	}
+    if (best < 0)
+	return 0;
+
+    uint32_t s = slots[best];
+    while (!(s & 1)) {
+	const uint32_t *child = node(s)->slot;
+	for (s = 0; !s; ++child)
+	    s = *child;
+    }
+    return leaf(s);
+}
+
+MultibitTrie::Leaf *
+MultibitTrie::find_insert(uint32_t key, Leaf **nearest)
+{
+    uint32_t *slots = _root;
+    int bits = root_bits;
+    int shift = 32 - root_bits;
+    uint32_t *sp = &_root[key >> shift];
+    while (*sp && !(*sp & 1)) {
+	slots = node(*sp)->slot;
+	bits = node_bits;
+	shift -= node_bits;
+	sp = &slots[(key >> shift) & (node_width - 1)];
+    }
+
+    Leaf *old = (*sp ? leaf(*sp) : 0);
+    if (old && old->key == key) {
+	if (nearest)
+	    *nearest = 0;
+	return old;
+    }
+
+    // Allocate everything before changing the trie.  If the slot holds a
+    // different key, push that leaf down until the keys' nibbles differ.
+    uint32_t nnodes = 0;
+    if (old) {
+	uint32_t diff = old->key ^ key;
+	int s = shift;
+	do {
+	    s -= node_bits;
+	    ++nnodes;
+	} while (!((diff >> s) & (node_width - 1)));
+    }
+    if (!reserve(nnodes))
+	return 0;
+
+    if (nearest)
+	*nearest = (old ? old : nearest_leaf(slots, bits, sp - slots));
+
+    uint32_t old_slot = *sp;
+    while (nnodes) {
+	uint32_t ns = _nnodes++ << 1;
+	Node *n = node(ns);
+	memset(n, 0, sizeof(Node));
+	*sp = ns;
+	shift -= node_bits;
+	int oi = (old->key >> shift) & (node_width - 1);
+	sp = &n->slot[(key >> shift) & (node_width - 1)];
+	if (--nnodes == 0)
+	    n->slot[oi] = old_slot;
+    }
+
+    uint32_t ls = (_nleaves++ << 1) | 1;
+    Leaf *l = leaf(ls);
+    l->key = key;
+    l->value = 0;
+    *sp = ls;
+    return l;
+}
+
+void
+MultibitTrie::const_iterator::advance()
+{
+    while (_depth >= 0) {
+	int width = (_depth ? node_width : root_width);
+	if (++_pos[_depth] >= width) {
+	    --_depth;
+	    continue;
+	}
+	uint32_t s = _slots[_depth][_pos[_depth]];
+	if (!s)
+	    continue;
+	if (s & 1) {
+	    _leaf = _trie->leaf(s);
+	    return;
+	}
+	++_depth;
+	_slots[_depth] = _trie->node(s)->slot;
+	_pos[_depth] = -1;
+    }
+    _leaf = 0;
+}
+
+CLICK_ENDDECLS
+ELEMENT_PROVIDES(MultibitTrie)
@@ -0,0 +1,180 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_MULTIBITTRIE_HH
+#define CLICK_MULTIBITTRIE_HH
+#include <click/vector.hh>
+#include <click/machine.hh>
+CLICK_DECLS
+
+/** @class MultibitTrie
+ * @brief Map from 32-bit keys (addresses or aggregates) to 32-bit values.
+ *
+ * A MultibitTrie indexes keys by their most significant bits first.  The
+ * root consumes 8 bits and every other node 4, so a lookup visits at most
+ * seven nodes; each node is 16 32-bit slots, exactly one cache line.  A slot
+ * holds either a child node or a leaf, and a leaf is stored in the first
+ * slot where its key is unique, so subtrees with a single key take no
+ * interior nodes.  Nodes and leaves live in large arena chunks and are
+ * addressed by 32-bit index.
+ *
+ * Keys are never removed individually; clear() empties the whole trie and
+ * keeps its memory for reuse.  Iteration visits leaves in increasing key
+ * order.  Leaf pointers stay valid until clear().
+ *
+ * find_insert() can also report an existing key that shares the longest
+ * possible prefix with a newly inserted key, which is what prefix-preserving
+ * anonymization needs. */
+class MultibitTrie { public:
+
+    struct Leaf {
+	uint32_t key;
+	uint32_t value;
+    };
+
+    MultibitTrie();
+    ~MultibitTrie();
+
+    /** @brief Return the number of keys. */
+    uint32_t size() const		{ return _nleaves; }
+
+    /** @brief Return the leaf for @a key, or null if there is none. */
+    inline Leaf *find(uint32_t key) const;
+
+    /** @brief Return the leaf for @a key, inserting it with value 0 if
+     * necessary.
+     * @param key key
+     * @param[out] nearest if nonnull, set to null if @a key was already
+     * present; otherwise, set to a previously present leaf whose key shares
+     * the longest prefix with @a key (or null if the trie was empty)
+     * @return the leaf, or null if out of memory */
+    Leaf *find_insert(uint32_t key, Leaf **nearest = 0);
+
+    /** @brief Prefetch the top of the search path for @a key.
+     *
+     * Call this for several keys before looking any of them up, so that
+     * their cache misses overlap. */
+    inline void prefetch(uint32_t key) const;
+
+    /** @brief Remove all keys. */
+    void clear();
+
+    /** @brief Swap the contents of this trie and @a x. */
+    void swap(MultibitTrie &x);
+
+    class const_iterator;
+    /** @brief Return an iterator over the leaves in increasing key order. */
+    inline const_iterator begin() const;
+
+  private:
+
+    enum {
+	root_bits = 8, node_bits = 4,
+	root_width = 1 << root_bits, node_width = 1 << node_bits,
+	max_depth = 1 + (32 - root_bits) / node_bits,
+	chunk_bits = 10, chunk_size = 1 << chunk_bits
+    };
+
+    // Slot values: 0 is empty, (i << 1) | 1 is leaf i, and i << 1 (i > 0)
+    // is node i.
+    struct Node {
+	uint32_t slot[node_width];
+    };
+
+    uint32_t _root[root_width];
+    Vector<Node *> _node_chunks;
+    Vector<char *> _node_memory;
+    Vector<Leaf *> _leaf_chunks;
+    uint32_t _nnodes;
+    uint32_t _nleaves;
+
+    Node *node(uint32_t s) const {
+	uint32_t i = s >> 1;
+	return &_node_chunks[i >> chunk_bits][i & (chunk_size - 1)];
+    }
+    Leaf *leaf(uint32_t s) const {
+	uint32_t i = s >> 1;
+	return &_leaf_chunks[i >> chunk_bits][i & (chunk_size - 1)];
+    }
+
+    bool reserve(uint32_t nnodes);
+    Leaf *nearest_leaf(const uint32_t *slots, int bits, int index) const;
+
+    MultibitTrie(const MultibitTrie &);
+    MultibitTrie &operator=(const MultibitTrie &);
+
+    friend class const_iterator;
+
+};
+
+class MultibitTrie::const_iterator { public:
+
+    typedef bool (const_iterator::*unspecified_bool_type)() const;
+
+    /** @brief Return true iff the iterator points to a leaf. */
+    bool live() const			{ return _leaf; }
+    inline operator unspecified_bool_type() const {
+	return _leaf ? &const_iterator::live : 0;
+    }
+
+    const Leaf *operator->() const	{ return _leaf; }
+    const Leaf &operator*() const	{ return *_leaf; }
+
+    void operator++()			{ advance(); }
+    void operator++(int)		{ advance(); }
+
+  private:
+
+    const MultibitTrie *_trie;
+    const Leaf *_leaf;
+    int _depth;
+    const uint32_t *_slots[max_depth];
+    int _pos[max_depth];
+
+    inline const_iterator(const MultibitTrie *trie);
+    void advance();
+
+    friend class MultibitTrie;
+
+};
+
+inline MultibitTrie::Leaf *
+MultibitTrie::find(uint32_t key) const
+{
+    uint32_t s = _root[key >> (32 - root_bits)];
+    int shift = 32 - root_bits;
+    while (s && !(s & 1)) {
+	shift -= node_bits;
+	s = node(s)->slot[(key >> shift) & (node_width - 1)];
+    }
+    if (s) {
+	Leaf *l = leaf(s);
+	if (l->key == key)
+	    return l;
+    }
+    return 0;
+}
+
+inline void
+MultibitTrie::prefetch(uint32_t key) const
+{
+    uint32_t s = _root[key >> (32 - root_bits)];
+    if (s)
+	click_prefetch0(s & 1 ? (const void *) leaf(s) : (const void *) node(s));
+}
+
+inline
+MultibitTrie::const_iterator::const_iterator(const MultibitTrie *trie)
+    : _trie(trie), _leaf(0), _depth(0)
+{
+    _slots[0] = trie->_root;
+    _pos[0] = -1;
+    advance();
+}
+
+inline MultibitTrie::const_iterator
+MultibitTrie::begin() const
+{
+    return const_iterator(this);
+}
+
+CLICK_ENDDECLS
+#endif
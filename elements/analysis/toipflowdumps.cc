@@ -42,12 +42,13 @@ CLICK_DECLS
 
 ToIPFlowDumps::Flow::Flow(const Packet *p, const String &filename,
 			  bool absolute_time, bool absolute_seq, bool binary,
-			  bool ip_id, int tcp_opt, bool tcp_window)
+			  bool ip_id, int tcp_opt, bool tcp_window,
+			  FlowDumpWriter *writer)
     : _next(0),
       _flowid(p), _ip_p(p->ip_header()->ip_p),
       _aggregate(AGGREGATE_ANNO(p)), _packet_count(0), _note_count(0),
       _filename(filename), _outputted(false), _binary(binary),
-      _tcp_opt(tcp_opt), _npkt(0), _nnote(0)
+      _tcp_opt(tcp_opt), _npkt(0), _nnote(0), _writer(writer)
 {
     // use the encapsulated IP header for ICMP errors
     if (_ip_p == IP_PROTO_ICMP) {
@@ -171,12 +172,16 @@ ToIPFlowDumps::Flow::output_binary(StringAccum &sa)
 }
 
 int
-ToIPFlowDumps::Flow::output(ErrorHandler *errh)
+ToIPFlowDumps::Flow::output(ErrorHandler *errh, int writer_flags)
 {
-    static StringAccum sa;
-
-    int fd;
-    if (_filename == "-")
+    static StringAccum static_sa;
+    StringAccum writer_sa;
+    StringAccum &sa = (_writer ? writer_sa : static_sa);
+
+    int fd = -1;
+    if (_writer)
+	/* the writer thread opens the file */;
+    else if (_filename == "-")
 	fd = STDOUT_FILENO;
     else if (_outputted)
 	fd = open(_filename.c_str(), O_WRONLY | O_APPEND);
@@ -184,7 +189,7 @@ ToIPFlowDumps::Flow::output(ErrorHandler *errh)
 	return -1;
     else
 	fd = open(_filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
-    if (fd < 0)
+    if (fd < 0 && !_writer)
 	return errh->error("%s: %s", _filename.c_str(), strerror(errno));
 
     // make a guess about how much data we'll need
@@ -308,6 +313,14 @@ ToIPFlowDumps::Flow::output(ErrorHandler *errh)
     _note_text.clear();
     _nnote = 0;
 
+    if (_writer) {
+	if (!_outputted)
+	    writer_flags |= FlowDumpWriter::W_TRUNCATE;
+	_writer->write(_aggregate, _filename, sa.take_string(), writer_flags);
+	_outputted = true;
+	return 0;
+    }
+
     // actually write data
     int pos = 0;
     while (pos < sa.length()) {
@@ -328,7 +341,11 @@ ToIPFlowDumps::Flow::output(ErrorHandler *errh)
 inline void
 ToIPFlowDumps::Flow::unlink(ErrorHandler *errh)
 {
-    if (_outputted && ::unlink(_filename.c_str()) < 0)
+    if (!_outputted)
+	/* nothing to remove */;
+    else if (_writer)
+	_writer->write(_aggregate, _filename, String(), FlowDumpWriter::W_UNLINK);
+    else if (::unlink(_filename.c_str()) < 0)
 	errh->error("%s: %s", _filename.c_str(), strerror(errno));
 }
 
@@ -534,6 +551,8 @@ ToIPFlowDumps::configure(Vector<String> &conf, ErrorHandler *errh)
     Element *e = 0;
     bool absolute_time = false, absolute_seq = false, binary = false, all_tcp_opt = false, tcp_opt = false, tcp_window = false, ip_id = false, gzip = false;
     _mincount = 0;
+    _writer_threads = 0;
+    _max_open_files = 256;
 
     if (Args(conf, this, errh)
 	.read_p("FILEPATTERN", FilenameArg(), _filename_pattern)
@@ -548,8 +567,16 @@ ToIPFlowDumps::configure(Vector<String> &conf, ErrorHandler *errh)
 	.read("GZIP", gzip)
 	.read("IP_ID", ip_id)
 	.read("MINCOUNT", _mincount)
+	.read("WRITER_THREADS", _writer_threads)
+	.read("MAX_OPEN_FILES", _max_open_files)
 	.complete() < 0)
 	return -1;
+#if !HAVE_MULTITHREAD
+    if (_writer_threads > 0)
+	return errh->error("WRITER_THREADS requires multithreading support");
+#endif
+    if (_writer_threads < 0 || _max_open_files <= 0)
+	return errh->error("WRITER_THREADS and MAX_OPEN_FILES must be positive");
 
     if (!_filename_pattern)
 	_filename_pattern = "-";
@@ -655,18 +682,35 @@ ToIPFlowDumps::add_compressable(const String &filename, ErrorHandler *errh)
 	return 0;
 }
 
+void
+ToIPFlowDumps::collect_written(ErrorHandler *errh)
+{
+    Vector<String> closed;
+    _writer.collect(closed, errh);
+    for (int i = 0; i < closed.size() && _gzip; i++)
+	if (add_compressable(closed[i], errh) < 0)
+	    _gzip = false;
+}
+
 void
 ToIPFlowDumps::end_flow(Flow *f, ErrorHandler *errh)
 {
     if (f->npackets() >= _mincount) {
-	f->output(errh);
-	if (_gzip && f->filename() != "-")
-	    if (add_compressable(f->filename(), errh) < 0)
+	bool compress = _gzip && f->filename() != "-";
+	if (_writer.running())
+	    // compress once the writer thread has closed the file
+	    f->output(errh, FlowDumpWriter::W_CLOSE | (compress ? FlowDumpWriter::W_NOTIFY : 0));
+	else {
+	    f->output(errh);
+	    if (compress && add_compressable(f->filename(), errh) < 0)
 		_gzip = false;
+	}
     } else
 	f->unlink(errh);
     delete f;
     _nflows--;
+    if (_writer.running())
+	collect_written(errh);
 }
 
 void
@@ -678,6 +722,13 @@ ToIPFlowDumps::cleanup(CleanupStage)
 	    _flowmap[i] = f->next();
 	    end_flow(f, errh);
 	}
+    if (_writer.running()) {
+	Vector<String> closed;
+	_writer.stop(closed, errh);
+	for (int i = 0; i < closed.size() && _gzip; i++)
+	    if (add_compressable(closed[i], errh) < 0)
+		_gzip = false;
+    }
     if (_nnoagg > 0 && _nagg == 0)
 	errh->lwarning(declaration(), "saw no packets with aggregate annotations");
     while ((_compress_child >= 0 || _compressables.size())
@@ -695,6 +746,9 @@ ToIPFlowDumps::initialize(ErrorHandler *errh)
     if (_agg_notifier)
 	_agg_notifier->add_listener(this);
     _gc_timer.initialize(this);
+    if (_writer_threads > 0
+	&& _writer.start(_writer_threads, _max_open_files, errh) < 0)
+	return -1;
     return 0;
 }
 
@@ -781,7 +835,7 @@ ToIPFlowDumps::find_aggregate(uint32_t agg, const Packet *p)
 
     if (f)
 	/* nada */;
-    else if (p && (f = new Flow(p, expand_filename(p, ErrorHandler::default_handler()), _absolute_time, _absolute_seq, _binary, _ip_id, _tcp_opt, _tcp_window))) {
+    else if (p && (f = new Flow(p, expand_filename(p, ErrorHandler::default_handler()), _absolute_time, _absolute_seq, _binary, _ip_id, _tcp_opt, _tcp_window, (_writer.running() ? &_writer : 0)))) {
 	prev = f;
 	_nflows++;
     } else
@@ -875,7 +929,23 @@ ToIPFlowDumps::gc_hook(Timer *t, void *thunk)
     }
 }
 
-enum { H_CLEAR };
+enum { H_CLEAR, H_WRITER_STALLS, H_WRITER_OPENS, H_WRITER_EVICTIONS };
+
+String
+ToIPFlowDumps::read_handler(Element *e, void *thunk)
+{
+    ToIPFlowDumps *td = static_cast<ToIPFlowDumps *>(e);
+    switch ((intptr_t)thunk) {
+      case H_WRITER_STALLS:
+	return String(td->_writer.nstalls());
+      case H_WRITER_OPENS:
+	return String(td->_writer.nopens());
+      case H_WRITER_EVICTIONS:
+	return String(td->_writer.nevictions());
+      default:
+	return String();
+    }
+}
 
 int
 ToIPFlowDumps::write_handler(const String &, Element *e, void *thunk, ErrorHandler *errh)
@@ -898,8 +968,13 @@ void
 ToIPFlowDumps::add_handlers()
 {
     add_write_handler("clear", write_handler, H_CLEAR);
+    if (_writer_threads > 0) {
+	add_read_handler("writer_stalls", read_handler, H_WRITER_STALLS);
+	add_read_handler("writer_opens", read_handler, H_WRITER_OPENS);
+	add_read_handler("writer_evictions", read_handler, H_WRITER_EVICTIONS);
+    }
 }
 
 CLICK_ENDDECLS
-ELEMENT_REQUIRES(userlevel AggregateNotifier IPSummaryDump_TCP)
+ELEMENT_REQUIRES(userlevel AggregateNotifier IPSummaryDump_TCP FlowDumpWriter)
 EXPORT_ELEMENT(ToIPFlowDumps)
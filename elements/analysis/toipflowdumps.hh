@@ -9,6 +9,7 @@
 #include <click/notifier.hh>
 #include <clicknet/tcp.h>
 #include "aggregatenotifier.hh"
+#include "flowdumpwriter.hh"
 CLICK_DECLS
 
 /*
@@ -110,11 +111,28 @@ Boolean. If true, then output packets' IP IDs. Defaults to false.
 Unsigned. Generate output only for flows with at least MINCOUNT packets.
 Defaults to 0 (output all flows).
 
+=item WRITER_THREADS
+
+Integer. If greater than 0, then hand file output to this many background
+threads, so that packet processing never waits for the file system. Each
+flow's output is assigned to one thread, so its file is written in order.
+Writer threads keep recently used files open and combine small writes.
+Output to standard output ("-") always goes through a single thread, so
+flows do not interleave mid-record.  Idle writer threads sleep until there
+is work.  Defaults to 0, which writes files directly from the router thread.
+
+=item MAX_OPEN_FILES
+
+Integer. With WRITER_THREADS, the maximum number of flow files kept open at
+once; the least recently used file is closed to make room for another.
+Defaults to 256.
+
 =back
 
 =n
 
-Only available in user-level processes.
+Only available in user-level processes.  WRITER_THREADS requires
+multithreading support.
 
 =e
 
@@ -138,6 +156,25 @@ numbers seen by ToIPFlowDumps are output as 0. The `C<!first_seq>' comments
 let you reconstruct actual sequence numbers if necessary. Similarly, timestamp
 annotations are relative to `C<!first_time>'.
 
+=h clear write-only
+
+Finish every active flow, as if each had been deleted.
+
+=h writer_stalls read-only
+
+With WRITER_THREADS, the number of file operations that found their writer
+thread's queue full.  Such operations wait in a private queue; the router
+thread does not block.
+
+=h writer_opens read-only
+
+With WRITER_THREADS, the number of files opened by writer threads.
+
+=h writer_evictions read-only
+
+With WRITER_THREADS, the number of files closed to stay within
+MAX_OPEN_FILES.
+
 =a
 
 FromIPSummaryDump, ToIPSummaryDump, AggregateIPFlows */
@@ -185,7 +222,7 @@ class ToIPFlowDumps : public Element, public AggregateListener { public:
 
     class Flow { public:
 
-	Flow(const Packet *, const String &, bool absolute_time, bool absolute_seq, bool binary, bool ip_id, int tcp_opt, bool tcp_window);
+	Flow(const Packet *, const String &, bool absolute_time, bool absolute_seq, bool binary, bool ip_id, int tcp_opt, bool tcp_window, FlowDumpWriter *writer);
 	~Flow();
 
 	uint32_t aggregate() const	{ return _aggregate; }
@@ -197,7 +234,7 @@ class ToIPFlowDumps : public Element, public AggregateListener { public:
 	int add_pkt(const Packet *, ErrorHandler *);
 	int add_note(const String &, ErrorHandler *);
 
-	int output(ErrorHandler *);
+	int output(ErrorHandler *, int writer_flags = 0);
 	void compress(ErrorHandler *);
 	inline void unlink(ErrorHandler *);
 
@@ -226,6 +263,7 @@ class ToIPFlowDumps : public Element, public AggregateListener { public:
 	StringAccum _opt_info;
 	uint16_t *_ip_ids;
 	uint16_t *_tcp_windows;
+	FlowDumpWriter *_writer;
 
 	int create_directories(const String &, ErrorHandler *);
 	void output_binary(StringAccum &);
@@ -263,12 +301,18 @@ class ToIPFlowDumps : public Element, public AggregateListener { public:
     Vector<String> _compressables;
     int _compress_child;
 
+    int _writer_threads;
+    int _max_open_files;
+    FlowDumpWriter _writer;
+
     String expand_filename(const Packet *, ErrorHandler *) const;
     Flow *find_aggregate(uint32_t, const Packet * = 0);
     void end_flow(Flow *, ErrorHandler *);
     int add_compressable(const String &, ErrorHandler *);
+    void collect_written(ErrorHandler *);
     inline void smaction(Packet *);
     static void gc_hook(Timer *, void *);
+    static String read_handler(Element *, void *) CLICK_COLD;
     static int write_handler(const String &, Element *, void *, ErrorHandler*) CLICK_COLD;
 
 };
@@ -30,6 +30,14 @@
 #include <time.h>
 CLICK_DECLS
 
+#ifdef i386
+# define GET4(p)	ntohl(*reinterpret_cast<const uint32_t *>((p)))
+# define PUT4(p, d)	*reinterpret_cast<uint32_t *>((p)) = htonl((d))
+#else
+# define GET4(p)	(((p)[0]<<24) | ((p)[1]<<16) | ((p)[2]<<8) | (p)[3])
+# define PUT4(p, d)	do { (p)[0] = (d)>>24; (p)[1] = (d)>>16; (p)[2] = (d)>>8; (p)[3] = (d); } while (0)
+#endif
+
 ToIPSummaryDump::ToIPSummaryDump()
     : _f(0), _task(this)
 {
@@ -50,6 +58,8 @@ ToIPSummaryDump::configure(Vector<String> &conf, ErrorHandler *errh)
     bool binary = false;
     bool header = true;
     bool extra_length = true;
+    bool delta = true;
+    _columnar = 0;
 
     if (Args(conf, this, errh)
 	.read_mp("FILENAME", FilenameArg(), _filename)
@@ -64,8 +74,12 @@ ToIPSummaryDump::configure(Vector<String> &conf, ErrorHandler *errh)
 	.read("CAREFUL_TRUNC", careful_trunc)
 	.read("EXTRA_LENGTH", extra_length)
 	.read("BINARY", binary)
+	.read("COLUMNAR", _columnar)
+	.read("DELTA", delta)
 	.complete() < 0)
 	return -1;
+    if (_columnar)
+	binary = true;
 
     Vector<String> v;
     cp_spacevec(save, v);
@@ -95,6 +109,26 @@ ToIPSummaryDump::configure(Vector<String> &conf, ErrorHandler *errh)
 	    errh->error("cannot use field %s with BINARY", word.c_str());
 	_binary_size += s;
 
+	// column layout
+	if (_columnar) {
+	    if (f->type == IPSummaryDump::B_SPECIAL || f->type < 0)
+		errh->error("cannot use variable-length field %s with COLUMNAR", word.c_str());
+	    int width = f->type & 255;
+	    _column_width.push_back(width);
+	    bool sequential = strcmp(f->name, "timestamp") == 0
+		|| strcmp(f->name, "ntimestamp") == 0
+		|| strcmp(f->name, "first_timestamp") == 0
+		|| strcmp(f->name, "first_ntimestamp") == 0
+		|| strcmp(f->name, "ts_sec") == 0
+		|| strcmp(f->name, "ts_usec1") == 0
+		|| strcmp(f->name, "tcp_seq") == 0
+		|| strcmp(f->name, "tcp_ack") == 0;
+	    if (delta && sequential && width % 4 == 0)
+		_column_encoding.push_back(IPSummaryDump::C_DELTA);
+	    else
+		_column_encoding.push_back(IPSummaryDump::C_RAW);
+	}
+
 	// remove _multipacket if packet count specified
 	if (strcmp(f->name, "count") == 0)
 	    _multipacket = false;
@@ -102,6 +136,15 @@ ToIPSummaryDump::configure(Vector<String> &conf, ErrorHandler *errh)
     if (_fields.size() == 0)
 	errh->error("no contents specified");
 
+    _record_size = 0;
+    for (int i = 0; i < _column_width.size(); i++)
+	_record_size += _column_width[i];
+    // A delta-encoded word takes at most 5 bytes; chunk lengths must fit in
+    // 31 bits.
+    if (_columnar
+	&& (uint64_t) _columnar * (_record_size + _fields.size()) + 12 + 8 * _fields.size() >= 0x80000000U)
+	errh->error("COLUMNAR chunk too large");
+
     _verbose = verbose;
     _bad_packets = bad_packets;
     _careful_trunc = careful_trunc;
@@ -132,6 +175,7 @@ ToIPSummaryDump::initialize(ErrorHandler *errh)
     }
     _active = true;
     _output_count = 0;
+    _chunk_count = 0;
 
     // magic number
     StringAccum sa;
@@ -162,7 +206,9 @@ ToIPSummaryDump::initialize(ErrorHandler *errh)
     sa << '\n';
 
     // binary marker
-    if (_binary)
+    if (_columnar)
+	sa << "!columnar\n";
+    else if (_binary)
 	sa << "!binary\n";
 
     // print output
@@ -175,6 +221,8 @@ ToIPSummaryDump::initialize(ErrorHandler *errh)
 void
 ToIPSummaryDump::cleanup(CleanupStage)
 {
+    if (_f)
+	flush_chunk();
     if (_f && _f != stdout)
 	fclose(_f);
     _f = 0;
@@ -252,12 +300,96 @@ ToIPSummaryDump::write_packet(Packet* p, int multipacket)
 
 	if (_bad_packets && _bad_sa)
 	    write_line(_bad_sa.take_string());
-	ignore_result(fwrite(_sa.data(), 1, _sa.length(), _f));
+	if (_columnar) {
+	    assert(_sa.length() == _record_size + 4);
+	    _chunk.append(_sa.data() + 4, _record_size);
+	    if (++_chunk_count == _columnar)
+		flush_chunk();
+	} else
+	    ignore_result(fwrite(_sa.data(), 1, _sa.length(), _f));
 
 	_output_count++;
     }
 }
 
+static bool
+encode_delta(StringAccum &sa, const uint8_t *data, int stride, uint32_t n, int width)
+{
+    for (int w = 0; w < width; w += 4) {
+	const uint8_t *x = data + w;
+	uint32_t prev = 0;
+	for (uint32_t i = 0; i < n; ++i, x += stride) {
+	    uint32_t v = GET4(x);
+	    int32_t d = (int32_t) (v - prev);
+	    uint32_t z = ((uint32_t) d << 1) ^ (uint32_t) (d >> 31);
+	    prev = v;
+	    char *c = sa.extend(5);
+	    if (!c)
+		return false;
+	    int len = 0;
+	    for (; z >= 0x80; z >>= 7)
+		c[len++] = (char) (z | 0x80);
+	    c[len++] = (char) z;
+	    sa.adjust_length(len - 5);
+	}
+    }
+    return true;
+}
+
+void
+ToIPSummaryDump::flush_chunk()
+{
+    if (!_chunk_count)
+	return;
+
+    // The chunk header is filled in last, since the column lengths aren't
+    // known until the columns are encoded.
+    int ncolumns = _column_width.size();
+    int header_size = 12 + 8 * ncolumns;
+    _chunk_out.clear();
+    _chunk_out.extend(header_size);
+    const uint8_t *rows = reinterpret_cast<const uint8_t *>(_chunk.data());
+    int offset = 0;
+    for (int i = 0; i < ncolumns; ++i) {
+	int width = _column_width[i];
+	int start = _chunk_out.length();
+	int raw_length = width * _chunk_count;
+	int encoding = _column_encoding[i];
+	if (encoding == IPSummaryDump::C_DELTA
+	    && (!encode_delta(_chunk_out, rows + offset, _record_size, _chunk_count, width)
+		|| _chunk_out.length() - start >= raw_length)) {
+	    _chunk_out.set_length(start);
+	    encoding = IPSummaryDump::C_RAW;
+	}
+	if (encoding == IPSummaryDump::C_RAW && raw_length) {
+	    char *c = _chunk_out.extend(raw_length);
+	    if (c)
+		for (uint32_t j = 0; j < _chunk_count; ++j, c += width)
+		    memcpy(c, rows + j * _record_size + offset, width);
+	}
+
+	if (!_chunk_out.out_of_memory()) {
+	    uint8_t *h = reinterpret_cast<uint8_t *>(_chunk_out.data()) + 12 + 8 * i;
+	    h[0] = encoding;
+	    h[1] = width;
+	    h[2] = h[3] = 0;
+	    PUT4(h + 4, _chunk_out.length() - start);
+	}
+	offset += width;
+    }
+
+    if (!_chunk_out.out_of_memory()) {
+	uint8_t *h = reinterpret_cast<uint8_t *>(_chunk_out.data());
+	PUT4(h, _chunk_out.length());
+	PUT4(h + 4, _chunk_count);
+	PUT4(h + 8, ncolumns);
+	ignore_result(fwrite(_chunk_out.data(), 1, _chunk_out.length(), _f));
+    }
+
+    _chunk.clear();
+    _chunk_count = 0;
+}
+
 void
 ToIPSummaryDump::push(int, Packet *p)
 {
@@ -288,8 +420,9 @@ ToIPSummaryDump::write_line(const String& s)
 {
     if (s.length()) {
 	assert(s.back() == '\n');
+	flush_chunk();
 	if (_binary) {
-	    uint32_t marker = htonl(s.length() | 0x80000000U);
+	    uint32_t marker = htonl((s.length() + 4) | 0x80000000U);
 	    ignore_result(fwrite(&marker, 4, 1, _f));
 	}
 	ignore_result(fwrite(s.data(), 1, s.length(), _f));
@@ -301,8 +434,9 @@ ToIPSummaryDump::add_note(const String &s)
 {
     if (s.length()) {
 	int extra = 1 + (s.back() == '\n' ? 0 : 1);
+	flush_chunk();
 	if (_binary) {
-	    uint32_t marker = htonl((s.length() + extra) | 0x80000000U);
+	    uint32_t marker = htonl((s.length() + extra + 4) | 0x80000000U);
 	    ignore_result(fwrite(&marker, 4, 1, _f));
 	}
 	fputc('#', _f);
@@ -316,8 +450,10 @@ int
 ToIPSummaryDump::flush_handler(const String &, Element *e, void *, ErrorHandler *)
 {
     ToIPSummaryDump *tod = (ToIPSummaryDump *) e;
-    if (tod->_f)
+    if (tod->_f) {
+	tod->flush_chunk();
 	fflush(tod->_f);
+    }
     return 0;
 }
 
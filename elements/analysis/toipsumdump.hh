@@ -23,7 +23,8 @@ Writes summary information about incoming packets to FILENAME in a simple
 ASCII format---each line corresponds to a packet.  The FIELDS keyword
 argument determines what information is written.  Writes to standard output if
 FILENAME is a single dash `C<->'.  The BINARY keyword argument writes a packed
-binary format to save space.
+binary format to save space, and the COLUMNAR keyword argument writes a more
+compact columnar binary format.
 
 ToIPSummaryDump uses packets' extra-length and extra-packet-count annotations.
 
@@ -137,6 +138,17 @@ of the dump. Ignored if HEADER is false.
 Boolean. If true, then output packet records in a binary format (explained
 below). Defaults to false.
 
+=item COLUMNAR
+
+Unsigned integer. If nonzero, then output packet records in a columnar binary
+format (explained below), COLUMNAR packets per chunk. Every field must have a
+fixed binary length. Defaults to 0, meaning no columnar output.
+
+=item DELTA
+
+Boolean. If true, then columnar output delta-encodes timestamp and TCP
+sequence number columns. Defaults to true.
+
 =item MULTIPACKET
 
 Boolean. If true, and the FIELDS option doesn't contain 'C<count>', then
@@ -338,6 +350,32 @@ The data stored in a metadata record is just an ASCII string, ending with
 newline, same as in a regular ASCII IPSummaryDump file. 'C<!bad>' records, for
 example, are stored this way.
 
+=head1 COLUMNAR FORMAT
+
+In a columnar IPSummaryDump file, the line 'C<!columnar>' replaces
+'C<!binary>'. The rest of the file consists of records with the same length
+words as in the binary format. Metadata records are unchanged, but each
+regular record is a chunk that holds several packets:
+
+   +---------------+---------------+---------------+---...
+   |0| chunk length|   npackets    |   ncolumns    | column
+   +---------------+---------------+---------------+ headers...
+
+Each column header is 8 bytes long: a 1-byte encoding, a 1-byte field
+length, 2 zero bytes, and the 4-byte length of the column's data. There is
+one column per field in the 'C<!data>' line. The column data follows the
+headers, in the same order. Encoding 0 stores each packet's field, in the
+format of a binary record, one after another. Encoding 1 treats a field as a
+sequence of 4-byte words and stores each word as the difference from the
+same word in the previous packet (the first packet in a chunk is relative to
+zero). The difference is zigzag-encoded (0, -1, 1, -2 become 0, 1, 2, 3) and
+written as a variable-length integer: seven bits per byte, least significant
+first, with the high bit set on every byte but the last.
+
+ToIPSummaryDump writes each chunk with a single large write. Because records
+must stay in order, a metadata record, such as a 'C<!bad>' line, ends the
+current chunk early.
+
 =h flush write-only
 
 Flush all internal buffers to disk.
@@ -385,6 +423,7 @@ class ToIPSummaryDump : public Element, public IPSummaryDumpInfo { public:
     bool _extra_length : 1;
     int32_t _binary_size;
     uint32_t _output_count;
+    uint32_t _columnar;
     Task _task;
     NotifierSignal _signal;
 
@@ -393,8 +432,16 @@ class ToIPSummaryDump : public Element, public IPSummaryDumpInfo { public:
 
     String _banner;
 
+    Vector<int> _column_width;
+    Vector<int> _column_encoding;
+    int _record_size;
+    uint32_t _chunk_count;
+    StringAccum _chunk;
+    StringAccum _chunk_out;
+
     bool summary(Packet* p, StringAccum& sa, StringAccum* bad_sa) const;
     void write_packet(Packet* p, int multipacket);
+    void flush_chunk();
     static int flush_handler(const String &, Element *, void *, ErrorHandler *);
 
 };
@@ -31,30 +31,46 @@
 CLICK_DECLS
 
 ARPTable::ARPTable()
-    : _entry_capacity(0), _packet_capacity(2048), _entry_packet_capacity(0), _capacity_slim_factor(2), _expire_timer(this)
+    : _slots(0), _slot_mask(0), _entry_capacity(0), _packet_capacity(2048),
+      _entry_packet_capacity(0), _capacity_slim_factor(2), _expire_timer(this)
 {
     _entry_count = _packet_count = _drops = 0;
 }
 
 ARPTable::~ARPTable()
 {
+    delete[] _slots;
 }
 
 int
 ARPTable::configure(Vector<String> &conf, ErrorHandler *errh)
 {
     Timestamp timeout(300);
+    uint32_t lookup_slots = 4096;
     if (Args(conf, this, errh)
 	.read("CAPACITY", _packet_capacity)
 	.read("ENTRY_CAPACITY", _entry_capacity)
 	.read("ENTRY_PACKET_CAPACITY", _entry_packet_capacity)
 	.read("CAPACITY_SLIM_FACTOR", _capacity_slim_factor)
 	.read("TIMEOUT", timeout)
+	.read("LOOKUP_SLOTS", lookup_slots)
 	.complete() < 0)
 	return -1;
     if (_capacity_slim_factor == 0)
 	return errh->error("CAPACITY_SLIM_FACTOR cannot be zero");
+    if (lookup_slots > 0x1000000)
+	return errh->error("LOOKUP_SLOTS too large");
     set_timeout(timeout);
+    // Lock-free readers may hold pointers into the lookup cache, so it is
+    // allocated once and never resized.
+    if (!_slots && lookup_slots) {
+	uint32_t n = 1;
+	while (n < lookup_slots)
+	    n <<= 1;
+	if (!(_slots = new LookupSlot[n]))
+	    return errh->error("out of memory");
+	_slot_mask = n - 1;
+    }
     if (_timeout_j) {
 	_expire_timer.initialize(this);
 	_expire_timer.schedule_after_sec(_timeout_j / CLICK_HZ);
@@ -83,6 +99,40 @@ ARPTable::clear()
     }
     _entry_count = _packet_count = 0;
     _age.__clear();
+    if (_slots)
+	for (uint32_t i = 0; i <= _slot_mask; ++i)
+	    if (_slots[i]._known) {
+		_slots[i]._seq.write_begin();
+		_slots[i]._known = false;
+		_slots[i]._seq.write_end();
+	    }
+}
+
+void
+ARPTable::publish(const ARPEntry *ae)
+{
+    if (!_slots)
+	return;
+    LookupSlot *ls = slot(ae->_ip);
+    ls->_seq.write_begin();
+    ls->_ip = ae->_ip;
+    ls->_eth = ae->_eth;
+    ls->_known = ae->_known;
+    ls->_live_at_j = ae->_live_at_j;
+    ls->_seq.write_end();
+}
+
+void
+ARPTable::unpublish(IPAddress ip)
+{
+    if (!_slots)
+	return;
+    LookupSlot *ls = slot(ip);
+    if (ls->_known && ls->_ip == ip) {
+	ls->_seq.write_begin();
+	ls->_known = false;
+	ls->_seq.write_end();
+    }
 }
 
 void
@@ -105,6 +155,11 @@ ARPTable::take_state(Element *e, ErrorHandler *errh)
 
     arpt->_entry_count = 0;
     arpt->_packet_count = 0;
+
+    click_jiffies_t now = click_jiffies();
+    for (ARPEntry *ae = _age.front(); ae; ae = ae->_age_link.next())
+	if (ae->known(now, _timeout_j))
+	    publish(ae);
 }
 
 void
@@ -118,6 +173,7 @@ ARPTable::slim(click_jiffies_t now)
 	       || (_entry_capacity && _entry_count > _entry_capacity))) {
 	_table.erase(ae->_ip);
 	_age.pop_front();
+	unpublish(ae->_ip);
 
 	while (Packet *p = ae->_head) {
 	    ae->_head = p->next();
@@ -208,6 +264,11 @@ ARPTable::insert(IPAddress ip, const EtherAddress &eth, Packet **head)
 	_age.push_back(ae);
     }
 
+    if (ae->_known)
+	publish(ae);
+    else
+	unpublish(ip);
+
     if (head) {
 	*head = ae->_head;
 	ae->_head = ae->_tail = 0;
@@ -283,6 +344,19 @@ ARPTable::append_query(IPAddress ip, Packet *p)
     return r;
 }
 
+void
+ARPTable::lookup(const IPAddress *ip, EtherAddress *eth, int *result, int n,
+		 uint32_t poll_timeout_j)
+{
+    // Prefetch every cache slot before resolving any of them, so the cache
+    // misses for a burst of addresses overlap.
+    if (_slots)
+	for (int i = 0; i < n; ++i)
+	    click_prefetch0(slot(ip[i]));
+    for (int i = 0; i < n; ++i)
+	result[i] = lookup(ip[i], &eth[i], poll_timeout_j);
+}
+
 IPAddress
 ARPTable::reverse_lookup(const EtherAddress &eth)
 {
@@ -350,6 +424,33 @@ ARPTable::write_handler(const String &str, Element *e, void *user_data, ErrorHan
     }
 }
 
+int
+ARPTable::lookup_handler(int, String &str, Element *e, const Handler *, ErrorHandler *errh)
+{
+    ARPTable *arpt = (ARPTable *) e;
+    Vector<String> words;
+    cp_spacevec(str, words);
+    Vector<IPAddress> ips(words.size(), IPAddress());
+    for (int i = 0; i < words.size(); ++i)
+	if (!IPAddressArg().parse(words[i], ips[i], arpt))
+	    return errh->error("expected IP address");
+
+    Vector<EtherAddress> eths(ips.size(), EtherAddress());
+    Vector<int> results(ips.size(), -1);
+    arpt->lookup(ips.begin(), eths.begin(), results.begin(), ips.size(), 0);
+
+    StringAccum sa;
+    for (int i = 0; i < ips.size(); ++i) {
+	sa << ips[i] << ' ';
+	if (results[i] >= 0)
+	    sa << eths[i] << '\n';
+	else
+	    sa << "-\n";
+    }
+    str = sa.take_string();
+    return 0;
+}
+
 void
 ARPTable::add_handlers()
 {
@@ -360,6 +461,7 @@ ARPTable::add_handlers()
     add_write_handler("insert", write_handler, h_insert);
     add_write_handler("delete", write_handler, h_delete);
     add_write_handler("clear", write_handler, h_clear);
+    set_handler("lookup", Handler::f_read | Handler::f_read_param, lookup_handler);
 }
 
 CLICK_ENDDECLS
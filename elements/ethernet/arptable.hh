@@ -57,6 +57,20 @@ service attack.
 Time value.  The amount of time after which an ARP entry will expire.  Default
 is 5 minutes.  Zero means ARP entries never expire.
 
+=item LOOKUP_SLOTS
+
+Unsigned integer.  The number of slots in the lookup cache, rounded up to a
+power of two.  Default is 4096; zero disables the cache.  Can't be changed by
+reconfiguration.
+
+=back
+
+Known entries are mirrored into a direct-mapped lookup cache whose slots are
+protected by sequence locks.  Lookups that hit the cache never write shared
+memory, so many threads can share an ARPTable without contending for a lock.
+Lookups that miss the cache, including lookups for IP addresses whose slots
+are held by other entries, fall back to the locked table.
+
 =h table r
 
 Return a table of the ARP entries.  The returned string has four
@@ -88,6 +102,12 @@ Return the number of entries in the table.
 
 Return the number of packets stored in the table.
 
+=h lookup r
+
+Takes one or more space-separated IP addresses as parameters.  Returns one line
+per address, containing the address and the corresponding Ethernet address, or
+C<-> if the address is not known.
+
 =a
 
 ARPQuerier
@@ -108,6 +128,8 @@ class ARPTable : public Element { public:
 
     int lookup(IPAddress ip, EtherAddress *eth, uint32_t poll_timeout_j);
     EtherAddress lookup(IPAddress ip);
+    void lookup(const IPAddress *ip, EtherAddress *eth, int *result, int n,
+		uint32_t poll_timeout_j);
     IPAddress reverse_lookup(const EtherAddress &eth);
     int insert(IPAddress ip, const EtherAddress &en, Packet **head = 0);
     int append_query(IPAddress ip, Packet *p);
@@ -165,6 +187,7 @@ class ARPTable : public Element { public:
     };
     static String read_handler(Element *e, void *user_data) CLICK_COLD;
     static int write_handler(const String &str, Element *e, void *user_data, ErrorHandler *errh) CLICK_COLD;
+    static int lookup_handler(int op, String &str, Element *e, const Handler *h, ErrorHandler *errh) CLICK_COLD;
 
     struct ARPEntry {		// This structure is now larger than I'd like
 	IPAddress _ip;		// (40B) but probably still fine.
@@ -208,7 +231,20 @@ class ARPTable : public Element { public:
 
   private:
 
+    struct LookupSlot {
+	SeqLock _seq;
+	IPAddress _ip;
+	EtherAddress _eth;
+	bool _known;
+	click_jiffies_t _live_at_j;
+	LookupSlot()
+	    : _known(false) {
+	}
+    };
+
     ReadWriteLock _lock;
+    LookupSlot *_slots;
+    uint32_t _slot_mask;
 
     typedef HashContainer<ARPEntry> Table;
     Table _table;
@@ -228,10 +264,49 @@ class ARPTable : public Element { public:
     ARPEntry *ensure(IPAddress ip, click_jiffies_t now);
     void slim(click_jiffies_t now);
 
+    inline LookupSlot *slot(IPAddress ip) const;
+    void publish(const ARPEntry *ae);
+    void unpublish(IPAddress ip);
+    int lookup_slow(IPAddress ip, EtherAddress *eth, uint32_t poll_timeout_j);
+
 };
 
+inline ARPTable::LookupSlot *
+ARPTable::slot(IPAddress ip) const
+{
+    uint32_t h = ip.addr();
+    h ^= h >> 16;
+    h *= 0x85EBCA6BU;
+    h ^= h >> 13;
+    return &_slots[h & _slot_mask];
+}
+
 inline int
 ARPTable::lookup(IPAddress ip, EtherAddress *eth, uint32_t poll_timeout_j)
+{
+    // Fast path: lock-free read of the lookup cache.  Fall back to the
+    // locked table on a miss, an expired entry, or when a poll is due.
+    if (_slots) {
+	const LookupSlot *ls = slot(ip);
+	uint32_t seq = ls->_seq.read_begin();
+	bool hit = ls->_known && ls->_ip == ip;
+	EtherAddress slot_eth = ls->_eth;
+	click_jiffies_t live_at_j = ls->_live_at_j;
+	if (!ls->_seq.read_retry(seq) && hit) {
+	    click_jiffies_t now = click_jiffies();
+	    if ((!_timeout_j || !click_jiffies_less(live_at_j + _timeout_j, now))
+		&& (!poll_timeout_j
+		    || click_jiffies_less(now, live_at_j + poll_timeout_j))) {
+		*eth = slot_eth;
+		return 0;
+	    }
+	}
+    }
+    return lookup_slow(ip, eth, poll_timeout_j);
+}
+
+inline int
+ARPTable::lookup_slow(IPAddress ip, EtherAddress *eth, uint32_t poll_timeout_j)
 {
     _lock.acquire_read();
     int r = -1;
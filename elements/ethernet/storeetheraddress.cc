@@ -54,6 +54,8 @@ StoreEtherAddress::configure(Vector<String> &conf, ErrorHandler *errh)
 Packet *
 StoreEtherAddress::simple_action(Packet *p)
 {
+    if (!(p = p->pullup(_offset + 6)))
+	return 0;
     if (_offset + 6 <= p->length()) {
 	if (WritablePacket *q = p->uniqueify()) {
 	    const uint8_t *addr = _use_anno ? q->anno_u8() + _anno : _address.data();
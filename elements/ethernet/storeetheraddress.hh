@@ -36,6 +36,7 @@ class StoreEtherAddress : public Element { public:
     const char *class_name() const		{ return "StoreEtherAddress"; }
     const char *port_count() const		{ return PORTS_1_1X2; }
     const char *processing() const		{ return PROCESSING_A_AH; }
+    const char *flags() const		{ return "D"; }
 
     int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
     void add_handlers() CLICK_COLD;
@@ -23,24 +23,175 @@
 #include <click/args.hh>
 #include <click/straccum.hh>
 #include <click/error.hh>
+#include <click/atomic.hh>
+#include <click/packet_anno.hh>
 CLICK_DECLS
 
 EtherSwitch::EtherSwitch()
-    : _table(AddrInfo(-1, Timestamp())), _timeout(300)
+    : _buckets(0), _buckets_alloc(0), _timeout(300), _epoch(1), _timer(this)
 {
 }
 
 EtherSwitch::~EtherSwitch()
 {
-    _table.clear();
+    delete[] _buckets_alloc;
 }
 
 int
 EtherSwitch::configure(Vector<String> &conf, ErrorHandler *errh)
 {
-    return Args(conf, this, errh)
+    _capacity = 16384;
+    _vlan = false;
+    if (Args(conf, this, errh)
 	.read("TIMEOUT", SecondsArg(), _timeout)
-	.complete();
+	.read("CAPACITY", _capacity)
+	.read("VLAN", _vlan)
+	.complete() < 0)
+	return -1;
+    if (_capacity == 0 || _capacity > 0x40000000)
+	return errh->error("CAPACITY out of range");
+    return 0;
+}
+
+int
+EtherSwitch::initialize(ErrorHandler *errh)
+{
+    static_assert(sizeof(Bucket) == CLICK_CACHE_LINE_SIZE, "EtherSwitch::Bucket must fill one cache line");
+    uint32_t nbuckets = 1;
+    while (nbuckets * bucket_size < _capacity)
+	nbuckets *= 2;
+    // Align buckets to cache lines so that a lookup touches only one.
+    _buckets_alloc = new char[nbuckets * sizeof(Bucket) + CLICK_CACHE_LINE_SIZE - 1];
+    if (!_buckets_alloc)
+	return errh->error("out of memory");
+    _buckets = reinterpret_cast<Bucket *>(((uintptr_t) _buckets_alloc + CLICK_CACHE_LINE_SIZE - 1) & ~(uintptr_t) (CLICK_CACHE_LINE_SIZE - 1));
+    memset(_buckets, 0, nbuckets * sizeof(Bucket));
+    _mask = nbuckets - 1;
+    _timer.initialize(this);
+    _timer.schedule_after_sec(1);
+    return 0;
+}
+
+void
+EtherSwitch::cleanup(CleanupStage)
+{
+    delete[] _buckets_alloc;
+    _buckets_alloc = 0;
+    _buckets = 0;
+}
+
+void
+EtherSwitch::run_timer(Timer *)
+{
+    _epoch = _epoch + 1;
+    _timer.reschedule_after_sec(1);
+}
+
+/* Lookups are lock-free.  A bucket's version is odd while a writer is
+   changing it; a reader that sees an odd version, or a version that changed
+   during its scan, scans again. */
+int
+EtherSwitch::lookup(uint64_t key) const
+{
+    const Bucket *b = bucket(key);
+    uint32_t epoch = _epoch;
+    while (1) {
+	uint32_t v = b->version;
+	click_read_fence();
+	int port = -1;
+	if (!(v & 1)) {
+	    for (int i = 0; i < bucket_size; ++i)
+		if (b->e[i].key == key && live(b->e[i], epoch))
+		    port = b->e[i].port;
+	    click_read_fence();
+	    if (b->version == v)
+		return port;
+	}
+	click_relax_fence();
+    }
+}
+
+void
+EtherSwitch::learn(uint64_t key, int port)
+{
+    Bucket *b = bucket(key);
+    uint32_t epoch = _epoch;
+
+    // Common case: the address is known on this port.  Refresh its epoch,
+    // at most once per epoch, without locking.  If a writer replaces the
+    // entry concurrently, the stray epoch store only affects its aging.
+    uint32_t v = b->version;
+    click_read_fence();
+    if (!(v & 1))
+	for (int i = 0; i < bucket_size; ++i) {
+	    Entry &e = b->e[i];
+	    if (e.key == key && e.port == port) {
+		click_read_fence();
+		if (b->version != v)
+		    break;
+		if (e.epoch != epoch)
+		    e.epoch = epoch;
+		return;
+	    }
+	}
+
+    // Otherwise lock the bucket by making its version odd.
+    while (1) {
+	v = b->version;
+	if (!(v & 1) && atomic_uint32_t::compare_swap(b->version, v, v + 1) == v)
+	    break;
+	click_relax_fence();
+    }
+
+    // Prefer the address's own entry, then an empty or expired entry, then
+    // the entry idle longest.
+    Entry *slot = 0;
+    for (int i = 0; i < bucket_size; ++i) {
+	Entry &e = b->e[i];
+	if (e.key == key) {
+	    slot = &e;
+	    break;
+	} else if (!slot
+		   || (live(*slot, epoch)
+		       && (!live(e, epoch) || epoch - e.epoch > epoch - slot->epoch)))
+	    slot = &e;
+    }
+    slot->key = key;
+    slot->port = port;
+    slot->epoch = epoch;
+
+    click_write_fence();
+    b->version = v + 2;
+}
+
+int
+EtherSwitch::learn_and_lookup(int source, Packet *p)
+{
+    // 0 timeout means dumb switch
+    if (_timeout == 0)
+	return -1;
+
+    const click_ether *e = reinterpret_cast<const click_ether *>(p->data());
+    int vlan = 0;
+    if (_vlan) {
+	if (e->ether_type == htons(ETHERTYPE_8021Q) && p->length() >= sizeof(click_ether_vlan))
+	    vlan = ntohs(reinterpret_cast<const click_ether_vlan *>(e)->ether_vlan_tci) & 0x0FFF;
+	else
+	    vlan = ntohs(VLAN_TCI_ANNO(p)) & 0x0FFF;
+    }
+
+    // Start loading the destination's bucket while we learn the source.
+    const Bucket *dst_bucket = 0;
+    uint64_t dst = 0;
+    if (!(e->ether_dhost[0] & 1)) {
+	dst = make_key(e->ether_dhost, vlan);
+	dst_bucket = bucket(dst);
+	click_prefetch0(dst_bucket);
+    }
+
+    learn(make_key(e->ether_shost, vlan), source);
+
+    return dst_bucket ? lookup(dst) : -1;
 }
 
 void
@@ -52,7 +203,8 @@ EtherSwitch::broadcast(int source, Packet *p)
   for (int i = n - 1; i >=0 ; i--)
     if (i != source) {
       Packet *pp = (sent < n - 2 ? p->clone() : p);
-      output(i).push(pp);
+      if (pp)
+	output(i).push(pp);
       sent++;
     }
   assert(sent == n - 1);
@@ -61,25 +213,7 @@ EtherSwitch::broadcast(int source, Packet *p)
 void
 EtherSwitch::push(int source, Packet *p)
 {
-    click_ether* e = (click_ether*) p->data();
-    int outport = -1;		// Broadcast
-
-    // 0 timeout means dumb switch
-    if (_timeout != 0) {
-	_table.set(EtherAddress(e->ether_shost), AddrInfo(source, p->timestamp_anno()));
-
-	// Set outport if dst is unicast, we have info about it, and the
-	// info is still valid.
-	EtherAddress dst(e->ether_dhost);
-	if (!dst.is_group()) {
-	    if (Table::iterator dst_info = _table.find(dst)) {
-		if (p->timestamp_anno() < dst_info.value().stamp + Timestamp(_timeout, 0))
-		    outport = dst_info.value().port;
-		else
-		    _table.erase(dst_info);
-	    }
-	}
-    }
+    int outport = learn_and_lookup(source, p);
 
   if (outport < 0)
     broadcast(source, p);
@@ -89,18 +223,37 @@ EtherSwitch::push(int source, Packet *p)
     output(outport).push(p);
 }
 
+enum { h_table, h_timeout, h_count };
+
 String
 EtherSwitch::reader(Element* f, void *thunk)
 {
     EtherSwitch* sw = (EtherSwitch*)f;
     switch ((intptr_t) thunk) {
-    case 0: {
+    case h_table:
+    case h_count: {
 	StringAccum sa;
-	for (Table::iterator iter = sw->_table.begin(); iter.live(); iter++)
-	    sa << iter.key() << ' ' << iter.value().port << '\n';
+	uint32_t epoch = sw->_epoch, count = 0;
+	for (uint32_t b = 0; b <= sw->_mask; ++b)
+	    for (int i = 0; i < bucket_size; ++i) {
+		Entry e = sw->_buckets[b].e[i];
+		if (!sw->live(e, epoch))
+		    continue;
+		++count;
+		if ((intptr_t) thunk == h_count)
+		    continue;
+		unsigned char addr[6];
+		for (int j = 0; j < 6; ++j)
+		    addr[j] = e.key >> (40 - 8 * j);
+		if (sw->_vlan)
+		    sa << ((e.key >> 48) & 0x0FFF) << ' ';
+		sa << EtherAddress(addr) << ' ' << e.port << '\n';
+	    }
+	if ((intptr_t) thunk == h_count)
+	    sa << count;
 	return sa.take_string();
     }
-    case 1:
+    case h_timeout:
 	return String(sw->_timeout);
     default:
 	return String();
@@ -119,10 +272,12 @@ EtherSwitch::writer(const String &s, Element *e, void *, ErrorHandler *errh)
 void
 EtherSwitch::add_handlers()
 {
-    add_read_handler("table", reader, 0);
-    add_read_handler("timeout", reader, 1);
+    add_read_handler("table", reader, h_table);
+    add_read_handler("count", reader, h_count);
+    add_read_handler("timeout", reader, h_timeout);
     add_write_handler("timeout", writer, 0);
 }
 
 EXPORT_ELEMENT(EtherSwitch)
+ELEMENT_MT_SAFE(EtherSwitch)
 CLICK_ENDDECLS
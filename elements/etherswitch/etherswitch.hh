@@ -2,13 +2,13 @@
 #define CLICK_ETHERSWITCH_HH
 #include <click/element.hh>
 #include <click/etheraddress.hh>
-#include <click/hashtable.hh>
+#include <click/timer.hh>
 CLICK_DECLS
 
 /*
 =c
 
-EtherSwitch([I<keywords> TIMEOUT])
+EtherSwitch([I<keywords> TIMEOUT, CAPACITY, VLAN])
 
 =s ethernet
 
@@ -29,6 +29,19 @@ the one corresponding to the packet's input port.  The TIMEOUT parameter
 affects how long port associations last.  If it is 0, then the element does
 not learn addresses, and acts like a dumb hub.
 
+EtherSwitch may be used by several threads at once.  Its table is a fixed
+array of buckets, each one cache line holding three associations.  Looking up
+a destination takes no lock: readers check a per-bucket version number and
+retry if an update raced with them.  Learning a source address that is
+already associated with its input port takes no lock either.  Associations
+are aged by a coarse epoch counter, advanced once a second by a timer, so a
+known address costs at most one write per second rather than a timestamp
+write per packet.  Only a new address, or one that moves to another port,
+locks its bucket.
+
+Flooded packets are cloned, not copied: every output shares the packet data.
+Downstream elements that modify headers will make private copies as needed.
+
 Keyword arguments are:
 
 =over 8
@@ -37,18 +50,36 @@ Keyword arguments are:
 
 The timeout for port associations, in seconds.  Any port mapping (i.e.,
 binding between an address and a port number) is dropped after TIMEOUT seconds
-of inactivity.  If 0, the element acts like a dumb hub.  Default is 300.
+of inactivity, give or take a second.  If 0, the element acts like a dumb hub.
+Default is 300.
 
-=back
+=item CAPACITY
 
-=n
+Unsigned.  The number of associations the table can hold, rounded up to a
+multiple of three times a power of two.  When a new address arrives and its
+bucket is full, the association that has been inactive longest is replaced.
+Default is 16384.
 
-The EtherSwitch element has no limit on the memory consumed by cached Ethernet
-addresses.
+=item VLAN
+
+Boolean.  If true, the switch learns addresses separately for each VLAN, as an
+802.1Q bridge with independent learning does: the same address may be
+associated with different ports on different VLANs, and a packet is forwarded
+using the associations of its own VLAN.  A packet's VLAN ID is taken from its
+802.1Q header, if it has one, and otherwise from its VLAN TCI annotation, as
+set by VLANDecap.  Packets are still flooded to every other port.  Default is
+false.
+
+=back
 
 =h table read-only
 
-Returns the current port association table.
+Returns the current port association table, one association per line: the
+Ethernet address and port number, preceded by the VLAN ID if VLAN is true.
+
+=h count read-only
+
+Returns the number of current associations.
 
 =h timeout read/write
 
@@ -70,34 +101,76 @@ class EtherSwitch : public Element { public:
   const char *flow_code() const			{ return "#/[^#]"; }
 
     int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
+    int initialize(ErrorHandler *) CLICK_COLD;
+    void cleanup(CleanupStage) CLICK_COLD;
     void add_handlers() CLICK_COLD;
 
   void push(int port, Packet* p);
+    void run_timer(Timer *);
 
-    struct AddrInfo {
-	int port;
-	Timestamp stamp;
-	inline AddrInfo(int p, const Timestamp &t);
-    };
+  protected:
+
+    int learn_and_lookup(int source, Packet *p);
+    void broadcast(int source, Packet*);
 
   private:
 
-    typedef HashTable<EtherAddress, AddrInfo> Table;
-    Table _table;
+    enum { bucket_size = 3 };
+
+    struct Entry {
+	uint64_t key;		// 0 if empty; see make_key()
+	uint32_t epoch;		// when last seen
+	int32_t port;
+    };
+
+    // One cache line.  The version is odd while the bucket is being
+    // changed; writers lock the bucket by making it odd.
+    struct Bucket {
+	uint32_t version;
+	uint32_t pad;
+	Entry e[bucket_size];
+	char cache_line_pad[CLICK_CACHE_LINE_PAD_BYTES(8 + bucket_size * sizeof(Entry))];
+    } CLICK_ALIGNED(CLICK_CACHE_LINE_SIZE);
+
+    Bucket *_buckets;
+    char *_buckets_alloc;
+    uint32_t _mask;
+    uint32_t _capacity;
     uint32_t _timeout;
+    volatile uint32_t _epoch;
+    bool _vlan;
+    Timer _timer;
 
-    void broadcast(int source, Packet*);
+    static inline uint64_t make_key(const unsigned char *addr, int vlan);
+    inline Bucket *bucket(uint64_t key) const;
+    inline bool live(const Entry &e, uint32_t epoch) const;
+    int lookup(uint64_t key) const;
+    void learn(uint64_t key, int port);
 
     static String reader(Element *, void *);
     static int writer(const String &, Element *, void *, ErrorHandler *);
-    friend class ListenEtherSwitch;
 
 };
 
-inline
-EtherSwitch::AddrInfo::AddrInfo(int p, const Timestamp& s)
-    : port(p), stamp(s)
+inline uint64_t
+EtherSwitch::make_key(const unsigned char *addr, int vlan)
+{
+    uint64_t k = ((uint64_t) 1 << 63) | ((uint64_t) vlan << 48);
+    for (int i = 0; i < 6; ++i)
+	k |= (uint64_t) addr[i] << (40 - 8 * i);
+    return k;
+}
+
+inline EtherSwitch::Bucket *
+EtherSwitch::bucket(uint64_t key) const
+{
+    return &_buckets[(uint32_t) ((key * 0x9E3779B97F4A7C15ULL) >> 32) & _mask];
+}
+
+inline bool
+EtherSwitch::live(const Entry &e, uint32_t epoch) const
 {
+    return e.key && epoch - e.epoch <= _timeout;
 }
 
 CLICK_ENDDECLS
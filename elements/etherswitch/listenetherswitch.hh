@@ -6,7 +6,7 @@ CLICK_DECLS
 /*
 =c
 
-ListenEtherSwitch([I<keywords> TIMEOUT])
+ListenEtherSwitch([I<keywords> TIMEOUT, CAPACITY, VLAN])
 
 =s ethernet
 
@@ -161,8 +161,11 @@ CheckIPHeader::drop(Reason reason, Packet *p)
 Packet *
 CheckIPHeader::simple_action(Packet *p)
 {
+  // make the longest possible IP header contiguous
+  if (p->has_segments() && !(p = p->pullup(_offset + 60)))
+    return 0;
   const click_ip *ip = reinterpret_cast<const click_ip *>(p->data() + _offset);
-  unsigned plen = p->length() - _offset;
+  unsigned plen = p->total_length() - _offset;
   unsigned hlen, len;
 
   // cast to int so very large plen is interpreted as negative
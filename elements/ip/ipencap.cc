@@ -150,7 +150,7 @@ IPEncap::simple_action(Packet *p_in)
       update_cksum(ip, 18);
   } else
       p->set_dst_ip_anno(IPAddress(ip->ip_dst));
-  ip->ip_len = htons(p->length());
+  ip->ip_len = htons(p->total_length());
   ip->ip_id = htons(_id.fetch_and_add(1));
   update_cksum(ip, 2);
   update_cksum(ip, 4);
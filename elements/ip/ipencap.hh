@@ -89,6 +89,7 @@ class IPEncap : public Element { public:
 
   const char *class_name() const		{ return "IPEncap"; }
   const char *port_count() const		{ return PORTS_1_1; }
+  const char *flags() const		{ return "D"; }
 
   int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
   bool can_live_reconfigure() const		{ return true; }
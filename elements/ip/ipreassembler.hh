@@ -4,7 +4,7 @@
 #include <click/element.hh>
 #include <click/glue.hh>
 #include <clicknet/ip.h>
-#include <click/timer.hh>
+#include "ipreassemblyengine.hh"
 CLICK_DECLS
 
 /*
@@ -27,11 +27,22 @@ outputs, however, a single packet containing all the received fragments at
 their proper offsets is pushed onto output 1.
 
 IPReassembler's memory usage is bounded. When memory consumption rises above
-HIMEM bytes, IPReassembler throws away old fragments until memory consumption
-drops below 3/4*HIMEM bytes. Default HIMEM is 256K.
-
-Output packets have the same MAC header as the fragment that contains
-offset 0.  Other than that, input MAC headers are ignored.
+HIMEM bytes, IPReassembler throws away the oldest incomplete datagrams until
+memory consumption drops below 3/4*HIMEM bytes. Default HIMEM is 256K.
+Memory consumption is the sum of the buffer sizes of the fragments held, plus
+a small per-fragment overhead.
+
+Datagrams are looked up by a hash of source, destination, IP ID and protocol.
+Fragments are held without copying until the datagram is complete, then
+copied once into the output packet. A fragment that overlaps data from an
+earlier fragment, other than an exact duplicate, causes the whole datagram to
+be dropped, as do fragments that disagree about the datagram's length and
+datagrams with more than MAX_FRAGMENTS fragments. Exact duplicates are
+ignored.
+
+Output packets have the same MAC header and annotations as the fragment that
+contains offset 0, except that their timestamp is that of the last fragment
+to arrive.  Other than that, input MAC headers are ignored.
 
 The IPREASSEMBLER annotation area is used to store packet metadata about
 packets in the process of reassembly.  On emitted reassembled packets,
@@ -45,6 +56,10 @@ Keyword arguments are:
 
 The upper bound for memory consumption, in bytes. Default is 256K.
 
+=item MAX_FRAGMENTS
+
+The largest number of fragments a datagram may have. Default is 64.
+
 =item MAX_MTU_ANNO
 
 Optional. A 2 byte annotation that will be filled with the maximum size of any
@@ -60,7 +75,11 @@ second output.
 
 IPReassembler destroys its input packets' "next packet" annotations.
 
-=a IPFragmenter */
+=h dump read-only
+
+Returns statistics and the fragment ranges of every incomplete datagram.
+
+=a IPFragmenter, IP6Reassembler */
 
 class IPReassembler : public Element { public:
 
@@ -81,19 +100,14 @@ class IPReassembler : public Element { public:
 
     void add_handlers() CLICK_COLD;
 
-    struct ChunkLink {
-	uint16_t off;
-	uint16_t lastoff;
-    };
-
   private:
 
+    typedef IPReassemblyEngine::Datagram Datagram;
+
     enum { REAP_TIMEOUT = 30, // seconds
-	   REAP_INTERVAL = 10, // seconds
-	   IPH_MEM_USED = 40 };
+	   REAP_INTERVAL = 10 }; // seconds
 
-    enum { NMAP = 256 };
-    WritablePacket *_map[NMAP];
+    IPReassemblyEngine _engine;
 
     int _reap_time;
 
@@ -102,39 +116,19 @@ class IPReassembler : public Element { public:
     uint32_t _stat_failed_assem;
     uint32_t _stat_bad_pkts;
 
-    uint32_t _mem_used;
     uint32_t _mem_high_thresh;	// defaults to 256K
     uint32_t _mem_low_thresh;	// defaults to 3/4 * _mem_high_thresh
     int8_t _mtu_anno;
 
-    static inline int bucketno(const click_ip *);
-    static inline bool same_segment(const click_ip *, const click_ip *);
+    static void unparse_key(StringAccum &, const Packet *);
     static String debug_dump(Element *e, void *);
 
-    WritablePacket *find_queue(Packet *, WritablePacket ***);
-    void make_queue(Packet *, WritablePacket **);
-    static ChunkLink *next_chunk(WritablePacket *, ChunkLink *);
-    Packet *emit_whole_packet(WritablePacket *, WritablePacket **, Packet *);
-    void reap_overfull(int);
+    WritablePacket *finish(Datagram *);
+    void fail(Datagram *);
+    void reap_overfull();
     void reap(int);
-    static void check_error(ErrorHandler *, int, const Packet *, const char *, ...);
 
 };
 
-
-inline int
-IPReassembler::bucketno(const click_ip *h)
-{
-    return (h->ip_id % NMAP);
-}
-
-inline bool
-IPReassembler::same_segment(const click_ip *h, const click_ip *h2)
-{
-    return h->ip_id == h2->ip_id && h->ip_p == h2->ip_p
-	&& h->ip_src.s_addr == h2->ip_src.s_addr
-	&& h->ip_dst.s_addr == h2->ip_dst.s_addr;
-}
-
 CLICK_ENDDECLS
 #endif
@@ -0,0 +1,240 @@
+// -*- c-basic-offset: 4; related-file-name: "ipreassemblyengine.hh" -*-
+/*
+ * ipreassemblyengine.{cc,hh} -- fragment store for IP reassembly
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "ipreassemblyengine.hh"
+#include <click/slaballocator.hh>
+#include <click/straccum.hh>
+CLICK_DECLS
+
+IPReassemblyEngine::IPReassemblyEngine()
+    : _alloc(SlabAllocator::shared(sizeof(Datagram))),
+      _max_fragments(default_max_fragments), _mem_used(0), _noverlaps(0),
+      _nduplicates(0)
+{
+    static_assert(sizeof(Range) == IPREASSEMBLER_ANNO_SIZE, "sizeof(Range) is expected to equal IPREASSEMBLER_ANNO_SIZE.");
+}
+
+IPReassemblyEngine::~IPReassemblyEngine()
+{
+    while (Datagram *d = _age.front())
+	destroy(d);
+}
+
+inline uint32_t
+IPReassemblyEngine::charge(const Packet *p)
+{
+    return p->buffer_length() + fragment_overhead;
+}
+
+IPReassemblyEngine::Datagram *
+IPReassemblyEngine::insert(const Key &key, Packet *p, unsigned off,
+			   unsigned lastoff, bool more, int now, Result &result)
+{
+    HashContainer<Datagram>::iterator it = _table.find(key);
+    Datagram *d = it.get();
+    if (!d) {
+	void *slot = _alloc->allocate();
+	if (!slot) {
+	    p->kill();
+	    result = r_invalid;
+	    return 0;
+	}
+	d = new(slot) Datagram;
+	d->key = key;
+	d->head = d->tail = 0;
+	d->nfragments = d->covered = d->total = d->mem = 0;
+	d->create_sec = now;
+	d->max_fragment_length = 0;
+	d->aux[0] = d->aux[1] = 0;
+	_table.set(it, d, true);
+	_age.push_back(d);
+    }
+
+    Range &r = range(p);
+    r.off = off;
+    r.lastoff = lastoff;
+
+    // The last fragment fixes the datagram's length; nothing may extend
+    // past it, and a second last fragment must agree.
+    if (d->total ? lastoff > d->total || (!more && lastoff != d->total)
+	: !more && d->tail && range(d->tail).lastoff > lastoff)
+	goto invalid;
+
+    Packet **pprev;
+    if (!d->tail || off >= range(d->tail).lastoff)
+	// in-order arrival: append
+	pprev = d->tail ? &d->tail->next() : &d->head;
+    else {
+	pprev = &d->head;
+	while (range(*pprev).lastoff <= off)
+	    pprev = &(*pprev)->next();
+	const Range &nr = range(*pprev);
+	if (nr.off == off && nr.lastoff == lastoff) {
+	    ++_nduplicates;
+	    p->kill();
+	    result = r_duplicate;
+	    return 0;
+	} else if (nr.off < lastoff) {
+	    ++_noverlaps;
+	    goto invalid;
+	}
+    }
+
+    if (d->nfragments == _max_fragments)
+	goto invalid;
+
+    p->set_next(*pprev);
+    *pprev = p;
+    if (!p->next())
+	d->tail = p;
+    ++d->nfragments;
+    d->covered += lastoff - off;
+    if (!more)
+	d->total = lastoff;
+    if (p->network_length() > d->max_fragment_length)
+	d->max_fragment_length = p->network_length();
+    d->mem += charge(p);
+    _mem_used += charge(p);
+
+    result = d->complete() ? r_complete : r_held;
+    return d;
+
+  invalid:
+    p->kill();
+    destroy(d);
+    result = r_invalid;
+    return 0;
+}
+
+void
+IPReassemblyEngine::destroy(Datagram *d)
+{
+    _table.erase(d->key);
+    _age.erase(d);
+    while (Packet *p = d->head) {
+	d->head = p->next();
+	p->kill();
+    }
+    _mem_used -= d->mem;
+    d->~Datagram();
+    _alloc->deallocate(d);
+}
+
+void
+IPReassemblyEngine::kill(Datagram *d)
+{
+    destroy(d);
+}
+
+WritablePacket *
+IPReassemblyEngine::flatten(Datagram *d)
+{
+    Packet *f = d->head;
+    // Copy from the start of the MAC header, which may lie in headroom.
+    const unsigned char *start = f->data();
+    if (f->has_mac_header() && f->mac_header() < start)
+	start = f->mac_header();
+    uint32_t pre = f->data() - start;
+    uint32_t hlen = f->transport_header() - f->data();
+    uint32_t len = range(d->tail).lastoff;
+
+    WritablePacket *q = Packet::make(f->headroom() - pre, 0, pre + hlen + len, 0);
+    if (q) {
+	memcpy(q->data(), start, pre + hlen);
+	q->pull(pre);
+	if (f->has_mac_header())
+	    q->set_mac_header(q->data() + f->mac_header_offset(), f->mac_header_length());
+	q->set_network_header(q->data() + f->network_header_offset(), f->network_header_length());
+	q->copy_annotations(f);
+	memset(&range(q), 0, sizeof(Range));
+
+	unsigned char *payload = q->transport_header();
+	uint32_t pos = 0;
+	for (Packet *x = d->head; x; x = x->next()) {
+	    const Range &r = range(x);
+	    if (r.off > pos)
+		memset(payload + pos, 0, r.off - pos);
+	    memcpy(payload + r.off, x->transport_header(), r.lastoff - r.off);
+	    pos = r.lastoff;
+	}
+    }
+
+    destroy(d);
+    return q;
+}
+
+Packet *
+IPReassemblyEngine::take_first(Datagram *d)
+{
+    Packet *p = 0;
+    if (d->has_first()) {
+	p = d->head;
+	d->head = p->next();
+	p->set_next(0);
+	memset(&range(p), 0, sizeof(Range));
+    }
+    destroy(d);
+    return p;
+}
+
+void
+IPReassemblyEngine::unparse(StringAccum &sa,
+			    void (*unparse_key)(StringAccum &, const Packet *)) const
+{
+    for (const Datagram *d = _age.front(); d; d = d->link.next()) {
+	unparse_key(sa, d->head);
+	// print adjacent fragments as one range
+	for (const Packet *x = d->head; x; ) {
+	    uint32_t off = range(x).off, lastoff = range(x).lastoff;
+	    for (x = x->next(); x && range(x).off == lastoff; x = x->next())
+		lastoff = range(x).lastoff;
+	    sa << " (" << off << ',' << lastoff << ')';
+	}
+	sa << '\n';
+    }
+}
+
+bool
+IPReassemblyEngine::check() const
+{
+    uint32_t mem = 0;
+    size_t n = 0;
+    for (const Datagram *d = _age.front(); d; d = d->link.next(), ++n) {
+	if (_table.get(d->key) != d || !d->head)
+	    return false;
+	uint32_t dmem = 0, covered = 0, nfragments = 0, pos = 0;
+	const Packet *last = 0;
+	for (const Packet *x = d->head; x; last = x, x = x->next()) {
+	    const Range &r = range(x);
+	    if (r.off >= r.lastoff || r.off < pos
+		|| (uint32_t) x->transport_length() != (uint32_t) (r.lastoff - r.off))
+		return false;
+	    pos = r.lastoff;
+	    covered += r.lastoff - r.off;
+	    dmem += charge(x);
+	    ++nfragments;
+	}
+	if (last != d->tail || covered != d->covered
+	    || nfragments != d->nfragments || dmem != d->mem
+	    || (d->total && d->total != pos) || d->complete())
+	    return false;
+	mem += dmem;
+    }
+    return n == _table.size() && mem == _mem_used;
+}
+
+CLICK_ENDDECLS
+ELEMENT_PROVIDES(IPReassemblyEngine)
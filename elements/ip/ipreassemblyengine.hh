@@ -0,0 +1,235 @@
+// -*- c-basic-offset: 4; related-file-name: "ipreassemblyengine.cc" -*-
+#ifndef CLICK_IPREASSEMBLYENGINE_HH
+#define CLICK_IPREASSEMBLYENGINE_HH
+#include <click/packet.hh>
+#include <click/packet_anno.hh>
+#include <click/hashcontainer.hh>
+#include <click/list.hh>
+CLICK_DECLS
+class SlabAllocator;
+class StringAccum;
+
+/** @class IPReassemblyEngine
+ * @brief Fragment store shared by IPReassembler and IP6Reassembler.
+ *
+ * The engine holds the fragments of partially received datagrams, keyed by
+ * source, destination, identification and protocol.  The caller parses each
+ * fragment, marks its transport header at the start of the fragment's
+ * payload, and passes it to insert() along with the payload's byte range.
+ *
+ * Fragments are kept as they arrived, chained in offset order through their
+ * "next packet" annotations; each fragment's range is stored in its
+ * IPREASSEMBLER annotation area.  Since chained fragments never overlap, the
+ * chain itself describes the datagram's holes, and a datagram is complete
+ * when it has a last fragment and its fragments cover every byte before the
+ * last fragment's end.  Payloads are copied exactly once, by flatten().
+ *
+ * A fragment that overlaps data already held, without exactly duplicating
+ * an earlier fragment, invalidates its whole datagram (see RFC 5722).  So do
+ * inconsistent lengths and datagrams with more than max_fragments()
+ * fragments.  This bounds both the work per fragment and the damage a
+ * stream of crafted overlaps can do.
+ *
+ * Datagrams are kept on a list in order of creation.  Callers expire and
+ * evict from its head, so the oldest datagrams are reclaimed first and no
+ * operation scans the whole table. */
+class IPReassemblyEngine { public:
+
+    struct Key {
+	uint32_t src[4];
+	uint32_t dst[4];
+	uint32_t id;
+	uint32_t proto;
+
+	inline hashcode_t hashcode() const;
+	inline bool operator==(const Key &x) const;
+    };
+
+    struct Datagram {
+	Key key;
+	Datagram *_hashnext;
+	List_member<Datagram> link;
+	Packet *head;		// fragments in offset order
+	Packet *tail;
+	uint32_t nfragments;
+	uint32_t covered;	// payload bytes held
+	uint32_t total;		// payload length; 0 until the last fragment
+	uint32_t mem;		// memory charged to this datagram
+	int create_sec;
+	uint16_t max_fragment_length;	// largest network_length()
+	uint16_t aux[2];	// for the caller
+
+	typedef Key key_type;
+	typedef const Key &key_const_reference;
+	const Key &hashkey() const {
+	    return key;
+	}
+
+	bool complete() const {
+	    return total && covered == total;
+	}
+	bool has_first() const;
+    };
+
+    enum {
+	default_max_fragments = 64,
+	fragment_overhead = 40		// memory charged per fragment
+    };
+
+    IPReassemblyEngine();
+    ~IPReassemblyEngine();
+
+    /** @brief Set the number of fragments a datagram may have. */
+    void set_max_fragments(uint32_t n) {
+	_max_fragments = n;
+    }
+    uint32_t max_fragments() const {
+	return _max_fragments;
+    }
+
+    enum Result {
+	r_held,			///< fragment stored, datagram incomplete
+	r_complete,		///< fragment stored, datagram complete
+	r_duplicate,		///< fragment repeats stored data; killed
+	r_invalid		///< datagram invalidated; all fragments killed
+    };
+
+    /** @brief Add fragment @a p to the datagram for @a key.
+     * @param p fragment; its transport header starts the payload, and its
+     *   transport_length() equals @a lastoff - @a off
+     * @param off payload offset of the fragment's first byte
+     * @param lastoff payload offset just past the fragment's last byte
+     * @param more true iff later fragments follow
+     * @param now current time in seconds, recorded for new datagrams
+     * @param[out] result what happened
+     * @return the datagram, or null if @a result is r_duplicate or
+     *   r_invalid
+     *
+     * The engine takes ownership of @a p.  When @a result is r_complete,
+     * the caller should flatten() the datagram. */
+    Datagram *insert(const Key &key, Packet *p, unsigned off,
+		     unsigned lastoff, bool more, int now, Result &result);
+
+    /** @brief Return the oldest datagram, or null if there are none. */
+    Datagram *oldest() {
+	return _age.front();
+    }
+
+    /** @brief Return the oldest datagram if it was created before
+     * @a sec, or null. */
+    Datagram *expired(int sec) {
+	Datagram *d = _age.front();
+	return d && d->create_sec < sec ? d : 0;
+    }
+
+    /** @brief Combine @a d's fragments into one packet and destroy @a d.
+     *
+     * The result is a copy of @a d's lowest-offset fragment up to and
+     * including its headers, followed by the payload, with every byte not
+     * covered by a fragment zeroed.  Its transport header marks the
+     * payload.  It has the lowest-offset fragment's annotations, except
+     * that the IPREASSEMBLER annotation area is zero.  Returns null if
+     * memory is exhausted. */
+    WritablePacket *flatten(Datagram *d);
+
+    /** @brief Destroy @a d, returning its fragment with offset 0, if any.
+     *
+     * The returned packet's IPREASSEMBLER annotation area is zero. */
+    Packet *take_first(Datagram *d);
+
+    /** @brief Destroy @a d and its fragments. */
+    void kill(Datagram *d);
+
+    /** @brief Return the number of datagrams held. */
+    size_t size() const {
+	return _table.size();
+    }
+
+    /** @brief Return the memory charged for held fragments.
+     *
+     * Each fragment is charged its buffer length plus fragment_overhead. */
+    uint32_t mem_used() const {
+	return _mem_used;
+    }
+
+    uint32_t noverlaps() const {
+	return _noverlaps;
+    }
+    uint32_t nduplicates() const {
+	return _nduplicates;
+    }
+
+    /** @brief Append each datagram's fragment ranges to @a sa.
+     *
+     * Each datagram takes one line, which starts with the output of
+     * @a unparse_key on the datagram's lowest-offset fragment. */
+    void unparse(StringAccum &sa,
+		 void (*unparse_key)(StringAccum &, const Packet *)) const;
+
+    /** @brief Check internal invariants, returning false on failure. */
+    bool check() const;
+
+    /** @brief Fragment range stored in the IPREASSEMBLER annotation area. */
+    struct Range {
+	uint16_t off;
+	uint16_t lastoff;
+    };
+    static inline Range &range(Packet *p);
+    static inline const Range &range(const Packet *p);
+
+  private:
+
+    HashContainer<Datagram> _table;
+    List<Datagram, &Datagram::link> _age;
+    SlabAllocator *_alloc;
+    uint32_t _max_fragments;
+    uint32_t _mem_used;
+    uint32_t _noverlaps;
+    uint32_t _nduplicates;
+
+    static inline uint32_t charge(const Packet *p);
+    void destroy(Datagram *d);
+
+    IPReassemblyEngine(const IPReassemblyEngine &x);
+    IPReassemblyEngine &operator=(const IPReassemblyEngine &x);
+
+};
+
+
+inline hashcode_t
+IPReassemblyEngine::Key::hashcode() const
+{
+    uint32_t h = id * 0x9E3779B1U;
+    for (int i = 0; i < 4; ++i)
+	h = ((h << 7) | (h >> 25)) ^ src[i] ^ (dst[i] * 0x85EBCA6BU);
+    return h ^ proto ^ (h >> 16);
+}
+
+inline bool
+IPReassemblyEngine::Key::operator==(const Key &x) const
+{
+    return id == x.id && proto == x.proto
+	&& memcmp(src, x.src, sizeof(src)) == 0
+	&& memcmp(dst, x.dst, sizeof(dst)) == 0;
+}
+
+inline IPReassemblyEngine::Range &
+IPReassemblyEngine::range(Packet *p)
+{
+    return *reinterpret_cast<Range *>(p->anno_u8() + IPREASSEMBLER_ANNO_OFFSET);
+}
+
+inline const IPReassemblyEngine::Range &
+IPReassemblyEngine::range(const Packet *p)
+{
+    return *reinterpret_cast<const Range *>(p->anno_u8() + IPREASSEMBLER_ANNO_OFFSET);
+}
+
+inline bool
+IPReassemblyEngine::Datagram::has_first() const
+{
+    return head && range(head).off == 0;
+}
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,365 @@
+/*
+ * rssswitch.{cc,hh} -- element spreads flows over outputs by Toeplitz hash
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "rssswitch.hh"
+#include <clicknet/ip.h>
+#include <clicknet/ip6.h>
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/glue.hh>
+#include <click/master.hh>
+#include <click/straccum.hh>
+CLICK_DECLS
+
+RSSSwitch::RSSSwitch()
+    : _table(0), _retire_timer(this)
+{
+}
+
+RSSSwitch::~RSSSwitch()
+{
+}
+
+int
+RSSSwitch::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    String key;
+    for (int i = 0; i < 20; ++i)
+	key.append("\x6d\x5a", 2);
+    bool symmetric = true;
+    uint32_t table_size = 128;
+    _anno = -1;
+    if (Args(conf, this, errh)
+	.read("KEY", key)
+	.read("SYMMETRIC", symmetric)
+	.read("TABLE_SIZE", table_size)
+	.read("ANNO", AnnoArg(4), _anno)
+	.complete() < 0)
+	return -1;
+    if (key.length() < max_input + 4)
+	return errh->error("KEY must have at least %d bytes", max_input + 4);
+    if (table_size == 0 || table_size > 65536 || (table_size & (table_size - 1)))
+	return errh->error("TABLE_SIZE must be a power of two between 1 and 65536");
+
+    // _lookup[p][v] is the hash contribution of byte value v at position p:
+    // the XOR of the 32-bit key windows starting at v's set bits.
+    const unsigned char *k = reinterpret_cast<const unsigned char *>(key.data());
+    for (int p = 0; p < max_input; ++p) {
+	uint32_t window[8];
+	for (int b = 0; b < 8; ++b) {
+	    const unsigned char *kk = k + p;
+	    uint32_t w = (kk[0] << 24) | (kk[1] << 16) | (kk[2] << 8) | kk[3];
+	    window[b] = b ? (w << b) | (kk[4] >> (8 - b)) : w;
+	}
+	for (int v = 0; v < 256; ++v) {
+	    uint32_t h = 0;
+	    for (int b = 0; b < 8; ++b)
+		if (v & (0x80 >> b))
+		    h ^= window[b];
+	    _lookup[p][v] = h;
+	}
+    }
+
+    // A key that repeats every 16 bits hashes both directions alike.
+    bool periodic = true;
+    for (int i = 2; i < max_input + 4; ++i)
+	periodic = periodic && k[i] == k[i - 2];
+    _canonicalize = symmetric && !periodic;
+
+    if (!(_table = make_table(table_size)))
+	return errh->error("out of memory");
+    for (uint32_t i = 0; i < table_size; ++i)
+	_table->entry[i] = i % noutputs();
+    return 0;
+}
+
+int
+RSSSwitch::initialize(ErrorHandler *)
+{
+    _retire_timer.initialize(this);
+    return 0;
+}
+
+void
+RSSSwitch::cleanup(CleanupStage)
+{
+    if (_table)
+	_retired.push_back(_table);
+    _table = 0;
+    for (Table **t = _retired.begin(); t != _retired.end(); ++t)
+	free_table(*t);
+    _retired.clear();
+}
+
+RSSSwitch::Table *
+RSSSwitch::make_table(uint32_t size)
+{
+    Table *t = new Table;
+    if (!t)
+	return 0;
+    t->mask = size - 1;
+    t->ncpus = master()->nthreads();
+    if (t->ncpus < 1)
+	t->ncpus = 1;
+    t->entry = new uint16_t[size];
+    t->counts = new uint32_t[t->ncpus * size];
+    if (!t->entry || !t->counts) {
+	free_table(t);
+	return 0;
+    }
+    memset(t->counts, 0, sizeof(uint32_t) * t->ncpus * size);
+    return t;
+}
+
+void
+RSSSwitch::free_table(Table *t)
+{
+    delete[] t->entry;
+    delete[] t->counts;
+    delete t;
+}
+
+/* Packets being switched on other threads may still use the old table, so
+   it is freed only after a grace period, long past the few instructions
+   push() spends with it. */
+void
+RSSSwitch::install_table(Table *t)
+{
+    _retired_lock.acquire();
+    Table *old = _table;
+    // Make the new table's contents visible before the pointer.
+    click_write_fence();
+    _table = t;
+    old->retired = Timestamp::now_steady();
+    _retired.push_back(old);
+    if (!_retire_timer.scheduled())
+	_retire_timer.schedule_after_msec(retire_msec);
+    _retired_lock.release();
+}
+
+void
+RSSSwitch::run_timer(Timer *)
+{
+    Timestamp limit = Timestamp::now_steady() - Timestamp::make_msec(retire_msec);
+    _retired_lock.acquire();
+    Table **w = _retired.begin();
+    for (Table **t = _retired.begin(); t != _retired.end(); ++t)
+	if ((*t)->retired <= limit)
+	    free_table(*t);
+	else
+	    *w++ = *t;
+    _retired.resize(w - _retired.begin());
+    if (_retired.size())
+	_retire_timer.schedule_at_steady(_retired[0]->retired
+					 + Timestamp::make_msec(retire_msec));
+    _retired_lock.release();
+}
+
+inline uint32_t
+RSSSwitch::hash_bytes(const unsigned char *a, const unsigned char *b,
+		      int alen, const unsigned char *ports) const
+{
+    const unsigned char *sp = ports, *dp = ports + 2;
+    if (_canonicalize) {
+	int c = memcmp(a, b, alen);
+	if (c > 0 || (c == 0 && ports && memcmp(sp, dp, 2) > 0)) {
+	    const unsigned char *x = a;
+	    a = b, b = x;
+	    x = sp;
+	    sp = dp, dp = x;
+	}
+    }
+
+    uint32_t h = 0;
+    int pos = 0;
+    for (int i = 0; i < alen; ++i, ++pos)
+	h ^= _lookup[pos][a[i]];
+    for (int i = 0; i < alen; ++i, ++pos)
+	h ^= _lookup[pos][b[i]];
+    if (ports)
+	h ^= _lookup[pos][sp[0]] ^ _lookup[pos + 1][sp[1]]
+	    ^ _lookup[pos + 2][dp[0]] ^ _lookup[pos + 3][dp[1]];
+    return h;
+}
+
+uint32_t
+RSSSwitch::hash(const Packet *p) const
+{
+    if (!p->has_network_header())
+	return 0;
+    const unsigned char *nh = p->network_header();
+    int nlen = p->network_length();
+    const unsigned char *ports = 0;
+    if (nlen >= (int) sizeof(click_ip) && (nh[0] >> 4) == 4) {
+	const click_ip *iph = reinterpret_cast<const click_ip *>(nh);
+	int hl = iph->ip_hl << 2;
+	if ((iph->ip_p == IP_PROTO_TCP || iph->ip_p == IP_PROTO_UDP)
+	    && !IP_ISFRAG(iph) && nlen >= hl + 4)
+	    ports = nh + hl;
+	return hash_bytes(reinterpret_cast<const unsigned char *>(&iph->ip_src),
+			  reinterpret_cast<const unsigned char *>(&iph->ip_dst),
+			  4, ports);
+    } else if (nlen >= (int) sizeof(click_ip6) && (nh[0] >> 4) == 6) {
+	const click_ip6 *ip6h = reinterpret_cast<const click_ip6 *>(nh);
+	if ((ip6h->ip6_nxt == IP_PROTO_TCP || ip6h->ip6_nxt == IP_PROTO_UDP)
+	    && nlen >= (int) sizeof(click_ip6) + 4)
+	    ports = nh + sizeof(click_ip6);
+	return hash_bytes(reinterpret_cast<const unsigned char *>(&ip6h->ip6_src),
+			  reinterpret_cast<const unsigned char *>(&ip6h->ip6_dst),
+			  16, ports);
+    } else
+	return 0;
+}
+
+void
+RSSSwitch::push(int, Packet *p)
+{
+    uint32_t h = hash(p);
+    if (_anno >= 0)
+	p->set_anno_u32(_anno, h);
+    Table *t = _table;
+    uint32_t i = h & t->mask;
+    ++t->counts[(click_current_cpu_id() % t->ncpus) * (t->mask + 1) + i];
+    output(t->entry[i]).push(p);
+}
+
+enum { h_table, h_table_size, h_loads, h_rebalance };
+
+String
+RSSSwitch::read_handler(Element *e, void *thunk)
+{
+    RSSSwitch *rs = static_cast<RSSSwitch *>(e);
+    Table *t = rs->_table;
+    uint32_t size = t->mask + 1;
+    StringAccum sa;
+    switch ((intptr_t) thunk) {
+    case h_table:
+	for (uint32_t i = 0; i < size; ++i)
+	    sa << (i ? " " : "") << t->entry[i];
+	break;
+    case h_table_size:
+	sa << size;
+	break;
+    case h_loads: {
+	Vector<uint64_t> load(rs->noutputs(), 0);
+	for (uint32_t c = 0; c < t->ncpus; ++c)
+	    for (uint32_t i = 0; i < size; ++i)
+		load[t->entry[i]] += t->counts[c * size + i];
+	for (int o = 0; o < load.size(); ++o)
+	    sa << o << ' ' << load[o] << '\n';
+	break;
+    }
+    }
+    return sa.take_string();
+}
+
+int
+RSSSwitch::write_handler(const String &str, Element *e, void *thunk, ErrorHandler *errh)
+{
+    RSSSwitch *rs = static_cast<RSSSwitch *>(e);
+    Table *t = rs->_table;
+    uint32_t size = t->mask + 1;
+    switch ((intptr_t) thunk) {
+
+    case h_table: {
+	Vector<String> words;
+	cp_spacevec(str, words);
+	uint32_t nsize = words.size();
+	if (nsize == 0 || nsize > 65536 || (nsize & (nsize - 1)))
+	    return errh->error("table size must be a power of two between 1 and 65536");
+	Table *nt = rs->make_table(nsize);
+	if (!nt)
+	    return errh->error("out of memory");
+	for (uint32_t i = 0; i < nsize; ++i) {
+	    uint32_t port;
+	    if (!IntArg().parse(words[i], port) || port >= (uint32_t) rs->noutputs()) {
+		free_table(nt);
+		return errh->error("bad output port %<%s%>", words[i].c_str());
+	    }
+	    nt->entry[i] = port;
+	}
+	rs->install_table(nt);
+	return 0;
+    }
+
+    case h_table_size: {
+	uint32_t nsize;
+	if (!IntArg().parse(cp_uncomment(str), nsize)
+	    || nsize == 0 || nsize > 65536 || (nsize & (nsize - 1)))
+	    return errh->error("table size must be a power of two between 1 and 65536");
+	Table *nt = rs->make_table(nsize);
+	if (!nt)
+	    return errh->error("out of memory");
+	// Entry i & mask serves the hashes that entry i will.
+	for (uint32_t i = 0; i < nsize; ++i)
+	    nt->entry[i] = t->entry[i & t->mask];
+	rs->install_table(nt);
+	return 0;
+    }
+
+    case h_rebalance: {
+	Vector<uint64_t> bload(size, 0), load(rs->noutputs(), 0);
+	for (uint32_t c = 0; c < t->ncpus; ++c)
+	    for (uint32_t i = 0; i < size; ++i) {
+		bload[i] += t->counts[c * size + i];
+		t->counts[c * size + i] = 0;
+	    }
+	for (uint32_t i = 0; i < size; ++i)
+	    load[t->entry[i]] += bload[i];
+
+	// Move the largest entry that narrows the gap between the most and
+	// least loaded outputs, until no entry does.
+	for (uint32_t round = 0; round < size; ++round) {
+	    int hi = 0, lo = 0;
+	    for (int o = 1; o < load.size(); ++o) {
+		if (load[o] > load[hi])
+		    hi = o;
+		if (load[o] < load[lo])
+		    lo = o;
+	    }
+	    uint64_t gap = load[hi] - load[lo];
+	    int best = -1;
+	    for (uint32_t i = 0; i < size; ++i)
+		if (t->entry[i] == hi && bload[i] && bload[i] < gap
+		    && (best < 0 || bload[i] > bload[best]))
+		    best = i;
+	    if (best < 0)
+		break;
+	    t->entry[best] = lo;
+	    load[hi] -= bload[best];
+	    load[lo] += bload[best];
+	}
+	return 0;
+    }
+
+    default:
+	return -1;
+    }
+}
+
+void
+RSSSwitch::add_handlers()
+{
+    add_read_handler("table", read_handler, h_table);
+    add_write_handler("table", write_handler, h_table);
+    add_read_handler("table_size", read_handler, h_table_size);
+    add_write_handler("table_size", write_handler, h_table_size);
+    add_read_handler("loads", read_handler, h_loads);
+    add_write_handler("rebalance", write_handler, h_rebalance, Handler::BUTTON);
+}
+
+CLICK_ENDDECLS
+EXPORT_ELEMENT(RSSSwitch)
+ELEMENT_MT_SAFE(RSSSwitch)
@@ -0,0 +1,160 @@
+#ifndef CLICK_RSSSWITCH_HH
+#define CLICK_RSSSWITCH_HH
+#include <click/element.hh>
+#include <click/timer.hh>
+#include <click/sync.hh>
+#include <click/vector.hh>
+CLICK_DECLS
+
+/*
+=c
+
+RSSSwitch(I<keywords> KEY, SYMMETRIC, TABLE_SIZE, ANNO)
+
+=s classification
+
+spreads flows over outputs by Toeplitz hash
+
+=d
+
+Can have any number of outputs.  Chooses the output for each packet as a
+network card performing receive-side scaling (RSS) would: it computes the
+Toeplitz hash of the packet's addresses and ports, and looks up the hash's
+low bits in an indirection table of output ports.  Packets of a flow always
+leave on the same output, so each output can feed a queue served by its own
+thread, and those threads can keep per-flow state without locking.
+
+Expects IPv4 or IPv6 packets with their network header annotations set, as
+by MarkIPHeader, CheckIPHeader, or MarkIP6Header.  For TCP and UDP packets
+other than IPv4 fragments, the hash input is the source address, destination
+address, source port and destination port; for other IP packets it is the
+two addresses.  IPv6 ports are found only when TCP or UDP immediately follows
+the IPv6 header.  Packets that are not IP hash to 0.
+
+The hash is computed from tables precomputed at configuration time, one
+table lookup per input byte.
+
+With the default key, a 16-bit pattern repeated, the hash is symmetric: the
+two directions of a connection hash, and so are switched, identically (Woo
+and Park, "Scalable TCP Session Monitoring with Symmetric Receive-side
+Scaling", 2012).  The hash equals that of network cards configured with the
+same key.
+
+Keyword arguments are:
+
+=over 8
+
+=item KEY
+
+String.  The Toeplitz key, at least 40 bytes.  Default is 0x6d5a repeated.
+Specify keys in hex as C<\E<lt>6d5a56da...E<gt>>.
+
+=item SYMMETRIC
+
+Boolean.  If true, and KEY does not repeat every 16 bits, the addresses and
+ports are put in a canonical order before hashing, so that the hash stays
+symmetric at the cost of matching network cards.  Default is true.
+
+=item TABLE_SIZE
+
+Unsigned.  The number of indirection table entries, a power of two no
+greater than 65536.  Initially entry I<i> holds output I<i> modulo the number
+of outputs.  Default is 128.
+
+=item ANNO
+
+Four-byte annotation.  If given, the hash is stored in this annotation.
+
+=back
+
+=h table read/write
+
+The indirection table, as a space-separated list of output ports.  Writing a
+list of a power-of-two length also changes TABLE_SIZE.
+
+=h table_size read/write
+
+The number of indirection table entries.  Writing a larger size keeps every
+flow's output; writing a smaller one keeps the first entries.  Resets the
+load counters.
+
+=h loads read-only
+
+Returns one line per output, giving the output number and the number of
+packets switched to it since the last rebalance.
+
+=h rebalance write-only
+
+Moves indirection table entries from the most loaded outputs to the least
+loaded ones, using the packet counts recorded per entry since the last
+rebalance, then resets those counts.  An entry is moved only if that
+reduces the larger of the two outputs' loads, so flows move only when the
+load is imbalanced.
+
+=e
+
+Spread flows from one device over four threads:
+
+  FromDevice(eth0) -> Strip(14) -> CheckIPHeader
+      -> rss :: RSSSwitch;
+  rss[0] -> q0 :: ThreadSafeQueue -> ... // processed by thread 0
+  rss[1] -> q1 :: ThreadSafeQueue -> ... // processed by thread 1
+  ...
+  StaticThreadSched(...)
+
+=a HashSwitch, CPUSwitch, RoundRobinSwitch
+*/
+
+class RSSSwitch : public Element { public:
+
+    RSSSwitch() CLICK_COLD;
+    ~RSSSwitch() CLICK_COLD;
+
+    const char *class_name() const	{ return "RSSSwitch"; }
+    const char *port_count() const	{ return "1/1-"; }
+    const char *processing() const	{ return PUSH; }
+
+    int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
+    int initialize(ErrorHandler *) CLICK_COLD;
+    void cleanup(CleanupStage) CLICK_COLD;
+    void add_handlers() CLICK_COLD;
+
+    void push(int port, Packet *);
+
+    uint32_t hash(const Packet *p) const;
+
+  private:
+
+    enum { max_input = 36 };	// IPv6 addresses and ports
+    enum { retire_msec = 1000 };
+
+    struct Table {
+	uint32_t mask;
+	uint32_t ncpus;
+	uint16_t *entry;
+	uint32_t *counts;	// per cpu, then per entry
+	Timestamp retired;
+    };
+
+    uint32_t _lookup[max_input][256];
+    bool _canonicalize;
+    int _anno;
+    Table *_table;
+    Vector<Table *> _retired;
+    SimpleSpinlock _retired_lock;	// handlers and the timer's thread
+    Timer _retire_timer;
+
+    inline uint32_t hash_bytes(const unsigned char *a, const unsigned char *b,
+			       int alen, const unsigned char *ports) const;
+    Table *make_table(uint32_t size);
+    void install_table(Table *t);
+    static void free_table(Table *t);
+    void run_timer(Timer *);
+
+    static String read_handler(Element *, void *);
+    static int write_handler(const String &, Element *, void *, ErrorHandler *);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,447 @@
+// -*- c-basic-offset: 4; related-file-name: "ip6poptrie.hh" -*-
+/*
+ * ip6poptrie.{cc,hh} -- longest-prefix-match table for IPv6
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "ip6poptrie.hh"
+#include <click/glue.hh>
+#include <click/machine.hh>
+CLICK_DECLS
+
+IP6Poptrie::IP6Poptrie()
+    : _root_leaf(0), _root_node(0), _root_len(0), _size(0), _nnodes(0)
+{
+}
+
+IP6Poptrie::~IP6Poptrie()
+{
+    if (_root_node)
+	clear();
+    CLICK_LFREE(_root_leaf, sizeof(uint32_t) << root_bits);
+    CLICK_LFREE(_root_node, sizeof(Node *) << root_bits);
+    CLICK_LFREE(_root_len, sizeof(uint8_t) << root_bits);
+}
+
+bool
+IP6Poptrie::initialize()
+{
+    if (!_root_leaf)
+	_root_leaf = (uint32_t *) CLICK_LALLOC(sizeof(uint32_t) << root_bits);
+    if (!_root_node)
+	_root_node = (Node **) CLICK_LALLOC(sizeof(Node *) << root_bits);
+    if (!_root_len)
+	_root_len = (uint8_t *) CLICK_LALLOC(sizeof(uint8_t) << root_bits);
+    if (!_root_leaf || !_root_node || !_root_len)
+	return false;
+    memset(_root_leaf, 0, sizeof(uint32_t) << root_bits);
+    memset(_root_node, 0, sizeof(Node *) << root_bits);
+    memset(_root_len, root_none, sizeof(uint8_t) << root_bits);
+    return true;
+}
+
+void
+IP6Poptrie::init_node(Node *n, uint32_t inherited)
+{
+    n->vector = 0;
+    n->leafvec = 1;
+    n->children = 0;
+    n->leaves = new uint32_t[1];
+    n->leaves[0] = inherited;
+    n->info = new Info;
+    n->info->inherited = inherited;
+    ++_nnodes;
+}
+
+/** Free @a n's subtree, leaving @a n itself to its owner. */
+void
+IP6Poptrie::release(Node *n)
+{
+    for (int k = popcount(n->vector) - 1; k >= 0; --k)
+	release(&n->children[k]);
+    delete[] n->children;
+    delete[] n->leaves;
+    delete n->info;
+    --_nnodes;
+}
+
+/** Recompute @a n's leaves from its prefixes and inherited value, and push
+    changed values into its children. */
+void
+IP6Poptrie::refresh(Node *n)
+{
+    uint32_t best[nslots];
+    for (int s = 0; s < nslots; ++s)
+	best[s] = n->info->inherited;
+    for (const Local *l = n->info->locals.begin(); l != n->info->locals.end(); ++l) {
+	int first = l->bits << (stride - l->len), last = first + (1 << (stride - l->len));
+	for (int s = first; s < last; ++s)
+	    best[s] = l->value;
+    }
+
+    uint32_t leaves[nslots];
+    uint64_t leafvec = 0;
+    int nleaves = 0;
+    for (int s = 0; s < nslots; ++s)
+	if (!(n->vector & (uint64_t(1) << s))
+	    && (nleaves == 0 || best[s] != leaves[nleaves - 1])) {
+	    leafvec |= uint64_t(1) << s;
+	    leaves[nleaves++] = best[s];
+	}
+    if (nleaves != popcount(n->leafvec)) {
+	delete[] n->leaves;
+	n->leaves = nleaves ? new uint32_t[nleaves] : 0;
+    }
+    memcpy(n->leaves, leaves, sizeof(uint32_t) * nleaves);
+    n->leafvec = leafvec;
+
+    Node *child = n->children;
+    for (int s = 0; s < nslots; ++s)
+	if (n->vector & (uint64_t(1) << s)) {
+	    if (child->info->inherited != best[s]) {
+		child->info->inherited = best[s];
+		refresh(child);
+	    }
+	    ++child;
+	}
+}
+
+/** Add a child node to @a n at slot @a i, and return it. */
+IP6Poptrie::Node *
+IP6Poptrie::add_child(Node *n, unsigned i)
+{
+    uint64_t bit = uint64_t(1) << i;
+    int nchildren = popcount(n->vector), pos = popcount(n->vector & (bit - 1));
+    Node *children = new Node[nchildren + 1];
+    if (nchildren) {
+	memcpy(children, n->children, sizeof(Node) * pos);
+	memcpy(children + pos + 1, n->children + pos, sizeof(Node) * (nchildren - pos));
+    }
+    init_node(&children[pos], leaf(n, i));
+    delete[] n->children;
+    n->children = children;
+    n->vector |= bit;
+    refresh(n);
+    return &children[pos];
+}
+
+/** Remove @a n's child at slot @a i, which must already be released. */
+void
+IP6Poptrie::remove_child(Node *n, unsigned i)
+{
+    uint64_t bit = uint64_t(1) << i;
+    int nchildren = popcount(n->vector), pos = popcount(n->vector & (bit - 1));
+    Node *children = 0;
+    if (nchildren > 1) {
+	children = new Node[nchildren - 1];
+	memcpy(children, n->children, sizeof(Node) * pos);
+	memcpy(children + pos, n->children + pos + 1, sizeof(Node) * (nchildren - pos - 1));
+    }
+    delete[] n->children;
+    n->children = children;
+    n->vector &= ~bit;
+    refresh(n);
+}
+
+inline uint32_t
+IP6Poptrie::root_key(uint32_t top, int len)
+{
+    return (len << root_bits) | (len ? top >> (root_bits - len) : 0);
+}
+
+void
+IP6Poptrie::root_assign(uint32_t top, uint32_t value, int len)
+{
+    _root_len[top] = value ? len : root_none;
+    if (_root_leaf[top] != value) {
+	_root_leaf[top] = value;
+	if (Node *n = _root_node[top]) {
+	    n->info->inherited = value;
+	    refresh(n);
+	}
+    }
+}
+
+/** Return the value of the longest direct-table prefix shorter than
+    @a len that covers @a top, setting @a cover_len to its length. */
+uint32_t
+IP6Poptrie::root_cover(uint32_t top, int len, int &cover_len) const
+{
+    for (cover_len = len - 1; cover_len >= 0; --cover_len)
+	if (uint32_t v = _root_prefixes.get(root_key(top, cover_len)))
+	    return v;
+    return 0;
+}
+
+uint32_t
+IP6Poptrie::set(const IP6Address &addr, int prefix_len, uint32_t value)
+{
+    assert(prefix_len >= 0 && prefix_len <= 128 && value);
+    uint64_t hi, lo;
+    split(addr, hi, lo);
+    uint32_t top = hi >> (64 - root_bits);
+
+    if (prefix_len <= root_bits) {
+	uint32_t key = root_key(top, prefix_len);
+	uint32_t old = _root_prefixes.get(key);
+	_root_prefixes.set(key, value);
+	_size += !old;
+	uint32_t first = (key & ((1 << root_bits) - 1)) << (root_bits - prefix_len),
+	    last = first + (1 << (root_bits - prefix_len));
+	for (uint32_t s = first; s < last; ++s)
+	    if (_root_len[s] == root_none || _root_len[s] <= prefix_len)
+		root_assign(s, value, prefix_len);
+	return old;
+    }
+
+    Node *n = _root_node[top];
+    if (!n) {
+	n = new Node;
+	init_node(n, _root_leaf[top]);
+	_root_node[top] = n;
+    }
+    int depth = root_bits;
+    for (; prefix_len > depth + stride; depth += stride) {
+	unsigned i = slot(hi, lo, depth);
+	uint64_t bit = uint64_t(1) << i;
+	if (n->vector & bit)
+	    n = &n->children[popcount(n->vector & (bit - 1))];
+	else
+	    n = add_child(n, i);
+    }
+
+    int len = prefix_len - depth;
+    uint8_t bits = slot(hi, lo, depth) >> (stride - len);
+    Vector<Local> &locals = n->info->locals;
+    Local *l = locals.begin();
+    for (; l != locals.end() && l->len <= len; ++l)
+	if (l->len == len && l->bits == bits) {
+	    uint32_t old = l->value;
+	    l->value = value;
+	    if (old != value)
+		refresh(n);
+	    return old;
+	}
+    Local nl;
+    nl.len = len;
+    nl.bits = bits;
+    nl.value = value;
+    locals.insert(l, nl);
+    ++_size;
+    refresh(n);
+    return 0;
+}
+
+uint32_t
+IP6Poptrie::remove(const IP6Address &addr, int prefix_len)
+{
+    assert(prefix_len >= 0 && prefix_len <= 128);
+    uint64_t hi, lo;
+    split(addr, hi, lo);
+    uint32_t top = hi >> (64 - root_bits);
+
+    if (prefix_len <= root_bits) {
+	uint32_t key = root_key(top, prefix_len);
+	uint32_t old = _root_prefixes.get(key);
+	if (!old)
+	    return 0;
+	_root_prefixes.erase(key);
+	--_size;
+	int cover_len;
+	uint32_t cover = root_cover(top, prefix_len, cover_len);
+	uint32_t first = (key & ((1 << root_bits) - 1)) << (root_bits - prefix_len),
+	    last = first + (1 << (root_bits - prefix_len));
+	for (uint32_t s = first; s < last; ++s)
+	    if (_root_len[s] == prefix_len)
+		root_assign(s, cover, cover_len);
+	return old;
+    }
+
+    // remember the path so that emptied nodes can be freed
+    enum { max_depth = (128 - root_bits + stride - 1) / stride };
+    Node *path[max_depth];
+    unsigned path_slot[max_depth];
+    int npath = 0;
+    Node *n = _root_node[top];
+    int depth = root_bits;
+    for (; n && prefix_len > depth + stride; depth += stride) {
+	unsigned i = slot(hi, lo, depth);
+	uint64_t bit = uint64_t(1) << i;
+	path[npath] = n;
+	path_slot[npath++] = i;
+	n = n->vector & bit ? &n->children[popcount(n->vector & (bit - 1))] : 0;
+    }
+    if (!n)
+	return 0;
+
+    int len = prefix_len - depth;
+    uint8_t bits = slot(hi, lo, depth) >> (stride - len);
+    Vector<Local> &locals = n->info->locals;
+    Local *l = locals.begin();
+    while (l != locals.end() && (l->len != len || l->bits != bits))
+	++l;
+    if (l == locals.end())
+	return 0;
+    uint32_t old = l->value;
+    locals.erase(l);
+    --_size;
+    refresh(n);
+
+    while (n->vector == 0 && n->info->locals.empty()) {
+	release(n);
+	if (npath == 0) {
+	    delete n;
+	    _root_node[top] = 0;
+	    break;
+	}
+	--npath;
+	remove_child(path[npath], path_slot[npath]);
+	n = path[npath];
+    }
+    return old;
+}
+
+uint32_t
+IP6Poptrie::get(const IP6Address &addr, int prefix_len) const
+{
+    uint64_t hi, lo;
+    split(addr, hi, lo);
+    uint32_t top = hi >> (64 - root_bits);
+    if (prefix_len <= root_bits)
+	return _root_prefixes.get(root_key(top, prefix_len));
+
+    const Node *n = _root_node[top];
+    int depth = root_bits;
+    for (; n && prefix_len > depth + stride; depth += stride) {
+	unsigned i = slot(hi, lo, depth);
+	uint64_t bit = uint64_t(1) << i;
+	n = n->vector & bit ? &n->children[popcount(n->vector & (bit - 1))] : 0;
+    }
+    if (!n)
+	return 0;
+    int len = prefix_len - depth;
+    uint8_t bits = slot(hi, lo, depth) >> (stride - len);
+    for (const Local *l = n->info->locals.begin(); l != n->info->locals.end(); ++l)
+	if (l->len == len && l->bits == bits)
+	    return l->value;
+    return 0;
+}
+
+void
+IP6Poptrie::lookup_batch(const IP6Address *addrs, uint32_t *values, int n) const
+{
+    enum { batch = 16 };
+    uint64_t hi[batch], lo[batch];
+    const Node *node[batch];
+    for (int i = 0; i < n; i += batch) {
+	int m = n - i < batch ? n - i : batch;
+	for (int j = 0; j < m; ++j) {
+	    split(addrs[i + j], hi[j], lo[j]);
+	    uint32_t top = hi[j] >> (64 - root_bits);
+	    click_prefetch0(&_root_node[top]);
+	    click_prefetch0(&_root_leaf[top]);
+	}
+	for (int j = 0; j < m; ++j)
+	    if ((node[j] = _root_node[hi[j] >> (64 - root_bits)]))
+		click_prefetch0(node[j]);
+	for (int j = 0; j < m; ++j)
+	    values[i + j] = node[j] ? walk(node[j], hi[j], lo[j])
+		: _root_leaf[hi[j] >> (64 - root_bits)];
+    }
+}
+
+void
+IP6Poptrie::clear()
+{
+    for (uint32_t s = 0; s < (1U << root_bits); ++s)
+	if (Node *n = _root_node[s]) {
+	    release(n);
+	    delete n;
+	    _root_node[s] = 0;
+	}
+    memset(_root_leaf, 0, sizeof(uint32_t) << root_bits);
+    memset(_root_len, root_none, sizeof(uint8_t) << root_bits);
+    _root_prefixes.clear();
+    _size = 0;
+}
+
+size_t
+IP6Poptrie::node_memory(const Node *n) const
+{
+    size_t m = sizeof(Info) + n->info->locals.capacity() * sizeof(Local)
+	+ popcount(n->leafvec) * sizeof(uint32_t);
+    for (int k = popcount(n->vector) - 1; k >= 0; --k)
+	m += sizeof(Node) + node_memory(&n->children[k]);
+    return m;
+}
+
+size_t
+IP6Poptrie::memory_used() const
+{
+    size_t m = (sizeof(uint32_t) + sizeof(Node *) + sizeof(uint8_t)) << root_bits;
+    for (uint32_t s = 0; s < (1U << root_bits); ++s)
+	if (const Node *n = _root_node[s])
+	    m += sizeof(Node) + node_memory(n);
+    return m;
+}
+
+bool
+IP6Poptrie::check_node(const Node *n, uint32_t inherited, int depth) const
+{
+    if (n->info->inherited != inherited
+	|| (n->vector == 0 && n->info->locals.empty())
+	|| depth >= 128)
+	return false;
+    for (int i = 1; i < n->info->locals.size(); ++i)
+	if (n->info->locals[i].len < n->info->locals[i - 1].len)
+	    return false;
+    for (const Local *l = n->info->locals.begin(); l != n->info->locals.end(); ++l)
+	if (l->len < 1 || l->len > stride || l->bits >= (1 << l->len)
+	    || depth + l->len > 128)
+	    return false;
+
+    const Node *child = n->children;
+    for (int s = 0; s < nslots; ++s) {
+	// the slot's value is that of its longest local prefix
+	uint32_t v = inherited;
+	int vlen = 0;
+	for (const Local *l = n->info->locals.begin(); l != n->info->locals.end(); ++l)
+	    if ((s >> (stride - l->len)) == l->bits && l->len >= vlen)
+		v = l->value, vlen = l->len;
+	if (n->vector & (uint64_t(1) << s)) {
+	    if (!check_node(child, v, depth + stride))
+		return false;
+	    ++child;
+	} else if (leaf(n, s) != v)
+	    return false;
+    }
+    return true;
+}
+
+bool
+IP6Poptrie::check() const
+{
+    for (uint32_t s = 0; s < (1U << root_bits); ++s) {
+	int len;
+	uint32_t v = root_cover(s, root_bits + 1, len);
+	if (v != _root_leaf[s] || (v ? len : root_none) != _root_len[s])
+	    return false;
+	if (const Node *n = _root_node[s])
+	    if (!check_node(n, v, root_bits))
+		return false;
+    }
+    return true;
+}
+
+CLICK_ENDDECLS
+ELEMENT_PROVIDES(IP6Poptrie)
@@ -0,0 +1,213 @@
+// -*- c-basic-offset: 4; related-file-name: "ip6poptrie.cc" -*-
+#ifndef CLICK_IP6POPTRIE_HH
+#define CLICK_IP6POPTRIE_HH
+#include <click/ip6address.hh>
+#include <click/hashtable.hh>
+#include <click/vector.hh>
+CLICK_DECLS
+
+/** @class IP6Poptrie
+ * @brief Longest-prefix-match table for IPv6 addresses.
+ *
+ * IP6Poptrie maps IPv6 prefixes to nonzero 32-bit values and finds the value
+ * of the longest prefix matching an address.  It follows the Poptrie scheme
+ * (Asai and Ohara, SIGCOMM 2015).  The first 16 bits of an address index a
+ * direct table; each later level is a node consuming 6 bits.  A node holds
+ * two 64-bit bitmaps, one marking slots with child nodes and one marking
+ * the slots that start a run of equal leaves, so that its children and its
+ * leaves are stored in dense arrays indexed by population counts.  Leaves
+ * are pushed down: every leaf holds the value of the longest prefix
+ * covering it, so a lookup ends at the first leaf it reaches.  A lookup
+ * reads one direct-table entry and one node per level below it, and never
+ * touches the prefixes themselves.
+ *
+ * Updates are incremental.  Each prefix is recorded in the direct table or
+ * in the single node whose 6 bits it ends in; changing it rebuilds that
+ * node's leaves and pushes the new value into the descendants that
+ * inherited the old one.  Nodes are created along a prefix's path on
+ * insertion and freed when they no longer hold prefixes or children.
+ *
+ * The value 0 means "no route". */
+class IP6Poptrie { public:
+
+    IP6Poptrie();
+    ~IP6Poptrie();
+
+    /** @brief Allocate the direct table.
+     * @return true on success, false if out of memory
+     *
+     * Call initialize() before any other method. */
+    bool initialize();
+
+    /** @brief Return the value of the longest prefix matching @a addr, or 0. */
+    inline uint32_t lookup(const IP6Address &addr) const;
+
+    /** @brief Look up @a n addresses at once.
+     * @param addrs addresses to look up
+     * @param[out] values values[@em i] is set to lookup(@a addrs[@em i])
+     *
+     * lookup_batch() prefetches every address's direct-table entry, and
+     * then its first node, before walking any of them, so the cache misses
+     * of independent lookups overlap. */
+    void lookup_batch(const IP6Address *addrs, uint32_t *values, int n) const;
+
+    /** @brief Map the prefix @a addr/@a prefix_len to @a value.
+     * @pre 0 <= @a prefix_len <= 128 and @a value != 0
+     * @return the prefix's previous value, or 0 if it was absent.
+     *
+     * Bits of @a addr beyond @a prefix_len are ignored. */
+    uint32_t set(const IP6Address &addr, int prefix_len, uint32_t value);
+
+    /** @brief Remove the prefix @a addr/@a prefix_len.
+     * @return the prefix's value, or 0 if it was absent. */
+    uint32_t remove(const IP6Address &addr, int prefix_len);
+
+    /** @brief Return the value of the prefix @a addr/@a prefix_len, or 0. */
+    uint32_t get(const IP6Address &addr, int prefix_len) const;
+
+    /** @brief Remove every prefix. */
+    void clear();
+
+    /** @brief Return the number of prefixes. */
+    uint32_t size() const {
+	return _size;
+    }
+
+    /** @brief Return the number of trie nodes, not counting the direct table. */
+    uint32_t nodes() const {
+	return _nnodes;
+    }
+
+    /** @brief Return the approximate number of bytes used. */
+    size_t memory_used() const;
+
+    /** @brief Check the trie's invariants, returning false on error. */
+    bool check() const;
+
+  private:
+
+    enum {
+	root_bits = 16,
+	stride = 6,
+	nslots = 1 << stride,
+	root_none = 0xFF
+    };
+
+    struct Local {		// a prefix ending in a node
+	uint8_t len;		// 1..stride bits past the node's depth
+	uint8_t bits;		// those bits, right-aligned
+	uint32_t value;
+    };
+
+    struct Info;
+
+    struct Node {
+	uint64_t vector;	// slot i has a child
+	uint64_t leafvec;	// slot i starts a run of leaves
+	Node *children;		// popcount(vector) nodes
+	uint32_t *leaves;	// popcount(leafvec) values
+	Info *info;
+    };
+
+    struct Info {
+	uint32_t inherited;	// value of the longest prefix above the node
+	Vector<Local> locals;	// sorted by len
+    };
+
+    uint32_t *_root_leaf;
+    Node **_root_node;
+    uint8_t *_root_len;		// length of the prefix setting _root_leaf
+    HashTable<uint32_t, uint32_t> _root_prefixes;
+    uint32_t _size;
+    uint32_t _nnodes;
+
+    static inline int popcount(uint64_t x);
+    static inline void split(const IP6Address &addr, uint64_t &hi, uint64_t &lo);
+    static inline unsigned slot(uint64_t hi, uint64_t lo, int depth);
+    static inline uint32_t leaf(const Node *n, unsigned i);
+    static inline uint32_t walk(const Node *n, uint64_t hi, uint64_t lo);
+
+    void init_node(Node *n, uint32_t inherited);
+    void release(Node *n);
+    void refresh(Node *n);
+    Node *add_child(Node *n, unsigned i);
+    void remove_child(Node *n, unsigned i);
+    void root_assign(uint32_t top, uint32_t value, int len);
+    uint32_t root_cover(uint32_t top, int len, int &cover_len) const;
+    static inline uint32_t root_key(uint32_t top, int len);
+    size_t node_memory(const Node *n) const;
+    bool check_node(const Node *n, uint32_t inherited, int depth) const;
+
+    IP6Poptrie(const IP6Poptrie &);
+    IP6Poptrie &operator=(const IP6Poptrie &);
+
+};
+
+inline int
+IP6Poptrie::popcount(uint64_t x)
+{
+#if __GNUC__
+    return __builtin_popcountll(x);
+#else
+    x = x - ((x >> 1) & 0x5555555555555555ULL);
+    x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+    x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return (x * 0x0101010101010101ULL) >> 56;
+#endif
+}
+
+inline void
+IP6Poptrie::split(const IP6Address &addr, uint64_t &hi, uint64_t &lo)
+{
+    const uint32_t *w = addr.data32();
+    hi = ((uint64_t) ntohl(w[0]) << 32) | ntohl(w[1]);
+    lo = ((uint64_t) ntohl(w[2]) << 32) | ntohl(w[3]);
+}
+
+/** Return the stride bits of the address hi:lo starting at bit @a depth.
+    Bits past the end of the address read as zero. */
+inline unsigned
+IP6Poptrie::slot(uint64_t hi, uint64_t lo, int depth)
+{
+    int shift = 128 - stride - depth;	// position of the slot's low bit
+    if (shift >= 64)
+	return (hi >> (shift - 64)) & (nslots - 1);
+    else if (shift > 0)
+	return ((lo >> shift) | (hi << (64 - shift))) & (nslots - 1);
+    else
+	return (lo << -shift) & (nslots - 1);
+}
+
+inline uint32_t
+IP6Poptrie::leaf(const Node *n, unsigned i)
+{
+    uint64_t below = (uint64_t(2) << i) - 1;
+    return n->leaves[popcount(n->leafvec & below) - 1];
+}
+
+inline uint32_t
+IP6Poptrie::walk(const Node *n, uint64_t hi, uint64_t lo)
+{
+    for (int depth = root_bits; ; depth += stride) {
+	unsigned i = slot(hi, lo, depth);
+	uint64_t below = (uint64_t(2) << i) - 1;
+	if (!(n->vector & (uint64_t(1) << i)))
+	    return n->leaves[popcount(n->leafvec & below) - 1];
+	n = &n->children[popcount(n->vector & below) - 1];
+    }
+}
+
+inline uint32_t
+IP6Poptrie::lookup(const IP6Address &addr) const
+{
+    uint64_t hi, lo;
+    split(addr, hi, lo);
+    uint32_t top = hi >> (64 - root_bits);
+    if (const Node *n = _root_node[top])
+	return walk(n, hi, lo);
+    else
+	return _root_leaf[top];
+}
+
+CLICK_ENDDECLS
+#endif
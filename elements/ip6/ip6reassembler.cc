@@ -0,0 +1,266 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * ip6reassembler.{cc,hh} -- defragments IP6 packets
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "ip6reassembler.hh"
+#include <click/ip6address.hh>
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/straccum.hh>
+#include <clicknet/ip6.h>
+CLICK_DECLS
+
+IP6Reassembler::IP6Reassembler()
+    : _stat_frags_seen(0), _stat_good_assem(0), _stat_failed_assem(0), _stat_bad_pkts(0)
+{
+}
+
+IP6Reassembler::~IP6Reassembler()
+{
+}
+
+int
+IP6Reassembler::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    _mem_high_thresh = 256 * 1024;
+    uint32_t max_fragments = IPReassemblyEngine::default_max_fragments;
+    int mtu_anno = -1;
+    if (Args(conf, this, errh)
+	.read("HIMEM", _mem_high_thresh)
+	.read("MAX_FRAGMENTS", max_fragments)
+	.read("MAX_MTU_ANNO", AnnoArg(2), mtu_anno)
+	.complete() < 0)
+	return -1;
+    if (max_fragments == 0)
+	return errh->error("MAX_FRAGMENTS must be at least 1");
+    _engine.set_max_fragments(max_fragments);
+    _mtu_anno = mtu_anno;
+    _mem_low_thresh = (_mem_high_thresh >> 2) * 3;
+    return 0;
+}
+
+int
+IP6Reassembler::initialize(ErrorHandler *)
+{
+    _reap_time = 0;
+    return 0;
+}
+
+void
+IP6Reassembler::cleanup(CleanupStage)
+{
+    while (Datagram *d = _engine.oldest())
+	_engine.kill(d);
+}
+
+void
+IP6Reassembler::unparse_key(StringAccum &sa, const Packet *p)
+{
+    const click_ip6 *ip6h = p->ip6_header();
+    const click_ip6_fragment *fh = reinterpret_cast<const click_ip6_fragment *>(p->transport_header()) - 1;
+    sa << ' ' << IP6Address(ip6h->ip6_src) << " > " << IP6Address(ip6h->ip6_dst)
+       << ' ' << ntohl(fh->ip6_frag_id);
+}
+
+String
+IP6Reassembler::debug_dump(Element *e, void *)
+{
+    IP6Reassembler *r = (IP6Reassembler *) e;
+    if (!r->_engine.check())
+	click_chatter("%p{element}: fragment store is inconsistent", r);
+    StringAccum sa;
+    sa <<
+	"frags seen total:    " << r->_stat_frags_seen << "\n"
+	"good reassemblies:   " << r->_stat_good_assem << "\n"
+	"failed reassemblies: " << r->_stat_failed_assem << "\n"
+	"bad fragments seen:  " << r->_stat_bad_pkts << "\n"
+	"overlapping frags:   " << r->_engine.noverlaps() << "\n"
+	"duplicate frags:     " << r->_engine.nduplicates() << "\n"
+	"memory used:         " << r->_engine.mem_used() << "\n"
+	"cached chunk data:\n";
+    r->_engine.unparse(sa, unparse_key);
+    return sa.take_string();
+}
+
+WritablePacket *
+IP6Reassembler::finish(Datagram *d)
+{
+    // aux[0]: offset of the Next Header field naming the Fragment header
+    // aux[1]: the Fragment header's Next Header
+    unsigned nxt_pos = d->aux[0];
+    uint8_t nxt = d->aux[1];
+    uint16_t mtu = d->max_fragment_length;
+    WritablePacket *q = _engine.flatten(d);
+    if (!q) {
+	click_chatter("out of memory");
+	return 0;
+    }
+
+    // Slide everything before the Fragment header over it.
+    unsigned hlen = q->network_header_length() - sizeof(click_ip6_fragment);
+    unsigned char *nh = q->network_header();
+    unsigned char *start = q->data();
+    unsigned char *mac = 0;
+    uint32_t mac_len = 0;
+    if (q->has_mac_header()) {
+	mac = q->mac_header();
+	mac_len = q->mac_header_length();
+	if (mac < start)
+	    start = mac;
+    }
+    memmove(start + sizeof(click_ip6_fragment), start, nh + hlen - start);
+    q->pull(sizeof(click_ip6_fragment));
+    if (mac)
+	q->set_mac_header(mac + sizeof(click_ip6_fragment), mac_len);
+    nh += sizeof(click_ip6_fragment);
+    click_ip6 *ip6h = reinterpret_cast<click_ip6 *>(nh);
+    q->set_ip6_header(ip6h, hlen);
+
+    nh[nxt_pos] = nxt;
+    ip6h->ip6_plen = htons(q->network_length() - sizeof(click_ip6));
+    if (_mtu_anno >= 0)
+	q->set_anno_u16(_mtu_anno, mtu);
+    return q;
+}
+
+void
+IP6Reassembler::fail(Datagram *d)
+{
+    ++_stat_failed_assem;
+    if (noutputs() == 2) {
+	if (Packet *p = _engine.take_first(d)) {
+	    p->set_ip6_header(p->ip6_header());
+	    output(1).push(p);
+	}
+    } else
+	_engine.kill(d);
+}
+
+Packet *
+IP6Reassembler::simple_action(Packet *p)
+{
+    assert(p->has_network_header());
+    const click_ip6 *ip6h = p->ip6_header();
+    const unsigned char *nh = p->network_header();
+    unsigned nlen = p->network_length();
+
+    // find the Fragment header, skipping the unfragmentable part
+    uint8_t nxt = ip6h->ip6_nxt;
+    unsigned nxt_pos = offsetof(click_ip6, ip6_nxt);
+    unsigned off = sizeof(click_ip6);
+    while (nxt == IP6PROTO_HOPOPTS || nxt == IP6PROTO_ROUTING
+	   || nxt == IP6PROTO_DSTOPTS) {
+	if (off + 8 > nlen)
+	    return p;
+	nxt_pos = off;
+	nxt = nh[off];
+	off += (nh[off + 1] + 1) << 3;
+    }
+    if (nxt != IP6PROTO_FRAGMENT)
+	return p;
+
+    ++_stat_frags_seen;
+
+    // reap if necessary
+    int now = p->timestamp_anno().sec();
+    if (!now) {
+	p->timestamp_anno().assign_now();
+	now = p->timestamp_anno().sec();
+    }
+    if (now >= _reap_time)
+	reap(now);
+
+    // calculate packet edges
+    unsigned hlen = off + sizeof(click_ip6_fragment);
+    unsigned len = sizeof(click_ip6) + ntohs(ip6h->ip6_plen);
+    if (hlen >= len || len > nlen) {
+	p->kill();
+	++_stat_bad_pkts;
+	return 0;
+    }
+    const click_ip6_fragment *fh = reinterpret_cast<const click_ip6_fragment *>(nh + off);
+    uint16_t offlg = ntohs(fh->ip6_frag_offset);
+    unsigned p_off = offlg & IP6_OFFMASK;
+    unsigned p_lastoff = p_off + len - hlen;
+    bool more = (offlg & IP6_MF) != 0;
+    if (p_lastoff > 0xFFFF || ((p_lastoff & 7) != 0 && more)) {
+	p->kill();
+	++_stat_bad_pkts;
+	return 0;
+    }
+    p->take(nlen - len);
+    p->set_network_header(nh, hlen);
+
+    // clean up memory if necessary
+    if (_engine.mem_used() > _mem_high_thresh)
+	reap_overfull();
+
+    IPReassemblyEngine::Key key;
+    memcpy(key.src, &ip6h->ip6_src, sizeof(key.src));
+    memcpy(key.dst, &ip6h->ip6_dst, sizeof(key.dst));
+    key.id = fh->ip6_frag_id;
+    key.proto = 0;
+    uint8_t frag_nxt = fh->ip6_frag_nxt;
+    Timestamp ts = p->timestamp_anno();
+
+    IPReassemblyEngine::Result result;
+    Datagram *d = _engine.insert(key, p, p_off, p_lastoff, more, now, result);
+    if (!d) {
+	if (result == IPReassemblyEngine::r_invalid)
+	    ++_stat_bad_pkts;
+	return 0;
+    }
+    if (p_off == 0) {
+	d->aux[0] = nxt_pos;
+	d->aux[1] = frag_nxt;
+    }
+    if (result != IPReassemblyEngine::r_complete)
+	return 0;
+
+    ++_stat_good_assem;
+    WritablePacket *q = finish(d);
+    if (q)
+	q->set_timestamp_anno(ts);
+    return q;
+}
+
+void
+IP6Reassembler::reap_overfull()
+{
+    while (_engine.mem_used() > _mem_low_thresh)
+	if (Datagram *d = _engine.oldest())
+	    fail(d);
+	else
+	    break;
+}
+
+void
+IP6Reassembler::reap(int now)
+{
+    int kill_time = now - REAP_TIMEOUT;
+    while (Datagram *d = _engine.expired(kill_time))
+	fail(d);
+    _reap_time = now + REAP_INTERVAL;
+}
+
+void
+IP6Reassembler::add_handlers()
+{
+    add_read_handler("dump", debug_dump);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(ip6 IPReassemblyEngine)
+EXPORT_ELEMENT(IP6Reassembler)
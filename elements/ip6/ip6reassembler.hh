@@ -0,0 +1,122 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_IP6REASSEMBLER_HH
+#define CLICK_IP6REASSEMBLER_HH
+#include <click/element.hh>
+#include "elements/ip/ipreassemblyengine.hh"
+CLICK_DECLS
+
+/*
+=c
+
+IP6Reassembler([I<KEYWORDS>])
+
+=s ip6
+
+Reassembles fragmented IPv6 packets
+
+=d
+
+Expects IPv6 packets, with their network header annotations set, as input to
+port 0. Packets without a Fragment header pass through unchanged. Fragments
+are held until every fragment of their datagram has arrived; then the
+reassembled datagram, without its Fragment header, is emitted onto output 0.
+Its unfragmentable part (the IPv6 header and any extension headers preceding
+the Fragment header) comes from the fragment with offset 0. The reassembled
+packet's transport header annotation points just past the unfragmentable
+part.
+
+Datagrams are identified by source address, destination address and
+fragment identification. If a datagram's fragments remain incomplete 60
+seconds after the first one arrived, they are dropped. If IP6Reassembler has
+two outputs, however, the fragment with offset 0, if any, is pushed onto
+output 1, ready for an ICMPv6 Time Exceeded message.
+
+As RFC 5722 requires, a fragment that overlaps data from an earlier fragment
+causes the whole datagram to be dropped. Exact duplicates are ignored.
+
+IP6Reassembler's memory usage is bounded. When memory consumption rises above
+HIMEM bytes, IP6Reassembler throws away the oldest incomplete datagrams until
+memory consumption drops below 3/4*HIMEM bytes.
+
+IP6Reassembler shares its fragment store with IPReassembler, and uses the
+IPREASSEMBLER annotation area the same way.
+
+Keyword arguments are:
+
+=over 8
+
+=item HIMEM
+
+The upper bound for memory consumption, in bytes. Default is 256K.
+
+=item MAX_FRAGMENTS
+
+The largest number of fragments a datagram may have. Default is 64.
+
+=item MAX_MTU_ANNO
+
+Optional. A 2 byte annotation that will be filled with the maximum size of any
+one fragment of this packet. If no reassembly is required, then the annotation
+is unchanged.
+
+=back
+
+=n
+
+IP6Reassembler destroys its input packets' "next packet" annotations.
+
+=h dump read-only
+
+Returns statistics and the fragment ranges of every incomplete datagram.
+
+=a IPReassembler, IP6Fragmenter, MarkIP6Header, CheckIP6Header */
+
+class IP6Reassembler : public Element { public:
+
+    IP6Reassembler() CLICK_COLD;
+    ~IP6Reassembler() CLICK_COLD;
+
+    const char *class_name() const	{ return "IP6Reassembler"; }
+    const char *port_count() const	{ return PORTS_1_1X2; }
+    const char *processing() const	{ return PROCESSING_A_AH; }
+
+    int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
+    int initialize(ErrorHandler *) CLICK_COLD;
+    void cleanup(CleanupStage) CLICK_COLD;
+
+    Packet *simple_action(Packet *);
+
+    void add_handlers() CLICK_COLD;
+
+  private:
+
+    typedef IPReassemblyEngine::Datagram Datagram;
+
+    enum { REAP_TIMEOUT = 60, // seconds
+	   REAP_INTERVAL = 10 }; // seconds
+
+    IPReassemblyEngine _engine;
+
+    int _reap_time;
+
+    uint32_t _stat_frags_seen;
+    uint32_t _stat_good_assem;
+    uint32_t _stat_failed_assem;
+    uint32_t _stat_bad_pkts;
+
+    uint32_t _mem_high_thresh;
+    uint32_t _mem_low_thresh;
+    int8_t _mtu_anno;
+
+    static void unparse_key(StringAccum &, const Packet *);
+    static String debug_dump(Element *e, void *);
+
+    WritablePacket *finish(Datagram *);
+    void fail(Datagram *);
+    void reap_overfull();
+    void reap(int);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -51,6 +51,12 @@ IP6RouteTable::remove_route(IP6Address, IP6Address, ErrorHandler *errh)
     return errh->error("cannot delete routes from this routing table");
 }
 
+int
+IP6RouteTable::lookup_route(IP6Address, IP6Address &) const
+{
+    return -1;			// by default, route lookups fail
+}
+
 String
 IP6RouteTable::dump_routes()
 {
@@ -127,5 +133,22 @@ IP6RouteTable::table_handler(Element *e, void *)
     return r->dump_routes();
 }
 
+int
+IP6RouteTable::lookup_handler(int, String &s, Element *e, const Handler *, ErrorHandler *errh)
+{
+    IP6RouteTable *r = static_cast<IP6RouteTable *>(e);
+    IP6Address a;
+    if (IP6AddressArg().parse(s, a, r)) {
+	IP6Address gw;
+	int port = r->lookup_route(a, gw);
+	if (gw)
+	    s = String(port) + " " + gw.unparse();
+	else
+	    s = String(port);
+	return 0;
+    } else
+	return errh->error("expected IP6 address");
+}
+
 CLICK_ENDDECLS
 ELEMENT_PROVIDES(IP6RouteTable)
@@ -162,6 +162,16 @@ LookupIP6Route::remove_route(IP6Address addr, IP6Address mask,
   return 0;
 }
 
+int
+LookupIP6Route::lookup_route(IP6Address addr, IP6Address &gw) const
+{
+  int ifi;
+  if (_t.lookup(addr, gw, ifi))
+    return ifi;
+  else
+    return -1;
+}
+
 void
 LookupIP6Route::add_handlers()
 {
@@ -169,6 +179,7 @@ LookupIP6Route::add_handlers()
     add_write_handler("remove", remove_route_handler, 0);
     add_write_handler("ctrl", ctrl_handler, 0);
     add_read_handler("table", table_handler, 0);
+    set_handler("lookup", Handler::f_read | Handler::f_read_param, lookup_handler);
 }
 
 CLICK_ENDDECLS
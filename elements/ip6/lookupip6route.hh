@@ -37,6 +37,14 @@ CLICK_DECLS
  *   rt[2] -> ... -> ToDevice(eth1);
  *   ...
  *
+ * =n
+ * LookupIP6Route searches its routes linearly.  Use PoptrieIP6Lookup for
+ * large tables.
+ *
+ * =h lookup read-only
+ * Reports the OUTput port and GW corresponding to an address.
+ *
+ * =a PoptrieIP6Lookup
  */
 
 class LookupIP6Route : public IP6RouteTable {
@@ -56,6 +64,7 @@ public:
 
   int add_route(IP6Address, IP6Address, IP6Address, int, ErrorHandler *);
   int remove_route(IP6Address, IP6Address, ErrorHandler *);
+  int lookup_route(IP6Address, IP6Address &) const;
   String dump_routes()				{ return _t.dump(); };
 
 private:
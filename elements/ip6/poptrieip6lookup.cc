@@ -0,0 +1,147 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * poptrieip6lookup.{cc,hh} -- IP6 routing table using a Poptrie
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "poptrieip6lookup.hh"
+#include <click/ip6address.hh>
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/straccum.hh>
+CLICK_DECLS
+
+PoptrieIP6Lookup::PoptrieIP6Lookup()
+{
+}
+
+PoptrieIP6Lookup::~PoptrieIP6Lookup()
+{
+}
+
+int
+PoptrieIP6Lookup::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    if (!_t.initialize())
+	return errh->error("out of memory");
+    _routes.clear();
+    _free_routes.clear();
+
+    int before = errh->nerrors();
+    for (int i = 0; i < conf.size(); i++) {
+	Vector<String> words;
+	cp_spacevec(conf[i], words);
+	IP6Address dst, mask, gw;
+	int port;
+	if ((words.size() == 2 || words.size() == 3)
+	    && IP6PrefixArg(true).parse(words[0], dst, mask, this)
+	    && (words.size() == 2 || IP6AddressArg().parse(words[1], gw, this))
+	    && IntArg().parse(words.back(), port)
+	    && port >= 0) {
+	    if (port >= noutputs())
+		errh->error("argument %d: output port out of range", i + 1);
+	    else
+		add_route(dst, mask, gw, port, errh);
+	} else
+	    errh->error("argument %d should be %<ADDR/MASK [GW] OUT%>", i + 1);
+    }
+    return errh->nerrors() == before ? 0 : -1;
+}
+
+int
+PoptrieIP6Lookup::add_route(IP6Address addr, IP6Address mask, IP6Address gw,
+			    int port, ErrorHandler *)
+{
+    Route r;
+    r.prefix_len = mask.mask_to_prefix_len();
+    r.addr = addr & mask;
+    r.gw = gw;
+    r.port = port;
+
+    uint32_t value;
+    if (_free_routes.size()) {
+	value = _free_routes.back();
+	_free_routes.pop_back();
+	_routes[value - 1] = r;
+    } else {
+	_routes.push_back(r);
+	value = _routes.size();
+    }
+    if (uint32_t old = _t.set(r.addr, r.prefix_len, value)) {
+	_routes[old - 1].port = -1;
+	_free_routes.push_back(old);
+    }
+    return 0;
+}
+
+int
+PoptrieIP6Lookup::remove_route(IP6Address addr, IP6Address mask,
+			       ErrorHandler *errh)
+{
+    if (uint32_t old = _t.remove(addr & mask, mask.mask_to_prefix_len())) {
+	_routes[old - 1].port = -1;
+	_free_routes.push_back(old);
+	return 0;
+    } else
+	return errh->error("route %s/%d not found", (addr & mask).unparse().c_str(),
+			   mask.mask_to_prefix_len());
+}
+
+int
+PoptrieIP6Lookup::lookup_route(IP6Address addr, IP6Address &gw) const
+{
+    if (uint32_t v = _t.lookup(addr)) {
+	gw = _routes[v - 1].gw;
+	return _routes[v - 1].port;
+    } else
+	return -1;
+}
+
+String
+PoptrieIP6Lookup::dump_routes()
+{
+    StringAccum sa;
+    if (_t.size())
+	sa << "# Active routes\n";
+    for (const Route *r = _routes.begin(); r != _routes.end(); ++r)
+	if (r->port >= 0)
+	    sa << r->addr << '/' << r->prefix_len << '\t' << r->gw
+	       << '\t' << r->port << '\n';
+    return sa.take_string();
+}
+
+void
+PoptrieIP6Lookup::push(int, Packet *p)
+{
+    if (uint32_t v = _t.lookup(DST_IP6_ANNO(p))) {
+	const Route &r = _routes[v - 1];
+	if (r.gw)
+	    SET_DST_IP6_ANNO(p, r.gw);
+	output(r.port).push(p);
+    } else
+	p->kill();
+}
+
+void
+PoptrieIP6Lookup::add_handlers()
+{
+    add_write_handler("add", add_route_handler, 0);
+    add_write_handler("remove", remove_route_handler, 0);
+    add_write_handler("ctrl", ctrl_handler, 0);
+    add_read_handler("table", table_handler, 0);
+    set_handler("lookup", Handler::f_read | Handler::f_read_param, lookup_handler);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(IP6RouteTable IP6Poptrie)
+EXPORT_ELEMENT(PoptrieIP6Lookup)
@@ -0,0 +1,100 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_POPTRIEIP6LOOKUP_HH
+#define CLICK_POPTRIEIP6LOOKUP_HH
+#include <click/element.hh>
+#include <click/vector.hh>
+#include "ip6routetable.hh"
+#include "ip6poptrie.hh"
+CLICK_DECLS
+
+/*
+=c
+
+PoptrieIP6Lookup(ADDR1/MASK1 [GW1] OUT1, ADDR2/MASK2 [GW2] OUT2, ...)
+
+=s ip6
+
+IP6 lookup using a compressed multibit trie
+
+=d
+
+Expects a destination IP6 address annotation with each packet.  Looks up
+that address in its routing table, using longest-prefix-match, sets the
+destination annotation to the corresponding GW (if specified), and emits the
+packet on the indicated OUTput port.  Packets without a matching route are
+dropped.
+
+Each argument is a route, specifying a destination prefix, an optional
+gateway IP6 address, and an output port.  The routes and handlers are those
+of LookupIP6Route, but lookups take time proportional to the length of the
+matching prefix rather than to the number of routes.
+
+PoptrieIP6Lookup implements Poptrie (Asai and Ohara, "Poptrie: A Compressed
+Trie with Population Count for Fast and Scalable Software IP Routing Table
+Lookup", SIGCOMM 2015).  The first 16 bits of the address index a direct
+table of 65536 entries, about 832KB; each later level of the trie consumes 6
+bits, and its nodes store their children and leaves compactly using 64-bit
+bitmaps.  Routes are added and removed incrementally, rebuilding only the
+nodes whose leaves change.
+
+=h table read-only
+
+Outputs a human-readable version of the current routing table.
+
+=h lookup read-only
+
+Reports the OUTput port and GW corresponding to an address.
+
+=h add write-only
+
+Adds a route to the table.  Format should be `C<ADDR/MASK [GW] OUT>'.  An
+existing route for C<ADDR/MASK> is replaced.
+
+=h remove write-only
+
+Removes a route from the table.  Format should be `C<ADDR/MASK>'.
+
+=h ctrl write-only
+
+Adds or removes a route.  Write `C<add ADDR/MASK [GW] OUT>' to add a route,
+and `C<remove ADDR/MASK>' to remove a route.
+
+=a LookupIP6Route, IP6PoptrieBenchmark, RadixIPLookup
+*/
+
+class PoptrieIP6Lookup : public IP6RouteTable { public:
+
+    PoptrieIP6Lookup() CLICK_COLD;
+    ~PoptrieIP6Lookup() CLICK_COLD;
+
+    const char *class_name() const	{ return "PoptrieIP6Lookup"; }
+    const char *port_count() const	{ return "1/-"; }
+    const char *processing() const	{ return PUSH; }
+
+    int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
+    void add_handlers() CLICK_COLD;
+
+    void push(int port, Packet *p);
+
+    int add_route(IP6Address, IP6Address, IP6Address, int, ErrorHandler *);
+    int remove_route(IP6Address, IP6Address, ErrorHandler *);
+    int lookup_route(IP6Address, IP6Address &) const;
+    String dump_routes();
+
+  private:
+
+    struct Route {
+	IP6Address addr;
+	IP6Address gw;
+	int prefix_len;
+	int port;		// -1 if the slot is free
+    };
+
+    IP6Poptrie _t;
+    Vector<Route> _routes;	// the trie's value v is _routes[v - 1]
+    Vector<uint32_t> _free_routes;
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -41,9 +41,10 @@ Packet*
 Pad::simple_action(Packet* p)
 {
     uint32_t nput;
-    if (unlikely(_nbytes))
-        nput = p->length() < _nbytes ? _nbytes - p->length() : 0;
-    else
+    if (unlikely(_nbytes)) {
+        uint32_t length = p->total_length();
+        nput = length < _nbytes ? _nbytes - length : 0;
+    } else
         nput = EXTRA_LENGTH_ANNO(p);
     if (nput) {
         WritablePacket* q = p->put(nput);
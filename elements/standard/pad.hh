@@ -42,6 +42,7 @@ class Pad : public Element { public:
 
     const char *class_name() const		{ return "Pad"; }
     const char *port_count() const		{ return PORTS_1_1; }
+    const char *flags() const		{ return "D"; }
 
     int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
     bool can_live_reconfigure() const		{ return true; }
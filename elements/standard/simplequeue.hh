@@ -84,6 +84,7 @@ class SimpleQueue : public Element, public Storage { public:
     const char *class_name() const		{ return "SimpleQueue"; }
     const char *port_count() const		{ return PORTS_1_1X2; }
     const char *processing() const		{ return "h/lh"; }
+    const char *flags() const		{ return "D"; }
     void* cast(const char*);
 
     int configure(Vector<String>&, ErrorHandler*) CLICK_COLD;
@@ -0,0 +1,37 @@
+/*
+ * slabinfo.{cc,hh} -- report slab allocator statistics
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "slabinfo.hh"
+#include <click/slaballocator.hh>
+CLICK_DECLS
+
+SlabInfo::SlabInfo()
+{
+}
+
+String
+SlabInfo::read_handler(Element *, void *)
+{
+    return SlabAllocator::unparse_all();
+}
+
+void
+SlabInfo::add_handlers()
+{
+    add_read_handler("stats", read_handler);
+}
+
+CLICK_ENDDECLS
+EXPORT_ELEMENT(SlabInfo)
@@ -0,0 +1,45 @@
+#ifndef CLICK_SLABINFO_HH
+#define CLICK_SLABINFO_HH
+#include <click/element.hh>
+CLICK_DECLS
+
+/*
+=c
+SlabInfo()
+
+=s information
+reports slab allocator statistics
+
+=d
+
+SlabInfo has no inputs or outputs.  Its handlers report on the slab
+allocators that elements use for per-flow state, such as the flow records of
+IPRewriter and AggregateIPFlows.
+
+=h stats read-only
+
+Returns one line per live slab allocator, of the form "size SIZE in_use N
+cached N capacity N bytes N [shared] [hugepages]".  SIZE is the object size.
+"in_use" counts allocated objects, "cached" counts free objects held for
+reuse, "capacity" counts objects ever carved from slabs, and "bytes" is the
+slab memory held.  "shared" marks the process-wide allocator for a size
+class, and "hugepages" marks allocators whose slabs use huge pages.  The
+counts are approximate while other threads run.
+*/
+
+class SlabInfo : public Element { public:
+
+    SlabInfo() CLICK_COLD;
+
+    const char *class_name() const	{ return "SlabInfo"; }
+
+    void add_handlers() CLICK_COLD;
+
+  private:
+
+    static String read_handler(Element *, void *) CLICK_COLD;
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -29,7 +29,13 @@ int
 Tee::configure(Vector<String> &conf, ErrorHandler *errh)
 {
     unsigned n = noutputs();
-    if (Args(conf, this, errh).read_p("N", n).complete() < 0)
+    _split = 0;
+    _headroom = Packet::default_headroom;
+    if (Args(conf, this, errh)
+	.read_p("N", n)
+	.read("SPLIT", _split)
+	.read("HEADROOM", _headroom)
+	.complete() < 0)
 	return -1;
     if (n != (unsigned) noutputs())
 	return errh->error("%d outputs implies %d arms", noutputs(), noutputs());
@@ -40,6 +46,15 @@ void
 Tee::push(int, Packet *p)
 {
   int n = noutputs();
+  if (_split) {
+    // Every output gets a split clone; sending p itself would leave its
+    // data shared with the clones' segments.
+    for (int i = 0; i < n; i++)
+      if (Packet *q = p->split_clone(_split, _headroom))
+	output(i).push(q);
+    p->kill();
+    return;
+  }
   for (int i = 0; i < n - 1; i++)
     if (Packet *q = p->clone())
       output(i).push(q);
@@ -5,7 +5,7 @@ CLICK_DECLS
 
 /*
  * =c
- * Tee([N])
+ * Tee([N, I<keywords> SPLIT, HEADROOM])
  *
  * PullTee([N])
  * =s basictransfer
@@ -20,6 +20,46 @@ CLICK_DECLS
  * Tee and PullTee have however many outputs are used in the configuration,
  * but you can say how many outputs you expect with the optional argument
  * N.
+ *
+ * Copies normally share the input packet's data, so the first element that
+ * modifies a copy, for instance by rewriting its Ethernet header, copies the
+ * whole packet.  If SPLIT is set, Tee instead gives each output a copy whose
+ * first SPLIT bytes live in a private buffer, while the rest of the data
+ * stays shared (see Packet::split_clone).  Elements that only modify or
+ * prepend headers within those bytes then copy nothing further, so
+ * replicating a packet to many outputs costs one header copy per output
+ * rather than one packet copy.  Data beyond the first SPLIT bytes is in a
+ * separate data segment.  Elements that understand segments, such as
+ * DecIPTTL, StoreEtherAddress, EtherEncap, Queue, ToDevice and ToDump, keep
+ * them; any other element receives the packet made contiguous again, at the
+ * cost of a copy.  SPLIT is effective only at user level.
+ *
+ * Keyword arguments for Tee are:
+ *
+ * =over 8
+ *
+ * =item SPLIT
+ *
+ * Unsigned.  Number of leading bytes to copy privately for each output.  It
+ * should cover every header that downstream elements modify.  Default is 0,
+ * which shares all data.
+ *
+ * =item HEADROOM
+ *
+ * Unsigned.  Headroom for the private bytes, available for prepending
+ * headers.  Default is the default packet headroom.
+ *
+ * =back
+ *
+ * =e
+ *
+ * Replicate IP multicast packets to several Ethernet ports, copying only the
+ * Ethernet and IP headers:
+ *
+ *   ... -> CheckIPHeader(14) -> t :: Tee(3, SPLIT 34);
+ *   t[0] -> DecIPTTL -> StoreEtherAddress(00:00:00:00:00:01, src) -> Queue -> ToDevice(eth0);
+ *   t[1] -> DecIPTTL -> StoreEtherAddress(00:00:00:00:00:02, src) -> Queue -> ToDevice(eth1);
+ *   t[2] -> DecIPTTL -> StoreEtherAddress(00:00:00:00:00:03, src) -> Queue -> ToDevice(eth2);
  */
 
 class Tee : public Element {
@@ -31,11 +71,17 @@ class Tee : public Element {
   const char *class_name() const		{ return "Tee"; }
   const char *port_count() const		{ return "1/1-"; }
   const char *processing() const		{ return PUSH; }
+  const char *flags() const		{ return "D"; }
 
   int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
 
   void push(int, Packet *);
 
+ private:
+
+  uint32_t _split;
+  uint32_t _headroom;
+
 };
 
 class PullTee : public Element {
@@ -41,8 +41,9 @@ Truncate::configure(Vector<String> &conf, ErrorHandler *errh)
 Packet *
 Truncate::simple_action(Packet *p)
 {
-    if (p->length() > _nbytes) {
-	unsigned nbytes = p->length() - _nbytes;
+    uint32_t length = p->total_length();
+    if (length > _nbytes) {
+	unsigned nbytes = length - _nbytes;
 	if (_extra_anno)
 	    SET_EXTRA_LENGTH_ANNO(p, EXTRA_LENGTH_ANNO(p) + nbytes);
         p->take(nbytes);
@@ -85,6 +85,9 @@ CheckTCPHeader::drop(Reason reason, Packet *p)
 Packet *
 CheckTCPHeader::simple_action(Packet *p)
 {
+  if (p->has_segments() && p->has_network_header()
+      && !(p = p->pullup(p->transport_header_offset() + sizeof(click_tcp))))
+    return 0;
   const click_ip *iph = p->ip_header();
   const click_tcp *tcph = p->tcp_header();
   unsigned len, iph_len, tcph_len, csum;
@@ -96,10 +99,10 @@ CheckTCPHeader::simple_action(Packet *p)
   len = ntohs(iph->ip_len) - iph_len;
   tcph_len = tcph->th_off << 2;
   if (tcph_len < sizeof(click_tcp) || len < tcph_len
-      || p->length() < len + iph_len + p->network_header_offset())
+      || p->total_length() < len + iph_len + p->network_header_offset())
     return drop(BAD_LENGTH, p);
 
-  csum = click_in_cksum((unsigned char *)tcph, len);
+  csum = p->in_cksum((unsigned char *)tcph, len);
   if (click_in_cksum_pseudohdr(csum, iph, len) != 0)
     return drop(BAD_CHECKSUM, p);
 
@@ -84,6 +84,9 @@ CheckUDPHeader::drop(Reason reason, Packet *p)
 Packet *
 CheckUDPHeader::simple_action(Packet *p)
 {
+  if (p->has_segments() && p->has_network_header()
+      && !(p = p->pullup(p->transport_header_offset() + sizeof(click_udp))))
+    return 0;
   const click_ip *iph = p->ip_header();
   const click_udp *udph = p->udp_header();
   unsigned len, iph_len;
@@ -94,11 +97,11 @@ CheckUDPHeader::simple_action(Packet *p)
   iph_len = iph->ip_hl << 2;
   len = ntohs(udph->uh_ulen);
   if (len < sizeof(click_udp)
-      || p->length() < len + iph_len + p->network_header_offset())
+      || p->total_length() < len + iph_len + p->network_header_offset())
     return drop(BAD_LENGTH, p);
 
   if (udph->uh_sum != 0) {
-    unsigned csum = click_in_cksum((unsigned char *)udph, len);
+    unsigned csum = p->in_cksum((unsigned char *)udph, len);
     if (click_in_cksum_pseudohdr(csum, iph, len) != 0)
       return drop(BAD_CHECKSUM, p);
   }
@@ -0,0 +1,308 @@
+/*
+ * grocoalescer.{cc,hh} -- software receive offload for TCP
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "grocoalescer.hh"
+#include <clicknet/ip.h>
+#include <clicknet/tcp.h>
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/glue.hh>
+CLICK_DECLS
+
+GROCoalescer::GROCoalescer()
+    : _held(0), _task(this), _count(0), _coalesced(0), _coalesced_segments(0)
+{
+}
+
+GROCoalescer::~GROCoalescer()
+{
+}
+
+int
+GROCoalescer::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    uint32_t max_length = 65535, nflows = 64;
+    _segments = false;
+    if (Args(conf, this, errh)
+	.read("MAX_LENGTH", max_length)
+	.read("FLOWS", nflows)
+	.read("SEGMENTS", _segments)
+	.complete() < 0)
+	return -1;
+    if (max_length < 68 || max_length > 65535)
+	return errh->error("MAX_LENGTH out of range");
+    if (nflows < 1 || nflows > 65536)
+	return errh->error("FLOWS out of range");
+    _max_length = max_length;
+    for (_flow_mask = 1; _flow_mask < nflows; _flow_mask <<= 1)
+	/* nada */;
+    _flow_mask -= 1;
+    return 0;
+}
+
+int
+GROCoalescer::initialize(ErrorHandler *errh)
+{
+    if (!(_held = new Held[_flow_mask + 1]))
+	return errh->error("out of memory");
+    memset(_held, 0, sizeof(Held) * (_flow_mask + 1));
+    _task.initialize(this, false);
+    return 0;
+}
+
+void
+GROCoalescer::cleanup(CleanupStage)
+{
+    if (_held)
+	for (uint32_t i = 0; i <= _flow_mask; ++i)
+	    if (_held[i].p)
+		_held[i].p->kill();
+    delete[] _held;
+    _held = 0;
+}
+
+static inline uint32_t
+flow_hash(const click_ip *iph, const click_tcp *tcph)
+{
+    uint32_t h = iph->ip_src.s_addr ^ (iph->ip_dst.s_addr * 0x9E3779B1U)
+	^ ((uint32_t) tcph->th_sport << 16) ^ tcph->th_dport;
+    h ^= h >> 16;
+    h *= 0x85EBCA6BU;
+    return h ^ (h >> 13);
+}
+
+static inline uint32_t
+network_length(const Packet *p)
+{
+    return p->total_length() - p->network_header_offset();
+}
+
+bool
+GROCoalescer::same_flow(const Packet *a, const Packet *b)
+{
+    const click_ip *ai = a->ip_header(), *bi = b->ip_header();
+    const click_tcp *at = a->tcp_header(), *bt = b->tcp_header();
+    return ai->ip_src.s_addr == bi->ip_src.s_addr
+	&& ai->ip_dst.s_addr == bi->ip_dst.s_addr
+	&& at->th_sport == bt->th_sport && at->th_dport == bt->th_dport;
+}
+
+/* Return the one's-complement sum of @a p's TCP payload.  A valid TCP
+   checksum makes the pseudo-header, TCP header and payload sum to -0, so
+   the payload sums to the negated sum of the other two. */
+uint32_t
+GROCoalescer::payload_sum(const Packet *p)
+{
+    const click_ip *iph = p->ip_header();
+    const click_tcp *tcph = p->tcp_header();
+    int tlen = ntohs(iph->ip_len) - sizeof(click_ip);
+    unsigned hsum = click_in_cksum((const unsigned char *) tcph, tcph->th_off << 2);
+    return click_in_cksum_pseudohdr(hsum, iph, tlen);
+}
+
+bool
+GROCoalescer::mergeable(const Held &h, const Packet *p) const
+{
+    const click_ip *iph = p->ip_header(), *qiph = h.p->ip_header();
+    const click_tcp *tcph = p->tcp_header(), *qtcph = h.p->tcp_header();
+    uint32_t len = ntohs(iph->ip_len) - sizeof(click_ip) - (tcph->th_off << 2);
+    return ntohl(tcph->th_seq) == h.next_seq
+	&& tcph->th_ack == qtcph->th_ack
+	&& tcph->th_off == qtcph->th_off
+	&& memcmp(tcph + 1, qtcph + 1, (tcph->th_off << 2) - sizeof(click_tcp)) == 0
+	&& iph->ip_tos == qiph->ip_tos && iph->ip_ttl == qiph->ip_ttl
+	&& ((iph->ip_off ^ qiph->ip_off) & htons(IP_DF)) == 0
+	&& ((tcph->th_flags ^ qtcph->th_flags) & ~(TH_PUSH | TH_FIN | TH_CWR)) == 0
+	&& len <= h.mss
+	&& network_length(h.p) + len <= _max_length;
+}
+
+bool
+GROCoalescer::append(Held &h, Packet *p)
+{
+    if (h.nsegs == 1 && _segments) {
+	// Payloads will be chained to the first segment; only its headers
+	// are modified.
+	if (!(h.p = h.p->uniqueify()))
+	    return false;
+	h.payload_sum = payload_sum(h.p);
+    } else if (h.nsegs == 1) {
+	// Move the first segment to a buffer with room for the rest.
+	Packet *f = h.p;
+	WritablePacket *q = Packet::make(f->headroom(), f->data(), f->length(),
+					 _max_length - f->network_length());
+	if (!q)
+	    return false;
+	q->copy_annotations(f);
+	if (f->has_mac_header() && f->mac_header_offset() >= 0)
+	    q->set_mac_header(q->data() + f->mac_header_offset());
+	q->set_ip_header(reinterpret_cast<click_ip *>(q->data() + f->network_header_offset()), sizeof(click_ip));
+	h.payload_sum = payload_sum(f);
+	f->kill();
+	h.p = q;
+    }
+
+    const click_tcp *tcph = p->tcp_header();
+    uint32_t thl = tcph->th_off << 2;
+    uint32_t len = ntohs(p->ip_header()->ip_len) - sizeof(click_ip) - thl;
+    WritablePacket *q = static_cast<WritablePacket *>(h.p);
+    uint32_t sum = payload_sum(p);
+    if ((network_length(q) - sizeof(click_ip) - thl) & 1)
+	sum = ((sum & 0xFF) << 8) | (sum >> 8);
+    sum += h.payload_sum;
+    h.payload_sum = (sum & 0xFFFF) + (sum >> 16);
+
+    if (!_segments) {
+	if (!(q = q->put(len))) {
+	    h.p = 0;
+	    return false;
+	}
+	memcpy(q->end_data() - len, p->transport_header() + thl, len);
+	h.p = q;
+    }
+    click_tcp *qtcph = q->tcp_header();
+    qtcph->th_win = tcph->th_win;
+    qtcph->th_flags |= tcph->th_flags & (TH_PUSH | TH_FIN);
+    h.next_seq += len;
+    ++h.nsegs;
+    bool done = (tcph->th_flags & (TH_PUSH | TH_FIN)) || len < h.mss;
+
+    if (_segments) {
+	// chain the segment's payload without copying it
+	p->pull(p->transport_header_offset() + thl);
+	p->take(p->total_length() - len);
+	q->append_segment(p);
+    } else
+	p->kill();
+    if (done || network_length(q) + h.mss > _max_length)
+	flush(h);
+    return true;
+}
+
+void
+GROCoalescer::flush(Held &h)
+{
+    if (h.nsegs > 1) {
+	WritablePacket *q = static_cast<WritablePacket *>(h.p);
+	click_ip *iph = q->ip_header();
+	uint16_t old_len = iph->ip_len;
+	iph->ip_len = htons(network_length(q));
+	click_update_in_cksum(&iph->ip_sum, old_len, iph->ip_len);
+
+	click_tcp *tcph = q->tcp_header();
+	tcph->th_sum = 0;
+	uint32_t sum = (~click_in_cksum((unsigned char *) tcph, tcph->th_off << 2) & 0xFFFF)
+	    + h.payload_sum;
+	sum = (sum & 0xFFFF) + (sum >> 16);
+	sum = (sum & 0xFFFF) + (sum >> 16);
+	tcph->th_sum = click_in_cksum_pseudohdr(~sum & 0xFFFF, iph, network_length(q) - sizeof(click_ip));
+
+	++_coalesced;
+	_coalesced_segments += h.nsegs;
+    }
+    Packet *p = h.p;
+    h.p = 0;
+    output(0).push(p);
+}
+
+void
+GROCoalescer::flush_all()
+{
+    // Pushing downstream may bring packets back to this element.
+    Vector<uint32_t> active;
+    active.swap(_active);
+    for (uint32_t *it = active.begin(); it != active.end(); ++it) {
+	Held &h = _held[*it];
+	h.listed = false;
+	if (h.p)
+	    flush(h);
+    }
+}
+
+void
+GROCoalescer::push(int, Packet *p)
+{
+    ++_count;
+    const click_ip *iph = p->ip_header();
+    if (iph->ip_p != IP_PROTO_TCP || iph->ip_hl != 5 || IP_ISFRAG(iph)
+	|| p->transport_length() < (int) sizeof(click_tcp)) {
+	output(0).push(p);
+	return;
+    }
+
+    const click_tcp *tcph = p->tcp_header();
+    uint32_t ip_len = ntohs(iph->ip_len);
+    uint32_t hlen = sizeof(click_ip) + (tcph->th_off << 2);
+    bool candidate = ip_len > hlen && tcph->th_off >= 5
+	&& p->network_length() >= (int) ip_len
+	&& (tcph->th_flags & (TH_SYN | TH_RST | TH_URG | TH_ACK)) == TH_ACK;
+
+    Held &h = _held[flow_hash(iph, tcph) & _flow_mask];
+    if (h.p) {
+	if (same_flow(h.p, p)) {
+	    if (candidate && mergeable(h, p) && append(h, p))
+		return;
+	    if (h.p)
+		flush(h);
+	} else if (candidate)
+	    flush(h);
+    }
+
+    if (!candidate || (tcph->th_flags & (TH_PUSH | TH_FIN))
+	|| ip_len + (ip_len - hlen) > _max_length) {
+	output(0).push(p);
+	return;
+    }
+
+    p->take(p->network_length() - ip_len);
+    h.p = p;
+    h.next_seq = ntohl(tcph->th_seq) + ip_len - hlen;
+    h.mss = ip_len - hlen;
+    h.nsegs = 1;
+    if (!h.listed) {
+	h.listed = true;
+	_active.push_back(&h - _held);
+    }
+    _task.reschedule();
+}
+
+bool
+GROCoalescer::run_task(Task *)
+{
+    if (_active.empty())
+	return false;
+    flush_all();
+    return true;
+}
+
+int
+GROCoalescer::write_flush(const String &, Element *e, void *, ErrorHandler *)
+{
+    static_cast<GROCoalescer *>(e)->flush_all();
+    return 0;
+}
+
+void
+GROCoalescer::add_handlers()
+{
+    add_data_handlers("count", Handler::OP_READ, &_count);
+    add_data_handlers("coalesced", Handler::OP_READ, &_coalesced);
+    add_data_handlers("coalesced_segments", Handler::OP_READ, &_coalesced_segments);
+    add_write_handler("flush", write_flush, 0, Handler::BUTTON);
+    add_task_handlers(&_task);
+}
+
+CLICK_ENDDECLS
+EXPORT_ELEMENT(GROCoalescer)
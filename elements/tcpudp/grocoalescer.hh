@@ -0,0 +1,143 @@
+#ifndef CLICK_GROCOALESCER_HH
+#define CLICK_GROCOALESCER_HH
+#include <click/element.hh>
+#include <click/task.hh>
+#include <click/vector.hh>
+CLICK_DECLS
+
+/*
+=c
+
+GROCoalescer(I<keywords> MAX_LENGTH, FLOWS, SEGMENTS)
+
+=s tcp
+
+coalesces in-order TCP segments into large packets
+
+=d
+
+Expects IP packets with their IP header annotations set.  Consecutive
+in-order TCP segments of a flow are combined into one large packet, as a
+network card performing receive offload would, so that later elements see
+fewer, larger packets.  Segments are held only until GROCoalescer's task
+runs, which happens after the element feeding it, such as a FromDevice
+delivering a burst, yields.  Packets that cannot be combined pass through
+unchanged, after any held packet of the same flow.
+
+A segment is combined with the flow's held packet if it has payload, starts
+at the next expected sequence number, has the same acknowledgment number,
+TCP options, TOS, TTL and flags (other than PSH, FIN and CWR), carries no more
+payload than the held packet's first segment, and the result fits in
+MAX_LENGTH bytes.  IP packets with options or fragments, and TCP segments
+with SYN, RST or URG set, are never combined.  A combined packet is emitted
+early after a segment with PSH or FIN, or one shorter than the first.
+
+A combined packet has the headers and annotations of its first segment,
+except for the window, which comes from the last segment, and PSH and FIN,
+which are or'ed over all segments.  Its checksums are valid if and only if
+the segments' checksums were valid; the TCP checksum is derived from the
+segments' checksums without reading their payloads.
+
+Normally a combined packet's data is copied into one buffer.  In SEGMENTS
+mode, each later segment's payload is instead chained to the first segment
+as a data segment (see Packet::has_segments), so no payload is copied.
+Elements that handle segmented packets, such as CheckIPHeader,
+CheckTCPHeader, SetTCPChecksum, ToDump and ToDevice, keep the segments.
+Any other element, including sinks like Socket, RawSocket, KernelTun,
+ToHost and ToDPDKDevice, receives the packet linearized into one buffer at
+its input port, so it always sees the whole packet at the cost of a copy.
+
+Use GSOSegmenter to split combined packets back into segments.
+
+Keyword arguments are:
+
+=over 8
+
+=item MAX_LENGTH
+
+Unsigned.  The largest IP length of a combined packet.  Default is 65535.
+
+=item FLOWS
+
+Unsigned.  The number of flows that can be held at once, rounded up to a
+power of two.  A segment whose flow collides with another held flow flushes
+that flow.  Default is 64.
+
+=item SEGMENTS
+
+Boolean.  If true, chain payloads rather than copying them.  Default is
+false.
+
+=back
+
+=h count read-only
+
+Returns the number of input packets.
+
+=h coalesced read-only
+
+Returns the number of combined packets emitted.
+
+=h coalesced_segments read-only
+
+Returns the number of segments in the combined packets emitted.
+
+=h flush write-only
+
+Emits every held packet.
+
+=a GSOSegmenter, TCPFragmenter
+*/
+
+class GROCoalescer : public Element { public:
+
+    GROCoalescer() CLICK_COLD;
+    ~GROCoalescer() CLICK_COLD;
+
+    const char *class_name() const	{ return "GROCoalescer"; }
+    const char *port_count() const	{ return PORTS_1_1; }
+    const char *processing() const	{ return PUSH; }
+
+    int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
+    int initialize(ErrorHandler *) CLICK_COLD;
+    void cleanup(CleanupStage) CLICK_COLD;
+    void add_handlers() CLICK_COLD;
+
+    void push(int, Packet *);
+    bool run_task(Task *);
+
+  private:
+
+    struct Held {
+	Packet *p;
+	uint32_t next_seq;
+	uint32_t payload_sum;	// one's-complement sum of the payload
+	uint16_t mss;
+	uint16_t nsegs;
+	bool listed;
+    };
+
+    Held *_held;
+    uint32_t _flow_mask;
+    Vector<uint32_t> _active;
+    uint32_t _max_length;
+    bool _segments;
+    Task _task;
+
+    uint32_t _count;
+    uint32_t _coalesced;
+    uint32_t _coalesced_segments;
+
+    static bool same_flow(const Packet *, const Packet *);
+    static uint32_t payload_sum(const Packet *);
+    bool mergeable(const Held &, const Packet *) const;
+    bool append(Held &, Packet *);
+    void flush(Held &);
+    void flush_all();
+
+    static int write_flush(const String &, Element *, void *, ErrorHandler *);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,177 @@
+/*
+ * gsosegmenter.{cc,hh} -- software segmentation offload for TCP and UDP
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "gsosegmenter.hh"
+#include <clicknet/ip.h>
+#include <clicknet/tcp.h>
+#include <clicknet/udp.h>
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/glue.hh>
+CLICK_DECLS
+
+GSOSegmenter::GSOSegmenter()
+    : _mtu(0), _mtu_anno(-1)
+{
+    _count = 0;
+    _segmented_count = 0;
+    _segments = 0;
+}
+
+GSOSegmenter::~GSOSegmenter()
+{
+}
+
+int
+GSOSegmenter::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    uint16_t mtu = 0;
+    int mtu_anno = -1;
+
+    if (Args(conf, this, errh)
+	.read_p("MTU", mtu)
+	.read("MTU_ANNO", AnnoArg(2), mtu_anno)
+	.complete() < 0)
+	return -1;
+
+    if (mtu == 0 && mtu_anno == -1)
+	return errh->error("At least one of MTU and MTU_ANNO must be set");
+
+    _mtu = mtu;
+    _mtu_anno = mtu_anno;
+    return 0;
+}
+
+void
+GSOSegmenter::fix_segment(WritablePacket *q, unsigned index, uint32_t offset,
+			  bool last)
+{
+    click_ip *iph = q->ip_header();
+    int tlen = q->transport_length();
+
+    uint16_t old_hw = iph->ip_len;
+    iph->ip_len = htons(q->network_length());
+    click_update_in_cksum(&iph->ip_sum, old_hw, iph->ip_len);
+    if (index) {
+	old_hw = iph->ip_id;
+	iph->ip_id = htons(ntohs(old_hw) + index);
+	click_update_in_cksum(&iph->ip_sum, old_hw, iph->ip_id);
+    }
+
+    if (iph->ip_p == IP_PROTO_TCP) {
+	click_tcp *tcph = q->tcp_header();
+	tcph->th_seq = htonl(ntohl(tcph->th_seq) + offset);
+	if (!last)
+	    tcph->th_flags &= ~(TH_FIN | TH_PUSH);
+	if (index)
+	    tcph->th_flags &= ~TH_CWR;
+	tcph->th_sum = 0;
+	unsigned csum = click_in_cksum((unsigned char *) tcph, tlen);
+	tcph->th_sum = click_in_cksum_pseudohdr(csum, iph, tlen);
+    } else {
+	click_udp *udph = q->udp_header();
+	udph->uh_ulen = htons(tlen);
+	if (udph->uh_sum) {
+	    udph->uh_sum = 0;
+	    unsigned csum = click_in_cksum((unsigned char *) udph, tlen);
+	    udph->uh_sum = click_in_cksum_pseudohdr(csum, iph, tlen);
+	    if (!udph->uh_sum)
+		udph->uh_sum = 0xFFFF;
+	}
+    }
+}
+
+void
+GSOSegmenter::push(int, Packet *p)
+{
+    unsigned mtu = _mtu;
+    if (_mtu_anno >= 0 && p->anno_u16(_mtu_anno) &&
+	(!mtu || mtu > p->anno_u16(_mtu_anno)))
+	mtu = p->anno_u16(_mtu_anno);
+
+    _count++;
+    if (p->has_segments() && !(p = p->linearize()))
+	return;
+
+    // find the headers; anything unexpected passes through
+    const click_ip *iph = p->ip_header();
+    unsigned ip_len = ntohs(iph->ip_len);
+    unsigned iphl = iph->ip_hl << 2;
+    unsigned hlen = 0;
+    if (mtu && ip_len > mtu && !IP_ISFRAG(iph)
+	&& p->network_length() >= (int) ip_len
+	&& p->network_header_offset() >= 0) {
+	if (iph->ip_p == IP_PROTO_TCP && ip_len >= iphl + sizeof(click_tcp))
+	    hlen = iphl + (p->tcp_header()->th_off << 2);
+	else if (iph->ip_p == IP_PROTO_UDP && ip_len >= iphl + sizeof(click_udp))
+	    hlen = iphl + sizeof(click_udp);
+    }
+    if (hlen <= iphl || hlen >= mtu || hlen >= ip_len) {
+	output(0).push(p);
+	return;
+    }
+
+    p->take(p->network_length() - ip_len);
+    unsigned pre = p->network_header_offset();
+    // The MAC header may lie in headroom, at a negative offset; copy it too.
+    bool has_mac = p->has_mac_header();
+    int mac_off = has_mac ? p->mac_header_offset() : 0;
+    int start = mac_off < 0 ? mac_off : 0;
+    uint32_t mss = mtu - hlen;
+    uint32_t payload = ip_len - hlen;
+    unsigned nseg = (payload + mss - 1) / mss;
+    _segmented_count++;
+
+    uint32_t offset = 0;
+    for (unsigned i = 0; i < nseg; ++i, offset += mss) {
+	uint32_t len = payload - offset < mss ? payload - offset : mss;
+	WritablePacket *q;
+	if (i + 1 < nseg) {
+	    if (!(q = Packet::make(p->headroom(), 0, pre + hlen + len, 0)))
+		break;
+	    memcpy(q->data() + start, p->data() + start, pre + hlen - start);
+	    memcpy(q->data() + pre + hlen, p->data() + pre + hlen + offset, len);
+	    q->copy_annotations(p);
+	} else {
+	    // The last segment keeps the input buffer; only the headers move.
+	    if (!(q = p->uniqueify()))
+		return;
+	    p = 0;
+	    memmove(q->data() + offset + start, q->data() + start, pre + hlen - start);
+	    q->pull(offset);
+	}
+	if (has_mac)
+	    q->set_mac_header(q->data() + mac_off);
+	q->set_ip_header(reinterpret_cast<click_ip *>(q->data() + pre), iphl);
+	fix_segment(q, i, offset, i + 1 == nseg);
+	_segments++;
+	output(0).push(q);
+    }
+
+    if (p)
+	p->kill();
+}
+
+void
+GSOSegmenter::add_handlers()
+{
+    add_data_handlers("count", Handler::OP_READ, &_count);
+    add_data_handlers("segmented_count", Handler::OP_READ, &_segmented_count);
+    add_data_handlers("segments", Handler::OP_READ, &_segments);
+}
+
+CLICK_ENDDECLS
+EXPORT_ELEMENT(GSOSegmenter)
+ELEMENT_MT_SAFE(GSOSegmenter)
@@ -0,0 +1,101 @@
+#ifndef CLICK_GSOSEGMENTER_HH
+#define CLICK_GSOSEGMENTER_HH
+#include <click/element.hh>
+#include <click/atomic.hh>
+CLICK_DECLS
+
+/*
+=c
+
+GSOSegmenter(MTU, I<keywords> MTU_ANNO)
+
+=s tcp
+
+segments large TCP and UDP packets in software
+
+=d
+
+Expects IP packets with their IP header annotations set.  TCP and UDP packets
+whose IP length exceeds the MTU are split into segments of at most MTU bytes,
+as a network card performing segmentation offload would.  Other packets,
+including IP fragments, pass through unchanged.
+
+Each segment carries a copy of the input packet's headers, from the start of
+the packet data to the end of the TCP or UDP header, and the next slice of
+the payload.  TCP segments get consecutive sequence numbers; FIN and PSH
+appear only on the last segment, and CWR only on the first.  UDP payloads
+are split into separate datagrams, as with Linux's UDP_SEGMENT; this is not IP
+fragmentation.  Each segment's IP ID is the input's IP ID plus the segment's
+index.
+
+The last segment reuses the input packet's buffer, so only its headers are
+copied.  IP header checksums are adjusted incrementally.  TCP checksums, and
+UDP checksums other than zero, are computed over each segment.
+
+Use GSOSegmenter to feed interfaces or elements that cannot handle packets
+larger than the MTU, such as after GROCoalescer, or after a FromDevice whose
+SNAPLEN admits the 64KB packets produced by the kernel's receive offloads.
+
+Keyword arguments are:
+
+=over 8
+
+=item MTU
+
+Unsigned. The largest IP packet length of a segment.  Zero means use only
+MTU_ANNO.
+
+=item MTU_ANNO
+
+Two-byte annotation.  If specified and nonzero on a packet, and smaller than
+MTU (or MTU is zero), then the annotation's value is used as that packet's
+MTU.
+
+=back
+
+=h count read-only
+
+Returns the number of input packets.
+
+=h segmented_count read-only
+
+Returns the number of input packets that were segmented.
+
+=h segments read-only
+
+Returns the number of segments emitted for segmented packets.
+
+=a GROCoalescer, TCPFragmenter, IPFragmenter
+*/
+
+class GSOSegmenter : public Element { public:
+
+    GSOSegmenter() CLICK_COLD;
+    ~GSOSegmenter() CLICK_COLD;
+
+    const char *class_name() const	{ return "GSOSegmenter"; }
+    const char *port_count() const	{ return PORTS_1_1; }
+    const char *processing() const	{ return PUSH; }
+    bool can_live_reconfigure() const	{ return true; }
+
+    int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
+    void add_handlers() CLICK_COLD;
+
+    void push(int, Packet *);
+
+  private:
+
+    uint16_t _mtu;
+    int8_t _mtu_anno;
+
+    atomic_uint32_t _count;
+    atomic_uint32_t _segmented_count;
+    atomic_uint32_t _segments;
+
+    static void fix_segment(WritablePacket *q, unsigned index,
+			    uint32_t offset, bool last);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -29,7 +29,7 @@
 CLICK_DECLS
 
 IPRewriter::IPRewriter()
-    : _udp_map(0)
+    : _udp_map(0), _udp_allocator(sizeof(UDPFlow))
 {
 }
 
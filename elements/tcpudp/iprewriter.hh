@@ -254,7 +254,7 @@ class IPRewriter : public TCPRewriter { public:
   private:
 
     Map _udp_map;
-    SizedHashAllocator<sizeof(UDPFlow)> _udp_allocator;
+    SlabAllocator _udp_allocator;
     uint32_t _udp_timeouts[2];
     uint32_t _udp_streaming_timeout;
 
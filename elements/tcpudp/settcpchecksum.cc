@@ -44,6 +44,9 @@ SetTCPChecksum::configure(Vector<String> &conf, ErrorHandler *errh)
 Packet *
 SetTCPChecksum::simple_action(Packet *p_in)
 {
+  if (p_in->has_segments() && p_in->has_transport_header()
+      && !(p_in = p_in->pullup(p_in->transport_header_offset() + sizeof(click_tcp))))
+    return 0;
   WritablePacket *p = p_in->uniqueify();
   click_ip *iph = p->ip_header();
   click_tcp *tcph = p->tcp_header();
@@ -51,7 +54,7 @@ SetTCPChecksum::simple_action(Packet *p_in)
   unsigned csum;
 
   if (!p->has_transport_header() || plen < sizeof(click_tcp)
-      || plen > (unsigned)p->transport_length())
+      || plen > p->total_length() - p->transport_header_offset())
     goto bad;
 
   if (_fixoff) {
@@ -63,7 +66,7 @@ SetTCPChecksum::simple_action(Packet *p_in)
   }
 
   tcph->th_sum = 0;
-  csum = click_in_cksum((unsigned char *)tcph, plen);
+  csum = p->in_cksum((unsigned char *)tcph, plen);
   tcph->th_sum = click_in_cksum_pseudohdr(csum, iph, plen);
 
   return p;
@@ -25,6 +25,7 @@ class SetTCPChecksum : public Element { public:
 
   const char *class_name() const		{ return "SetTCPChecksum"; }
   const char *port_count() const		{ return PORTS_1_1; }
+  const char *flags() const		{ return "D"; }
   int configure(Vector<String> &conf, ErrorHandler *errh) CLICK_COLD;
 
   Packet *simple_action(Packet *);
@@ -37,6 +37,9 @@ SetUDPChecksum::~SetUDPChecksum()
 Packet *
 SetUDPChecksum::simple_action(Packet *p_in)
 {
+    if (p_in->has_segments()
+	&& !(p_in = p_in->pullup(p_in->transport_header_offset() + sizeof(click_udp))))
+	return 0;
     WritablePacket *p = p_in->uniqueify();
     if (!p)
 	return 0;
@@ -44,11 +47,11 @@ SetUDPChecksum::simple_action(Packet *p_in)
     // XXX check IP header/UDP protocol?
     click_ip *iph = p->ip_header();
     click_udp *udph = p->udp_header();
+    int tlen = p->total_length() - p->transport_header_offset();
     int len;
     if (IP_ISFRAG(iph)
-	|| p->transport_length() < (int) sizeof(click_udp)
-	|| (len = ntohs(udph->uh_ulen),
-	    p->transport_length() < len)) {
+	|| tlen < (int) sizeof(click_udp)
+	|| (len = ntohs(udph->uh_ulen), tlen < len)) {
 	// fragment, or packet data too short
 	if (noutputs() == 1) {
 	    void *&x = router()->force_attachment("SetUDPChecksum_message");
@@ -62,7 +65,7 @@ SetUDPChecksum::simple_action(Packet *p_in)
     }
 
     udph->uh_sum = 0;
-    unsigned csum = click_in_cksum((unsigned char *)udph, len);
+    unsigned csum = p->in_cksum((unsigned char *)udph, len);
     udph->uh_sum = click_in_cksum_pseudohdr(csum, iph, len);
 
     return p;
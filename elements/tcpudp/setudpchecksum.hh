@@ -30,6 +30,7 @@ class SetUDPChecksum : public Element { public:
     const char *class_name() const	{ return "SetUDPChecksum"; }
     const char *port_count() const	{ return PORTS_1_1X2; }
     const char *processing() const	{ return PROCESSING_A_AH; }
+    const char *flags() const	{ return "D"; }
 
     Packet *simple_action(Packet *);
 
@@ -235,6 +235,7 @@ TCPRewriter::TCPFlow::unparse(StringAccum &sa, bool direction, click_jiffies_t n
 // TCPRewriter
 
 TCPRewriter::TCPRewriter()
+    : _allocator(sizeof(TCPFlow))
 {
 }
 
@@ -3,6 +3,7 @@
 #include "elements/ip/iprewriterbase.hh"
 #include "elements/ip/iprwmapping.hh"
 #include <clicknet/tcp.h>
+#include <click/slaballocator.hh>
 CLICK_DECLS
 
 /*
@@ -175,7 +176,7 @@ class TCPRewriter : public IPRewriterBase { public:
 
  protected:
 
-    SizedHashAllocator<sizeof(TCPFlow)> _allocator;
+    SlabAllocator _allocator;
     unsigned _annos;
     uint32_t _tcp_data_timeout;
     uint32_t _tcp_done_timeout;
@@ -97,7 +97,7 @@ UDPIPEncap::simple_action(Packet *p_in)
   // set up IP header
   ip->ip_v = 4;
   ip->ip_hl = sizeof(click_ip) >> 2;
-  ip->ip_len = htons(p->length());
+  ip->ip_len = htons(p->total_length());
   ip->ip_id = htons(_id.fetch_and_add(1));
   ip->ip_p = IP_PROTO_UDP;
   ip->ip_src = _saddr;
@@ -128,11 +128,11 @@ UDPIPEncap::simple_action(Packet *p_in)
   // set up UDP header
   udp->uh_sport = _sport;
   udp->uh_dport = _dport;
-  uint16_t len = p->length() - sizeof(click_ip);
+  uint16_t len = p->total_length() - sizeof(click_ip);
   udp->uh_ulen = htons(len);
   udp->uh_sum = 0;
   if (_cksum) {
-    unsigned csum = click_in_cksum((unsigned char *)udp, len);
+    unsigned csum = p->in_cksum((unsigned char *)udp, len);
     udp->uh_sum = click_in_cksum_pseudohdr(csum, ip, len);
   }
 
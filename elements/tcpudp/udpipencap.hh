@@ -59,7 +59,7 @@ class UDPIPEncap : public Element { public:
 
     const char *class_name() const	{ return "UDPIPEncap"; }
     const char *port_count() const	{ return PORTS_1_1; }
-    const char *flags() const		{ return "A"; }
+    const char *flags() const		{ return "A D"; }
 
     int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
     bool can_live_reconfigure() const	{ return true; }
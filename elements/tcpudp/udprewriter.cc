@@ -67,6 +67,7 @@ UDPRewriter::UDPFlow::apply(WritablePacket *p, bool direction, unsigned annos)
 }
 
 UDPRewriter::UDPRewriter()
+    : _allocator(sizeof(UDPFlow))
 {
 }
 
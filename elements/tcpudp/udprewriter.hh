@@ -3,6 +3,7 @@
 #include "elements/ip/iprewriterbase.hh"
 #include "elements/ip/iprwmapping.hh"
 #include <click/sync.hh>
+#include <click/slaballocator.hh>
 CLICK_DECLS
 
 /*
@@ -200,7 +201,7 @@ class UDPRewriter : public IPRewriterBase { public:
 
   private:
 
-    SizedHashAllocator<sizeof(UDPFlow)> _allocator;
+    SlabAllocator _allocator;
     unsigned _annos;
     uint32_t _udp_streaming_timeout;
 
@@ -0,0 +1,173 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * hashcontainerbenchmark.{cc,hh} -- compare hash container performance
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "hashcontainerbenchmark.hh"
+#include <click/hashcontainer.hh>
+#include <click/openhashcontainer.hh>
+#include <click/ipflowid.hh>
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/timestamp.hh>
+CLICK_DECLS
+
+namespace {
+struct BenchEntry {
+    IPFlowID _key;
+    BenchEntry *_hashnext;
+
+    typedef IPFlowID key_type;
+    typedef const IPFlowID &key_const_reference;
+
+    key_const_reference hashkey() const {
+	return _key;
+    }
+};
+
+typedef HashContainer<BenchEntry> Chained;
+typedef OpenHashContainer<BenchEntry> Open;
+
+inline void
+bench_insert(Chained &h, BenchEntry *e)
+{
+    Chained::iterator it = h.find(e->_key);
+    h.set(it, e, true);
+}
+
+inline void
+bench_insert(Open &h, BenchEntry *e)
+{
+    h.insert(e);
+}
+
+struct BenchData {
+    Vector<BenchEntry> entries;
+    Vector<IPFlowID> misses;
+    Vector<uint32_t> order;
+};
+
+enum { B_INSERT, B_HIT, B_BATCH, B_MISS, B_ERASE, B_N };
+static const uint32_t batch = 16;
+
+inline double
+nsec_per(const Timestamp &t, uint32_t n)
+{
+    return n ? t.doubleval() * 1e9 / n : 0;
+}
+
+template <typename H> uintptr_t
+bench_round(const BenchData &d, double *ns)
+{
+    H h;
+    BenchEntry *entries = const_cast<BenchEntry *>(d.entries.begin());
+    uint32_t n = d.entries.size(), nlookups = d.order.size();
+    uintptr_t x = 0;
+
+    Timestamp t0 = Timestamp::now();
+    for (uint32_t i = 0; i < n; ++i)
+	bench_insert(h, &entries[i]);
+    Timestamp t1 = Timestamp::now();
+    for (uint32_t i = 0; i < nlookups; ++i)
+	x += reinterpret_cast<uintptr_t>(h.get(entries[d.order[i]]._key));
+    Timestamp t2 = Timestamp::now();
+    for (uint32_t i = 0; i < nlookups; i += batch) {
+	IPFlowID keys[batch];
+	BenchEntry *got[batch];
+	uint32_t m = nlookups - i < batch ? nlookups - i : batch;
+	for (uint32_t j = 0; j < m; ++j)
+	    keys[j] = entries[d.order[i + j]]._key;
+	h.get_batch(keys, got, m);
+	for (uint32_t j = 0; j < m; ++j)
+	    x += reinterpret_cast<uintptr_t>(got[j]);
+    }
+    Timestamp t3 = Timestamp::now();
+    for (uint32_t i = 0; i < nlookups; ++i)
+	x += reinterpret_cast<uintptr_t>(h.get(d.misses[d.order[i]]));
+    Timestamp t4 = Timestamp::now();
+    for (uint32_t i = 0; i < n; ++i)
+	x += reinterpret_cast<uintptr_t>(h.erase(entries[i]._key));
+    Timestamp t5 = Timestamp::now();
+
+    double r[B_N] = {
+	nsec_per(t1 - t0, n), nsec_per(t2 - t1, nlookups),
+	nsec_per(t3 - t2, nlookups), nsec_per(t4 - t3, nlookups),
+	nsec_per(t5 - t4, n)
+    };
+    for (int i = 0; i < B_N; ++i)
+	if (ns[i] == 0 || r[i] < ns[i])
+	    ns[i] = r[i];
+    return x;
+}
+}
+
+HashContainerBenchmark::HashContainerBenchmark()
+{
+}
+
+int
+HashContainerBenchmark::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    _n = 100000;
+    _lookups = 1000000;
+    _rounds = 3;
+    if (Args(conf, this, errh)
+	.read_p("N", _n)
+	.read("LOOKUPS", _lookups)
+	.read("ROUNDS", _rounds)
+	.complete() < 0)
+	return -1;
+    if (_n == 0 || _rounds == 0)
+	return errh->error("N and ROUNDS must be positive");
+    return 0;
+}
+
+int
+HashContainerBenchmark::initialize(ErrorHandler *errh)
+{
+    BenchData d;
+    d.entries.resize(_n);
+    d.misses.resize(_n);
+    for (uint32_t i = 0; i < _n; ++i) {
+	d.entries[i]._key = IPFlowID(IPAddress(click_random()), click_random(),
+				     IPAddress(click_random()), click_random());
+	d.entries[i]._hashnext = 0;
+	d.misses[i] = IPFlowID(IPAddress(click_random()), click_random(),
+			       IPAddress(click_random()), click_random());
+    }
+    d.order.resize(_lookups);
+    for (uint32_t i = 0; i < _lookups; ++i)
+	d.order[i] = click_random(0, _n - 1);
+
+    double chained[B_N], open[B_N];
+    memset(chained, 0, sizeof(chained));
+    memset(open, 0, sizeof(open));
+    uintptr_t x = 0;
+    for (uint32_t r = 0; r < _rounds; ++r) {
+	x += bench_round<Chained>(d, chained);
+	x += bench_round<Open>(d, open);
+    }
+
+    // x depends on every lookup, so the compiler cannot skip them
+    errh->message("%u entries, %u lookups, checksum %u", _n, _lookups, (unsigned) (x & 1));
+    errh->message("HashContainer:     insert %.1f hit %.1f batch %.1f miss %.1f erase %.1f ns/op",
+		  chained[B_INSERT], chained[B_HIT], chained[B_BATCH], chained[B_MISS], chained[B_ERASE]);
+    errh->message("OpenHashContainer: insert %.1f hit %.1f batch %.1f miss %.1f erase %.1f ns/op",
+		  open[B_INSERT], open[B_HIT], open[B_BATCH], open[B_MISS], open[B_ERASE]);
+    return 0;
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel)
+EXPORT_ELEMENT(HashContainerBenchmark)
@@ -0,0 +1,68 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_HASHCONTAINERBENCHMARK_HH
+#define CLICK_HASHCONTAINERBENCHMARK_HH
+#include <click/element.hh>
+CLICK_DECLS
+
+/*
+=c
+
+HashContainerBenchmark([N, I<keywords> LOOKUPS, ROUNDS])
+
+=s test
+
+compares HashContainer and OpenHashContainer performance
+
+=d
+
+HashContainerBenchmark times flow-table operations on HashContainer, the
+chained hash table, and OpenHashContainer, the open-addressing hash table,
+at initialization time.  It does not route packets.
+
+Each round inserts N entries keyed by random IPFlowIDs, performs LOOKUPS
+successful lookups one at a time, the same lookups 16 at a time with
+get_batch(), and LOOKUPS failed lookups, all in random order, and erases
+every entry.  The chained table is balanced after each insertion, as elements that
+use HashContainer do.  Results are reported as nanoseconds per operation,
+using the best of ROUNDS rounds, one line per container.
+
+Keyword arguments are:
+
+=over 8
+
+=item N
+
+Number of entries.  Default is 100000.
+
+=item LOOKUPS
+
+Number of successful lookups, and also of failed lookups.  Default is
+1000000.
+
+=item ROUNDS
+
+Number of rounds.  Default is 3.
+
+=back
+
+=a HashTableTest */
+
+class HashContainerBenchmark : public Element { public:
+
+    HashContainerBenchmark() CLICK_COLD;
+
+    const char *class_name() const		{ return "HashContainerBenchmark"; }
+
+    int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
+    int initialize(ErrorHandler *) CLICK_COLD;
+
+  private:
+
+    uint32_t _n;
+    uint32_t _lookups;
+    uint32_t _rounds;
+
+};
+
+CLICK_ENDDECLS
+#endif
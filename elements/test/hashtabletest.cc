@@ -19,6 +19,7 @@
 #include <click/config.h>
 #include "hashtabletest.hh"
 #include <click/hashtable.hh>
+#include <click/openhashcontainer.hh>
 #include <click/error.hh>
 #if CLICK_USERLEVEL
 # include <sys/time.h>
@@ -442,6 +443,175 @@ struct MyHashContainerEntry {
 };
 
 typedef HashContainer<MyHashContainerEntry> MyHashContainer;
+typedef OpenHashContainer<MyHashContainerEntry> MyOpenHashContainer;
+
+static int
+check_open_hashcontainer(ErrorHandler *errh)
+{
+    MyOpenHashContainer h;
+    enum { N = 5000 };
+    MyHashContainerEntry *e[N];
+    for (int i = 0; i < N; ++i)
+	e[i] = new MyHashContainerEntry(i * 7);
+
+    // insertion, with lookups during incremental resizes
+    bool saw_resize = false;
+    for (int i = 0; i < N; ++i) {
+	CHECK(!h.get(i * 7));
+	h.insert(e[i]);
+	saw_resize |= h.resizing();
+	CHECK(h.get(i * 7) == e[i]);
+	CHECK(h.get(i / 2 * 7) == e[i / 2]);
+    }
+    CHECK(saw_resize);
+    CHECK(h.size() == N);
+    CHECK(!h.contains(3) && !h.find(3).live());
+
+    // iteration visits every element once
+    int n = 0, sum = 0;
+    for (MyOpenHashContainer::const_iterator it = h.begin(); it; ++it)
+	++n, sum += it->_key / 7;
+    CHECK(n == N && sum == N * (N - 1) / 2);
+
+    // set() replaces
+    MyHashContainerEntry replacement(14);
+    CHECK(h.set(&replacement) == e[2]);
+    CHECK(h.get(14) == &replacement);
+    CHECK(h.set(e[2]) == &replacement);
+
+    // erasing through an iterator advances it
+    n = 0;
+    for (MyOpenHashContainer::iterator it = h.begin(); it; )
+	if (it->_key % 2)
+	    h.erase(it);
+	else
+	    ++n, ++it;
+    CHECK(h.size() == (size_t) n && n == (N + 1) / 2);
+    for (int i = 0; i < N; ++i)
+	CHECK(h.get(i * 7) == (i % 2 ? 0 : e[i]));
+
+    // random inserts and erases against a reference
+    bool in[N];
+    for (int i = 0; i < N; ++i)
+	in[i] = !(i % 2);
+    uint32_t r = 1;
+    for (int round = 0; round < 50000; ++round) {
+	r = r * 1103515245 + 12345;
+	int i = (r >> 8) % N;
+	if (in[i]) {
+	    CHECK(h.erase(i * 7) == e[i]);
+	} else
+	    h.insert(e[i]);
+	in[i] = !in[i];
+    }
+    n = 0;
+    for (int i = 0; i < N; ++i) {
+	CHECK(h.get(i * 7) == (in[i] ? e[i] : 0));
+	n += in[i];
+    }
+    CHECK(h.size() == (size_t) n);
+
+    h.rehash(4 * N);
+    CHECK(!h.resizing() && h.size() == (size_t) n);
+    for (int i = 0; i < N; ++i)
+	CHECK(h.get(i * 7) == (in[i] ? e[i] : 0));
+
+    h.clear();
+    CHECK(h.size() == 0 && !h.begin().live());
+    for (int i = 0; i < N; ++i)
+	delete e[i];
+    return 0;
+}
+
+static int
+check_batch_lookup(ErrorHandler *errh)
+{
+    // 40 keys, more than one internal chunk; odd keys are absent
+    enum { N = 40 };
+    int keys[N];
+    for (int i = 0; i < N; ++i)
+	keys[i] = i * 3;
+
+    MyHashContainer hc;
+    MyOpenHashContainer ohc;
+    HashTable<int, int> ht;
+    MyHashContainerEntry *e[N];
+    for (int i = 0; i < N; ++i) {
+	e[i] = new MyHashContainerEntry(keys[i]);
+	if (keys[i] % 2 == 0) {
+	    MyHashContainer::iterator it = hc.find(keys[i]);
+	    hc.insert_at(it, e[i]);
+	    ohc.insert(e[i]);
+	    ht[keys[i]] = i;
+	}
+    }
+
+    MyHashContainer::iterator its[N];
+    MyHashContainerEntry *got[N];
+    hc.find_batch(keys, its, N);
+    hc.get_batch(keys, got, N);
+    for (int i = 0; i < N; ++i) {
+	CHECK(its[i].get() == hc.get(keys[i]) && got[i] == hc.get(keys[i]));
+	CHECK(got[i] == (keys[i] % 2 ? 0 : e[i]));
+	CHECK(its[i].can_insert() && its[i].bucket() == hc.bucket(keys[i]));
+    }
+    // a failed find_batch() iterator can insert, like find()'s
+    hc.insert_at(its[1], e[1]);
+    CHECK(hc.get(keys[1]) == e[1]);
+
+    ohc.get_batch(keys, got, N);
+    for (int i = 0; i < N; ++i)
+	CHECK(got[i] == (keys[i] % 2 ? 0 : e[i]));
+
+    HashTable<int, int>::iterator hits[N];
+    ht.find_batch(keys, hits, N);
+    for (int i = 0; i < N; ++i)
+	CHECK(keys[i] % 2 ? !hits[i].live()
+	      : hits[i].live() && hits[i].value() == i);
+
+    for (int i = 0; i < N; ++i)
+	delete e[i];
+    return 0;
+}
+
+static int
+check_open_hashtable(ErrorHandler *errh)
+{
+    typedef HashTable<int, String, OpenHashContainer> OpenMap;
+    enum { N = 3000 };
+    OpenMap h("none");
+    h[7] = "seven";
+    String *seven = h.get_pointer(7);
+    for (int i = 0; i < N; ++i)
+	if (i != 7)
+	    CHECK(h.set(i, String(i)));
+    // values never move, even across resizes
+    CHECK(h.size() == N && h.get_pointer(7) == seven && *seven == "seven");
+    CHECK(!h.set(7, "7") && h[7] == "7");
+    CHECK(h.get(-1) == "none" && !h.find(-1).live() && h.count(5) == 1);
+
+    OpenMap::iterator its[4];
+    int keys[4] = { 1, -2, 3, N };
+    h.find_batch(keys, its, 4);
+    CHECK(its[0].value() == "1" && !its[1] && its[2].key() == 3 && !its[3]);
+
+    OpenMap copy(h);
+    int n = 0;
+    for (OpenMap::iterator it = h.begin(); it; )
+	if (it.key() % 3)
+	    it = h.erase(it);
+	else
+	    ++n, ++it;
+    CHECK(h.size() == (size_t) n && n == (N + 2) / 3);
+    for (int i = 0; i < N; ++i) {
+	CHECK(h.count(i) == !(i % 3));
+	CHECK(copy[i] == String(i));
+    }
+    CHECK(h.erase(3) == 1 && h.erase(3) == 0);
+    h.clear();
+    CHECK(h.empty() && copy.size() == N);
+    return 0;
+}
 
 int
 HashTableTest::initialize(ErrorHandler *errh)
@@ -466,6 +636,11 @@ HashTableTest::initialize(ErrorHandler *errh)
     }
     CHECK(my_hashcontainer.size() == 0);
 
+    if (check_open_hashcontainer(errh) < 0
+	|| check_batch_lookup(errh) < 0
+	|| check_open_hashtable(errh) < 0)
+	return -1;
+
     MAP_S2I h;
 
     MAP_INSERT(h, "Foo", 1);
@@ -0,0 +1,227 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * ip6lookupbenchmark.{cc,hh} -- compare IPv6 routing table performance
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "ip6lookupbenchmark.hh"
+#include "elements/ip6/ip6poptrie.hh"
+#include <click/ip6table.hh>
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/timestamp.hh>
+CLICK_DECLS
+
+namespace {
+struct BenchRoute {
+    IP6Address addr;
+    int prefix_len;
+};
+
+// Approximate prefix length distribution of a public IPv6 routing table.
+const struct {
+    int prefix_len;
+    int weight;
+} length_weights[] = {
+    { 24, 1 }, { 28, 1 }, { 29, 3 }, { 32, 12 }, { 34, 1 }, { 36, 4 },
+    { 40, 6 }, { 44, 8 }, { 46, 3 }, { 47, 2 }, { 48, 48 }, { 56, 3 },
+    { 64, 5 }, { 128, 1 }
+};
+
+// Regions allocated to the regional registries.
+const uint16_t regions[] = {
+    0x2001, 0x2400, 0x2600, 0x2800, 0x2a00, 0x2c00
+};
+
+inline uint32_t
+random32()
+{
+    return (click_random() << 16) ^ click_random();
+}
+
+void
+random_suffix(IP6Address &a, int prefix_len)
+{
+    uint32_t *w = a.data32();
+    IP6Address mask = IP6Address::make_prefix(prefix_len);
+    for (int i = 0; i < 4; ++i)
+	w[i] = (w[i] & mask.data32()[i]) | (random32() & ~mask.data32()[i]);
+}
+
+int
+random_length()
+{
+    int total = 0, n = sizeof(length_weights) / sizeof(length_weights[0]);
+    for (int i = 0; i < n; ++i)
+	total += length_weights[i].weight;
+    int x = click_random(0, total - 1);
+    for (int i = 0; ; ++i)
+	if ((x -= length_weights[i].weight) < 0)
+	    return length_weights[i].prefix_len;
+}
+
+void
+make_routes(Vector<BenchRoute> &routes, uint32_t n)
+{
+    Vector<int> covers;		// indexes of routes of /32 or shorter
+    int nregions = sizeof(regions) / sizeof(regions[0]);
+    while (routes.size() < (int) n) {
+	BenchRoute r;
+	r.prefix_len = random_length();
+	if (r.prefix_len > 32 && covers.size() && click_random(0, 1)) {
+	    const BenchRoute &c = routes[covers[click_random(0, covers.size() - 1)]];
+	    r.addr = c.addr;
+	    random_suffix(r.addr, c.prefix_len);
+	} else {
+	    uint16_t region = regions[click_random(0, nregions - 1)];
+	    r.addr = IP6Address();
+	    r.addr.data32()[0] = htonl(region << 16);
+	    random_suffix(r.addr, region == 0x2001 ? 16 : 12);
+	}
+	r.addr &= IP6Address::make_prefix(r.prefix_len);
+	if (r.prefix_len <= 32)
+	    covers.push_back(routes.size());
+	routes.push_back(r);
+    }
+}
+
+inline double
+nsec_per(const Timestamp &t, uint32_t n)
+{
+    return n ? t.doubleval() * 1e9 / n : 0;
+}
+
+uint32_t
+compare(const IP6Poptrie &t, const IP6Table &lt,
+	const Vector<IP6Address> &addrs, uint32_t n)
+{
+    uint32_t mismatches = 0;
+    for (uint32_t i = 0; i < n; ++i) {
+	IP6Address gw;
+	int index = 0;
+	if (!lt.lookup(addrs[i], gw, index))
+	    index = 0;
+	if (t.lookup(addrs[i]) != (uint32_t) index)
+	    ++mismatches;
+    }
+    return mismatches;
+}
+}
+
+IP6LookupBenchmark::IP6LookupBenchmark()
+{
+}
+
+int
+IP6LookupBenchmark::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    _n = 20000;
+    _lookups = 1000000;
+    _linear = true;
+    _linear_lookups = 2000;
+    if (Args(conf, this, errh)
+	.read_p("N", _n)
+	.read("LOOKUPS", _lookups)
+	.read("LINEAR", _linear)
+	.read("LINEAR_LOOKUPS", _linear_lookups)
+	.complete() < 0)
+	return -1;
+    if (_n == 0)
+	return errh->error("N must be positive");
+    if (_linear_lookups > _lookups)
+	_linear_lookups = _lookups;
+    return 0;
+}
+
+int
+IP6LookupBenchmark::initialize(ErrorHandler *errh)
+{
+    Vector<BenchRoute> routes;
+    make_routes(routes, _n);
+    Vector<IP6Address> addrs;
+    addrs.resize(_lookups);
+    for (uint32_t i = 0; i < _lookups; ++i) {
+	const BenchRoute &r = routes[click_random(0, _n - 1)];
+	addrs[i] = r.addr;
+	random_suffix(addrs[i], r.prefix_len);
+    }
+    Vector<uint32_t> values;
+    values.resize(_lookups);
+
+    IP6Poptrie t;
+    if (!t.initialize())
+	return errh->error("out of memory");
+    uint32_t x = 0;
+
+    Timestamp t0 = Timestamp::now();
+    for (uint32_t i = 0; i < _n; ++i)
+	t.set(routes[i].addr, routes[i].prefix_len, i + 1);
+    Timestamp t1 = Timestamp::now();
+    for (uint32_t i = 0; i < _lookups; ++i)
+	x += t.lookup(addrs[i]);
+    Timestamp t2 = Timestamp::now();
+    t.lookup_batch(addrs.begin(), values.begin(), _lookups);
+    Timestamp t3 = Timestamp::now();
+    for (uint32_t i = 0; i < _lookups; ++i)
+	x -= values[i];
+    if (x != 0 || !t.check())
+	return errh->error("IP6Poptrie is inconsistent");
+    uint32_t nroutes = t.size(), nodes = t.nodes();
+    size_t memory = t.memory_used();
+
+    double linear_ns = 0;
+    if (_linear) {
+	IP6Table lt;
+	for (uint32_t i = 0; i < _n; ++i)
+	    lt.add(routes[i].addr, IP6Address::make_prefix(routes[i].prefix_len),
+		   IP6Address(), i + 1);
+	Timestamp l0 = Timestamp::now();
+	for (uint32_t i = 0; i < _linear_lookups; ++i) {
+	    IP6Address gw;
+	    int index;
+	    x += lt.lookup(addrs[i], gw, index) ? index : 0;
+	}
+	linear_ns = nsec_per(Timestamp::now() - l0, _linear_lookups);
+	uint32_t mismatches = compare(t, lt, addrs, _linear_lookups);
+
+	// check incremental removal
+	for (uint32_t i = 0; i < _n; i += 2) {
+	    IP6Address mask = IP6Address::make_prefix(routes[i].prefix_len);
+	    t.remove(routes[i].addr, routes[i].prefix_len);
+	    lt.del(routes[i].addr, mask);
+	}
+	mismatches += compare(t, lt, addrs, _linear_lookups);
+	if (mismatches || !t.check())
+	    return errh->error("IP6Poptrie and IP6Table disagree on %u lookups", mismatches);
+    }
+
+    Timestamp t4 = Timestamp::now();
+    for (uint32_t i = 0; i < _n; ++i)
+	t.remove(routes[i].addr, routes[i].prefix_len);
+    Timestamp t5 = Timestamp::now();
+    if (t.size() || t.nodes())
+	return errh->error("IP6Poptrie is not empty after removing every route");
+
+    errh->message("%u routes, %u nodes, %u KB, %u lookups, checksum %u",
+		  nroutes, nodes, (unsigned) (memory >> 10), _lookups, x & 1);
+    errh->message("IP6Poptrie: insert %.1f lookup %.1f batch %.1f remove %.1f ns/op",
+		  nsec_per(t1 - t0, _n), nsec_per(t2 - t1, _lookups),
+		  nsec_per(t3 - t2, _lookups), nsec_per(t5 - t4, _n));
+    if (_linear)
+	errh->message("IP6Table:   lookup %.1f ns/op", linear_ns);
+    return 0;
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel ip6 IP6Poptrie)
+EXPORT_ELEMENT(IP6LookupBenchmark)
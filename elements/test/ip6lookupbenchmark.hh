@@ -0,0 +1,81 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_IP6LOOKUPBENCHMARK_HH
+#define CLICK_IP6LOOKUPBENCHMARK_HH
+#include <click/element.hh>
+CLICK_DECLS
+
+/*
+=c
+
+IP6LookupBenchmark([N, I<keywords> LOOKUPS, LINEAR, LINEAR_LOOKUPS])
+
+=s test
+
+compares IPv6 routing table performance
+
+=d
+
+IP6LookupBenchmark times longest-prefix-match lookups on IP6Poptrie, the
+table behind PoptrieIP6Lookup, and IP6Table, the linear table behind
+LookupIP6Route, at initialization time.  It does not route packets.
+
+The benchmark builds N random routes whose prefix lengths follow the
+distribution of a public IPv6 routing table: about half are /48s, most of
+the rest lie between /29 and /44, and a few are /56, /64 or host routes.
+Prefixes fall in the 2000::/3 regions allocated to the regional registries,
+and many longer prefixes nest inside shorter ones.  Lookup addresses are
+random addresses within random routes.
+
+IP6Poptrie is timed inserting every route, performing LOOKUPS lookups one at
+a time and 16 at a time with lookup_batch(), and removing every route.  If
+LINEAR is true, IP6Table is loaded with the same routes and timed performing
+the first LINEAR_LOOKUPS lookups.  The benchmark also checks that the two
+tables agree on those lookups, both before and after half the routes are
+removed, and fails if they do not.  Results are reported as nanoseconds per
+operation.
+
+Keyword arguments are:
+
+=over 8
+
+=item N
+
+Number of routes.  Default is 20000.  Loading IP6Table takes time quadratic
+in N; set LINEAR to false to time IP6Poptrie alone on larger tables.
+
+=item LOOKUPS
+
+Number of IP6Poptrie lookups.  Default is 1000000.
+
+=item LINEAR
+
+Boolean.  If true, compare with IP6Table.  Default is true.
+
+=item LINEAR_LOOKUPS
+
+Number of IP6Table lookups.  Default is 2000.
+
+=back
+
+=a PoptrieIP6Lookup, LookupIP6Route */
+
+class IP6LookupBenchmark : public Element { public:
+
+    IP6LookupBenchmark() CLICK_COLD;
+
+    const char *class_name() const		{ return "IP6LookupBenchmark"; }
+
+    int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
+    int initialize(ErrorHandler *) CLICK_COLD;
+
+  private:
+
+    uint32_t _n;
+    uint32_t _lookups;
+    uint32_t _linear_lookups;
+    bool _linear;
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,150 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * slaballocatortest.{cc,hh} -- regression test element for SlabAllocator
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "slaballocatortest.hh"
+#include <click/slaballocator.hh>
+#include <click/vector.hh>
+#include <click/error.hh>
+CLICK_DECLS
+
+#if CLICK_USERLEVEL && HAVE_MULTITHREAD && HAVE___THREAD_STORAGE_CLASS
+# define SET_THREAD(t) (click_current_thread_id = (t) | 0x40000000)
+# define RESET_THREAD() (click_current_thread_id = saved_thread_id)
+#else
+# define SET_THREAD(t) ((void) (t))
+# define RESET_THREAD() ((void) 0)
+#endif
+
+SlabAllocatorTest::SlabAllocatorTest()
+{
+}
+
+#define CHECK(x) if (!(x)) return errh->error("%s:%d: test %<%s%> failed", __FILE__, __LINE__, #x);
+
+static int
+check_allocator(SlabAllocator &a, const char *how, ErrorHandler *errh)
+{
+    enum { N = 1000 };
+    Vector<int *> v;
+    SlabAllocator::Stats s;
+
+    // distinct, writable objects
+    for (int i = 0; i < N; ++i) {
+	int *p = reinterpret_cast<int *>(a.allocate());
+	CHECK(p);
+	*p = i;
+	v.push_back(p);
+    }
+    for (int i = 0; i < N; ++i)
+	if (*v[i] != i)
+	    return errh->error("%s: object %d overwritten", how, i);
+    a.stats(s);
+    CHECK(s.in_use == N && s.capacity >= N);
+
+    // freed objects are reused before new ones are carved
+    size_t capacity = s.capacity;
+    for (int i = 0; i < N; i += 2)
+	a.deallocate(v[i]);
+    a.stats(s);
+    CHECK(s.in_use == N / 2 && s.cached >= N / 2);
+    for (int i = 0; i < N; i += 2)
+	CHECK((v[i] = reinterpret_cast<int *>(a.allocate())));
+    a.stats(s);
+    CHECK(s.in_use == N && s.capacity == capacity);
+
+    for (int i = 0; i < N; ++i)
+	a.deallocate(v[i]);
+    a.deallocate(0);
+    a.stats(s);
+    CHECK(s.in_use == 0 && s.cached == s.capacity);
+    return 0;
+}
+
+int
+SlabAllocatorTest::initialize(ErrorHandler *errh)
+{
+#if CLICK_USERLEVEL && HAVE_MULTITHREAD && HAVE___THREAD_STORAGE_CLASS
+    int saved_thread_id = click_current_thread_id;
+#endif
+
+    CHECK(SlabAllocator::size_class(1) == 16);
+    CHECK(SlabAllocator::size_class(16) == 16);
+    CHECK(SlabAllocator::size_class(17) == 32);
+    CHECK(SlabAllocator::size_class(256) == 256);
+    CHECK(SlabAllocator::size_class(257) == 320);
+    CHECK(SlabAllocator::size_class(512) == 512);
+    CHECK(SlabAllocator::size_class(513) == 640);
+    CHECK(SlabAllocator::size_class(1000) == 1024);
+    CHECK(SlabAllocator::size_class(65536) == 65536);
+
+    CHECK(SlabAllocator::shared(20) == SlabAllocator::shared(32));
+    CHECK(SlabAllocator::shared(20) != SlabAllocator::shared(33));
+    CHECK(SlabAllocator::shared(33)->size() == 48);
+    CHECK(SlabAllocator::shared(65536) != SlabAllocator::shared(65535 - 8192));
+
+    {
+	// a thread that is not a router thread uses the depot
+	SlabAllocator a(24);
+	CHECK(a.size() == 32);
+	if (check_allocator(a, "depot", errh) < 0)
+	    return -1;
+    }
+
+    {
+	SlabAllocator a(100, SlabAllocator::F_HUGEPAGES);
+	SET_THREAD(0);
+	int r = check_allocator(a, "magazines", errh);
+	RESET_THREAD();
+	if (r < 0)
+	    return -1;
+    }
+
+    if (click_max_cpu_ids() >= 2) {
+	// objects allocated by one thread and freed by another
+	enum { N = 500 };
+	SlabAllocator a(64);
+	Vector<void *> v;
+	SET_THREAD(0);
+	for (int i = 0; i < N; ++i)
+	    v.push_back(a.allocate());
+	SET_THREAD(1);
+	for (int i = 0; i < N; ++i)
+	    a.deallocate(v[i]);
+	SlabAllocator::Stats s;
+	a.stats(s);
+	size_t capacity = s.capacity;
+	for (int i = 0; i < N; ++i)
+	    v[i] = a.allocate();
+	SET_THREAD(0);
+	for (int i = 0; i < N; ++i)
+	    a.deallocate(v[i]);
+	// the freed objects reach thread 0 through the depot
+	for (int i = 0; i < N; ++i)
+	    v[i] = a.allocate();
+	a.stats(s);
+	RESET_THREAD();
+	CHECK(s.in_use == N && s.capacity == capacity);
+	for (int i = 0; i < N; ++i)
+	    a.deallocate(v[i]);
+    }
+
+    errh->message("All tests pass!");
+    return 0;
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel)
+EXPORT_ELEMENT(SlabAllocatorTest)
@@ -0,0 +1,36 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_SLABALLOCATORTEST_HH
+#define CLICK_SLABALLOCATORTEST_HH
+#include <click/element.hh>
+CLICK_DECLS
+
+/*
+=c
+
+SlabAllocatorTest()
+
+=s test
+
+runs regression tests for SlabAllocator
+
+=d
+
+SlabAllocatorTest runs SlabAllocator regression tests at initialization time.
+It does not route packets.  With more than one thread (for instance, "click
+-j 2"), it also checks objects freed by a thread other than the one that
+allocated them.
+
+*/
+
+class SlabAllocatorTest : public Element { public:
+
+    SlabAllocatorTest() CLICK_COLD;
+
+    const char *class_name() const		{ return "SlabAllocatorTest"; }
+
+    int initialize(ErrorHandler *) CLICK_COLD;
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,170 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * adaptivepolling.{cc,hh} -- element backs off idle polling threads
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "adaptivepolling.hh"
+#include <click/task.hh>
+#include <click/routerthread.hh>
+#include <click/master.hh>
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/straccum.hh>
+CLICK_DECLS
+
+AdaptivePolling::AdaptivePolling()
+{
+}
+
+int
+AdaptivePolling::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    _busy_poll = Timestamp::make_usec(100);
+    _pause = Timestamp::make_msec(1);
+    _wake_latency = Timestamp::make_msec(1);
+    _threads.clear();
+    if (Args(conf, this, errh)
+	.read("BUSY_POLL", _busy_poll)
+	.read("PAUSE", _pause)
+	.read("WAKE_LATENCY", _wake_latency)
+	.read_all("THREADS", _threads)
+	.complete() < 0)
+	return -1;
+    if (!_wake_latency)
+	return errh->error("WAKE_LATENCY must be positive");
+    if (!_threads.size())
+	for (int t = 0; t < master()->nthreads(); ++t)
+	    _threads.push_back(t);
+    for (int *t = _threads.begin(); t != _threads.end(); ++t)
+	if (*t < 0 || *t >= master()->nthreads())
+	    return errh->error("thread %d out of range", *t);
+    return 0;
+}
+
+void
+AdaptivePolling::apply()
+{
+    for (int *t = _threads.begin(); t != _threads.end(); ++t)
+	master()->thread(*t)->set_idle_backoff(_busy_poll, _pause, _wake_latency, this);
+}
+
+int
+AdaptivePolling::initialize(ErrorHandler *)
+{
+    apply();
+    for (int *t = _threads.begin(); t != _threads.end(); ++t)
+	master()->thread(*t)->reset_utilization();
+    return 0;
+}
+
+void
+AdaptivePolling::cleanup(CleanupStage stage)
+{
+    if (stage >= CLEANUP_INITIALIZED)
+	for (int *t = _threads.begin(); t != _threads.end(); ++t)
+	    master()->thread(*t)->clear_idle_backoff(this);
+}
+
+enum { h_utilization, h_utilization_cycles, h_state, h_reset,
+       h_busy_poll, h_pause, h_wake_latency };
+
+String
+AdaptivePolling::read_handler(Element *e, void *thunk)
+{
+    AdaptivePolling *ap = static_cast<AdaptivePolling *>(e);
+    StringAccum sa;
+    switch ((intptr_t) thunk) {
+    case h_utilization:
+    case h_utilization_cycles:
+	for (int *t = ap->_threads.begin(); t != ap->_threads.end(); ++t) {
+	    RouterThread *thread = ap->master()->thread(*t);
+	    click_cycles_t c[RouterThread::NUTIL], total = 0;
+	    for (int i = 0; i < RouterThread::NUTIL; ++i)
+		total += c[i] = thread->utilization_cycles(i);
+	    sa << *t;
+	    for (int i = 0; i < RouterThread::NUTIL; ++i)
+		if ((intptr_t) thunk == h_utilization_cycles)
+		    sa << ' ' << c[i];
+		else
+		    sa.snprintf(16, " %.1f", total ? c[i] * 100. / total : 0.);
+	    sa << ' ' << thread->idle_sleeps() << '\n';
+	}
+	break;
+    case h_state: {
+	static const char * const names[] = { "busy", "pause", "sleep" };
+	for (int *t = ap->_threads.begin(); t != ap->_threads.end(); ++t)
+	    sa << *t << ' ' << names[ap->master()->thread(*t)->poll_state()] << '\n';
+	break;
+    }
+    case h_busy_poll:
+	sa << ap->_busy_poll;
+	break;
+    case h_pause:
+	sa << ap->_pause;
+	break;
+    case h_wake_latency:
+	sa << ap->_wake_latency;
+	break;
+    }
+    return sa.take_string();
+}
+
+int
+AdaptivePolling::write_handler(const String &str, Element *e, void *thunk, ErrorHandler *errh)
+{
+    AdaptivePolling *ap = static_cast<AdaptivePolling *>(e);
+    Timestamp ts;
+    switch ((intptr_t) thunk) {
+    case h_reset:
+	for (int *t = ap->_threads.begin(); t != ap->_threads.end(); ++t)
+	    ap->master()->thread(*t)->reset_utilization();
+	return 0;
+    case h_busy_poll:
+    case h_pause:
+    case h_wake_latency:
+	if (!TimestampArg().parse(cp_uncomment(str), ts))
+	    return errh->error("expected time");
+	if ((intptr_t) thunk == h_busy_poll)
+	    ap->_busy_poll = ts;
+	else if ((intptr_t) thunk == h_pause)
+	    ap->_pause = ts;
+	else if (!ts)
+	    return errh->error("wake_latency must be positive");
+	else
+	    ap->_wake_latency = ts;
+	ap->apply();
+	return 0;
+    default:
+	return -1;
+    }
+}
+
+void
+AdaptivePolling::add_handlers()
+{
+    add_read_handler("utilization", read_handler, h_utilization);
+    add_read_handler("utilization_cycles", read_handler, h_utilization_cycles);
+    add_read_handler("state", read_handler, h_state);
+    add_write_handler("reset", write_handler, h_reset, Handler::BUTTON);
+    add_read_handler("busy_poll", read_handler, h_busy_poll);
+    add_write_handler("busy_poll", write_handler, h_busy_poll);
+    add_read_handler("pause", read_handler, h_pause);
+    add_write_handler("pause", write_handler, h_pause);
+    add_read_handler("wake_latency", read_handler, h_wake_latency);
+    add_write_handler("wake_latency", write_handler, h_wake_latency);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel)
+EXPORT_ELEMENT(AdaptivePolling)
@@ -0,0 +1,127 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_ADAPTIVEPOLLING_HH
+#define CLICK_ADAPTIVEPOLLING_HH
+#include <click/element.hh>
+CLICK_DECLS
+
+/*
+=c
+
+AdaptivePolling([I<keywords> BUSY_POLL, PAUSE, WAKE_LATENCY, THREADS])
+
+=s threads
+
+backs off idle polling threads
+
+=d
+
+Turns on idle backoff for the driver threads, so that threads whose tasks
+poll for work, such as FromDPDKDevice, stop consuming a whole CPU while there
+is no work to do.
+
+Tasks report whether they did work by the return values of their run_task()
+callbacks.  Once no task on a thread has done work for BUSY_POLL, the thread
+executes pause instructions between polls.  After a further PAUSE, the thread
+sleeps between polls, waking when a file descriptor becomes ready, a timer
+expires, another thread schedules one of its tasks, or WAKE_LATENCY has
+passed.  As soon as any task reports work, the thread returns to busy
+polling.  Thus a thread that has been idle for a while takes up to
+WAKE_LATENCY to notice new work that only polling can find.
+
+Keyword arguments are:
+
+=over 8
+
+=item BUSY_POLL
+
+Time.  How long to busy-poll after tasks stop doing work.  Default is 100us.
+
+=item PAUSE
+
+Time.  How long to then pause between polls.  Default is 1ms.
+
+=item WAKE_LATENCY
+
+Time.  The longest an idle thread sleeps before polling again.  Click usually
+sleeps in poll(), which counts in milliseconds, so values below 1ms act as
+1ms.  Default is 1ms.
+
+=item THREADS
+
+Space-separated list of thread IDs.  Only these threads back off.  Default is
+all threads.
+
+=back
+
+Only one AdaptivePolling element should configure each thread.  Idle backoff
+is turned off when the router is removed, unless an AdaptivePolling element
+in a hotswapped router has taken the thread over.
+
+=h utilization read-only
+
+Returns one line per thread: the thread ID, followed by the percentage of
+cycles spent running tasks that did work, running tasks that did no work
+(including pauses), and in the operating system (sleeping or handling file
+descriptors), and then the number of times the thread slept because of
+backoff.  Counts start when the router is installed or at the last reset.
+Cycles are counted with the timestamp counter, and only on threads with
+idle backoff on; on other architectures the percentages are 0.
+
+=h utilization_cycles read-only
+
+Like utilization, but reports raw cycle counts.
+
+=h state read-only
+
+Returns one line per thread: the thread ID and its polling state, "busy",
+"pause", or "sleep".
+
+=h reset write-only
+
+Resets the utilization counts.
+
+=h busy_poll read/write
+
+=h pause read/write
+
+=h wake_latency read/write
+
+Return or set the corresponding arguments.
+
+=e
+
+  FromDPDKDevice(0) -> ... -> ToDPDKDevice(1);
+  AdaptivePolling(BUSY_POLL 50us, WAKE_LATENCY 2ms);
+
+=a
+
+StaticThreadSched, FromDPDKDevice
+*/
+
+class AdaptivePolling : public Element { public:
+
+    AdaptivePolling() CLICK_COLD;
+
+    const char *class_name() const	{ return "AdaptivePolling"; }
+
+    int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
+    int initialize(ErrorHandler *) CLICK_COLD;
+    void cleanup(CleanupStage) CLICK_COLD;
+    void add_handlers() CLICK_COLD;
+
+  private:
+
+    Timestamp _busy_poll;
+    Timestamp _pause;
+    Timestamp _wake_latency;
+    Vector<int> _threads;
+
+    void apply();
+
+    static String read_handler(Element *, void *);
+    static int write_handler(const String &, Element *, void *, ErrorHandler *);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,252 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * workstealingsched.{cc,hh} -- element moves tasks from busy threads to
+ * idle ones
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "workstealingsched.hh"
+#include <click/task.hh>
+#include <click/routerthread.hh>
+#include <click/router.hh>
+#include <click/master.hh>
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/straccum.hh>
+CLICK_DECLS
+
+WorkStealingSched::WorkStealingSched()
+    : _threads(0), _nthreads(0)
+{
+}
+
+WorkStealingSched::~WorkStealingSched()
+{
+    delete[] _threads;
+}
+
+int
+WorkStealingSched::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    Vector<String> pin;
+    _interval = Timestamp::make_msec(1);
+    _cooldown = 10;
+    _active = true;
+    if (Args(conf, this, errh)
+	.read("INTERVAL", _interval)
+	.read("PIN", AnyArg(), pin)
+	.read("COOLDOWN", _cooldown)
+	.read("ACTIVE", _active)
+	.complete() < 0)
+	return -1;
+    if (!_interval)
+	return errh->error("INTERVAL must be positive");
+
+    _pinned.assign(router()->nelements(), false);
+    Vector<String> words;
+    for (String *p = pin.begin(); p != pin.end(); ++p)
+	cp_spacevec(*p, words);
+    for (String *w = words.begin(); w != words.end(); ++w) {
+	bool found = false;
+	if (Element *e = router()->find(*w, this))
+	    _pinned[e->eindex()] = found = true;
+	else {
+	    String prefix = router()->ename_context(eindex()) + *w + "/";
+	    for (int i = 0; i != router()->nelements(); ++i)
+		if (router()->ename(i).starts_with(prefix))
+		    _pinned[i] = found = true;
+	}
+	if (!found)
+	    errh->error("%<%s%> does not name an element", w->c_str());
+    }
+    return errh->nerrors() ? -1 : 0;
+}
+
+int
+WorkStealingSched::initialize(ErrorHandler *)
+{
+    _nthreads = master()->nthreads();
+    _threads = new ThreadState[_nthreads];
+    for (int i = 0; i < _nthreads; ++i) {
+	ThreadState &ts = _threads[i];
+	ts.sched = this;
+	ts.id = i;
+	ts.tick = 0;
+	ts.steals = ts.stolen = ts.lost = 0;
+	ts.timer.assign(timer_hook, &ts);
+	ts.timer.initialize(this);
+	ts.timer.move_thread(i);
+	ts.timer.schedule_after(_interval);
+    }
+    return 0;
+}
+
+void
+WorkStealingSched::cleanup(CleanupStage)
+{
+    // Clear the deques: tasks may be deleted after this.
+    for (int i = 0; i < _nthreads; ++i) {
+	_threads[i].timer.unschedule();
+	while (_threads[i].deque.size())
+	    (void) _threads[i].deque.pop();
+    }
+}
+
+void
+WorkStealingSched::timer_hook(Timer *, void *thunk)
+{
+    ThreadState *ts = static_cast<ThreadState *>(thunk);
+    ts->sched->run_thread(*ts);
+    ts->timer.reschedule_after(ts->sched->_interval);
+}
+
+bool
+WorkStealingSched::offer(ThreadState &ts, Task *t) const
+{
+    Element *e = t->element();
+    if (e && e->router() == router() && _pinned[e->eindex()])
+	return false;
+    for (Recent *r = ts.recent.begin(); r != ts.recent.end(); ++r)
+	if (r->task == t)
+	    return false;
+    return true;
+}
+
+inline bool
+WorkStealingSched::in_transit(Task *t, RouterThread *thread)
+{
+    return t->home_thread_id() == thread->thread_id() && t->thread() != thread
+	&& t->scheduled();
+}
+
+static int
+task_decreasing_sorter(const void *va, const void *vb, void *)
+{
+    Task **a = (Task **) va, **b = (Task **) vb;
+    int ca = (*a)->cycles(), cb = (*b)->cycles();
+    return (ca < cb ? 1 : (cb < ca ? -1 : 0));
+}
+
+void
+WorkStealingSched::run_thread(ThreadState &ts)
+{
+    RouterThread *thread = master()->thread(ts.id);
+    ++ts.tick;
+
+    // Forget stolen tasks whose cooldown has passed, once they arrive.
+    for (int i = 0; i < ts.recent.size(); )
+	if (ts.tick - ts.recent[i].tick > _cooldown
+	    && !in_transit(ts.recent[i].task, thread)) {
+	    ts.recent[i] = ts.recent.back();
+	    ts.recent.pop_back();
+	} else
+	    ++i;
+
+    // Withdraw the last offer, then examine this thread's tasks.
+    while (ts.deque.size())
+	(void) ts.deque.pop();
+    ts.tasks.clear();
+    thread->scheduled_tasks(router(), ts.tasks);
+    if (!_active)
+	return;
+
+    bool idle = !ts.tasks.size()
+	|| (thread->idle_backoff() && thread->poll_state() != RouterThread::POLL_BUSY);
+
+    // A thread waiting for a stolen task to arrive is not idle.
+    for (Recent *r = ts.recent.begin(); idle && r != ts.recent.end(); ++r)
+	if (in_transit(r->task, thread))
+	    idle = false;
+
+    if (!idle && ts.tasks.size() >= 2) {
+	// Keep the most expensive task and offer the rest.
+	click_qsort(ts.tasks.begin(), ts.tasks.size(), sizeof(Task *), task_decreasing_sorter);
+	for (Task **t = ts.tasks.begin() + 1; t != ts.tasks.end(); ++t)
+	    if (offer(ts, *t) && !ts.deque.push(*t))
+		break;
+    } else if (idle) {
+	ThreadState *victim = 0;
+	uint32_t most = 0;
+	for (int i = 0; i < _nthreads; ++i)
+	    if (i != ts.id && _threads[i].deque.size() > most) {
+		victim = &_threads[i];
+		most = victim->deque.size();
+	    }
+	if (victim) {
+	    bool lost;
+	    Task *t = victim->deque.steal(lost);
+	    if (t && t->home_thread_id() == victim->id) {
+		t->move_thread(ts.id);
+		++ts.steals;
+		++victim->stolen;
+		Recent r = { t, ts.tick };
+		ts.recent.push_back(r);
+	    } else if (t || lost)
+		++ts.lost;
+	}
+    }
+}
+
+enum { h_stats, h_reset, h_active };
+
+String
+WorkStealingSched::read_handler(Element *e, void *thunk)
+{
+    WorkStealingSched *ws = static_cast<WorkStealingSched *>(e);
+    StringAccum sa;
+    switch ((intptr_t) thunk) {
+    case h_stats:
+	for (int i = 0; i < ws->_nthreads; ++i) {
+	    ThreadState &ts = ws->_threads[i];
+	    sa << i << ' ' << ts.steals << ' ' << ts.stolen << ' ' << ts.lost << '\n';
+	}
+	break;
+    case h_active:
+	sa << ws->_active;
+	break;
+    }
+    return sa.take_string();
+}
+
+int
+WorkStealingSched::write_handler(const String &str, Element *e, void *thunk, ErrorHandler *errh)
+{
+    WorkStealingSched *ws = static_cast<WorkStealingSched *>(e);
+    switch ((intptr_t) thunk) {
+    case h_reset:
+	for (int i = 0; i < ws->_nthreads; ++i) {
+	    ThreadState &ts = ws->_threads[i];
+	    ts.steals = ts.stolen = ts.lost = 0;
+	}
+	return 0;
+    case h_active:
+	if (!BoolArg().parse(cp_uncomment(str), ws->_active))
+	    return errh->error("expected boolean");
+	return 0;
+    default:
+	return -1;
+    }
+}
+
+void
+WorkStealingSched::add_handlers()
+{
+    add_read_handler("stats", read_handler, h_stats);
+    add_write_handler("reset", write_handler, h_reset, Handler::BUTTON);
+    add_read_handler("active", read_handler, h_active);
+    add_write_handler("active", write_handler, h_active);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel multithread)
+EXPORT_ELEMENT(WorkStealingSched)
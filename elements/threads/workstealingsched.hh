@@ -0,0 +1,206 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_WORKSTEALINGSCHED_HH
+#define CLICK_WORKSTEALINGSCHED_HH
+#include <click/element.hh>
+#include <click/timer.hh>
+#include <click/atomic.hh>
+CLICK_DECLS
+
+/*
+=c
+
+WorkStealingSched([I<keywords> INTERVAL, PIN, COOLDOWN, ACTIVE])
+
+=s threads
+
+moves tasks from busy threads to idle ones
+
+=d
+
+Lets idle threads steal scheduled tasks from busy threads.  Unlike
+BalancedThreadSched, which periodically reassigns tasks from one thread
+according to their average cost, WorkStealingSched reacts within INTERVAL to
+threads running out of work, so bursty loads spread over the available
+cores.
+
+Every INTERVAL, each thread examines its own scheduled tasks.  A thread with
+at least two scheduled tasks is busy: it keeps its most expensive task, by
+cycle count, and offers the rest in a per-thread lock-free deque, most
+expensive first.  A thread with no scheduled tasks, or one that AdaptivePolling
+has backing off, is idle: it steals the first task offered by the busy thread
+offering the most, and that task moves to the idle thread as if by its
+home_thread handler.  Several idle threads can steal from one deque
+concurrently; each task is taken at most once.
+
+Tasks that keep state best accessed from one core can be pinned with PIN.
+A task that has just been stolen is not offered again for COOLDOWN
+intervals, so tasks do not bounce between threads.
+
+Keyword arguments are:
+
+=over 8
+
+=item INTERVAL
+
+Time.  How often threads offer and steal tasks.  Default is 1ms.
+
+=item PIN
+
+Space-separated list of element names.  Tasks belonging to these elements,
+or to elements inside these compound elements, are never stolen.
+
+=item COOLDOWN
+
+Unsigned.  Number of intervals before a stolen task may be stolen again.
+Default is 10.
+
+=item ACTIVE
+
+Boolean.  If false, no tasks are stolen.  Default is true.
+
+=back
+
+=h stats read-only
+
+Returns one line per thread: the thread ID, the number of tasks the thread
+stole, the number of tasks stolen from it, and the number of steal attempts
+that found no task because another thread took it first or the busy thread
+withdrew it.
+
+=h reset write-only
+
+Resets the statistics.
+
+=h active read/write
+
+Returns or sets ACTIVE.
+
+=e
+
+Four tasks start on thread 0; idle threads 1 to 3 take three of them:
+
+  StaticThreadSched(u0 0, u1 0, u2 0, u3 0);
+  WorkStealingSched(PIN counter);
+
+The conf/workstealing-bench.click configuration compares latency under a
+skewed load with and without WorkStealingSched.
+
+=a BalancedThreadSched, StaticThreadSched, AdaptivePolling
+*/
+
+class WorkStealingSched : public Element { public:
+
+    WorkStealingSched() CLICK_COLD;
+    ~WorkStealingSched() CLICK_COLD;
+
+    const char *class_name() const	{ return "WorkStealingSched"; }
+
+    int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
+    int initialize(ErrorHandler *) CLICK_COLD;
+    void cleanup(CleanupStage) CLICK_COLD;
+    void add_handlers() CLICK_COLD;
+
+  private:
+
+    // Chase-Lev work-stealing deque of fixed capacity.  Only the owning
+    // thread pushes and pops at the bottom; any thread steals from the top.
+    class StealDeque { public:
+	StealDeque()			: _bottom(0) { _top = 0; }
+	inline bool push(Task *t);
+	inline Task *pop();
+	inline Task *steal(bool &lost);
+	uint32_t size() const		{ return _bottom - _top.value(); }
+      private:
+	enum { capacity = 64 };
+	atomic_uint32_t _top;
+	volatile uint32_t _bottom;
+	Task *_slots[capacity];
+    };
+
+    struct Recent {
+	Task *task;
+	uint32_t tick;
+    };
+
+    struct ThreadState {
+	WorkStealingSched *sched;
+	int id;
+	uint32_t tick;
+	Timer timer;
+	StealDeque deque;
+	Vector<Task *> tasks;
+	Vector<Recent> recent;
+	uint64_t steals;
+	uint64_t stolen;
+	uint64_t lost;
+    };
+
+    ThreadState *_threads;
+    int _nthreads;
+    Timestamp _interval;
+    uint32_t _cooldown;
+    bool _active;
+    Vector<bool> _pinned;
+
+    static void timer_hook(Timer *, void *);
+    void run_thread(ThreadState &ts);
+    bool offer(ThreadState &ts, Task *t) const;
+    static inline bool in_transit(Task *t, RouterThread *thread);
+
+    static String read_handler(Element *, void *);
+    static int write_handler(const String &, Element *, void *, ErrorHandler *);
+
+};
+
+inline bool
+WorkStealingSched::StealDeque::push(Task *t)
+{
+    uint32_t b = _bottom;
+    if (b - _top.value() >= (uint32_t) capacity)
+	return false;
+    _slots[b % capacity] = t;
+    click_write_fence();
+    _bottom = b + 1;
+    return true;
+}
+
+inline Task *
+WorkStealingSched::StealDeque::pop()
+{
+    uint32_t b = _bottom - 1;
+    _bottom = b;
+    click_fence();
+    uint32_t t = _top.value();
+    if ((int32_t) (b - t) < 0) {
+	_bottom = t;
+	return 0;
+    }
+    Task *x = _slots[b % capacity];
+    if (b == t) {
+	// Last entry: race thieves for it.
+	if (_top.compare_swap(t, t + 1) != t)
+	    x = 0;
+	_bottom = t + 1;
+    }
+    return x;
+}
+
+inline Task *
+WorkStealingSched::StealDeque::steal(bool &lost)
+{
+    uint32_t t = _top.value();
+    click_fence();
+    uint32_t b = _bottom;
+    lost = false;
+    if ((int32_t) (b - t) <= 0)
+	return 0;
+    Task *x = _slots[t % capacity];
+    if (_top.compare_swap(t, t + 1) != t) {
+	lost = true;
+	return 0;
+    }
+    return x;
+}
+
+CLICK_ENDDECLS
+#endif
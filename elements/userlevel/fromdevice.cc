@@ -196,6 +196,43 @@ FromDevice::open_packet_socket(String ifname, ErrorHandler *errh)
     return fd;
 }
 
+/* Have the kernel timestamp packets as they arrive, and report the
+   timestamps with each recvmsg(). */
+void
+FromDevice::enable_linux_timestamps()
+{
+    int one = 1;
+# ifdef SO_TIMESTAMPNS
+    if (setsockopt(_fd, SOL_SOCKET, SO_TIMESTAMPNS, &one, sizeof(one)) == 0) {
+	_linux_tstamp = SCM_TIMESTAMPNS;
+	return;
+    }
+# endif
+    if (setsockopt(_fd, SOL_SOCKET, SO_TIMESTAMP, &one, sizeof(one)) == 0)
+	_linux_tstamp = SCM_TIMESTAMP;
+}
+
+void
+FromDevice::set_linux_timestamp(Packet *p, struct msghdr &msg)
+{
+    for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm))
+	if (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == _linux_tstamp) {
+# ifdef SO_TIMESTAMPNS
+	    if (_linux_tstamp == SCM_TIMESTAMPNS) {
+		struct timespec ts;
+		memcpy(&ts, CMSG_DATA(cm), sizeof(ts));
+		p->timestamp_anno() = Timestamp(ts);
+		return;
+	    }
+# endif
+	    struct timeval tv;
+	    memcpy(&tv, CMSG_DATA(cm), sizeof(tv));
+	    p->timestamp_anno() = Timestamp(tv);
+	    return;
+	}
+    p->timestamp_anno().set_timeval_ioctl(_fd, SIOCGSTAMP);
+}
+
 int
 FromDevice::set_promiscuous(int fd, String ifname, bool promisc)
 {
@@ -403,6 +440,10 @@ FromDevice::initialize(ErrorHandler *errh)
 	} else
 	    _was_promisc = promisc_ok;
 
+	_linux_tstamp = 0;
+	if (_timestamp)
+	    enable_linux_timestamps();
+
 	_datalink = FAKE_DLT_EN10MB;
 	_method = method_linux;
     }
@@ -532,9 +573,23 @@ FromDevice::selected(int, int)
     int nlinux = 0;
     while (_method == method_linux && nlinux < _burst) {
 	struct sockaddr_ll sa;
-	socklen_t fromlen = sizeof(sa);
 	WritablePacket *p = Packet::make(_headroom, 0, _snaplen, 0);
-	int len = recvfrom(_fd, p->data(), p->length(), MSG_TRUNC, (sockaddr *)&sa, &fromlen);
+	struct iovec iov;
+	iov.iov_base = p->data();
+	iov.iov_len = p->length();
+	union {
+	    struct cmsghdr cm;
+	    char buf[CMSG_SPACE(sizeof(struct timespec))];
+	} control;
+	struct msghdr msg;
+	msg.msg_name = &sa;
+	msg.msg_namelen = sizeof(sa);
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = &control;
+	msg.msg_controllen = sizeof(control);
+	msg.msg_flags = 0;
+	int len = recvmsg(_fd, &msg, MSG_TRUNC);
 	if (len > 0 && (sa.sll_pkttype != PACKET_OUTGOING || _outbound)
             && (_protocol == 0 || _protocol == sa.sll_protocol)) {
 	    if (len > _snaplen) {
@@ -543,7 +598,8 @@ FromDevice::selected(int, int)
 	    } else
 		p->take(_snaplen - len);
 	    p->set_packet_type_anno((Packet::PacketType)sa.sll_pkttype);
-	    p->timestamp_anno().set_timeval_ioctl(_fd, SIOCGSTAMP);
+	    if (_timestamp)
+		set_linux_timestamp(p, msg);
 	    p->set_mac_header(p->data());
 	    ++nlinux;
 	    ++_count;
@@ -554,7 +610,7 @@ FromDevice::selected(int, int)
 	} else {
 	    p->kill();
 	    if (len <= 0 && errno != EAGAIN)
-		click_chatter("FromDevice(%s): recvfrom: %s", _ifname.c_str(), strerror(errno));
+		click_chatter("FromDevice(%s): recvmsg: %s", _ifname.c_str(), strerror(errno));
 	    break;
 	}
     }
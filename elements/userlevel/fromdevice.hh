@@ -5,6 +5,7 @@
 
 #ifdef __linux__
 # define FROMDEVICE_ALLOW_LINUX 1
+# include <sys/socket.h>
 #endif
 
 #if HAVE_PCAP
@@ -132,6 +133,10 @@ Integer. Maximum number of packets to read per scheduling. Defaults to 1.
 =item TIMESTAMP
 
 Boolean. If false, then do not timestamp packets. Defaults to true.
+Timestamps come from the kernel, which records each packet's arrival time as
+it receives it, not from the clock when FromDevice reads the packet.  With
+METHOD LINUX, FromDevice asks for nanosecond-precision timestamps
+(SO_TIMESTAMPNS) where available.
 
 =back
 
@@ -227,6 +232,11 @@ class FromDevice : public Element { public:
     pcap_t *_pcap;
     int _pcap_complaints;
 #endif
+#if FROMDEVICE_ALLOW_LINUX
+    int _linux_tstamp;
+    void enable_linux_timestamps();
+    void set_linux_timestamp(Packet *p, struct msghdr &msg);
+#endif
 #if FROMDEVICE_ALLOW_NETMAP
     NetmapInfo _netmap;
     int netmap_dispatch();
@@ -0,0 +1,426 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * metricsexporter.{cc,hh} -- element exports numeric handler values
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "metricsexporter.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/router.hh>
+#include <click/handler.hh>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+CLICK_DECLS
+
+MetricsExporter::MetricsExporter()
+    : _socket_fd(-1), _type(type_none), _format(format_prometheus),
+      _localhost(false), _verbose(false), _prefix("click_"), _timer(this)
+{
+}
+
+MetricsExporter::~MetricsExporter()
+{
+}
+
+int
+MetricsExporter::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    String socktype, format = "prometheus", handlers;
+    _interval = Timestamp(1);
+    Args args = Args(this, errh).bind(conf);
+    if (args.read_p("TYPE", WordArg(), socktype)
+	.read("INTERVAL", _interval)
+	.read("FORMAT", WordArg(), format)
+	.read("HANDLERS", AnyArg(), handlers)
+	.read("PREFIX", _prefix)
+	.read("LOCALHOST", _localhost)
+	.read("VERBOSE", _verbose)
+	.consume() < 0)
+	return -1;
+
+    socktype = socktype.upper();
+    if (!socktype) {
+	_type = type_none;
+	if (args.complete() < 0)
+	    return -1;
+    } else if (socktype == "TCP") {
+	_type = type_tcp;
+	uint16_t portno;
+	if (args.read_mp("PORT", IPPortArg(IP_PROTO_TCP), portno)
+	    .complete() < 0)
+	    return -1;
+	_pathname = String(portno);
+    } else if (socktype == "UNIX") {
+	_type = type_unix;
+	if (args.read_mp("FILENAME", FilenameArg(), _pathname)
+	    .complete() < 0)
+	    return -1;
+	if (_pathname.length() >= (int)sizeof(((struct sockaddr_un *)0)->sun_path))
+	    return errh->error("filename too long");
+    } else
+	return errh->error("unknown socket type %<%s%>", socktype.c_str());
+
+    format = format.lower();
+    if (format == "prometheus")
+	_format = format_prometheus;
+    else if (format == "openmetrics")
+	_format = format_openmetrics;
+    else
+	return errh->error("unknown FORMAT %<%s%>", format.c_str());
+
+    _patterns.clear();
+    cp_spacevec(cp_unquote(handlers), _patterns);
+    if (_interval <= Timestamp())
+	return errh->error("INTERVAL must be positive");
+    return 0;
+}
+
+int
+MetricsExporter::initialize_socket(ErrorHandler *errh)
+{
+    if (_type == type_tcp) {
+	_socket_fd = socket(PF_INET, SOCK_STREAM, 0);
+	if (_socket_fd < 0)
+	    return errh->error("socket: %s", strerror(errno));
+	int sockopt = 1;
+	if (setsockopt(_socket_fd, SOL_SOCKET, SO_REUSEADDR, (void *)&sockopt, sizeof(sockopt)) < 0)
+	    errh->warning("setsockopt: %s", strerror(errno));
+
+	int portno;
+	(void) cp_integer(_pathname.begin(), _pathname.end(), 0, &portno);
+	struct sockaddr_in sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sin_family = AF_INET;
+	sa.sin_port = htons(portno);
+	sa.sin_addr.s_addr = htonl(_localhost ? INADDR_LOOPBACK : INADDR_ANY);
+	if (bind(_socket_fd, (struct sockaddr *)&sa, sizeof(sa)) < 0)
+	    return errh->error("bind: %s", strerror(errno));
+
+    } else {
+	_socket_fd = socket(PF_UNIX, SOCK_STREAM, 0);
+	if (_socket_fd < 0)
+	    return errh->error("socket: %s", strerror(errno));
+
+	struct sockaddr_un sa;
+	sa.sun_family = AF_UNIX;
+	memcpy(sa.sun_path, _pathname.c_str(), _pathname.length() + 1);
+	if (bind(_socket_fd, (struct sockaddr *)&sa, sizeof(sa)) < 0)
+	    return errh->error("bind: %s", strerror(errno));
+    }
+
+    if (listen(_socket_fd, 8) < 0)
+	return errh->error("listen: %s", strerror(errno));
+
+    fcntl(_socket_fd, F_SETFL, O_NONBLOCK);
+    fcntl(_socket_fd, F_SETFD, FD_CLOEXEC);
+    add_select(_socket_fd, SELECT_READ);
+    return 0;
+}
+
+int
+MetricsExporter::initialize(ErrorHandler *errh)
+{
+    if (_type != type_none && initialize_socket(errh) < 0)
+	return -1;
+    _timer.initialize(this);
+    // first snapshot runs after every element has initialized
+    _timer.schedule_now();
+    return 0;
+}
+
+void
+MetricsExporter::cleanup(CleanupStage)
+{
+    for (connection **it = _conns.begin(); it != _conns.end(); ++it)
+	if (*it) {
+	    close((*it)->fd);
+	    delete *it;
+	}
+    _conns.clear();
+    if (_socket_fd >= 0) {
+	close(_socket_fd);
+	if (_type == type_unix)
+	    unlink(_pathname.c_str());
+	_socket_fd = -1;
+    }
+}
+
+bool
+MetricsExporter::pattern_match(Element *e, const String &hname) const
+{
+    static const char * const default_patterns[] = {
+	"count", "*_count", "rate", "*_rate", "drops", "*_drops", "length",
+	"highwater_length", "capacity", "nmappings"
+    };
+    if (!_patterns.size()) {
+	for (size_t i = 0; i < sizeof(default_patterns) / sizeof(default_patterns[0]); ++i)
+	    if (hname.glob_match(default_patterns[i]))
+		return true;
+	return false;
+    }
+    String fullname;
+    for (const String *it = _patterns.begin(); it != _patterns.end(); ++it)
+	if (it->find_left('.') >= 0) {
+	    if (!fullname)
+		fullname = e->name() + "." + hname;
+	    if (fullname.glob_match(*it))
+		return true;
+	} else if (hname.glob_match(*it))
+	    return true;
+    return false;
+}
+
+String
+MetricsExporter::metric_name(const String &hname) const
+{
+    StringAccum sa;
+    sa << _prefix;
+    for (const char *s = hname.begin(); s != hname.end(); ++s)
+	if (isalnum((unsigned char) *s) || *s == '_')
+	    sa << *s;
+	else
+	    sa << '_';
+    return sa.take_string();
+}
+
+bool
+MetricsExporter::numeric_value(const String &s, String &value)
+{
+    value = s.trim_space();
+    double d;
+    return value && DoubleArg().parse(value, d);
+}
+
+/* Select handlers by name and flags only, since reading a handler to see
+   whether it is numeric could have side effects. */
+void
+MetricsExporter::discover()
+{
+    static const char * const skip_handlers[] = {
+	"name", "class", "config", "ports", "handlers"
+    };
+    const uint32_t skip_flags = Handler::f_raw | Handler::f_expensive
+	| Handler::f_deprecated | Handler::f_read_private;
+
+    HashTable<String, int> family_index(-1);
+    Vector<int> hindexes;
+    _sources.clear();
+    _families.clear();
+
+    for (Element * const *ep = router()->elements().begin();
+	 ep != router()->elements().end(); ++ep) {
+	Element *e = *ep;
+	if (e == this)
+	    continue;
+	hindexes.clear();
+	Router::element_hindexes(e, hindexes);
+	for (int *hip = hindexes.begin(); hip != hindexes.end(); ++hip) {
+	    const Handler *h = Router::handler(router(), *hip);
+	    if (!h || !h->readable() || (h->flags() & skip_flags))
+		continue;
+	    const char * const *sp = skip_handlers;
+	    while (sp != skip_handlers + sizeof(skip_handlers) / sizeof(skip_handlers[0])
+		   && h->name() != *sp)
+		++sp;
+	    if (sp != skip_handlers + sizeof(skip_handlers) / sizeof(skip_handlers[0])
+		|| !pattern_match(e, h->name()))
+		continue;
+
+	    String name = metric_name(h->name());
+	    int &fi = family_index[name];
+	    if (fi < 0) {
+		fi = _families.size();
+		_families.push_back(family(name));
+	    }
+	    _families[fi].sources.push_back(_sources.size());
+	    _sources.push_back(source(e, *hip));
+	}
+    }
+}
+
+static void
+append_label(StringAccum &sa, const String &s)
+{
+    for (const char *x = s.begin(); x != s.end(); ++x)
+	if (*x == '\\' || *x == '\"')
+	    sa << '\\' << *x;
+	else if (*x == '\n')
+	    sa << "\\n";
+	else
+	    sa << *x;
+}
+
+void
+MetricsExporter::update()
+{
+    // Rediscover each time, so handlers added since the last snapshot are
+    // exported; this only compares names and flags.
+    discover();
+
+    StringAccum sa;
+    String value;
+    const char *type = (_format == format_openmetrics ? "unknown" : "untyped");
+    for (family *f = _families.begin(); f != _families.end(); ++f) {
+	bool any = false;
+	for (int *sp = f->sources.begin(); sp != f->sources.end(); ++sp) {
+	    source &s = _sources[*sp];
+	    const Handler *h = Router::handler(router(), s.hindex);
+	    if (!h || !numeric_value(h->call_read(s.e), value))
+		continue;
+	    if (!any) {
+		sa << "# TYPE " << f->name << ' ' << type << '\n';
+		any = true;
+	    }
+	    sa << f->name << "{element=\"";
+	    append_label(sa, s.e->name());
+	    sa << "\",class=\"" << s.e->class_name() << "\"} " << value << '\n';
+	}
+    }
+    if (_format == format_openmetrics)
+	sa << "# EOF\n";
+    _snapshot = sa.take_string();
+}
+
+void
+MetricsExporter::run_timer(Timer *)
+{
+    update();
+    _timer.reschedule_after(_interval);
+}
+
+String
+MetricsExporter::make_response(const String &request) const
+{
+    if (request.find_left("HTTP/") < 0)
+	return _snapshot;
+    StringAccum sa;
+    sa << "HTTP/1.0 200 OK\r\nContent-Type: ";
+    if (_format == format_openmetrics)
+	sa << "application/openmetrics-text; version=1.0.0; charset=utf-8";
+    else
+	sa << "text/plain; version=0.0.4; charset=utf-8";
+    sa << "\r\nContent-Length: " << _snapshot.length()
+       << "\r\nConnection: close\r\n\r\n" << _snapshot;
+    return sa.take_string();
+}
+
+void
+MetricsExporter::close_connection(connection *conn)
+{
+    remove_select(conn->fd, SELECT_READ | SELECT_WRITE);
+    close(conn->fd);
+    if (_verbose)
+	click_chatter("%s: closed connection %d", declaration().c_str(), conn->fd);
+    _conns[conn->fd] = 0;
+    delete conn;
+}
+
+void
+MetricsExporter::selected(int fd, int)
+{
+    if (fd == _socket_fd) {
+	int new_fd = accept(_socket_fd, 0, 0);
+	if (new_fd < 0) {
+	    if (errno != EAGAIN)
+		click_chatter("%s: accept: %s", declaration().c_str(), strerror(errno));
+	    return;
+	}
+	if (_verbose)
+	    click_chatter("%s: opened connection %d", declaration().c_str(), new_fd);
+	fcntl(new_fd, F_SETFL, O_NONBLOCK);
+	fcntl(new_fd, F_SETFD, FD_CLOEXEC);
+	add_select(new_fd, SELECT_READ);
+	if (_conns.size() <= new_fd)
+	    _conns.resize(new_fd + 1);
+	_conns[new_fd] = new connection(new_fd);
+	return;
+    }
+
+    if (fd >= _conns.size() || !_conns[fd])
+	return;
+    connection *conn = _conns[fd];
+
+    // read the request until a blank line, EOF, or too much data
+    if (conn->outpos < 0) {
+	bool complete = false;
+	if (char *buf = conn->in_text.reserve(2048)) {
+	    ssize_t r = read(conn->fd, buf, 2048);
+	    if (r > 0)
+		conn->in_text.adjust_length(r);
+	    else if (r == 0 || (errno != EAGAIN && errno != EINTR))
+		complete = true;
+	} else
+	    complete = true;
+	String in = conn->in_text.take_string();
+	if (in.find_left("\r\n\r\n") >= 0 || in.find_left("\n\n") >= 0
+	    || (in && in.find_left("HTTP/") < 0 && in.back() == '\n')
+	    || in.length() >= 8192)
+	    complete = true;
+	if (!complete) {
+	    conn->in_text << in;
+	    return;
+	}
+	conn->out_text = make_response(in);
+	conn->outpos = 0;
+	remove_select(conn->fd, SELECT_READ);
+	add_select(conn->fd, SELECT_WRITE);
+    }
+
+    // write the response, then close
+    while (conn->outpos < conn->out_text.length()) {
+	ssize_t w = write(conn->fd, conn->out_text.data() + conn->outpos,
+			  conn->out_text.length() - conn->outpos);
+	if (w > 0)
+	    conn->outpos += w;
+	else if (w == -1 && (errno == EAGAIN || errno == EINTR))
+	    return;
+	else
+	    break;
+    }
+    close_connection(conn);
+}
+
+String
+MetricsExporter::read_handler(Element *e, void *thunk)
+{
+    MetricsExporter *me = static_cast<MetricsExporter *>(e);
+    if (thunk)
+	return String(me->_sources.size());
+    else
+	return me->_snapshot;
+}
+
+int
+MetricsExporter::write_handler(const String &, Element *e, void *, ErrorHandler *)
+{
+    static_cast<MetricsExporter *>(e)->update();
+    return 0;
+}
+
+void
+MetricsExporter::add_handlers()
+{
+    add_read_handler("metrics", read_handler, 0, Handler::f_raw);
+    add_read_handler("nmetrics", read_handler, 1);
+    add_write_handler("update", write_handler, 0, Handler::f_button);
+    if (_type == type_tcp)
+	add_data_handlers("port", Handler::f_read, &_pathname);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel)
+EXPORT_ELEMENT(MetricsExporter)
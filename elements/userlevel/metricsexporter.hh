@@ -0,0 +1,189 @@
+#ifndef CLICK_METRICSEXPORTER_HH
+#define CLICK_METRICSEXPORTER_HH
+#include <click/element.hh>
+#include <click/timer.hh>
+#include <click/straccum.hh>
+#include <click/hashtable.hh>
+CLICK_DECLS
+
+/*
+=c
+
+MetricsExporter([TYPE, PORT or FILENAME, I<keywords INTERVAL, FORMAT, HANDLERS, PREFIX, LOCALHOST, VERBOSE>])
+
+=s control
+
+exports numeric handler values in Prometheus text format
+
+=d
+
+Periodically collects the values of numeric read handlers from the elements
+in the router, and serves the resulting snapshot in Prometheus text
+exposition format or OpenMetrics format.
+
+Handlers are selected by name, from the HANDLERS patterns, and are never read
+unless selected, since reading some handlers has side effects. Handlers marked
+as raw, expensive, deprecated, or private are skipped, as are the default
+C<name>, C<class>, C<config>, C<ports>, and C<handlers> handlers. Without
+HANDLERS, the selected handlers are the usual statistics: C<count>,
+C<*_count>, C<rate>, C<*_rate>, C<drops>, C<*_drops>, C<length>,
+C<highwater_length>, C<capacity>, and C<nmappings>. Examples include Counter's
+C<count> and C<byte_count>, Queue's C<drops> and C<highwater_length>,
+AverageCounter's C<rate>, and IPRewriter's C<nmappings>.
+
+Every INTERVAL, a timer selects the handlers again, so handlers added since
+the last snapshot are picked up, then reads them and stores the formatted
+result. A selected handler whose value is not a number is left out of that
+snapshot. Clients never call handlers directly: socket requests and the
+C<metrics> handler return the most recent snapshot.
+
+Metric names are PREFIX followed by the handler name, with characters other
+than letters, digits, and underscores replaced by underscores. Each sample is
+labeled with the element's name and class, as in
+C<click_count{element="c",class="Counter"} 10>.
+
+If TYPE is given, MetricsExporter listens on a socket. TYPE may be "TCP",
+followed by a port number, or "UNIX", followed by a filename. Each connection
+receives the current snapshot and is then closed. If the client sends an HTTP
+request, the snapshot is wrapped in a minimal HTTP/1.0 response, so a
+Prometheus server can scrape the socket directly.
+
+Keyword arguments are:
+
+=over 8
+
+=item INTERVAL
+
+Time. How often to refresh the snapshot. Default is 1 second.
+
+=item FORMAT
+
+Either C<prometheus> or C<openmetrics>. Default is C<prometheus>.
+
+=item HANDLERS
+
+Space-separated list of glob patterns. Matching handlers are exported. A
+pattern containing a period is matched against C<I<element>.I<handler>>; other
+patterns are matched against the handler name alone. Default is the usual
+statistics handlers listed above.
+
+=item PREFIX
+
+String. Prefix for metric names. Default is C<click_>.
+
+=item LOCALHOST
+
+Boolean. When true, a TCP MetricsExporter only accepts connections from the
+local host. Default is false.
+
+=item VERBOSE
+
+Boolean. When true, report opened and closed connections. Default is false.
+
+=back
+
+MetricsExporter is only available in user-level processes.
+
+=e
+
+  c :: Counter;
+  MetricsExporter(TCP, 9100, INTERVAL 5s, HANDLERS "count byte_count drops");
+
+=h metrics r
+
+Returns the current snapshot.
+
+=h nmetrics r
+
+Returns the number of selected handlers.
+
+=h update w
+
+Refreshes the snapshot immediately.
+
+=h port r
+
+Returns the TCP port number.  Only available for TYPE TCP.
+
+=a ControlSocket, Counter, Queue */
+
+class MetricsExporter : public Element { public:
+
+    MetricsExporter() CLICK_COLD;
+    ~MetricsExporter() CLICK_COLD;
+
+    const char *class_name() const	{ return "MetricsExporter"; }
+
+    int configure(Vector<String> &conf, ErrorHandler *) CLICK_COLD;
+    int initialize(ErrorHandler *) CLICK_COLD;
+    void cleanup(CleanupStage) CLICK_COLD;
+    void add_handlers() CLICK_COLD;
+
+    void run_timer(Timer *);
+    void selected(int fd, int mask);
+
+  private:
+
+    enum { type_none, type_tcp, type_unix };
+    enum { format_prometheus, format_openmetrics };
+
+    struct source {
+	Element *e;
+	int hindex;
+	source(Element *e_, int hindex_)
+	    : e(e_), hindex(hindex_) {
+	}
+    };
+
+    struct family {
+	String name;
+	Vector<int> sources;
+	family(const String &name_)
+	    : name(name_) {
+	}
+    };
+
+    struct connection {
+	int fd;
+	StringAccum in_text;
+	String out_text;
+	int outpos;
+	connection(int fd_)
+	    : fd(fd_), outpos(-1) {
+	}
+    };
+
+    String _pathname;
+    int _socket_fd;
+    uint8_t _type;
+    uint8_t _format;
+    bool _localhost;
+    bool _verbose;
+    String _prefix;
+    Vector<String> _patterns;
+    Timestamp _interval;
+    Timer _timer;
+
+    Vector<source> _sources;
+    Vector<family> _families;
+    String _snapshot;
+
+    Vector<connection *> _conns;
+
+    int initialize_socket(ErrorHandler *);
+    void close_connection(connection *conn);
+    String make_response(const String &request) const;
+
+    bool pattern_match(Element *e, const String &hname) const;
+    String metric_name(const String &hname) const;
+    static bool numeric_value(const String &s, String &value);
+    void discover();
+    void update();
+
+    static String read_handler(Element *, void *) CLICK_COLD;
+    static int write_handler(const String &, Element *, void *, ErrorHandler *) CLICK_COLD;
+
+};
+
+CLICK_ENDDECLS
+#endif
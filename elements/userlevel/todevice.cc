@@ -290,6 +290,21 @@ ToDevice::cleanup(CleanupStage)
  * timer if buffers are not available.
  * --jbicket
  */
+inline bool
+ToDevice::can_gather(const Packet *p) const
+{
+#if TODEVICE_ALLOW_LINUX
+    if (_method == method_linux) {
+	int n = 0;
+	for (; p && n <= max_segments; p = p->next_segment())
+	    ++n;
+	return n <= max_segments;
+    }
+#endif
+    (void) p;
+    return false;
+}
+
 int
 ToDevice::send_packet(Packet *p)
 {
@@ -317,8 +332,20 @@ ToDevice::send_packet(Packet *p)
 #endif
 
 #if TODEVICE_ALLOW_LINUX
-    if (_method == method_linux)
+    if (_method == method_linux && !p->has_segments())
 	r = send(_fd, p->data(), p->length(), 0);
+    else if (_method == method_linux) {
+	// gather the data segments
+	struct iovec iov[max_segments];
+	struct msghdr msg;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = iov;
+	for (const Packet *s = p; s; s = s->next_segment(), ++msg.msg_iovlen) {
+	    iov[msg.msg_iovlen].iov_base = const_cast<unsigned char *>(s->data());
+	    iov[msg.msg_iovlen].iov_len = s->length();
+	}
+	r = sendmsg(_fd, &msg, 0);
+    }
 #endif
 
 #if TODEVICE_ALLOW_DEVBPF
@@ -351,6 +378,8 @@ ToDevice::run_task(Task *)
 	    ++_pulls;
 	    if (!(p = input(0).pull()))
 		break;
+	    if (p->has_segments() && !can_gather(p) && !(p = p->linearize()))
+		continue;
 	}
 	if ((r = send_packet(p)) >= 0) {
 	    _backoff = 0;
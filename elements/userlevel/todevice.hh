@@ -58,6 +58,10 @@ CLICK_DECLS
  *
  * Packets that are written successfully are sent on output 0, if it exists.
  * Packets that fail to be written are pushed out output 1, if it exists.
+ *
+ * The LINUX method sends packets made of up to 16 data segments, such as
+ * those from Tee's SPLIT mode or GROCoalescer's SEGMENTS mode, without
+ * copying them.  Other methods copy segmented packets into one buffer first.
 
  * KernelTun lets you send IP packets to the host kernel's IP processing code,
  * sort of like the kernel module's ToHost element.
@@ -91,7 +95,7 @@ class ToDevice : public Element { public:
     const char *class_name() const		{ return "ToDevice"; }
     const char *port_count() const		{ return "1/0-2"; }
     const char *processing() const		{ return "l/h"; }
-    const char *flags() const			{ return "S2"; }
+    const char *flags() const			{ return "S2 D"; }
 
     int configure_phase() const { return KernelFilter::CONFIGURE_PHASE_TODEVICE; }
     int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
@@ -138,7 +142,9 @@ class ToDevice : public Element { public:
     int _pulls;
 
     enum { h_debug, h_signal, h_pulls, h_q };
+    enum { max_segments = 16 };
     FromDevice *find_fromdevice() const;
+    inline bool can_gather(const Packet *p) const;
     int send_packet(Packet *p);
     static int write_param(const String &in_s, Element *e, void *vparam, ErrorHandler *errh) CLICK_COLD;
     static String read_param(Element *e, void *thunk) CLICK_COLD;
@@ -221,15 +221,20 @@ ToDump::write_packet(Packet *p)
     ph.ts.tv.tv_sec = ts.sec();
     ph.ts.tv.tv_usec = _nano ? ts.nsec() : ts.usec();
 
-    unsigned to_write = p->length();
+    unsigned to_write = p->total_length();
     ph.len = to_write + (_extra_length ? EXTRA_LENGTH_ANNO(p) : 0);
     if (_snaplen && to_write > _snaplen)
 	to_write = _snaplen;
     ph.caplen = to_write;
 
     // XXX writing to pipe?
-    if (fwrite(&ph, sizeof(ph), 1, _fp) == 0
-	|| (to_write > 0 && fwrite(p->data(), 1, to_write, _fp) == 0)) {
+    bool ok = fwrite(&ph, sizeof(ph), 1, _fp) != 0;
+    for (const Packet *s = p; ok && to_write > 0 && s; s = s->next_segment()) {
+	unsigned len = s->length() < to_write ? s->length() : to_write;
+	ok = len == 0 || fwrite(s->data(), 1, len, _fp) != 0;
+	to_write -= len;
+    }
+    if (!ok) {
 	if (errno != EAGAIN) {
 	    _active = false;
 	    click_chatter("ToDump(%s): %s", _filename.c_str(), strerror(errno));
@@ -102,7 +102,7 @@ class ToDump : public Element { public:
 
     const char *class_name() const	{ return "ToDump"; }
     const char *port_count() const	{ return "1/0-1"; }
-    const char *flags() const		{ return "S2"; }
+    const char *flags() const		{ return "S2 D"; }
 
     // configure after FromDevice and FromDump
     int configure_phase() const		{ return CONFIGURE_PHASE_DEFAULT+100; }
@@ -23,11 +23,19 @@
 #include <click/glue.hh>
 #include <elements/wifi/path.hh>
 #include <click/straccum.hh>
+#include <click/heap.hh>
 CLICK_DECLS
 
 LinkTable::LinkTable()
-  : _timer(this)
+  : dijkstra_full_count(0), dijkstra_incremental_count(0),
+    _timer(this), _sp_index(-1), _sp_root(-1), _sp_topology_dirty(true),
+    _version(1)
 {
+  for (int d = 0; d < 2; d++) {
+    _sp_full_needed[d] = true;
+    _sp_version[d] = 0;
+    _route_version[d] = 1;
+  }
 }
 
 
@@ -77,6 +85,7 @@ LinkTable::configure (Vector<String> &conf, ErrorHandler *errh)
   _stale_timeout.assign(stale_period, 0);
 
   _hosts.insert(_ip, HostInfo(_ip));
+  sp_topology_changed();
   return ret;
 }
 
@@ -88,6 +97,7 @@ LinkTable::take_state(Element *e, ErrorHandler *) {
 
   _hosts = q->_hosts;
   _links = q->_links;
+  sp_topology_changed();
   dijkstra(true);
   dijkstra(false);
 }
@@ -137,7 +147,7 @@ LinkTable::clear()
 {
   _hosts.clear();
   _links.clear();
-
+  sp_topology_changed();
 }
 bool
 LinkTable::update_link(IPAddress from, IPAddress to,
@@ -170,8 +180,22 @@ LinkTable::update_link(IPAddress from, IPAddress to,
   LinkInfo *lnfo = _links.findp(p);
   if (!lnfo) {
     _links.insert(p, LinkInfo(from, to, seq, age, metric));
+    sp_topology_changed();
   } else {
+    unsigned old_metric = lnfo->_metric;
     lnfo->update(seq, age, metric);
+    if (lnfo->_metric != old_metric) {
+      /* remember the change so dijkstra() can repair the trees */
+      ++_version;
+      if (_sp_change.size() > 64 + _sp_host.size() / 8) {
+	_sp_full_needed[0] = _sp_full_needed[1] = true;
+	_sp_change.clear();
+	_sp_change_version.clear();
+      } else {
+	_sp_change.push_back(p);
+	_sp_change_version.push_back(_version);
+      }
+    }
   }
   return true;
 }
@@ -344,6 +368,17 @@ LinkTable::best_route(IPAddress dst, bool from_me)
   if (!dst) {
     return reverse_route;
   }
+
+  CachedRoute *cr = _route_cache[from_me].findp(dst);
+  if (cr && cr->_version == _route_version[from_me]) {
+    return cr->_route;
+  }
+  if (!cr) {
+    _route_cache[from_me].insert(dst, CachedRoute());
+    cr = _route_cache[from_me].findp(dst);
+  }
+  cr->_version = _route_version[from_me];
+
   HostInfo *nfo = _hosts.findp(dst);
 
   if (from_me) {
@@ -371,9 +406,11 @@ LinkTable::best_route(IPAddress dst, bool from_me)
 	  for (int i=reverse_route.size() - 1; i >= 0; i--) {
 		  route.push_back(reverse_route[i]);
 	  }
+	  cr->_route = route;
 	  return route;
   }
 
+  cr->_route = reverse_route;
   return reverse_route;
 }
 
@@ -458,12 +495,11 @@ LinkTable::print_hosts()
 void
 LinkTable::clear_stale() {
 
-  LTable links;
+  Vector<IPPair> stale;
   for (LTIter iter = _links.begin(); iter.live(); iter++) {
     LinkInfo nfo = iter.value();
-    if ((unsigned) _stale_timeout.sec() >= nfo.age()) {
-      links.insert(IPPair(nfo._from, nfo._to), nfo);
-    } else {
+    if ((unsigned) _stale_timeout.sec() < nfo.age()) {
+      stale.push_back(iter.key());
       if (0) {
 	click_chatter("%p{element} :: %s removing link %s -> %s metric %d seq %d age %d\n",
 		      this,
@@ -476,13 +512,15 @@ LinkTable::clear_stale() {
       }
     }
   }
-  _links.clear();
 
-  for (LTIter iter = links.begin(); iter.live(); iter++) {
-    LinkInfo nfo = iter.value();
-    _links.insert(IPPair(nfo._from, nfo._to), nfo);
+  /* leave the table, and the shortest-path state, alone unless some link
+     actually went stale */
+  for (int i = 0; i < stale.size(); i++) {
+    _links.erase(stale[i]);
+  }
+  if (stale.size()) {
+    sp_topology_changed();
   }
-
 }
 
 Vector<IPAddress>
@@ -490,137 +528,292 @@ LinkTable::get_neighbors(IPAddress ip)
 {
   Vector<IPAddress> neighbors;
 
-  typedef HashMap<IPAddress, bool> IPMap;
-  IPMap ip_addrs;
-
-  for (HTIter iter = _hosts.begin(); iter.live(); iter++) {
-    ip_addrs.insert(iter.value()._ip, true);
+  if (_sp_topology_dirty) {
+    sp_rebuild();
   }
-
-  for (IPMap::const_iterator i = ip_addrs.begin(); i.live(); i++) {
-    HostInfo *neighbor = _hosts.findp(i.key());
-    assert(neighbor);
-    if (ip != neighbor->_ip) {
-      LinkInfo *lnfo = _links.findp(IPPair(ip, neighbor->_ip));
-      if (lnfo) {
-	neighbors.push_back(neighbor->_ip);
-      }
+  int i = _sp_index.find(ip);
+  if (i >= 0) {
+    for (int e = _sp_start[1][i]; e < _sp_start[1][i + 1]; e++) {
+      neighbors.push_back(_sp_host[_sp_edges[1][e]._target]->_ip);
     }
-
   }
 
   return neighbors;
 }
+
 void
-LinkTable::dijkstra(bool from_me)
+LinkTable::sp_topology_changed()
 {
-  Timestamp start = Timestamp::now();
-  IPAddress src = _ip;
-
-  typedef HashMap<IPAddress, bool> IPMap;
-  IPMap ip_addrs;
+  _sp_topology_dirty = true;
+  ++_version;
+  _sp_change.clear();
+  _sp_change_version.clear();
+}
 
+void
+LinkTable::sp_rebuild()
+{
+  _sp_index.clear();
+  _sp_host.clear();
   for (HTIter iter = _hosts.begin(); iter.live(); iter++) {
-    ip_addrs.insert(iter.value()._ip, true);
+    _sp_index.insert(iter.key(), _sp_host.size());
+    _sp_host.push_back(_hosts.findp(iter.key()));
   }
+  _sp_root = _sp_index.find(_ip);
 
-  for (IPMap::const_iterator i = ip_addrs.begin(); i.live(); i++) {
-    /* clear them all initially */
-    HostInfo *n = _hosts.findp(i.key());
-    n->clear(from_me);
+  /* lay out the links as two compact adjacency arrays: direction 1 indexed
+     by source, direction 0 indexed by destination */
+  int n = _sp_host.size();
+  for (int d = 0; d < 2; d++) {
+    _sp_start[d].assign(n + 1, 0);
+    _sp_edges[d].clear();
+  }
+  for (LTIter iter = _links.begin(); iter.live(); iter++) {
+    int a = _sp_index.find(iter.key()._from);
+    int b = _sp_index.find(iter.key()._to);
+    if (a >= 0 && b >= 0 && a != b) {
+      _sp_start[1][a + 1]++;
+      _sp_start[0][b + 1]++;
+    }
+  }
+  for (int d = 0; d < 2; d++) {
+    for (int i = 0; i < n; i++) {
+      _sp_start[d][i + 1] += _sp_start[d][i];
+    }
+    _sp_edges[d].assign(_sp_start[d][n], SPEdge(-1, 0));
+  }
+  Vector<int> fill[2];
+  fill[0] = _sp_start[0];
+  fill[1] = _sp_start[1];
+  for (LTIter iter = _links.begin(); iter.live(); iter++) {
+    int a = _sp_index.find(iter.key()._from);
+    int b = _sp_index.find(iter.key()._to);
+    if (a >= 0 && b >= 0 && a != b) {
+      LinkInfo *lnfo = _links.findp(iter.key());
+      _sp_edges[1][fill[1][a]++] = SPEdge(b, lnfo);
+      _sp_edges[0][fill[0][b]++] = SPEdge(a, lnfo);
+    }
   }
-  HostInfo *root_info = _hosts.findp(src);
-
 
-  assert(root_info);
+  for (int d = 0; d < 2; d++) {
+    _sp_full_needed[d] = true;
+    _route_cache[d].clear();
+  }
+  _sp_change.clear();
+  _sp_change_version.clear();
+  _sp_topology_dirty = false;
+}
 
-  if (from_me) {
-    root_info->_prev_from_me = root_info->_ip;
-    root_info->_metric_from_me = 0;
-  } else {
-    root_info->_prev_to_me = root_info->_ip;
-    root_info->_metric_to_me = 0;
+void
+LinkTable::sp_run(int d, Vector<uint64_t> &heap, Vector<int> &changed)
+{
+  Vector<uint32_t> &dist = _sp_dist[d];
+  Vector<int> &prev = _sp_prev[d];
+  const Vector<int> &start = _sp_start[d];
+  const Vector<SPEdge> &edges = _sp_edges[d];
+
+  while (heap.size()) {
+    uint64_t top = heap[0];
+    pop_heap(heap.begin(), heap.end(), less<uint64_t>());
+    heap.pop_back();
+    uint32_t current = top >> 32;
+    int u = (int) (top & 0xFFFFFFFFU);
+    if (current != dist[u]) {
+      continue;		/* stale heap entry */
+    }
+    for (int e = start[u]; e < start[u + 1]; e++) {
+      const SPEdge &edge = edges[e];
+      uint32_t metric = edge._link->_metric;
+      if (!metric) {
+	continue;
+      }
+      uint32_t adjusted_metric = current + metric;
+      if (adjusted_metric < dist[edge._target]) {
+	dist[edge._target] = adjusted_metric;
+	prev[edge._target] = u;
+	changed.push_back(edge._target);
+	heap.push_back(((uint64_t) adjusted_metric << 32) | edge._target);
+	push_heap(heap.begin(), heap.end(), less<uint64_t>());
+      }
+    }
   }
+}
+
+void
+LinkTable::sp_full(int d, Vector<int> &changed)
+{
+  int n = _sp_host.size();
+  _sp_dist[d].assign(n, sp_infinity);
+  _sp_prev[d].assign(n, -1);
+  changed.clear();
+  for (int i = 0; i < n; i++) {
+    changed.push_back(i);
+  }
+  if (_sp_root < 0) {
+    return;
+  }
+
+  Vector<uint64_t> heap;
+  Vector<int> ignored;
+  _sp_dist[d][_sp_root] = 0;
+  heap.push_back(_sp_root);
+  sp_run(d, heap, ignored);
+}
 
-  IPAddress current_min_ip = root_info->_ip;
+void
+LinkTable::sp_repair(int d, int x, int y, uint32_t metric, Vector<int> &changed)
+{
+  /* The metric of the link relaxed from x to y changed. */
+  Vector<uint32_t> &dist = _sp_dist[d];
+  Vector<int> &prev = _sp_prev[d];
+  Vector<uint64_t> heap;
+
+  if (dist[x] == sp_infinity) {
+    return;
+  }
+  uint32_t adjusted_metric = (metric ? dist[x] + metric : sp_infinity);
+  if (adjusted_metric < dist[y]) {
+    /* better path: propagate the improvement downstream */
+    dist[y] = adjusted_metric;
+    prev[y] = x;
+    changed.push_back(y);
+    heap.push_back(((uint64_t) adjusted_metric << 32) | y);
+    sp_run(d, heap, changed);
+    return;
+  } else if (prev[y] != x || adjusted_metric == dist[y]) {
+    return;
+  }
+
+  /* a tree link got worse: collect the subtree hanging from it */
+  Vector<int> subtree;
+  subtree.push_back(y);
+  for (int i = 0; i < subtree.size(); i++) {
+    int u = subtree[i];
+    for (int e = _sp_start[d][u]; e < _sp_start[d][u + 1]; e++) {
+      int v = _sp_edges[d][e]._target;
+      if (prev[v] == u) {
+	subtree.push_back(v);
+      }
+    }
+  }
+  for (int i = 0; i < subtree.size(); i++) {
+    dist[subtree[i]] = sp_infinity;
+    prev[subtree[i]] = -1;
+    changed.push_back(subtree[i]);
+  }
+
+  /* reattach each subtree node through its best link from outside the
+     subtree, then let Dijkstra settle the subtree */
+  const Vector<int> &rstart = _sp_start[1 - d];
+  const Vector<SPEdge> &redges = _sp_edges[1 - d];
+  for (int i = 0; i < subtree.size(); i++) {
+    int v = subtree[i];
+    for (int e = rstart[v]; e < rstart[v + 1]; e++) {
+      int u = redges[e]._target;
+      uint32_t m = redges[e]._link->_metric;
+      if (m && dist[u] != sp_infinity && dist[u] + m < dist[v]) {
+	dist[v] = dist[u] + m;
+	prev[v] = u;
+      }
+    }
+    if (dist[v] != sp_infinity) {
+      heap.push_back(((uint64_t) dist[v] << 32) | v);
+      push_heap(heap.begin(), heap.end(), less<uint64_t>());
+    }
+  }
+  sp_run(d, heap, changed);
+}
 
-  while (current_min_ip) {
-    HostInfo *current_min = _hosts.findp(current_min_ip);
-    assert(current_min);
+void
+LinkTable::sp_write_back(int d, const Vector<int> &changed)
+{
+  if (!changed.size()) {
+    return;
+  }
+  bool from_me = d;
+  for (int i = 0; i < changed.size(); i++) {
+    int x = changed[i];
+    HostInfo *nfo = _sp_host[x];
+    uint32_t metric = _sp_dist[d][x];
+    IPAddress prev;
+    if (x == _sp_root) {
+      prev = nfo->_ip;
+    } else if (_sp_prev[d][x] >= 0) {
+      prev = _sp_host[_sp_prev[d][x]]->_ip;
+    }
+    bool marked = (metric != sp_infinity);
+    if (!marked) {
+      metric = 0;
+    }
     if (from_me) {
-      current_min->_marked_from_me = true;
+      nfo->_metric_from_me = metric;
+      nfo->_prev_from_me = prev;
+      nfo->_marked_from_me = marked;
     } else {
-      current_min->_marked_to_me = true;
+      nfo->_metric_to_me = metric;
+      nfo->_prev_to_me = prev;
+      nfo->_marked_to_me = marked;
     }
+  }
+  ++_route_version[d];
+}
 
+void
+LinkTable::dijkstra(bool from_me)
+{
+  int d = from_me;
+  if (_sp_topology_dirty) {
+    sp_rebuild();
+  }
+  if (!_sp_full_needed[d] && _sp_version[d] == _version) {
+    return;
+  }
 
-    for (IPMap::const_iterator i = ip_addrs.begin(); i.live(); i++) {
-      HostInfo *neighbor = _hosts.findp(i.key());
-      assert(neighbor);
-      bool marked = neighbor->_marked_to_me;
-      if (from_me) {
-	marked = neighbor->_marked_from_me;
-      }
-
-      if (marked) {
+  Timestamp start = Timestamp::now();
+  Vector<int> changed;
+  if (_sp_full_needed[d]) {
+    sp_full(d, changed);
+    dijkstra_full_count++;
+  } else {
+    for (int i = 0; i < _sp_change.size(); i++) {
+      if (_sp_change_version[i] <= _sp_version[d]) {
 	continue;
       }
-
-      IPPair pair = IPPair(neighbor->_ip, current_min_ip);
-      if (from_me) {
-	pair = IPPair(current_min_ip, neighbor->_ip);
-      }
-      LinkInfo *lnfo = _links.findp(pair);
-      if (!lnfo || !lnfo->_metric) {
+      int a = _sp_index.find(_sp_change[i]._from);
+      int b = _sp_index.find(_sp_change[i]._to);
+      LinkInfo *lnfo = _links.findp(_sp_change[i]);
+      if (a < 0 || b < 0 || a == b || !lnfo) {
 	continue;
       }
-      uint32_t neighbor_metric = neighbor->_metric_to_me;
-      uint32_t current_metric = current_min->_metric_to_me;
-
       if (from_me) {
-	neighbor_metric = neighbor->_metric_from_me;
-	current_metric = current_min->_metric_from_me;
-      }
-
-
-      uint32_t adjusted_metric = current_metric + lnfo->_metric;
-      if (!neighbor_metric ||
-	  adjusted_metric < neighbor_metric) {
-	if (from_me) {
-	  neighbor->_metric_from_me = adjusted_metric;
-	  neighbor->_prev_from_me = current_min_ip;
-	} else {
-	  neighbor->_metric_to_me = adjusted_metric;
-	  neighbor->_prev_to_me = current_min_ip;
-	}
-
+	sp_repair(d, a, b, lnfo->_metric, changed);
+      } else {
+	sp_repair(d, b, a, lnfo->_metric, changed);
       }
     }
+    dijkstra_incremental_count++;
+  }
+  _sp_full_needed[d] = false;
+  _sp_version[d] = _version;
 
-    current_min_ip = IPAddress();
-    uint32_t  min_metric = ~0;
-    for (IPMap::const_iterator i = ip_addrs.begin(); i.live(); i++) {
-      HostInfo *nfo = _hosts.findp(i.key());
-      uint32_t metric = nfo->_metric_to_me;
-      bool marked = nfo->_marked_to_me;
-      if (from_me) {
-	metric = nfo->_metric_from_me;
-	marked = nfo->_marked_from_me;
-      }
-      if (!marked && metric &&
-	  metric < min_metric) {
-        current_min_ip = nfo->_ip;
-        min_metric = metric;
-      }
+  /* forget changes that both directions have seen */
+  uint32_t seen = _version;
+  for (int e = 0; e < 2; e++) {
+    if (!_sp_full_needed[e] && _sp_version[e] < seen) {
+      seen = _sp_version[e];
     }
-
-
+  }
+  int n = 0;
+  while (n < _sp_change.size() && _sp_change_version[n] <= seen) {
+    n++;
+  }
+  if (n) {
+    _sp_change.erase(_sp_change.begin(), _sp_change.begin() + n);
+    _sp_change_version.erase(_sp_change_version.begin(), _sp_change_version.begin() + n);
   }
 
+  sp_write_back(d, changed);
   dijkstra_time = Timestamp::now() - start;
-  //StringAccum sa;
-  //sa << "dijstra took " << finish - start;
-  //click_chatter("%s: %s\n", name().c_str(), sa.take_string().c_str());
 }
 
 
@@ -635,7 +828,8 @@ enum {H_BLACKLIST,
       H_HOSTS,
       H_CLEAR,
       H_DIJKSTRA,
-      H_DIJKSTRA_TIME};
+      H_DIJKSTRA_TIME,
+      H_DIJKSTRA_STATS};
 
 static String
 LinkTable_read_param(Element *e, void *thunk)
@@ -663,6 +857,12 @@ LinkTable_read_param(Element *e, void *thunk)
       sa << td->dijkstra_time << "\n";
       return sa.take_string();
     }
+    case H_DIJKSTRA_STATS: {
+      StringAccum sa;
+      sa << "full " << td->dijkstra_full_count
+	 << "\nincremental " << td->dijkstra_incremental_count << "\n";
+      return sa.take_string();
+    }
     default:
       return String();
     }
@@ -709,6 +909,7 @@ LinkTable::add_handlers() {
   add_read_handler("hosts", LinkTable_read_param, H_HOSTS);
   add_read_handler("blacklist", LinkTable_read_param, H_BLACKLIST);
   add_read_handler("dijkstra_time", LinkTable_read_param, H_DIJKSTRA_TIME);
+  add_read_handler("dijkstra_stats", LinkTable_read_param, H_DIJKSTRA_STATS);
 
   add_write_handler("clear", LinkTable_write_param, H_CLEAR);
   add_write_handler("blacklist_clear", LinkTable_write_param, H_BLACKLIST_CLEAR);
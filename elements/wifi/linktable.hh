@@ -17,6 +17,16 @@ CLICK_DECLS
  * for other elements
  * =d
  * Runs dijkstra's algorithm occasionally.
+ *
+ * Shortest paths are computed over a compact adjacency array that is rebuilt
+ * only when hosts or links are added or removed.  When only link metrics
+ * change, dijkstra() repairs the affected subtrees of the existing
+ * shortest-path trees instead of recomputing them, and does nothing at all
+ * if no metric changed since the last call.  best_route() results are cached
+ * and invalidated by per-direction route version numbers.
+ *
+ * =h dijkstra_stats r
+ * Returns the number of full and incremental shortest-path computations.
  * =a ARPTable
  *
  */
@@ -126,6 +136,8 @@ public:
   IPTable _blacklist;
 
   Timestamp dijkstra_time;
+  uint32_t dijkstra_full_count;
+  uint32_t dijkstra_incremental_count;
 protected:
   class LinkInfo {
   public:
@@ -236,6 +248,53 @@ protected:
   IPAddress _ip;
   Timestamp _stale_timeout;
   Timer _timer;
+
+  // Shortest-path state.  Direction 1 is "from me" and relaxes links
+  // (u -> v) from u; direction 0 is "to me" and relaxes links (v -> u) from
+  // u.  Node indexes, adjacency arrays, and HostInfo/LinkInfo pointers stay
+  // valid until _sp_topology_dirty is set.
+  struct SPEdge {
+    int _target;
+    LinkInfo *_link;
+    SPEdge(int target, LinkInfo *link)
+      : _target(target), _link(link) {
+    }
+  };
+
+  struct CachedRoute {
+    uint32_t _version;
+    Path _route;
+    CachedRoute()
+      : _version(0) {
+    }
+  };
+
+  enum { sp_infinity = 0xFFFFFFFFU };
+
+  HashMap<IPAddress, int> _sp_index;
+  Vector<HostInfo *> _sp_host;
+  int _sp_root;
+  Vector<int> _sp_start[2];
+  Vector<SPEdge> _sp_edges[2];
+  Vector<uint32_t> _sp_dist[2];
+  Vector<int> _sp_prev[2];
+  bool _sp_topology_dirty;
+  bool _sp_full_needed[2];
+
+  uint32_t _version;
+  uint32_t _sp_version[2];
+  Vector<uint32_t> _sp_change_version;
+  Vector<IPPair> _sp_change;
+
+  uint32_t _route_version[2];
+  HashMap<IPAddress, CachedRoute> _route_cache[2];
+
+  void sp_rebuild();
+  void sp_run(int d, Vector<uint64_t> &heap, Vector<int> &changed);
+  void sp_full(int d, Vector<int> &changed);
+  void sp_repair(int d, int x, int y, uint32_t metric, Vector<int> &changed);
+  void sp_write_back(int d, const Vector<int> &changed);
+  void sp_topology_changed();
 };
 
 
@@ -230,6 +230,9 @@ class Element { public:
 
         Element* _e;
         int _port;
+#if CLICK_USERLEVEL || CLICK_MINIOS
+        bool _linearize;                // Receiver doesn't handle segments
+#endif
 #if HAVE_BOUND_PORT_TRANSFER
         union {
             void (*push)(Element *e, int port, Packet *p);
@@ -240,13 +243,22 @@ class Element { public:
 #if CLICK_STATS >= 1
         mutable unsigned _packets;      // How many packets have we moved?
 #endif
-#if CLICK_STATS >= 2
+#if CLICK_STATS >= 2 || CLICK_PROFILE
         Element* _owner;                // Whose input or output are we?
 #endif
 
         inline Port();
         inline void assign(bool isoutput, Element *owner, Element *e, int port);
 
+        inline void xfer_push(Packet* p) const;
+        inline Packet* xfer_pull() const;
+#if CLICK_PROFILE
+        static volatile uint32_t nprofiling;    // Routers sampling transfers
+        void sampled_push(Packet* p) const;
+        Packet* sampled_pull() const;
+        friend class Profiler;
+#endif
+
         friend class Element;
 
     };
@@ -515,18 +527,24 @@ Element::input_is_push(int port) const
         && !_ports[0][port].active();
 }
 
-#if CLICK_STATS >= 2
-# define PORT_ASSIGN(o) _packets = 0; _owner = (o)
-#elif CLICK_STATS >= 1
-# define PORT_ASSIGN(o) _packets = 0; (void) (o)
+#if CLICK_STATS >= 2 || CLICK_PROFILE
+# define PORT_ASSIGN_OWNER(o) _owner = (o)
+#else
+# define PORT_ASSIGN_OWNER(o) (void) (o)
+#endif
+#if CLICK_STATS >= 1
+# define PORT_ASSIGN(o) _packets = 0; PORT_ASSIGN_OWNER(o)
 #else
-# define PORT_ASSIGN(o) (void) (o)
+# define PORT_ASSIGN(o) PORT_ASSIGN_OWNER(o)
 #endif
 
 inline
 Element::Port::Port()
     : _e(0), _port(-2)
 {
+#if CLICK_USERLEVEL || CLICK_MINIOS
+    _linearize = true;
+#endif
     PORT_ASSIGN(0);
 }
 
@@ -536,6 +554,10 @@ Element::Port::assign(bool isoutput, Element *e, int port)
     _e = e;
     _port = port;
     (void) isoutput;
+#if CLICK_USERLEVEL || CLICK_MINIOS
+    // A pull input's receiver is its owner; see the other assign().
+    _linearize = !isoutput || !e || e->flag_value('D') < 0;
+#endif
 #if HAVE_BOUND_PORT_TRANSFER
     if (e) {
         if (isoutput) {
@@ -554,6 +576,10 @@ Element::Port::assign(bool isoutput, Element *owner, Element *e, int port)
 {
     PORT_ASSIGN(owner);
     assign(isoutput, e, port);
+#if CLICK_USERLEVEL || CLICK_MINIOS
+    if (!isoutput)
+        _linearize = !owner || owner->flag_value('D') < 0;
+#endif
 }
 
 /** @brief Returns whether this port is active (a push output or a pull input).
@@ -599,16 +625,39 @@ Element::Port::port() const
  * downstream.  To push a copy and keep a copy, see Packet::clone().
  *
  * output(i).push(p) basically behaves like the following code, although it
- * maintains additional statistics depending on how CLICK_STATS is defined:
+ * maintains additional statistics depending on how CLICK_STATS is defined,
+ * and, when Click is configured with --enable-profile and the router's
+ * profile_sample handler is nonzero, occasionally times the transfer:
  *
  * @code
  * output(i).element()->push(output(i).port(), p);
  * @endcode
+ *
+ * If @a p has data segments (Packet::has_segments()) and the receiving
+ * element's flags() lack <tt>D</tt>, push() first makes @a p contiguous
+ * with Packet::linearize(), dropping it if that fails.
  */
 inline void
 Element::Port::push(Packet* p) const
 {
     assert(_e && p);
+#if CLICK_USERLEVEL || CLICK_MINIOS
+    if (unlikely(p->has_segments()) && _linearize && !(p = p->linearize()))
+        return;
+#endif
+#if CLICK_PROFILE
+    if (unlikely(nprofiling)) {
+        sampled_push(p);
+        return;
+    }
+#endif
+    xfer_push(p);
+}
+
+/** @cond never */
+inline void
+Element::Port::xfer_push(Packet* p) const
+{
 #if CLICK_STATS >= 1
     ++_packets;
 #endif
@@ -634,6 +683,7 @@ Element::Port::push(Packet* p) const
 # endif
 #endif
 }
+/** @endcond never */
 
 /** @brief Pull a packet over this port and return it.
  *
@@ -645,16 +695,38 @@ Element::Port::push(Packet* p) const
  * code like @link Element::input input(i) @endlink .pull().
  *
  * input(i).pull() basically behaves like the following code, although it
- * maintains additional statistics depending on how CLICK_STATS is defined:
+ * maintains additional statistics depending on how CLICK_STATS is defined,
+ * and may be timed like push():
  *
  * @code
  * input(i).element()->pull(input(i).port())
  * @endcode
+ *
+ * As with push(), a packet with data segments is made contiguous unless
+ * the pulling element's flags() include <tt>D</tt>.
  */
 inline Packet*
 Element::Port::pull() const
 {
     assert(_e);
+    Packet *p;
+#if CLICK_PROFILE
+    if (unlikely(nprofiling))
+        p = sampled_pull();
+    else
+#endif
+    p = xfer_pull();
+#if CLICK_USERLEVEL || CLICK_MINIOS
+    if (p && unlikely(p->has_segments()) && _linearize)
+        p = p->linearize();
+#endif
+    return p;
+}
+
+/** @cond never */
+inline Packet*
+Element::Port::xfer_pull() const
+{
 #if CLICK_STATS >= 2
     click_cycles_t start_cycles = click_get_cycles(),
         old_child_cycles = _e->_child_cycles;
@@ -683,6 +755,7 @@ Element::Port::pull() const
 #endif
     return p;
 }
+/** @endcond never */
 
 /** @brief Push packet @a p to output @a port, or kill it if @a port is out of
  * range.
@@ -725,5 +798,6 @@ Element::checked_input_pull(int port) const
 }
 
 #undef PORT_ASSIGN
+#undef PORT_ASSIGN_OWNER
 CLICK_ENDDECLS
 #endif
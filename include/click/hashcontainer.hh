@@ -3,6 +3,7 @@
 #include <click/glue.hh>
 #include <click/hashcode.hh>
 #include <click/libdivide.h>
+#include <click/machine.hh>
 #if CLICK_DEBUG_HASHMAP
 # define click_hash_assert(x) assert(x)
 #else
@@ -57,7 +58,8 @@ class HashContainer_adapter { public:
 
   Unlike many hash tables HashContainer does not automatically grow itself to
   maintain good lookup performance.  Its users are expected to call rehash()
-  when appropriate.  See unbalanced().
+  when appropriate.  See unbalanced().  OpenHashContainer stores the same
+  elements in an open-addressing table that grows by itself.
 
   With the default adapter type (A), the template type T must:
 
@@ -196,6 +198,32 @@ class HashContainer { public:
      * to find(key).get(). */
     inline T *get(const key_type &key) const;
 
+    /** @brief Prefetch the bucket for @a key.
+     *
+     * Call prefetch() for a key some time before looking it up, for instance
+     * for every packet in a burst before processing the first. */
+    inline void prefetch(const key_type &key) const {
+	click_prefetch0(&_rep.buckets[bucket(key)]);
+    }
+
+    /** @brief Look up @a n keys at once.
+     * @param keys keys to find
+     * @param[out] its its[@em i] is set to find(@a keys[@em i])
+     * @param n number of keys
+     *
+     * find_batch() computes and prefetches every key's bucket before
+     * reading any of them, then prefetches the head of every bucket's chain
+     * before walking any chain.  The lookups' cache misses thus overlap,
+     * rather than each waiting for the last. */
+    void find_batch(const key_type *keys, iterator *its, int n);
+
+    /** @brief Return the elements for @a n keys.
+     * @param keys keys to find
+     * @param[out] result result[@em i] is set to get(@a keys[@em i])
+     * @param n number of keys
+     * @sa find_batch */
+    void get_batch(const key_type *keys, T **result, int n) const;
+
     /** @brief Insert an element at position @a it.
      * @param it iterator
      * @param element element
@@ -590,6 +618,49 @@ inline T *HashContainer<T, A>::get(const key_type &key) const
     return find(key).get();
 }
 
+template <typename T, typename A>
+void HashContainer<T, A>::find_batch(const key_type *keys, iterator *its,
+				     int n)
+{
+    enum { chunk = 16 };
+    bucket_count_type b[chunk];
+    for (; n > 0; keys += chunk, its += chunk, n -= chunk) {
+	int m = n < chunk ? n : chunk;
+	for (int i = 0; i < m; ++i) {
+	    b[i] = bucket(keys[i]);
+	    click_prefetch0(&_rep.buckets[b[i]]);
+	}
+	for (int i = 0; i < m; ++i)
+	    if (T *element = _rep.buckets[b[i]])
+		click_prefetch0(element);
+	for (int i = 0; i < m; ++i) {
+	    T **pprev;
+	    for (pprev = &_rep.buckets[b[i]]; *pprev; pprev = &_rep.hashnext(*pprev))
+		if (_rep.hashkeyeq(_rep.hashkey(*pprev), keys[i]))
+		    break;
+	    if (*pprev)
+		its[i] = iterator(this, b[i], pprev, *pprev);
+	    else
+		its[i] = iterator(this, b[i], &_rep.buckets[b[i]], 0);
+	}
+    }
+}
+
+template <typename T, typename A>
+void HashContainer<T, A>::get_batch(const key_type *keys, T **result,
+				    int n) const
+{
+    enum { chunk = 16 };
+    iterator its[chunk];
+    HashContainer<T, A> *hc = const_cast<HashContainer<T, A> *>(this);
+    for (; n > 0; keys += chunk, result += chunk, n -= chunk) {
+	int m = n < chunk ? n : chunk;
+	hc->find_batch(keys, its, m);
+	for (int i = 0; i < m; ++i)
+	    result[i] = its[i].get();
+    }
+}
+
 template <typename T, typename A>
 T *HashContainer<T, A>::set(iterator &it, T *element, bool balance)
 {
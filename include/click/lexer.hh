@@ -7,6 +7,7 @@
 #include <click/variableenv.hh>
 CLICK_DECLS
 class LexerExtra;
+class RouterImage;
 
 enum Lexemes {
     lexEOF = 0,
@@ -104,6 +105,7 @@ class Lexer { public:
     void ystep();
 
     Router *create_router(Master *);
+    Router *create_router(const RouterImage &image, Master *master, ErrorHandler *errh);
 
   private:
 
@@ -170,7 +172,7 @@ class Lexer { public:
     ParseState *_ps;
     int _group_depth;
 
-    Vector<TunnelEnd *> _tunnels;
+    HashTable<int, TunnelEnd *> _tunnels;
 
     // compound elements
     int _anonymous_offset;
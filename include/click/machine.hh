@@ -79,4 +79,15 @@ inline void click_write_fence() {
 #endif
 }
 
+/** @brief Prefetch the cache line containing @a p for reading.
+
+    A hint only; does nothing on compilers without prefetch support. */
+inline void click_prefetch0(const void *p) {
+#if defined(__GNUC__)
+    __builtin_prefetch(p, 0, 3);
+#else
+    (void) p;
+#endif
+}
+
 #endif
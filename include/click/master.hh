@@ -167,6 +167,23 @@ TimerSet::next_timer_delay(bool more_tasks, Timestamp &t) const
         return 0;
 # endif
 }
+
+/** @brief Return how long the select set should wait, as for
+    TimerSet::next_timer_delay().
+
+    While idle backoff has the thread sleeping, waits despite scheduled
+    tasks, but no longer than the wake latency. */
+inline int
+RouterThread::next_select_delay(Timestamp &t) const
+{
+    bool sleeping = _poll_state == POLL_SLEEP;
+    int delay_type = _timers.next_timer_delay(!sleeping && active(), t);
+    if (sleeping && (delay_type < 0 || (delay_type > 0 && t > _wake_latency))) {
+        t = _wake_latency;
+        delay_type = 1;
+    }
+    return delay_type;
+}
 #endif
 
 inline void
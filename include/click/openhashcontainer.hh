@@ -0,0 +1,773 @@
+#ifndef CLICK_OPENHASHCONTAINER_HH
+#define CLICK_OPENHASHCONTAINER_HH
+#include <click/hashcontainer.hh>
+#include <click/machine.hh>
+CLICK_DECLS
+
+template <typename T, typename A = HashContainer_adapter<T> > class OpenHashContainer_const_iterator;
+template <typename T, typename A = HashContainer_adapter<T> > class OpenHashContainer_iterator;
+template <typename T, typename A = HashContainer_adapter<T> > class OpenHashContainer;
+
+/** @cond never */
+template <typename T>
+struct OpenHashContainer_slot {
+    T *element;
+    uint32_t hash;
+    uint32_t dist;		// 0 if empty, else 1 + distance from home slot
+};
+
+template <typename T>
+struct OpenHashContainer_table {
+    OpenHashContainer_slot<T> *slots;
+    uint32_t capacity;		// number of home slots, a power of 2
+    uint32_t nslots;		// capacity plus overflow slots
+    uint32_t shift;		// home slot is hash >> shift
+};
+
+template <typename T, typename A>
+class OpenHashContainer_rep : public A {
+    OpenHashContainer_table<T> cur;
+    OpenHashContainer_table<T> old;	// table being migrated, if any
+    uint32_t cursor;			// next old slot to migrate
+    size_t size;
+    friend class OpenHashContainer<T, A>;
+    friend class OpenHashContainer_const_iterator<T, A>;
+    friend class OpenHashContainer_iterator<T, A>;
+};
+/** @endcond */
+
+/** @class OpenHashContainer
+  @brief Intrusive open-addressing hash table template.
+
+  OpenHashContainer stores the same kind of elements as HashContainer, and
+  uses the same adapter type, but keeps element pointers in a flat array
+  instead of chaining them through the elements.  Each slot also caches
+  the element's hash value, so a lookup usually touches one or two cache
+  lines of the array and dereferences only the matching element.
+  Elements may still declare a _hashnext member, which OpenHashContainer
+  ignores; this lets a class switch between the two containers by changing
+  a typedef.
+
+  The table uses Robin Hood hashing: an element that is far from its home
+  slot may displace one that is closer to its own, which keeps probe
+  sequences short and lets failed lookups stop early.  Removing an element
+  shifts its successors back, so the table never accumulates tombstones.
+
+  OpenHashContainer grows automatically when it is 7/8 full.  Growth is
+  incremental: a bigger array is allocated, and each later insertion moves a
+  few elements from the old array to the new one.  Lookups check both arrays
+  until the move is finished.
+
+  Unlike HashContainer, OpenHashContainer requires keys to be unique, and
+  insertion invalidates all iterators.  Erasing through an iterator
+  advances that iterator and leaves others unspecified.  Because it needs
+  large contiguous allocations, OpenHashContainer is best suited to user
+  level.
+
+  OpenHashContainer also provides the parts of the HashContainer interface
+  that HashTable uses, so HashTable<K, V, OpenHashContainer> is an
+  open-addressing HashTable.
+*/
+template <typename T, typename A>
+class OpenHashContainer { public:
+
+    /** @brief Key type. */
+    typedef typename A::key_type key_type;
+
+    /** @brief Value type.
+     *
+     * Must meet the HashContainer requirements defined by type A, except
+     * that the hashnext() member is not used. */
+    typedef T value_type;
+
+    /** @brief Type of sizes. */
+    typedef size_t size_type;
+
+    /** @brief Type of bucket counts. */
+    typedef uint32_t bucket_count_type;
+
+    enum {
+	initial_bucket_count = 64,
+	max_bucket_count = 0x40000000,
+	migrate_step = 16
+    };
+
+    /** @brief Construct an empty OpenHashContainer. */
+    OpenHashContainer();
+
+    /** @brief Construct an empty OpenHashContainer with room for at least
+     * @a n elements before growing. */
+    explicit OpenHashContainer(bucket_count_type n);
+
+    /** @brief Destroy the OpenHashContainer. */
+    ~OpenHashContainer();
+
+
+    /** @brief Return the number of elements stored. */
+    inline size_type size() const {
+	return _rep.size;
+    }
+
+    /** @brief Return true iff size() == 0. */
+    inline bool empty() const {
+	return _rep.size == 0;
+    }
+
+    /** @brief Return the number of home slots in the current array. */
+    inline bucket_count_type bucket_count() const {
+	return _rep.cur.capacity;
+    }
+
+    /** @brief Return true iff the table is moving elements to a bigger
+     * array. */
+    inline bool resizing() const {
+	return _rep.old.slots != 0;
+    }
+
+    typedef OpenHashContainer_const_iterator<T, A> const_iterator;
+    typedef OpenHashContainer_iterator<T, A> iterator;
+
+    /** @brief Return an iterator for the first element in the container.
+     *
+     * @note OpenHashContainer iterators return elements in random order. */
+    inline iterator begin();
+    /** @overload */
+    inline const_iterator begin() const;
+
+    /** @brief Return an iterator for the end of the container.
+     * @invariant end().live() == false */
+    inline iterator end();
+    /** @overload */
+    inline const_iterator end() const;
+
+    /** @brief Test if an element with key @a key exists in the table. */
+    inline bool contains(const key_type &key) const {
+	return get(key) != 0;
+    }
+    /** @brief Return the number of elements with key @a key in the table. */
+    inline size_type count(const key_type &key) const {
+	return get(key) != 0;
+    }
+
+    /** @brief Return an iterator for the element with @a key, if any.
+     *
+     * Returns end() if no element with @a key exists. */
+    inline iterator find(const key_type &key);
+    /** @overload */
+    inline const_iterator find(const key_type &key) const;
+
+    /** @brief Return an iterator for the element with @a key, if any.
+     *
+     * Same as find(); provided for HashContainer compatibility. */
+    inline iterator find_prefer(const key_type &key) {
+	return find(key);
+    }
+
+    /** @brief Return the element for @a key, if any.
+     *
+     * Returns null if no element for @a key currently exists. */
+    inline T *get(const key_type &key) const;
+
+    /** @brief Prefetch the home slot for @a key. */
+    inline void prefetch(const key_type &key) const {
+	uint32_t h = hash(key);
+	click_prefetch0(_rep.cur.slots + (h >> _rep.cur.shift));
+    }
+
+    /** @brief Return the elements for @a n keys.
+     * @param keys keys to find
+     * @param[out] result result[@em i] is set to get(@a keys[@em i])
+     * @param n number of keys
+     *
+     * Hashes every key and prefetches its home slot before probing any of
+     * them, so that the lookups' cache misses overlap. */
+    void get_batch(const key_type *keys, T **result, int n) const;
+
+    /** @brief Find @a n keys at once.
+     * @param keys keys to find
+     * @param[out] its its[@em i] is set to find(@a keys[@em i])
+     * @param n number of keys
+     * @sa get_batch */
+    void find_batch(const key_type *keys, iterator *its, int n);
+
+    /** @brief Insert @a element.
+     * @pre @a element != NULL
+     * @pre No element with @a element's key is in the OpenHashContainer
+     *
+     * Insertion may grow the table and invalidates all iterators. */
+    void insert(T *element);
+
+    /** @brief Replace the element with @a element->hashkey() with @a element.
+     * @param element element
+     * @return the previous element with that key, if any
+     *
+     * If there is no former element then @a element is inserted, which
+     * invalidates all iterators. */
+    T *set(T *element);
+
+    /** @brief Replace the element at position @a it with @a element.
+     * @param it iterator, either live or returned by a failed find()
+     * @param element new element
+     * @param balance ignored; provided for HashContainer compatibility
+     * @return the previous value of it.get()
+     * @pre @a it is live or no element with @a element's key exists
+     *
+     * If @a it is live, the element it points at is replaced.  Otherwise
+     * @a element is inserted, which invalidates all iterators, and @a it is
+     * set to point at @a element. */
+    T *set(iterator &it, T *element, bool balance = true);
+
+    /** @brief Remove the element at position @a it.
+     * @param it iterator
+     * @return the previous value of it.get()
+     *
+     * As a side effect, @a it is advanced to the next element as by ++@a it. */
+    T *erase(iterator &it);
+
+    /** @brief Remove the element with hashkey @a key.
+     * @return the element removed, if any */
+    inline T *erase(const key_type &key);
+
+    /** @brief Removes all elements from the container.
+     * @post size() == 0 */
+    void clear();
+
+    /** @brief Swaps the contents of *this and @a x. */
+    inline void swap(OpenHashContainer<T, A> &x);
+
+    /** @brief Rebuild the table at once with room for at least @a n
+     * elements, finishing any incremental resize.
+     *
+     * @note Rehashing invalidates all existing iterators. */
+    void rehash(bucket_count_type n);
+
+  private:
+
+    typedef OpenHashContainer_slot<T> slot;
+    typedef OpenHashContainer_table<T> table;
+
+    OpenHashContainer_rep<T, A> _rep;
+
+    static inline uint32_t hash(const key_type &key) {
+	return (uint32_t) hashcode(key) * 2654435769U;
+    }
+    static inline bool full(const table &t, size_t n) {
+	return n > t.capacity - (t.capacity >> 3);
+    }
+    static void make_table(table &t, bucket_count_type capacity);
+    static void free_table(table &t);
+
+    inline slot *lookup(const table &t, const key_type &key, uint32_t h) const;
+    static slot *place(table &t, T *element, uint32_t h);
+    slot *insert_slot(T *element);
+    static void remove(table &t, slot *s);
+    void migrate(uint32_t n);
+
+    OpenHashContainer(const OpenHashContainer<T, A> &);
+    OpenHashContainer<T, A> &operator=(const OpenHashContainer<T, A> &);
+
+    friend class OpenHashContainer_iterator<T, A>;
+    friend class OpenHashContainer_const_iterator<T, A>;
+
+};
+
+/** @class OpenHashContainer_const_iterator
+ * @brief The const_iterator type for OpenHashContainer. */
+template <typename T, typename A>
+class OpenHashContainer_const_iterator { public:
+
+    /** @brief Construct an uninitialized iterator. */
+    OpenHashContainer_const_iterator() {
+    }
+
+    /** @brief Return a pointer to the element, null if *this == end(). */
+    T *get() const {
+	return _element;
+    }
+
+    /** @brief Return a pointer to the element, null if *this == end(). */
+    T *operator->() const {
+	return _element;
+    }
+
+    /** @brief Return a reference to the element.
+     * @pre *this != end() */
+    T &operator*() const {
+	return *_element;
+    }
+
+    /** @brief Return true iff *this != end(). */
+    inline bool live() const {
+	return _element;
+    }
+
+    typedef T *(OpenHashContainer_const_iterator::*unspecified_bool_type)() const;
+    /** @brief Return true iff *this != end(). */
+    inline operator unspecified_bool_type() const {
+	return _element ? &OpenHashContainer_const_iterator::get : 0;
+    }
+
+    /** @brief Return the corresponding OpenHashContainer. */
+    const OpenHashContainer<T, A> *hashcontainer() const {
+	return _hc;
+    }
+
+    /** @brief Advance this iterator to the next element. */
+    void operator++() {
+	++_pos;
+	settle();
+    }
+
+    /** @brief Advance this iterator to the next element. */
+    void operator++(int) {
+	++*this;
+    }
+
+  private:
+
+    T *_element;
+    const OpenHashContainer<T, A> *_hc;
+    int _table;			// 0 for the old array, 1 for the current one
+    uint32_t _pos;
+
+    inline OpenHashContainer_const_iterator(const OpenHashContainer<T, A> *hc)
+	: _hc(hc) {
+	if (hc->_rep.old.slots)
+	    _table = 0, _pos = hc->_rep.cursor;
+	else
+	    _table = 1, _pos = 0;
+	settle();
+    }
+
+    inline OpenHashContainer_const_iterator(const OpenHashContainer<T, A> *hc, int table, uint32_t pos)
+	: _hc(hc), _table(table), _pos(pos) {
+	const OpenHashContainer_table<T> &t = (table ? hc->_rep.cur : hc->_rep.old);
+	_element = (pos < t.nslots ? t.slots[pos].element : 0);
+    }
+
+    // Find the first live element at or after _pos.
+    void settle() {
+	while (1) {
+	    const OpenHashContainer_table<T> &t = (_table ? _hc->_rep.cur : _hc->_rep.old);
+	    for (; _pos < t.nslots; ++_pos)
+		if ((_element = t.slots[_pos].element))
+		    return;
+	    if (_table) {
+		_element = 0;
+		return;
+	    }
+	    _table = 1;
+	    _pos = 0;
+	}
+    }
+
+    friend class OpenHashContainer<T, A>;
+    friend class OpenHashContainer_iterator<T, A>;
+
+};
+
+/** @class OpenHashContainer_iterator
+  @brief The iterator type for OpenHashContainer. */
+template <typename T, typename A>
+class OpenHashContainer_iterator : public OpenHashContainer_const_iterator<T, A> { public:
+
+    typedef OpenHashContainer_const_iterator<T, A> inherited;
+
+    /** @brief Construct an uninitialized iterator. */
+    OpenHashContainer_iterator() {
+    }
+
+    /** @brief Return the corresponding OpenHashContainer. */
+    OpenHashContainer<T, A> *hashcontainer() const {
+	return const_cast<OpenHashContainer<T, A> *>(this->_hc);
+    }
+
+  private:
+
+    inline OpenHashContainer_iterator(OpenHashContainer<T, A> *hc)
+	: inherited(hc) {
+    }
+
+    inline OpenHashContainer_iterator(OpenHashContainer<T, A> *hc, int table, uint32_t pos)
+	: inherited(hc, table, pos) {
+    }
+
+    friend class OpenHashContainer<T, A>;
+
+};
+
+template <typename T, typename A>
+void OpenHashContainer<T, A>::make_table(table &t, bucket_count_type capacity)
+{
+    int bits = 3;
+    while ((1U << bits) < capacity && (1U << bits) < (uint32_t) max_bucket_count)
+	++bits;
+    t.capacity = 1U << bits;
+    t.shift = 32 - bits;
+    // Elements never wrap around to the start of the array, so leave room
+    // for probe sequences that run past the last home slot.
+    t.nslots = t.capacity + (t.capacity >> 3) + 16;
+    t.slots = (slot *) CLICK_LALLOC(sizeof(slot) * t.nslots);
+    memset(t.slots, 0, sizeof(slot) * t.nslots);
+}
+
+template <typename T, typename A>
+void OpenHashContainer<T, A>::free_table(table &t)
+{
+    if (t.slots)
+	CLICK_LFREE(t.slots, sizeof(slot) * t.nslots);
+    t.slots = 0;
+    t.capacity = t.nslots = 0;
+}
+
+template <typename T, typename A>
+OpenHashContainer<T, A>::OpenHashContainer()
+{
+    make_table(_rep.cur, initial_bucket_count);
+    _rep.old.slots = 0;
+    _rep.old.capacity = _rep.old.nslots = 0;
+    _rep.cursor = 0;
+    _rep.size = 0;
+}
+
+template <typename T, typename A>
+OpenHashContainer<T, A>::OpenHashContainer(bucket_count_type n)
+{
+    make_table(_rep.cur, n + (n >> 3) + 1);
+    _rep.old.slots = 0;
+    _rep.old.capacity = _rep.old.nslots = 0;
+    _rep.cursor = 0;
+    _rep.size = 0;
+}
+
+template <typename T, typename A>
+OpenHashContainer<T, A>::~OpenHashContainer()
+{
+    free_table(_rep.cur);
+    free_table(_rep.old);
+}
+
+template <typename T, typename A>
+inline typename OpenHashContainer<T, A>::const_iterator
+OpenHashContainer<T, A>::begin() const
+{
+    return const_iterator(this);
+}
+
+template <typename T, typename A>
+inline typename OpenHashContainer<T, A>::iterator
+OpenHashContainer<T, A>::begin()
+{
+    return iterator(this);
+}
+
+template <typename T, typename A>
+inline typename OpenHashContainer<T, A>::const_iterator
+OpenHashContainer<T, A>::end() const
+{
+    return const_iterator(this, 1, _rep.cur.nslots);
+}
+
+template <typename T, typename A>
+inline typename OpenHashContainer<T, A>::iterator
+OpenHashContainer<T, A>::end()
+{
+    return iterator(this, 1, _rep.cur.nslots);
+}
+
+template <typename T, typename A>
+inline typename OpenHashContainer<T, A>::slot *
+OpenHashContainer<T, A>::lookup(const table &t, const key_type &key, uint32_t h) const
+{
+    // Robin Hood order: once a slot's element is closer to its home than
+    // we are to ours, the key cannot be further on.  Tombstones in an old
+    // array keep their distance, so they do not stop the probe.
+    slot *s = t.slots + (h >> t.shift), *e = t.slots + t.nslots;
+    for (uint32_t d = 1; s != e && s->dist >= d; ++s, ++d)
+	if (s->hash == h && s->element
+	    && _rep.hashkeyeq(_rep.hashkey(s->element), key))
+	    return s;
+    return 0;
+}
+
+template <typename T, typename A>
+inline typename OpenHashContainer<T, A>::iterator
+OpenHashContainer<T, A>::find(const key_type &key)
+{
+    uint32_t h = hash(key);
+    if (slot *s = lookup(_rep.cur, key, h))
+	return iterator(this, 1, s - _rep.cur.slots);
+    if (_rep.old.slots)
+	if (slot *s = lookup(_rep.old, key, h))
+	    return iterator(this, 0, s - _rep.old.slots);
+    return end();
+}
+
+template <typename T, typename A>
+inline typename OpenHashContainer<T, A>::const_iterator
+OpenHashContainer<T, A>::find(const key_type &key) const
+{
+    return const_cast<OpenHashContainer<T, A> *>(this)->find(key);
+}
+
+template <typename T, typename A>
+inline T *OpenHashContainer<T, A>::get(const key_type &key) const
+{
+    uint32_t h = hash(key);
+    if (slot *s = lookup(_rep.cur, key, h))
+	return s->element;
+    if (_rep.old.slots)
+	if (slot *s = lookup(_rep.old, key, h))
+	    return s->element;
+    return 0;
+}
+
+template <typename T, typename A>
+void OpenHashContainer<T, A>::get_batch(const key_type *keys, T **result,
+					int n) const
+{
+    enum { chunk = 16 };
+    uint32_t h[chunk];
+    for (; n > 0; keys += chunk, result += chunk, n -= chunk) {
+	int m = n < chunk ? n : chunk;
+	for (int i = 0; i < m; ++i) {
+	    h[i] = hash(keys[i]);
+	    click_prefetch0(_rep.cur.slots + (h[i] >> _rep.cur.shift));
+	}
+	for (int i = 0; i < m; ++i) {
+	    slot *s = lookup(_rep.cur, keys[i], h[i]);
+	    if (!s && _rep.old.slots)
+		s = lookup(_rep.old, keys[i], h[i]);
+	    result[i] = s ? s->element : 0;
+	}
+    }
+}
+
+template <typename T, typename A>
+void OpenHashContainer<T, A>::find_batch(const key_type *keys, iterator *its,
+					 int n)
+{
+    enum { chunk = 16 };
+    uint32_t h[chunk];
+    for (; n > 0; keys += chunk, its += chunk, n -= chunk) {
+	int m = n < chunk ? n : chunk;
+	for (int i = 0; i < m; ++i) {
+	    h[i] = hash(keys[i]);
+	    click_prefetch0(_rep.cur.slots + (h[i] >> _rep.cur.shift));
+	}
+	for (int i = 0; i < m; ++i) {
+	    if (slot *s = lookup(_rep.cur, keys[i], h[i]))
+		its[i] = iterator(this, 1, s - _rep.cur.slots);
+	    else if (_rep.old.slots
+		     && (s = lookup(_rep.old, keys[i], h[i])))
+		its[i] = iterator(this, 0, s - _rep.old.slots);
+	    else
+		its[i] = end();
+	}
+    }
+}
+
+template <typename T, typename A>
+typename OpenHashContainer<T, A>::slot *
+OpenHashContainer<T, A>::place(table &t, T *element, uint32_t h)
+{
+    // Insert before the first element closer to its home than we would be
+    // to ours, shifting the rest of the run up to the next empty slot.
+    slot *s = t.slots + (h >> t.shift), *e = t.slots + t.nslots;
+    uint32_t d = 1;
+    for (; s != e && s->dist >= d; ++s, ++d)
+	/* nada */;
+    slot *hole = s;
+    while (hole != e && hole->dist)
+	++hole;
+    if (hole == e)
+	return 0;
+    for (; hole != s; --hole) {
+	*hole = hole[-1];
+	++hole->dist;
+    }
+    s->element = element;
+    s->hash = h;
+    s->dist = d;
+    return s;
+}
+
+template <typename T, typename A>
+void OpenHashContainer<T, A>::remove(table &t, slot *s)
+{
+    slot *e = t.slots + t.nslots;
+    for (slot *n = s + 1; n != e && n->dist > 1; s = n, ++n) {
+	*s = *n;
+	--s->dist;
+    }
+    s->element = 0;
+    s->hash = s->dist = 0;
+}
+
+template <typename T, typename A>
+void OpenHashContainer<T, A>::migrate(uint32_t n)
+{
+    for (; n && _rep.old.slots; --n) {
+	slot &s = _rep.old.slots[_rep.cursor];
+	if (s.element) {
+	    if (!place(_rep.cur, s.element, s.hash)) {
+		rehash(_rep.cur.capacity);
+		return;
+	    }
+	    s.element = 0;	// leave a tombstone
+	}
+	if (++_rep.cursor == _rep.old.nslots) {
+	    free_table(_rep.old);
+	    _rep.cursor = 0;
+	}
+    }
+}
+
+template <typename T, typename A>
+typename OpenHashContainer<T, A>::slot *
+OpenHashContainer<T, A>::insert_slot(T *element)
+{
+    click_hash_assert(element && !get(_rep.hashkey(element)));
+    if (_rep.old.slots)
+	migrate(migrate_step);
+    if (unlikely(full(_rep.cur, _rep.size + 1))
+	&& _rep.cur.capacity < (uint32_t) max_bucket_count) {
+	if (_rep.old.slots)
+	    migrate(_rep.old.nslots);
+	if (!_rep.old.slots) {
+	    _rep.old = _rep.cur;
+	    _rep.cursor = 0;
+	    make_table(_rep.cur, _rep.old.capacity * 2);
+	    migrate(migrate_step);
+	}
+    }
+    uint32_t h = hash(_rep.hashkey(element));
+    slot *s;
+    while (unlikely(!(s = place(_rep.cur, element, h))))
+	rehash(_rep.cur.capacity);
+    ++_rep.size;
+    return s;
+}
+
+template <typename T, typename A>
+void OpenHashContainer<T, A>::insert(T *element)
+{
+    (void) insert_slot(element);
+}
+
+template <typename T, typename A>
+T *OpenHashContainer<T, A>::set(T *element)
+{
+    iterator it = find(_rep.hashkey(element));
+    if (T *old = it.get()) {
+	table &t = (it._table ? _rep.cur : _rep.old);
+	t.slots[it._pos].element = element;
+	return old;
+    }
+    insert(element);
+    return 0;
+}
+
+template <typename T, typename A>
+T *OpenHashContainer<T, A>::set(iterator &it, T *element, bool)
+{
+    click_hash_assert(it._hc == this);
+    if (T *old = it._element) {
+	table &t = (it._table ? _rep.cur : _rep.old);
+	t.slots[it._pos].element = element;
+	it._element = element;
+	return old;
+    }
+    slot *s = insert_slot(element);
+    it = iterator(this, 1, s - _rep.cur.slots);
+    return 0;
+}
+
+template <typename T, typename A>
+T *OpenHashContainer<T, A>::erase(iterator &it)
+{
+    click_hash_assert(it._hc == this);
+    T *old = it._element;
+    if (!old)
+	return 0;
+    if (it._table)
+	// the next element may shift into this slot
+	remove(_rep.cur, _rep.cur.slots + it._pos);
+    else {
+	_rep.old.slots[it._pos].element = 0;
+	++it._pos;
+    }
+    --_rep.size;
+    it.settle();
+    return old;
+}
+
+template <typename T, typename A>
+inline T *OpenHashContainer<T, A>::erase(const key_type &key)
+{
+    iterator it = find(key);
+    return erase(it);
+}
+
+template <typename T, typename A>
+void OpenHashContainer<T, A>::clear()
+{
+    free_table(_rep.old);
+    _rep.cursor = 0;
+    memset(_rep.cur.slots, 0, sizeof(slot) * _rep.cur.nslots);
+    _rep.size = 0;
+}
+
+template <typename T, typename A>
+inline void OpenHashContainer<T, A>::swap(OpenHashContainer<T, A> &o)
+{
+    OpenHashContainer_rep<T, A> rep(_rep);
+    _rep = o._rep;
+    o._rep = rep;
+}
+
+template <typename T, typename A>
+void OpenHashContainer<T, A>::rehash(bucket_count_type n)
+{
+    if (n < _rep.size)
+	n = _rep.size;
+    bucket_count_type capacity = n + (n >> 3) + 1;
+
+    table t;
+  retry:
+    make_table(t, capacity);
+    for (int which = 0; which < 2; ++which) {
+	const table &from = (which ? _rep.cur : _rep.old);
+	for (uint32_t i = 0; i < from.nslots; ++i)
+	    if (from.slots[i].element
+		&& !place(t, from.slots[i].element, from.slots[i].hash)) {
+		capacity = t.capacity * 2;
+		free_table(t);
+		goto retry;
+	    }
+    }
+
+    free_table(_rep.old);
+    free_table(_rep.cur);
+    _rep.cur = t;
+    _rep.cursor = 0;
+}
+
+template <typename T, typename A>
+inline bool
+operator==(const OpenHashContainer_const_iterator<T, A> &a, const OpenHashContainer_const_iterator<T, A> &b)
+{
+    click_hash_assert(a.hashcontainer() == b.hashcontainer());
+    return a.get() == b.get();
+}
+
+template <typename T, typename A>
+inline bool
+operator!=(const OpenHashContainer_const_iterator<T, A> &a, const OpenHashContainer_const_iterator<T, A> &b)
+{
+    click_hash_assert(a.hashcontainer() == b.hashcontainer());
+    return a.get() != b.get();
+}
+
+CLICK_ENDDECLS
+#endif
@@ -74,6 +74,7 @@ class Packet { public:
 
     inline bool shared() const;
     Packet *clone() CLICK_WARN_UNUSED_RESULT;
+    Packet *split_clone(uint32_t len, uint32_t headroom = default_headroom) CLICK_WARN_UNUSED_RESULT;
     inline WritablePacket *uniqueify() CLICK_WARN_UNUSED_RESULT;
 
     inline const unsigned char *data() const;
@@ -85,6 +86,16 @@ class Packet { public:
     inline const unsigned char *end_buffer() const;
     inline uint32_t buffer_length() const;
 
+    inline bool has_segments() const;
+    inline Packet *next_segment() const;
+    inline uint32_t total_length() const;
+    inline Packet *linearize() CLICK_WARN_UNUSED_RESULT;
+    inline Packet *pullup(uint32_t len) CLICK_WARN_UNUSED_RESULT;
+#if CLICK_USERLEVEL || CLICK_MINIOS
+    void append_segment(Packet *segment);
+#endif
+    uint16_t in_cksum(const unsigned char *start, uint32_t len) const;
+
 #if CLICK_LINUXMODULE
     struct sk_buff *skb()		{ return (struct sk_buff *)this; }
     const struct sk_buff *skb() const	{ return (const struct sk_buff*)this; }
@@ -178,7 +189,11 @@ class Packet { public:
      * Ethernet header).  This operation is efficient: it just bumps a
      * pointer.
      *
-     * It is an error to attempt to pull more than length() bytes.
+     * If the packet has_segments(), @a len may exceed length(): the first
+     * segment is emptied, and the rest is removed from later segments.  Use
+     * pullup() before reading the new data().
+     *
+     * It is an error to attempt to pull more than total_length() bytes.
      *
      * @post new data() == old data() + @a len
      * @post new length() == old length() - @a len
@@ -194,7 +209,8 @@ class Packet { public:
      * after the current packet's data (starting at end_data()).  A copy of
      * the packet data is made if there isn't enough tailroom() in the current
      * packet, or if the current packet is shared().  If no copy is made, this
-     * operation is quite efficient.
+     * operation is quite efficient.  A packet that has_segments() is
+     * linearized first.
      *
      * If a data copy would be required, but the copy fails because of lack of
      * memory, then the current packet is freed.
@@ -233,7 +249,9 @@ class Packet { public:
      * @param len amount of space to remove
      *
      * Removes @a len bytes from the end of the packet.  This operation is
-     * efficient: it just bumps a pointer.
+     * efficient: it just bumps a pointer.  If the packet has_segments(), the
+     * bytes are removed from its last segments, and emptied segments are
+     * freed.
      *
      * It is an error to attempt to pull more than length() bytes.
      *
@@ -754,6 +772,7 @@ class Packet { public:
 # if CLICK_USERLEVEL || CLICK_MINIOS
     buffer_destructor_type _destructor;
     void* _destructor_argument;
+    Packet *_segment; /* next data segment, if any */
 # endif
 #endif
 
@@ -778,6 +797,13 @@ class Packet { public:
     WritablePacket *expensive_uniqueify(int32_t extra_headroom, int32_t extra_tailroom, bool free_on_failure);
     WritablePacket *expensive_push(uint32_t nbytes);
     WritablePacket *expensive_put(uint32_t nbytes);
+#if CLICK_USERLEVEL || CLICK_MINIOS
+    Packet *expensive_linearize();
+    Packet *expensive_pullup(uint32_t len);
+    void pull_segments(uint32_t nbytes);
+    void take_segments(uint32_t nbytes);
+    static void kill_segments(Packet *s);
+#endif
 
     friend class WritablePacket;
 
@@ -885,6 +911,7 @@ WritablePacket::initialize()
     _data_packet = 0;
 # if CLICK_USERLEVEL || CLICK_MINIOS
     _destructor = 0;
+    _segment = 0;
 # elif CLICK_BSDMODULE
     _m = 0;
 # endif
@@ -955,7 +982,12 @@ Packet::end_buffer() const
 #endif
 }
 
-/** @brief Return the packet's length. */
+/** @brief Return the packet's length.
+ *
+ * If the packet has_segments(), this is the length of its first segment,
+ * the data between data() and end_data().  See total_length().  Only
+ * elements with the <tt>D</tt> flag receive segmented packets (see
+ * Element::flags()). */
 inline uint32_t
 Packet::length() const
 {
@@ -997,6 +1029,102 @@ Packet::buffer_length() const
     return end_buffer() - buffer();
 }
 
+/** @brief Test whether the packet's data continues in further segments.
+ *
+ * A segmented packet's data() holds only its first segment; the rest of the
+ * packet data follows in next_segment() and its successors.  Packets are
+ * segmented only at user level, for instance by split_clone(). */
+inline bool
+Packet::has_segments() const
+{
+#if CLICK_USERLEVEL || CLICK_MINIOS
+    return _segment != 0;
+#else
+    return false;
+#endif
+}
+
+/** @brief Return the packet's next data segment, or null if it has none.
+ *
+ * A segment is a packet whose data() and length() describe part of the
+ * containing packet's data.  Its annotations are meaningless, and it must
+ * not be modified or freed. */
+inline Packet *
+Packet::next_segment() const
+{
+#if CLICK_USERLEVEL || CLICK_MINIOS
+    return _segment;
+#else
+    return 0;
+#endif
+}
+
+/** @brief Return the packet's length, including every data segment.
+ *
+ * Equals length() unless the packet has_segments(). */
+inline uint32_t
+Packet::total_length() const
+{
+    uint32_t len = length();
+#if CLICK_USERLEVEL || CLICK_MINIOS
+    for (const Packet *s = _segment; s; s = s->_segment)
+	len += s->length();
+#endif
+    return len;
+}
+
+/** @brief Return a packet whose data is contiguous.
+ * @return the contiguous packet, or null on failure
+ *
+ * If the packet has_segments(), copies its data into a single buffer, so
+ * that data() and length() cover the whole packet.  Otherwise simply returns
+ * this packet.  The input packet is freed if the copy fails.  As with
+ * uniqueify(), do not use the input pointer after the call.
+ *
+ * Packets are linearized automatically on their way into elements whose
+ * flags() lack <tt>D</tt>.  Elements with that flag that examine data beyond
+ * the headers should linearize packets themselves. */
+inline Packet *
+Packet::linearize()
+{
+#if CLICK_USERLEVEL || CLICK_MINIOS
+    if (_segment)
+	return expensive_linearize();
+#endif
+    return this;
+}
+
+/** @brief Return a packet whose first @a len bytes are contiguous.
+ * @param len number of bytes needed
+ * @return the packet, or null on failure
+ *
+ * Ensures that the first min(@a len, total_length()) bytes of packet data
+ * lie in the first segment, between data() and end_data(), by copying
+ * them from later segments if necessary.  Only the bytes needed are
+ * copied.  Unless the packet has_segments(), simply returns this packet.
+ * The input packet is freed if the copy fails.  As with uniqueify(), do not
+ * use the input pointer after the call.
+ *
+ * Elements that read headers of packets that may be segmented use pullup()
+ * to make the headers contiguous:
+ * @code
+ * if (!(p = p->pullup(sizeof(click_ip))))
+ *     return 0;
+ * @endcode
+ *
+ * @sa linearize */
+inline Packet *
+Packet::pullup(uint32_t len)
+{
+#if CLICK_USERLEVEL || CLICK_MINIOS
+    if (_segment && len > length())
+	return expensive_pullup(len);
+#else
+    (void) len;
+#endif
+    return this;
+}
+
 inline Packet *
 Packet::next() const
 {
@@ -1610,6 +1738,12 @@ Packet::nonunique_push(uint32_t len)
 inline void
 Packet::pull(uint32_t len)
 {
+#if CLICK_USERLEVEL || CLICK_MINIOS
+    if (_segment && len > length()) {
+	pull_segments(len);
+	return;
+    }
+#endif
     if (len > length()) {
 	click_chatter("Packet::pull %d > length %d\n", len, length());
 	len = length();
@@ -1629,7 +1763,7 @@ Packet::pull(uint32_t len)
 inline WritablePacket *
 Packet::put(uint32_t len)
 {
-    if (tailroom() >= len && !shared()) {
+    if (tailroom() >= len && !shared() && !has_segments()) {
 	WritablePacket *q = (WritablePacket *)this;
 #if CLICK_LINUXMODULE	/* Linux kernel module */
 	__skb_put(q->skb(), len);
@@ -1648,7 +1782,7 @@ Packet::put(uint32_t len)
 inline Packet *
 Packet::nonunique_put(uint32_t len)
 {
-    if (tailroom() >= len) {
+    if (tailroom() >= len && !has_segments()) {
 #if CLICK_LINUXMODULE	/* Linux kernel module */
 	__skb_put(skb(), len);
 #else				/* User-space and BSD kernel module */
@@ -1666,6 +1800,12 @@ Packet::nonunique_put(uint32_t len)
 inline void
 Packet::take(uint32_t len)
 {
+#if CLICK_USERLEVEL || CLICK_MINIOS
+    if (_segment) {
+	take_segments(len);
+	return;
+    }
+#endif
     if (len > length()) {
 	click_chatter("Packet::take %d > length %d\n", len, length());
 	len = length();
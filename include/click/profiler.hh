@@ -0,0 +1,116 @@
+// -*- c-basic-offset: 4; related-file-name: "../../lib/profiler.cc" -*-
+#ifndef CLICK_PROFILER_HH
+#define CLICK_PROFILER_HH
+#include <click/element.hh>
+#include <click/hashtable.hh>
+#include <click/sync.hh>
+#if CLICK_PROFILE
+CLICK_DECLS
+
+/** @file <click/profiler.hh>
+ * @brief Sampling profiler for packet transfers.
+ */
+
+/** @class Profiler
+ * @brief Sampling profiler for a router's packet transfers.
+ *
+ * When Click is configured with --enable-profile, every Router can time a
+ * sample of its packet transfers.  Writing N to the global profile_sample
+ * handler makes each thread pick about one in N of the push and pull
+ * transfers it starts from a task, timer, or selected file descriptor,
+ * chosen at random.  The chosen transfer and every transfer nested inside
+ * it, which together carry one packet through a push or pull path, are
+ * timed with click_get_cycles().  Each timed transfer charges the receiving
+ * element with the cycles it spent outside nested transfers.
+ *
+ * The profiler keeps, per element, a log2 histogram of those cycle counts;
+ * per connection, the number of sampled packets that crossed it; and per
+ * call path, the cycles charged to the path's last element.  Global handlers
+ * report them: profile_elements, profile_histograms, profile_edges, and
+ * profile_folded, whose lines are the "folded stacks" read by flamegraph
+ * tools.  Writing 0 to profile_sample stops sampling.
+ *
+ * A build without --enable-profile has no profiling code at all.  A build
+ * with it tests one global word per transfer while no router is sampling.
+ * Pull transfers that return no packet are not sampled, so idle polling does
+ * not swamp the histograms.
+ */
+class Profiler { public:
+
+    enum { nbuckets = 32 };
+
+    explicit Profiler(Router *router) CLICK_COLD;
+    ~Profiler() CLICK_COLD;
+
+    static void static_initialize() CLICK_COLD;
+
+    /** @brief Return the sampling period, or 0 if not sampling. */
+    uint32_t period() const {
+        return _period;
+    }
+    void set_period(uint32_t period);
+    void reset();
+
+  private:
+
+    struct ElementStats {
+        uint32_t samples;
+        click_cycles_t cycles;
+        uint32_t hist[nbuckets];
+    };
+
+    struct Node {
+        int parent;
+        int eindex;
+        click_cycles_t cycles;
+    };
+
+    struct Thread {
+        SimpleSpinlock lock;
+        uint32_t countdown;
+        uint32_t seed;
+        int depth;                          // nested transfers
+        int sampled;                        // nested sampled transfers
+        int node;
+        click_cycles_t child_cycles;
+        Vector<ElementStats> elements;
+        Vector<Node> nodes;                 // nodes[0] is the root
+        HashTable<uint64_t, int> node_map;  // (parent, eindex) -> node
+        HashTable<uintptr_t, uint32_t> edges; // port | is_pull -> samples
+    };
+
+    struct Sample {
+        Thread *thread;
+        int parent_node;
+        click_cycles_t parent_child_cycles;
+        click_cycles_t begin;
+        click_cycles_t start;
+    };
+
+    Router *_router;
+    Thread *_threads;
+    int _nthreads;
+    uint32_t _period;
+
+    inline Thread *thread();
+    inline uint32_t next_countdown(Thread &t);
+    int child_node(Thread &t, int parent, int eindex);
+    inline bool enter(Sample &s, const Element *from, const Element *to);
+    inline void leave(Sample &s, uintptr_t edge, bool moved);
+
+    String unparse_elements() const;
+    String unparse_histograms() const;
+    String unparse_edges() const;
+    String unparse_folded() const;
+    void merge_elements(Vector<ElementStats> &stats) const;
+
+    static String read_handler(Element *, void *);
+    static int write_handler(const String &, Element *, void *, ErrorHandler *);
+
+    friend class Element::Port;
+
+};
+
+CLICK_ENDDECLS
+#endif
+#endif
@@ -19,6 +19,9 @@ class NotifierSignal;
 class ThreadSched;
 class Handler;
 class NameInfo;
+#if CLICK_PROFILE
+class Profiler;
+#endif
 
 class Router { public:
 
@@ -99,6 +102,11 @@ class Router { public:
     NameInfo* force_name_info();
     /** @endcond never */
 
+#if CLICK_PROFILE
+    inline Profiler* profiler() const;
+    Profiler* force_profiler();
+#endif
+
     // UNPARSING
     String configuration_string() const;
     void unparse(StringAccum& sa, const String& indent = String()) const;
@@ -133,6 +141,7 @@ class Router { public:
 
     int initialize(ErrorHandler* errh);
     void activate(bool foreground, ErrorHandler* errh);
+    void add_startup_phase(const String &name, const Timestamp &duration);
     inline void activate(ErrorHandler* errh);
     inline void set_foreground(bool foreground);
 
@@ -274,6 +283,16 @@ class Router { public:
     Vector<String> _attachment_names;
     Vector<void*> _attachments;
 
+    struct startup_class_t {
+        String name;
+        int nelements;
+        Timestamp configure_time;
+        Timestamp initialize_time;
+    };
+    Vector<String> _startup_phase_names;
+    Vector<Timestamp> _startup_phase_times;
+    Vector<startup_class_t> _startup_classes;
+
     Element* _root_element;
     String _configuration;
 
@@ -293,6 +312,9 @@ class Router { public:
     Router* _hotswap_router;
     ThreadSched* _thread_sched;
     mutable NameInfo* _name_info;
+#if CLICK_PROFILE
+    Profiler* _profiler;
+#endif
     Vector<int> _flow_code_override_eindex;
     Vector<String> _flow_code_override;
 
@@ -311,6 +333,8 @@ class Router { public:
     int check_hookup_elements(ErrorHandler*);
     int check_hookup_range(ErrorHandler*);
     int check_hookup_completeness(ErrorHandler*);
+    void record_startup_classes(const Vector<Timestamp> &configure_time,
+                                const Vector<Timestamp> &initialize_time);
 
     const char *hard_flow_code_override(int e) const;
     int processing_error(const Connection &conn, bool, int, ErrorHandler*);
@@ -478,6 +502,15 @@ Router::name_info() const
 }
 /** @endcond never */
 
+#if CLICK_PROFILE
+/** @brief  Return the router's sampling profiler, if it exists. */
+inline Profiler*
+Router::profiler() const
+{
+    return _profiler;
+}
+#endif
+
 /** @brief  Return the Master object for this router. */
 inline Master*
 Router::master() const
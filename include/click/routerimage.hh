@@ -0,0 +1,112 @@
+// -*- c-basic-offset: 4; related-file-name: "../../lib/routerimage.cc" -*-
+#ifndef CLICK_ROUTERIMAGE_HH
+#define CLICK_ROUTERIMAGE_HH
+#include <click/string.hh>
+#include <click/vector.hh>
+CLICK_DECLS
+class ErrorHandler;
+
+/** @file <click/routerimage.hh>
+ * @brief Class for precompiled router images. */
+
+/** @class RouterImage
+ * @brief A flattened, preparsed router configuration.
+ *
+ * A router image holds everything the driver needs to instantiate a router
+ * without running the lexer: the element list, with each element's name,
+ * class, configuration string, and landmark; the connections between
+ * elements; and the configuration's requirements.  Compound elements have
+ * already been expanded and variables substituted.  Images are written by
+ * "click-flatten --image" and read by the user-level driver, which maps the
+ * image into memory and uses its strings in place.
+ *
+ * An image also carries the flattened configuration as text.  Separate
+ * checksums cover the binary sections and the text, so if the binary part
+ * of an image is damaged, the driver can still fall back to parsing the
+ * text.
+ *
+ * Images use the host's byte order; an image written on a machine with a
+ * different byte order is rejected. */
+class RouterImage { public:
+
+    struct ElementInfo {
+	String name;		///< Element name
+	String class_name;	///< Element class name
+	String configuration;	///< Configuration string
+	String filename;	///< Landmark filename
+	unsigned lineno;	///< Landmark line number
+    };
+
+    struct ConnectionInfo {
+	uint32_t from_idx;
+	uint32_t from_port;
+	uint32_t to_idx;
+	uint32_t to_port;
+    };
+
+    Vector<ElementInfo> elements;
+    Vector<ConnectionInfo> connections;
+    Vector<String> requirements;	///< Alternating types and values
+    String configuration;		///< Flattened configuration text
+
+    enum {
+	parse_ok = 0,		///< Image is intact
+	parse_text_only = 1	///< Only the configuration text is usable
+    };
+
+    /** @brief Return true iff @a data starts with the image magic number. */
+    static bool is_image(const String &data);
+
+    /** @brief Parse @a data into this image.
+     * @param data image data
+     * @param errh error message receiver
+     * @return parse_ok, parse_text_only, or a negative error code
+     *
+     * Strings in the parsed image share memory with @a data, so if @a data
+     * is stable (for example, a memory-mapped file), parsing copies no
+     * string data. */
+    int parse(const String &data, ErrorHandler *errh);
+
+    /** @brief Return the binary representation of this image. */
+    String unparse() const;
+
+  private:
+
+    enum { image_version = 2, byte_order_mark = 0x01020304 };
+
+    // The body checksum covers the whole header except itself, the records,
+    // and the string table; the text fields stay usable if it fails.
+    struct header {
+	char magic[8];
+	uint32_t version;
+	uint32_t byte_order;
+	uint32_t size;
+	uint32_t text_offset;
+	uint32_t text_length;
+	uint32_t text_checksum;
+	uint32_t body_checksum;
+	uint32_t nelements;
+	uint32_t nconnections;
+	uint32_t nrequirements;
+	uint32_t strings_offset;
+	uint32_t strings_length;
+    };
+
+    // string references are (offset, length) pairs relative to the start
+    // of the string table, which NUL-terminates every string
+    struct element_record {
+	uint32_t name[2];
+	uint32_t class_name[2];
+	uint32_t configuration[2];
+	uint32_t filename[2];
+	uint32_t lineno;
+    };
+
+    static const char magic[8];
+
+    static uint32_t body_checksum(const char *data, uint32_t end);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -74,6 +74,28 @@ class RouterThread { public:
     void set_greedy(bool g)             { _greedy = g; }
 #endif
 
+#if CLICK_USERLEVEL
+    // Idle backoff: after tasks stop reporting work, busy-poll for
+    // busy_poll, then pause between polls for pause, then sleep in the
+    // select set for up to wake_latency between polls.  The owner that
+    // turned backoff on is the only one that can turn it off.
+    enum { POLL_BUSY, POLL_PAUSE, POLL_SLEEP };
+    inline bool idle_backoff() const    { return _backoff; }
+    void set_idle_backoff(const Timestamp &busy_poll, const Timestamp &pause,
+                          const Timestamp &wake_latency, const void *owner);
+    void clear_idle_backoff(const void *owner);
+    int poll_state() const              { return _poll_state; }
+    inline int next_select_delay(Timestamp &t) const;
+
+    // Cycles spent running tasks that did work, running tasks that did
+    // none (including pauses), and in the operating system.  Counted only
+    // while idle backoff is on.
+    enum { U_WORK, U_IDLE, U_OS, NUTIL };
+    click_cycles_t utilization_cycles(int which) const { return _util_cycles[which]; }
+    uint64_t idle_sleeps() const        { return _idle_sleeps; }
+    void reset_utilization();
+#endif
+
     inline void wake();
 
 #if CLICK_USERLEVEL
@@ -166,6 +188,18 @@ class RouterThread { public:
 #endif
 #if CLICK_MINIOS
     struct thread *_minios_thread;
+#endif
+#if CLICK_USERLEVEL
+    bool _backoff;
+    int _poll_state;
+    const void *_backoff_owner;
+    Timestamp _busy_poll;
+    Timestamp _pause_poll;
+    Timestamp _wake_latency;
+    Timestamp _idle_start;
+    click_cycles_t _util_mark;
+    click_cycles_t _util_cycles[NUTIL];
+    uint64_t _idle_sleeps;
 #endif
   public:
     unsigned _tasks_per_iter;
@@ -225,7 +259,7 @@ class RouterThread { public:
         assert(val == (uint32_t) -1);
     }
 
-    inline void run_tasks(int ntasks);
+    inline bool run_tasks(int ntasks);
     inline void process_pending();
     inline void run_os();
 #if HAVE_ADAPTIVE_SCHEDULER
@@ -234,6 +268,10 @@ class RouterThread { public:
 #endif
 #if HAVE_TASK_HEAP
     void task_reheapify_from(int pos, Task*);
+#endif
+#if CLICK_USERLEVEL
+    inline void account_cycles(int which);
+    void update_idle_backoff(bool worked);
 #endif
     static inline bool running_in_interrupt();
     inline bool current_thread_is_running() const;
@@ -507,6 +545,16 @@ RouterThread::set_thread_state_for_blocking(int delay_type)
         set_thread_state(delay_type ? S_TIMERWAIT : S_PAUSED);
 }
 
+#if CLICK_USERLEVEL
+inline void
+RouterThread::account_cycles(int which)
+{
+    click_cycles_t now = click_get_cycles();
+    _util_cycles[which] += now - _util_mark;
+    _util_mark = now;
+}
+#endif
+
 #if CLICK_DEBUG_SCHEDULING > 1
 inline Timestamp
 RouterThread::thread_state_time(int state) const
@@ -0,0 +1,207 @@
+// -*- related-file-name: "../../lib/slaballocator.cc" -*-
+#ifndef CLICK_SLABALLOCATOR_HH
+#define CLICK_SLABALLOCATOR_HH
+#include <click/glue.hh>
+#include <click/sync.hh>
+CLICK_DECLS
+class String;
+
+/** @class SlabAllocator
+ * @brief Thread-aware allocator for fixed-size objects.
+ *
+ * SlabAllocator hands out objects of one size, carved from large slabs.  It
+ * is meant for per-flow state that is created and destroyed at high rates,
+ * and has the same allocate() and deallocate() interface as HashAllocator,
+ * so that it can replace a HashAllocator that feeds a HashContainer.
+ *
+ * Unlike HashAllocator, SlabAllocator may be used by several threads at
+ * once.  Each thread has two magazines, small stacks of free objects, and
+ * allocates from and frees into them without locking.  When both magazines
+ * are empty or full, the thread exchanges one with a shared depot under a
+ * lock.  An object freed by a thread other than the one that allocated it
+ * simply enters the freeing thread's magazine, and returns to circulation
+ * through the depot.  Memory is returned to the system only when the
+ * SlabAllocator is destroyed.
+ *
+ * Object sizes are rounded up to a size class; see size_class().  shared()
+ * returns a process-wide SlabAllocator for each size class, so that
+ * different elements with similarly sized objects draw from one pool.
+ *
+ * The lock-free path applies only to Click router threads.  Other threads,
+ * and builds without per-thread identifiers, always use the depot. */
+class SlabAllocator { public:
+
+    enum {
+	F_HUGEPAGES = 1		///< Back slabs with huge pages, if possible
+    };
+
+    /** @brief Construct an allocator for objects of @a size bytes.
+     * @param size object size; rounded up to size_class(@a size)
+     * @param flags F_ flags */
+    explicit SlabAllocator(size_t size, int flags = 0);
+    ~SlabAllocator();
+
+    /** @brief Return the shared allocator for size_class(@a size).
+     * @pre @a size <= max_shared_size
+     *
+     * Shared allocators live until the process exits. */
+    static SlabAllocator *shared(size_t size);
+
+    /** @brief Return the object size that SlabAllocator uses for @a size.
+     *
+     * Sizes up to 256 bytes are rounded up to a multiple of 16.  Larger
+     * sizes are rounded up to a multiple of a quarter of the largest power
+     * of two not greater than the size, so at most 25% is wasted. */
+    static size_t size_class(size_t size);
+
+    enum { max_shared_size = 65536 };
+
+    /** @brief Return the object size. */
+    size_t size() const {
+	return _size;
+    }
+
+    /** @brief Allocate an object.
+     *
+     * Returns null if memory is exhausted. */
+    inline void *allocate();
+
+    /** @brief Free @a p, which must have come from this allocator's
+     * allocate().  Does nothing if @a p is null. */
+    inline void deallocate(void *p);
+
+    struct Stats {
+	size_t size;		///< object size
+	size_t in_use;		///< objects allocated and not yet freed
+	size_t cached;		///< free objects in magazines and the depot
+	size_t capacity;	///< objects carved from slabs so far
+	size_t slab_bytes;	///< bytes of slab memory
+	bool hugepages;		///< true iff slabs use huge pages
+    };
+
+    /** @brief Fill @a s with current statistics.
+     *
+     * Counters of other threads are read without synchronization, so the
+     * numbers are approximate while those threads run. */
+    void stats(Stats &s) const;
+
+    /** @brief Return one line of statistics for every live SlabAllocator. */
+    static String unparse_all();
+
+  private:
+
+    enum { magazine_size = 30 };
+
+    struct Magazine {
+	Magazine *next;
+	int n;
+	void *obj[magazine_size];
+    };
+
+    struct link {
+	link *next;
+    };
+
+    struct slab {
+	slab *next;
+	size_t size;
+	bool huge;
+	char *memory;		// new[] block holding the aligned slab
+    };
+
+    // A thread's magazines are created on its first hard_allocate() or
+    // hard_deallocate().
+    struct CPU {
+	Magazine *loaded;
+	Magazine *previous;
+	uint64_t nalloc;
+	uint64_t nfree;
+    } CLICK_ALIGNED(CLICK_CACHE_LINE_SIZE);
+
+    size_t _size;
+    int _flags;
+
+    CPU *_cpus;
+    unsigned _ncpus;
+    char *_cpu_memory;
+
+    // depot, protected by _lock
+    SimpleSpinlock _lock;
+    Magazine *_full;
+    Magazine *_empty;
+    size_t _nfull;
+    link *_free;
+    size_t _nfree_list;
+    uint64_t _depot_nalloc;
+    uint64_t _depot_nfree;
+
+    // slabs, protected by _lock
+    slab *_slabs;
+    char *_slab_pos;
+    char *_slab_end;
+    size_t _capacity;
+    size_t _slab_bytes;
+    bool _hugepages;
+
+    // list of all allocators, for unparse_all()
+    SlabAllocator *_next_allocator;
+    SlabAllocator **_pprev_allocator;
+    bool _shared;
+
+    static inline unsigned current_cpu();
+    void *hard_allocate(unsigned cpu);
+    void hard_deallocate(unsigned cpu, void *p);
+    bool fill(Magazine *m);
+    Magazine *new_magazine();
+    void install_magazines(CPU &c);
+    void *carve();
+    bool grow();
+    void free_slab(slab *s);
+
+    SlabAllocator(const SlabAllocator &x);
+    SlabAllocator &operator=(const SlabAllocator &x);
+
+};
+
+
+inline unsigned SlabAllocator::current_cpu()
+{
+#if CLICK_USERLEVEL && HAVE_MULTITHREAD && HAVE___THREAD_STORAGE_CLASS
+    // Threads other than router threads have no identifier of their own.
+    if (!(click_current_thread_id & 0x40000000))
+	return (unsigned) -1;
+#endif
+    return click_current_cpu_id();
+}
+
+inline void *SlabAllocator::allocate()
+{
+    unsigned id = current_cpu();
+    if (id < _ncpus) {
+	CPU &c = _cpus[id];
+	if (c.loaded && c.loaded->n) {
+	    ++c.nalloc;
+	    return c.loaded->obj[--c.loaded->n];
+	}
+    }
+    return hard_allocate(id);
+}
+
+inline void SlabAllocator::deallocate(void *p)
+{
+    if (p) {
+	unsigned id = current_cpu();
+	if (id < _ncpus) {
+	    CPU &c = _cpus[id];
+	    if (c.loaded && c.loaded->n < magazine_size) {
+		++c.nfree;
+		c.loaded->obj[c.loaded->n++] = p;
+		return;
+	    }
+	}
+	hard_deallocate(id, p);
+    }
+}
+
+CLICK_ENDDECLS
+#endif
@@ -563,6 +563,82 @@ ReadWriteLock::release_write()
 #endif
 }
 
+/** @class SeqLock
+ * @brief A sequence lock whose readers never write shared memory.
+ *
+ * A SeqLock protects small pieces of data that are read often and written
+ * rarely.  Writers bracket their updates with write_begin() and write_end(),
+ * which make the sequence number odd during the update.  Readers call
+ * read_begin(), copy the protected data, and then call read_retry(); if
+ * read_retry() returns true, a writer intervened and the copy must be
+ * discarded.  Readers never modify the lock, so concurrent readers on
+ * different CPUs do not contend for its cache line.
+ *
+ * SeqLock does not serialize writers.  Protect write_begin()/write_end()
+ * sections with a Spinlock or similar if there can be more than one writer.
+ */
+class SeqLock { public:
+
+    inline SeqLock();
+
+    inline uint32_t read_begin() const;
+    inline bool read_retry(uint32_t seq) const;
+    inline void write_begin();
+    inline void write_end();
+
+  private:
+
+    volatile uint32_t _seq;
+
+};
+
+/** @brief Create a SeqLock. */
+inline
+SeqLock::SeqLock()
+    : _seq(0)
+{
+}
+
+/** @brief Begin a read-side critical section.
+ * @return sequence number to pass to read_retry()
+ *
+ * Spins while a writer is active. */
+inline uint32_t
+SeqLock::read_begin() const
+{
+    uint32_t seq;
+    while ((seq = _seq) & 1)
+	click_relax_fence();
+    click_read_fence();
+    return seq;
+}
+
+/** @brief End a read-side critical section.
+ * @param seq sequence number returned by read_begin()
+ * @return true iff the data read since read_begin() may be inconsistent */
+inline bool
+SeqLock::read_retry(uint32_t seq) const
+{
+    click_read_fence();
+    return _seq != seq;
+}
+
+/** @brief Begin a write-side critical section. */
+inline void
+SeqLock::write_begin()
+{
+    _seq = _seq + 1;
+    click_write_fence();
+}
+
+/** @brief End a write-side critical section. */
+inline void
+SeqLock::write_end()
+{
+    click_write_fence();
+    _seq = _seq + 1;
+}
+
 CLICK_ENDDECLS
 #undef SPINLOCK_ASSERTLEVEL
 #endif
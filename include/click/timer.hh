@@ -153,6 +153,13 @@ class Timer { public:
     /** @brief Return the Timer's associated home thread ID. */
     int home_thread_id() const;
 
+    /** @brief Move the timer to another thread.
+     * @param thread_id the new home thread ID
+     *
+     * The timer must be initialized and unscheduled.  Once scheduled, it
+     * fires on thread @a thread_id. */
+    void move_thread(int thread_id);
+
 
     /** @brief Initialize the timer.
      * @param owner the owner element
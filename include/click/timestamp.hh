@@ -119,6 +119,19 @@ Timestamp operator+(Timestamp, const Timestamp &);
 #endif
 
 
+// TIMESTAMP_THREAD_CLOCK is defined if this Timestamp implementation keeps
+// per-thread clock state, which lets recent() return a time cached for the
+// current driver iteration.  TIMESTAMP_TSC_CLOCK is defined if it can also
+// compute the current time from the processor's cycle counter.
+
+#if CLICK_USERLEVEL && (!HAVE_MULTITHREAD || HAVE___THREAD_STORAGE_CLASS)
+# define TIMESTAMP_THREAD_CLOCK 1
+# if HAVE_USE_CLOCK_GETTIME && TIMESTAMP_REP_FLAT64 && defined(__x86_64__)
+#  define TIMESTAMP_TSC_CLOCK 1
+# endif
+#endif
+
+
 class Timestamp { public:
 
     /** @brief  Type represents a number of seconds. */
@@ -442,7 +455,11 @@ class Timestamp { public:
      * The Timestamp::now() function calculates the current system time, which
      * is relatively expensive.  Timestamp::recent() can be faster, but is
      * less precise: it returns a cached copy of a recent system time.
-     * @sa now(), assign_recent() */
+     *
+     * At user level, a driver thread calculates the current time at its
+     * first call to recent() in each scheduler iteration and returns that
+     * time until the iteration ends.  Other threads get now().
+     * @sa now(), assign_recent(), refresh_recent() */
     static inline Timestamp recent();
 
     /** @brief Set this timestamp to a recent system time.
@@ -476,7 +493,8 @@ class Timestamp { public:
      * The Timestamp::now_steady() function calculates the current
      * steady-clock time, which is relatively expensive.
      * Timestamp::recent_steady() can be faster, but is less precise: it
-     * returns a cached copy of a recent steady-clock time.
+     * returns a cached copy of a recent steady-clock time, which at user
+     * level lasts for the current scheduler iteration, as with recent().
      * @sa now_steady(), assign_recent_steady() */
     static inline Timestamp recent_steady();
 
@@ -667,6 +685,51 @@ class Timestamp { public:
     //@}
 #endif
 
+#if TIMESTAMP_THREAD_CLOCK
+    /** @name Clock Sources */
+    //@{
+    enum clock_source_type {
+        clock_system = 0,       ///< Read the system clock (the default).
+        clock_tsc = 1           ///< Extrapolate from the cycle counter.
+    };
+
+    /** @brief Return the active clock source. */
+    static inline int clock_source();
+
+    /** @brief Set the clock source to @a c.
+     * @return 0 on success, -1 if @a c is not available
+     *
+     * With #clock_tsc, now() and now_steady() read the processor's cycle
+     * counter, which takes a few nanoseconds, rather than asking the system
+     * clock.  Each thread converts cycles to time relative to its own base
+     * reading of the system clock, which it refreshes every 100 milliseconds,
+     * so the two clocks never drift far apart.  The conversion rate is
+     * measured when the source is set, which takes 10 milliseconds, and
+     * refined at each refresh.  Steady-clock time does not move backwards
+     * when a thread refreshes its base.
+     *
+     * #clock_tsc requires a cycle counter that runs at a constant rate
+     * through frequency changes and sleep states, and is only available on
+     * x86-64. */
+    static int set_clock_source(clock_source_type c);
+
+    /** @brief Start a new recent() period on this thread.
+     *
+     * After this call, the thread's next calls to recent() and
+     * recent_steady() calculate the current time, and later calls return the
+     * same time until the next refresh_recent().  RouterThread::driver()
+     * calls this function at the start of each scheduler iteration and after
+     * waiting for events. */
+    static inline void refresh_recent();
+
+    /** @brief Stop caching recent() times on this thread.
+     *
+     * After this call, recent() and recent_steady() return the current time
+     * until the next refresh_recent(). */
+    static inline void uncache_recent();
+    //@}
+#endif
+
   private:
 
     rep_t _t;
@@ -719,6 +782,9 @@ class Timestamp { public:
     friend inline Timestamp operator-(const Timestamp &b);
     friend inline Timestamp &operator+=(Timestamp &a, const Timestamp &b);
     friend inline Timestamp &operator-=(Timestamp &a, const Timestamp &b);
+#if TIMESTAMP_THREAD_CLOCK
+    friend class TimestampClock;
+#endif
 
 };
 
@@ -754,6 +820,66 @@ inline Timestamp Timestamp::warped(bool steady) const {
 }
 #endif
 
+#if TIMESTAMP_THREAD_CLOCK
+/** @cond never */
+class TimestampClock {
+    struct thread_state {
+        int recent_state;               // 1: caching, 2: both cached
+        Timestamp::rep_t recent[2];
+# if TIMESTAMP_TSC_CLOCK
+        uint64_t base_cycles;
+        int64_t base_nsec[2];
+# endif
+    };
+# if HAVE_MULTITHREAD
+    static __thread thread_state thread;
+# else
+    static thread_state thread;
+# endif
+    static Timestamp::clock_source_type source;
+    static inline void flush_recent() {
+        thread.recent_state &= 1;
+    }
+    static void cache_recent(const Timestamp &t, bool steady);
+# if TIMESTAMP_TSC_CLOCK
+    static uint64_t period_cycles;      // refresh bases this often
+    static uint64_t mult;               // nanoseconds per cycle << 32
+    static uint64_t calibrate_cycles;
+    static int64_t calibrate_nsec;
+    static bool calibrate();
+    static void rebase(thread_state &t);
+    static inline int64_t tsc_nsec(bool steady);
+# endif
+    friend class Timestamp;
+};
+/** @endcond never */
+
+inline int Timestamp::clock_source() {
+    return TimestampClock::source;
+}
+
+inline void Timestamp::refresh_recent() {
+    TimestampClock::thread.recent_state = 1;
+}
+
+inline void Timestamp::uncache_recent() {
+    TimestampClock::thread.recent_state = 0;
+}
+
+# if TIMESTAMP_TSC_CLOCK
+inline int64_t TimestampClock::tsc_nsec(bool steady) {
+    thread_state &t = thread;
+    uint64_t delta = click_get_cycles() - t.base_cycles;
+    // A counter that moved backwards also forces a new base.
+    if (unlikely(delta >= period_cycles)) {
+        rebase(t);
+        delta = 0;
+    }
+    return t.base_nsec[steady] + (int64_t) ((delta * mult) >> 32);
+}
+# endif
+#endif
+
 
 /** @brief Create a Timestamp measuring @a tv.
     @param tv timeval structure */
@@ -789,6 +915,13 @@ Timestamp::assign_now(bool recent, bool steady, bool unwarped)
 {
     (void) recent, (void) steady, (void) unwarped;
 
+#if TIMESTAMP_THREAD_CLOCK
+    if (recent && (TimestampClock::thread.recent_state & 2)) {
+        _t = TimestampClock::thread.recent[steady];
+        return;
+    }
+#endif
+
 #if TIMESTAMP_PUNS_TIMESPEC
 # define TIMESTAMP_DECLARE_TSP struct timespec &tsp = _t.tspec
 # define TIMESTAMP_RESOLVE_TSP /* nothing */
@@ -884,12 +1017,20 @@ Timestamp::assign_now(bool recent, bool steady, bool unwarped)
     }
 
 #elif HAVE_USE_CLOCK_GETTIME
+# if TIMESTAMP_TSC_CLOCK
+    if (TimestampClock::source == clock_tsc)
+        *this = make_nsec(TimestampClock::tsc_nsec(steady));
+    else {
+# endif
     TIMESTAMP_DECLARE_TSP;
     if (steady)
         clock_gettime(CLOCK_MONOTONIC, &tsp);
     else
         clock_gettime(CLOCK_REALTIME, &tsp);
     TIMESTAMP_RESOLVE_TSP;
+# if TIMESTAMP_TSC_CLOCK
+    }
+# endif
 
 #else
     TIMESTAMP_DECLARE_TVP;
@@ -907,6 +1048,11 @@ Timestamp::assign_now(bool recent, bool steady, bool unwarped)
     if (!unwarped && TimestampWarp::kind)
         warp(steady, true);
 #endif
+
+#if TIMESTAMP_THREAD_CLOCK
+    if (recent && TimestampClock::thread.recent_state)
+        TimestampClock::cache_recent(*this, steady);
+#endif
 }
 
 inline void
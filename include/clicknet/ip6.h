@@ -59,9 +59,18 @@ struct click_ip6 {
 
 #define IP6_CHECK_V(hdr)	(((hdr).ip6_vfc & htonl(IP6_V_MASK)) == htonl(6 << IP6_V_SHIFT))
 
+#ifndef IP6PROTO_HOPOPTS
+#define IP6PROTO_HOPOPTS 0x00
+#endif
+#ifndef IP6PROTO_ROUTING
+#define IP6PROTO_ROUTING 0x2b
+#endif
 #ifndef IP6PROTO_FRAGMENT
 #define IP6PROTO_FRAGMENT 0x2c
 #endif
+#ifndef IP6PROTO_DSTOPTS
+#define IP6PROTO_DSTOPTS 0x3c
+#endif
 struct click_ip6_fragment {
     uint8_t ip6_frag_nxt;
     uint8_t ip6_frag_reserved;
@@ -54,6 +54,12 @@
 # include <click/straccum.hh>
 # include <click/nameinfo.hh>
 # include <click/bighashmap_arena.hh>
+# include <click/routerimage.hh>
+#endif
+#if CLICK_USERLEVEL && defined(ALLOW_MMAP)
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
 #endif
 
 #if HAVE_DYNAMIC_LINKING && !CLICK_LINUXMODULE && !CLICK_BSDMODULE
@@ -480,6 +486,36 @@ click_static_cleanup()
 # endif /* HAVE_DYNAMIC_LINKING */
 }
 
+#if CLICK_USERLEVEL && defined(ALLOW_MMAP)
+/* Return the contents of @a filename as a stable string backed by a
+   read-only mapping if it is a router image, or a null string otherwise.
+   Image strings point directly into the mapping, which is never unmapped:
+   routers, and the strings they hand out, may live as long as the
+   process. */
+static String
+mapped_router_image(const String &filename)
+{
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        return String();
+    String result;
+    struct stat st;
+    if (fstat(fd, &st) >= 0 && S_ISREG(st.st_mode)
+        && st.st_size > 0 && st.st_size < 0x7FFFFFFF) {
+        void *data = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            result = String::make_stable((const char *) data, st.st_size);
+            if (!RouterImage::is_image(result)) {
+                munmap(data, st.st_size);
+                result = String();
+            }
+        }
+    }
+    close(fd);
+    return result;
+}
+#endif
+
 Router *
 click_read_router(String filename, bool is_expr, ErrorHandler *errh, bool initialize, Master *master)
 {
@@ -497,6 +533,11 @@ click_read_router(String filename, bool is_expr, ErrorHandler *errh, bool initia
         errh->error("MiniOS doesn't support loading configurations from files!");
 #else
     } else {
+# if CLICK_USERLEVEL && defined(ALLOW_MMAP)
+        if (filename && filename != "-")
+            config_str = mapped_router_image(filename);
+        if (!config_str)
+# endif
         config_str = file_string(filename, errh);
         if (!filename || filename == "-")
             filename = "<stdin>";
@@ -505,6 +546,40 @@ click_read_router(String filename, bool is_expr, ErrorHandler *errh, bool initia
     if (errh->nerrors() > before)
         return 0;
 
+    // instantiate precompiled router images directly
+    if (RouterImage::is_image(config_str)) {
+        RouterImage image;
+        ContextErrorHandler cerrh(errh, "While loading router image %<%s%>:", filename.c_str());
+        int r = image.parse(config_str, &cerrh);
+        if (r < 0)
+            return 0;
+        Router *router = 0;
+        if (r == RouterImage::parse_ok) {
+            RequireLexerExtra lextra(0);
+            for (int i = 0; i + 1 < image.requirements.size(); i += 2)
+                lextra.require(image.requirements[i], image.requirements[i+1], errh);
+            if (errh->nerrors() > before)
+                return 0;
+            Master *image_master = master ? master : new Master(1);
+            Timestamp create_start = Timestamp::now();
+            router = click_lexer()->create_router(image, image_master, errh);
+            if (router)
+                router->add_startup_phase("create", Timestamp::now() - create_start);
+            else if (image_master != master)
+                delete image_master;
+        }
+        if (router) {
+            if (initialize)
+                if (errh->nerrors() > before || router->initialize(errh) < 0) {
+                    delete router;
+                    return 0;
+                }
+            return router;
+        }
+        // fall back to the configuration text
+        config_str = image.configuration;
+    }
+
     // find config string in archive
     Vector<ArchiveElement> archive;
     if (config_str.length() != 0 && config_str[0] == '!') {
@@ -520,11 +595,17 @@ click_read_router(String filename, bool is_expr, ErrorHandler *errh, bool initia
     // lex
     Lexer *l = click_lexer();
     RequireLexerExtra lextra(&archive);
+    Timestamp parse_start = Timestamp::now();
     int cookie = l->begin_parse(config_str, filename, &lextra, errh);
     while (!l->ydone())
         l->ystep();
+    Timestamp create_start = Timestamp::now();
     Router *router = l->create_router(master ? master : new Master(1));
     l->end_parse(cookie);
+    if (router) {
+        router->add_startup_phase("parse", create_start - parse_start);
+        router->add_startup_phase("create", Timestamp::now() - create_start);
+    }
 
     // initialize if requested
     if (initialize)
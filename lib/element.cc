@@ -1214,6 +1214,12 @@ Element::processing_vector(int* in_v, int* out_v, ErrorHandler* errh) const
  * RoundRobinSched has 0 inputs, are idle rather than busy, and waste no
  * CPU time.</dd>
  *
+ * <dt><tt>D</tt></dt> <dd>This element handles packets whose data continues
+ * in segments (see Packet::has_segments()).  Packets arriving at an element
+ * without this flag, by push or by pull, are first made contiguous with
+ * Packet::linearize(), so that its data() and length() cover the whole
+ * packet.</dd>
+ *
  * </dl>
  */
 const char*
@@ -1241,9 +1247,7 @@ Element::flag_value(int flag) const
 		return value;
 	    } else
 		return 1;
-	} else
-	    while (isspace(*data))
-		++data;
+	}
     return -1;
 }
 
@@ -239,14 +239,25 @@ FromFile::read(void *vdata, uint32_t dlen, ErrorHandler *errh)
     return dlen;
 }
 
+// Return a pointer to the first '\n' or '\r' in [s, e), or e if there is
+// none.  C libraries vectorize memchr; the '\r' search usually covers just
+// one line.
+static inline const unsigned char *
+find_line_end(const unsigned char *s, const unsigned char *e)
+{
+    const unsigned char *nl = (const unsigned char *) memchr(s, '\n', e - s);
+    if (!nl)
+	nl = e;
+    const unsigned char *cr = (const unsigned char *) memchr(s, '\r', nl - s);
+    return cr ? cr : nl;
+}
+
 int
 FromFile::read_line(String &result, ErrorHandler *errh, bool temporary)
 {
     // first, try to read a line from the current buffer
-    const unsigned char *s = _buffer + _pos;
+    const unsigned char *s = find_line_end(_buffer + _pos, _buffer + _len);
     const unsigned char *e = _buffer + _len;
-    while (s < e && *s != '\n' && *s != '\r')
-	s++;
     if (s < e && (*s == '\n' || s + 1 < e)) {
 	s += (*s == '\r' && s[1] == '\n' ? 2 : 1);
 	int new_pos = s - _buffer;
@@ -278,9 +289,8 @@ FromFile::read_line(String &result, ErrorHandler *errh, bool temporary)
 	    _pos = _len;
 	    done = true;
 	} else {
-	    s = _buffer, e = _buffer + _len;
-	    while (s < e && *s != '\n' && *s != '\r')
-		s++;
+	    e = _buffer + _len;
+	    s = find_line_end(_buffer, e);
 	    if (s < e && (*s == '\n' || s + 1 < e)) {
 		s += (*s == '\r' && s[1] == '\n' ? 2 : 1);
 		sa.append(_buffer, s - _buffer);
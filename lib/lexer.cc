@@ -33,6 +33,7 @@
 #include <click/straccum.hh>
 #include <click/variableenv.hh>
 #include <click/bitvector.hh>
+#include <click/routerimage.hh>
 #include <click/standard/errorelement.hh>
 #if CLICK_USERLEVEL
 # include <click/userutils.hh>
@@ -564,9 +565,9 @@ Lexer::end_parse(int cookie)
 {
   lexical_scoping_out(cookie);
 
-  for (TunnelEnd **tep = _tunnels.begin(); tep != _tunnels.end(); ++tep)
-    while (TunnelEnd *t = *tep) {
-      *tep = t->next();
+  for (HashTable<int, TunnelEnd *>::iterator it = _tunnels.begin(); it.live(); ++it)
+    while (TunnelEnd *t = it.value()) {
+      it.value() = t->next();
       delete t;
     }
   _tunnels.clear();
@@ -1092,12 +1093,14 @@ Lexer::get_element(String name, int etype, const String &conf,
 {
   assert(name && etype >= 0 && etype < _element_types.size());
 
-  // if an element 'name' already exists return it
-  if (_c->_element_map[name] >= 0)
-    return _c->_element_map[name];
+  // if an element 'name' already exists return it; otherwise claim the
+  // slot with a single hash table probe
+  HashTable<String, int>::iterator it = _c->_element_map.find_insert(name);
+  if (it.value() >= 0)
+    return it.value();
 
   int eid = _c->_elements.size();
-  _c->_element_map.set(name, eid);
+  it.value() = eid;
 
   // check 'name' for validity
   for (int i = 0; i < name.length(); i++) {
@@ -2174,7 +2177,23 @@ Lexer::create_router(Master *master)
   // expand compounds
   for (int i = 0; i < _global_scope.size(); i++)
     _c->scope().define(_global_scope.name(i), _global_scope.value(i), true);
+  // Size the element and tunnel tables for the expansion up front:
+  // rehashing a table of several hundred thousand names more than doubles
+  // expansion time for configurations with many compound instances.
   int initial_elements_size = _c->_elements.size();
+  int expected_elements = _c->_element_map.size(), expected_tunnels = 0;
+  for (int i = 0; i < initial_elements_size; i++) {
+    int etype = _c->_elements[i];
+    if (etype >= 0 && _element_types[etype].factory == compound_element_factory) {
+      expected_elements += ((Compound *) _element_types[etype].thunk)->_elements.size();
+      expected_tunnels += 3;
+    }
+  }
+  if (expected_elements > (int) _c->_element_map.bucket_count())
+    _c->_element_map.rehash(expected_elements);
+  if (expected_tunnels > (int) _tunnels.bucket_count())
+    _tunnels.rehash(expected_tunnels);
+
   for (int i = 0; i < initial_elements_size; i++)
     expand_compound_element(i, _c->scope());
 
@@ -2237,6 +2256,66 @@ Lexer::create_router(Master *master)
 }
 
 
+Router *
+Lexer::create_router(const RouterImage &image, Master *master, ErrorHandler *errh)
+{
+  // Look up every element class before creating anything, so that a
+  // configuration using an unknown class can fall back to the text parser
+  // (which reports the error properly).  Images store each class name once,
+  // so consecutive elements of one class share string data.
+  Vector<int> etypes(image.elements.size(), -1);
+  const char *last_class_data = 0;
+  int last_etype = -1;
+  for (int i = 0; i < image.elements.size(); i++) {
+    const String &class_name = image.elements[i].class_name;
+    if (class_name.data() != last_class_data) {
+      last_class_data = class_name.data();
+      last_etype = element_type(class_name);
+      if (last_etype <= TUNNEL_TYPE
+          || _element_types[last_etype].factory == compound_element_factory)
+        return 0;
+    }
+    etypes[i] = last_etype;
+  }
+
+  Router *router = new Router(image.configuration, master);
+  if (!router)
+    return 0;
+
+  for (int i = 0; i < image.elements.size(); i++) {
+    const RouterImage::ElementInfo &ei = image.elements[i];
+    const ElementType &et = _element_types[etypes[i]];
+    if (Element *e = (*et.factory)(et.thunk))
+      router->add_element(e, ei.name, ei.configuration, ei.filename, ei.lineno);
+    else {
+      errh->lerror(ei.filename + ":" + String(ei.lineno), "failed to create element %<%s%>", ei.name.c_str());
+      delete router;
+      return 0;
+    }
+  }
+
+  // Router::add_connection expects sorted connections
+  Vector<Connection> conn;
+  conn.reserve(image.connections.size());
+  bool sorted = true;
+  for (int i = 0; i < image.connections.size(); i++) {
+    const RouterImage::ConnectionInfo &ci = image.connections[i];
+    conn.push_back(Connection(ci.from_idx, ci.from_port, ci.to_idx, ci.to_port));
+    if (i && conn[i] < conn[i - 1])
+      sorted = false;
+  }
+  if (!sorted)
+    click_qsort(conn.begin(), conn.size());
+  for (Connection *cp = conn.begin(); cp != conn.end(); ++cp)
+    router->add_connection((*cp)[1].idx, (*cp)[1].port, (*cp)[0].idx, (*cp)[0].port);
+
+  for (int i = 0; i + 1 < image.requirements.size(); i += 2)
+    router->add_requirement(image.requirements[i], image.requirements[i+1]);
+
+  return router;
+}
+
+
 //
 // LEXEREXTRA
 //
@@ -2254,31 +2333,22 @@ LexerExtra::require(String, String, ErrorHandler *)
 Lexer::TunnelEnd *
 Lexer::find_tunnel(const Port &h, bool isoutput, bool insert)
 {
-  // binary search for tunnel
-  unsigned l = 0, r = _tunnels.size();
-  while (l < r) {
-    unsigned m = l + (r - l) / 2;
-    if (h.idx < _tunnels[m]->_port.idx)
-      r = m;
-    else if (h.idx > _tunnels[m]->_port.idx)
-      l = m + 1;
-    else {
-      l = m;
-      r = m + 1;
-      break;
-    }
+  // Tunnel ends are chained per element index.  A hash table keeps this
+  // constant time: compound expansion creates tunnels for elements in
+  // nonmonotonic index order, which made a sorted vector quadratic.
+  TunnelEnd **headp;
+  if (insert)
+    headp = &_tunnels.find_insert(h.idx).value();
+  else {
+    HashTable<int, TunnelEnd *>::iterator it = _tunnels.find(h.idx);
+    if (!it)
+      return 0;
+    headp = &it.value();
   }
 
-  // insert space if necessary
-  if (l >= r && insert) {
-    _tunnels.insert(_tunnels.begin() + l, 0);
-    ++r;
-  } else if (l >= r)
-    return 0;
-
   // find match
   TunnelEnd *match = 0;
-  for (TunnelEnd *te = _tunnels[l]; te; te = te->next())
+  for (TunnelEnd *te = *headp; te; te = te->next())
     if (te->isoutput() == isoutput && te->port().port == h.port)
       return te;
     else if (te->isoutput() == isoutput && te->port().port == 0)
@@ -2286,14 +2356,14 @@ Lexer::find_tunnel(const Port &h, bool isoutput, bool insert)
 
   // add new end if necessary
   if (match && !insert) {
-    TunnelEnd *te = new TunnelEnd(h, isoutput, _tunnels[l]);
-    _tunnels[l] = te;
+    TunnelEnd *te = new TunnelEnd(h, isoutput, *headp);
+    *headp = te;
     TunnelEnd *ote = find_tunnel(Port(match->other()->port().idx, h.port), !isoutput, true);
     te->pair_with(ote);
     return te;
   } else if (insert) {
-    TunnelEnd *te = new TunnelEnd(h, isoutput, _tunnels[l]);
-    _tunnels[l] = te;
+    TunnelEnd *te = new TunnelEnd(h, isoutput, *headp);
+    *headp = te;
     return te;
   } else
     return 0;
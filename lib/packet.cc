@@ -24,6 +24,7 @@
 #include <click/packet_anno.hh>
 #include <click/glue.hh>
 #include <click/sync.hh>
+#include <clicknet/ip.h>
 #if CLICK_USERLEVEL || CLICK_MINIOS
 # include <unistd.h>
 #endif
@@ -96,6 +97,26 @@ CLICK_DECLS
  *       +===========+================================+===========+
  * </pre>
  *
+ * <h3>Data Segments</h3>
+ *
+ * At user level, a packet's data may continue past end_data() in further
+ * <em>data segments</em>, each a packet whose own data follows the last.
+ * Segmented packets let packets share most of their data while owning
+ * private headers: split_clone() returns a clone whose first bytes are copied
+ * into a private buffer, and whose remaining data is a shared segment.  For a
+ * segmented packet, data() and length() cover only the first segment, and
+ * uniqueify() and push() copy only that segment; total_length() returns the
+ * length of the whole packet, and linearize() copies it into one buffer.
+ * Code that builds large packets, such as receive offload, can avoid copying
+ * data by chaining packets with append_segment().  Elements that read headers
+ * call pullup() to make just the headers contiguous, and in_cksum()
+ * checksums data that spans segments.  Most packets have no segments.
+ *
+ * Only elements whose Element::flags() include <tt>D</tt> see segmented
+ * packets.  Element::Port::push() and Element::Port::pull() linearize a
+ * segmented packet on its way into any other element, so code unaware of
+ * segments always sees the whole packet in data() and length().
+ *
  * Packet objects are implemented in different ways in different drivers.  The
  * userlevel driver has its own C++ implementation.  In the linuxmodule
  * driver, however, Packet is an overlay on Linux's native sk_buff
@@ -208,6 +229,10 @@ Packet::~Packet()
 #if CLICK_LINUXMODULE
     panic("Packet destructor");
 #else
+# if CLICK_USERLEVEL || CLICK_MINIOS
+    if (_segment)
+	kill_segments(_segment);
+# endif
     if (_data_packet)
 	_data_packet->kill();
 # if CLICK_USERLEVEL || CLICK_MINIOS
@@ -683,16 +708,256 @@ Packet::clone()
     p->_data_packet = origin;
 # if CLICK_USERLEVEL || CLICK_MINIOS
     p->_destructor = 0;
+    p->_segment = 0;
 # else
     p->_m = m;
 # endif
     // increment our reference count because of _data_packet reference
     origin->_use_count++;
+# if CLICK_USERLEVEL || CLICK_MINIOS
+    if (_segment && !(p->_segment = _segment->clone())) {
+	p->kill();
+	return 0;
+    }
+# endif
     return p;
 
 #endif /* CLICK_LINUXMODULE */
 }
 
+#if CLICK_USERLEVEL || CLICK_MINIOS
+static inline unsigned char *
+split_header(unsigned char *h, const unsigned char *data, int32_t lo,
+	     uint32_t len, unsigned char *new_data)
+{
+    if (h && h >= data + lo && h <= data + len)
+	return new_data + (h - data);
+    else
+	return 0;
+}
+#endif
+
+/** @brief Create a clone of this packet with private headers.
+ * @param len number of leading data bytes to copy
+ * @param headroom headroom for the copied bytes
+ * @return the clone, or null if there's no memory for it
+ *
+ * The returned clone's first @a len bytes of data are copied into a new,
+ * unshared buffer with @a headroom bytes of headroom.  The rest of its data
+ * is shared with this packet, as by clone(), in a data segment that follows
+ * the copy (see next_segment()).  Since uniqueify() and push() affect only
+ * the first segment, elements that rewrite or prepend headers can modify the
+ * clone without copying the rest of the packet.
+ *
+ * The clone's annotations are copied from this packet.  Header annotations
+ * that point into the first @a len bytes, or into the headroom, point into
+ * the copy, and the headroom they cover is copied too; other header
+ * annotations are cleared.
+ *
+ * Outside user level, split_clone() is equivalent to clone(). */
+Packet *
+Packet::split_clone(uint32_t len, uint32_t headroom)
+{
+#if CLICK_USERLEVEL || CLICK_MINIOS
+    if (len > length())
+	len = length();
+
+    // Also copy the headroom containing any header before data().
+    int32_t lo = 0;
+    unsigned char *hdr[3] = { _aa.mac, _aa.nh, _aa.h };
+    for (int i = 0; i < 3; ++i)
+	if (hdr[i] && hdr[i] >= _head && hdr[i] - _data < lo)
+	    lo = hdr[i] - _data;
+
+    WritablePacket *q = make(headroom, _data + lo, len - lo, 0);
+    if (!q)
+	return 0;
+    q->_data -= lo;
+    q->copy_annotations(this);
+    q->_aa.mac = split_header(_aa.mac, _data, lo, len, q->_data);
+    q->_aa.nh = split_header(_aa.nh, _data, lo, len, q->_data);
+    q->_aa.h = split_header(_aa.h, _data, lo, len, q->_data);
+
+    Packet *t = 0;
+    if (len < length()) {
+	if ((t = clone()))
+	    t->_data += len;
+    } else if (_segment)
+	t = _segment->clone();
+    if (!t && (len < length() || _segment)) {
+	q->kill();
+	return 0;
+    }
+    q->_segment = t;
+    return q;
+#else
+    (void) len, (void) headroom;
+    return clone();
+#endif
+}
+
+/** @brief Calculate an Internet checksum over packet data.
+ * @param start first byte to checksum, within the first segment
+ * @param len number of bytes to checksum
+ *
+ * Like click_in_cksum(@a start, @a len), except that the data may continue
+ * past end_data() into the packet's later segments.
+ *
+ * @sa has_segments */
+uint16_t
+Packet::in_cksum(const unsigned char *start, uint32_t len) const
+{
+#if CLICK_USERLEVEL || CLICK_MINIOS
+    if (_segment) {
+	const Packet *s = this;
+	uint32_t n = _tail - start, pos = 0, sum = 0;
+	while (1) {
+	    if (n > len)
+		n = len;
+	    uint32_t part = ~click_in_cksum(start, n) & 0xFFFF;
+	    // a part that starts at an odd offset contributes byte-swapped
+	    if (pos & 1)
+		part = ((part & 0xFF) << 8) | (part >> 8);
+	    sum += part;
+	    pos += n;
+	    len -= n;
+	    if (!len || !(s = s->_segment))
+		break;
+	    start = s->_data;
+	    n = s->length();
+	}
+	sum = (sum & 0xFFFF) + (sum >> 16);
+	sum += sum >> 16;
+	return ~sum & 0xFFFF;
+    }
+#endif
+    return click_in_cksum(start, len);
+}
+
+#if CLICK_USERLEVEL || CLICK_MINIOS
+void
+Packet::kill_segments(Packet *s)
+{
+    while (s) {
+	Packet *next = s->_segment;
+	s->_segment = 0;
+	s->kill();
+	s = next;
+    }
+}
+
+Packet *
+Packet::expensive_linearize()
+{
+    uint32_t slen = total_length() - length();
+    WritablePacket *q;
+    if (!shared() && tailroom() >= slen)
+	q = static_cast<WritablePacket *>(this);
+    else if (!(q = expensive_uniqueify(0, tailroom() < slen ? slen - tailroom() : 0, true)))
+	return 0;
+
+    Packet *chain = q->_segment;
+    q->_segment = 0;
+    for (Packet *s = chain; s; s = s->_segment) {
+	memcpy(q->_tail, s->_data, s->length());
+	q->_tail += s->length();
+    }
+    kill_segments(chain);
+    return q;
+}
+
+/** @brief Append a data segment to this packet.
+ * @param segment packet whose data follows this packet's data
+ *
+ * The data of @a segment, and of any segments it has, is added to the end of
+ * this packet's data, after its last segment.  This packet takes ownership
+ * of @a segment, whose annotations are ignored from now on.  No data is
+ * copied.  @a segment may be a clone that shares its data with other
+ * packets.
+ *
+ * @note Only available at user level */
+void
+Packet::append_segment(Packet *segment)
+{
+    Packet **pp = &_segment;
+    while (*pp)
+	pp = &(*pp)->_segment;
+    *pp = segment;
+}
+
+Packet *
+Packet::expensive_pullup(uint32_t len)
+{
+    uint32_t total = total_length();
+    if (len > total)
+	len = total;
+    uint32_t need = len - length();
+    WritablePacket *q;
+    if (!shared() && tailroom() >= need)
+	q = static_cast<WritablePacket *>(this);
+    else if (!(q = expensive_uniqueify(0, tailroom() < need ? need - tailroom() : 0, true)))
+	return 0;
+
+    while (need) {
+	Packet *s = q->_segment;
+	uint32_t n = s->length() < need ? s->length() : need;
+	memcpy(q->_tail, s->_data, n);
+	q->_tail += n;
+	s->_data += n;
+	need -= n;
+	if (s->_data == s->_tail) {
+	    q->_segment = s->_segment;
+	    s->_segment = 0;
+	    s->kill();
+	}
+    }
+    return q;
+}
+
+void
+Packet::pull_segments(uint32_t nbytes)
+{
+    uint32_t total = total_length();
+    if (nbytes > total) {
+	click_chatter("Packet::pull %d > length %d\n", nbytes, total);
+	nbytes = total;
+    }
+    nbytes -= length();
+    _data = _tail;
+    while (nbytes) {
+	Packet *s = _segment;
+	uint32_t n = s->length() < nbytes ? s->length() : nbytes;
+	s->_data += n;
+	nbytes -= n;
+	if (s->_data == s->_tail) {
+	    _segment = s->_segment;
+	    s->_segment = 0;
+	    s->kill();
+	}
+    }
+}
+
+void
+Packet::take_segments(uint32_t nbytes)
+{
+    uint32_t total = total_length();
+    if (nbytes > total) {
+	click_chatter("Packet::take %d > length %d\n", nbytes, total);
+	nbytes = total;
+    }
+    uint32_t keep = total - nbytes;
+    Packet *s = this;
+    while (keep > s->length()) {
+	keep -= s->length();
+	s = s->_segment;
+    }
+    s->_tail = s->_data + keep;
+    Packet *rest = s->_segment;
+    s->_segment = 0;
+    kill_segments(rest);
+}
+#endif
+
 WritablePacket *
 Packet::expensive_uniqueify(int32_t extra_headroom, int32_t extra_tailroom,
 			    bool free_on_failure)
@@ -864,6 +1129,12 @@ Packet::expensive_push(uint32_t nbytes)
 WritablePacket *
 Packet::expensive_put(uint32_t nbytes)
 {
+#if CLICK_USERLEVEL || CLICK_MINIOS
+  if (_segment) {
+    Packet *p = expensive_linearize();
+    return p ? p->put(nbytes) : 0;
+  }
+#endif
   static int chatter = 0;
   if (tailroom() < nbytes && chatter < 5) {
     click_chatter("expensive Packet::put; have %d wanted %d",
@@ -0,0 +1,445 @@
+// -*- c-basic-offset: 4; related-file-name: "../include/click/profiler.hh" -*-
+/*
+ * profiler.{cc,hh} -- samples and times packet transfers
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include <click/profiler.hh>
+#include <click/router.hh>
+#include <click/master.hh>
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/straccum.hh>
+#include <click/integers.hh>
+#if CLICK_PROFILE
+CLICK_DECLS
+
+volatile uint32_t Element::Port::nprofiling = 0;
+
+Profiler::Profiler(Router *router)
+    : _router(router), _period(0)
+{
+#if HAVE_MULTITHREAD
+    _nthreads = click_max_cpu_ids();
+#else
+    _nthreads = 1;
+#endif
+    _threads = new Thread[_nthreads];
+    for (int i = 0; i < _nthreads; ++i) {
+        Thread &t = _threads[i];
+        t.countdown = 1;
+        t.seed = 2654435761U * (i + 1);
+        t.depth = 0;
+        t.sampled = 0;
+        t.node = 0;
+        t.child_cycles = 0;
+        t.elements.resize(router->nelements(), ElementStats());
+        Node root = { -1, -1, 0 };
+        t.nodes.push_back(root);
+    }
+}
+
+Profiler::~Profiler()
+{
+    if (_period)
+        --Element::Port::nprofiling;
+    delete[] _threads;
+}
+
+/** @brief Sample about one in @a period transfers, or stop if @a period is 0. */
+void
+Profiler::set_period(uint32_t period)
+{
+    if (period && !_period)
+        ++Element::Port::nprofiling;
+    else if (!period && _period)
+        --Element::Port::nprofiling;
+    _period = period;
+    // A countdown left from a long period would delay the first sample.
+    for (int i = 0; i < _nthreads; ++i)
+        _threads[i].countdown = 1;
+}
+
+/** @brief Discard all samples. */
+void
+Profiler::reset()
+{
+    // Samples in progress still refer to nodes, so only their counts go.
+    for (int i = 0; i < _nthreads; ++i) {
+        Thread &t = _threads[i];
+        t.lock.acquire();
+        memset(t.elements.begin(), 0, sizeof(ElementStats) * t.elements.size());
+        for (Node *n = t.nodes.begin(); n != t.nodes.end(); ++n)
+            n->cycles = 0;
+        for (HashTable<uintptr_t, uint32_t>::iterator it = t.edges.begin();
+             it.live(); ++it)
+            it.value() = 0;
+        t.lock.release();
+    }
+}
+
+/* Returns the running thread's slot, or null if it has none.  Two threads
+   must never share a slot, so threads other than router threads, which have
+   no identifier of their own, are not sampled. */
+inline Profiler::Thread *
+Profiler::thread()
+{
+#if CLICK_USERLEVEL && HAVE_MULTITHREAD && HAVE___THREAD_STORAGE_CLASS
+    if (!(click_current_thread_id & 0x40000000))
+        return 0;
+#elif CLICK_USERLEVEL && HAVE_MULTITHREAD
+    // sched_getcpu() can name the same CPU in two threads at once.
+    return 0;
+#endif
+    unsigned id = click_current_cpu_id();
+    return id < (unsigned) _nthreads ? &_threads[id] : 0;
+}
+
+inline uint32_t
+Profiler::next_countdown(Thread &t)
+{
+    // Uniform on [1, 2 * period - 1], so the mean is period but sampling
+    // cannot lock onto a periodic traffic pattern.
+    t.seed ^= t.seed << 13;
+    t.seed ^= t.seed >> 17;
+    t.seed ^= t.seed << 5;
+    return 1 + t.seed % (2 * (uint64_t) _period - 1);
+}
+
+int
+Profiler::child_node(Thread &t, int parent, int eindex)
+{
+    uint64_t key = ((uint64_t) parent << 32) | (uint32_t) eindex;
+    t.lock.acquire();
+    int &n = t.node_map[key];
+    if (!n) {
+        Node node = { parent, eindex, 0 };
+        n = t.nodes.size();
+        t.nodes.push_back(node);
+    }
+    int result = n;
+    t.lock.release();
+    return result;
+}
+
+/* Only transfers that start outside any other transfer count down to a
+   sample, so a sample follows its packet from where it was introduced.
+   The caller sets s.thread from thread().  Returns true if the transfer is sampled.  The caller ends a sampled
+   transfer with leave() and an unsampled one by decrementing the thread's
+   depth. */
+inline bool
+Profiler::enter(Sample &s, const Element *from, const Element *to)
+{
+    Thread &t = *s.thread;
+    if (!t.sampled) {
+        if (t.depth++ || --t.countdown)
+            return false;
+        t.countdown = next_countdown(t);
+        t.node = child_node(t, 0, from->eindex());
+        t.child_cycles = 0;
+    } else
+        ++t.depth;
+    s.begin = click_get_cycles();
+    s.parent_node = t.node;
+    s.parent_child_cycles = t.child_cycles;
+    t.node = child_node(t, t.node, to->eindex());
+    t.child_cycles = 0;
+    ++t.sampled;
+    s.start = click_get_cycles();
+    return true;
+}
+
+inline void
+Profiler::leave(Sample &s, uintptr_t edge, bool moved)
+{
+    click_cycles_t end = click_get_cycles();
+    Thread &t = *s.thread;
+    --t.depth;
+    --t.sampled;
+    if (moved) {
+        click_cycles_t all = end - s.start;
+        click_cycles_t own = all > t.child_cycles ? all - t.child_cycles : 0;
+        int b = own ? 64 - ffs_msb((uint64_t) own) : 0;
+        if (b >= nbuckets)
+            b = nbuckets - 1;
+        t.lock.acquire();
+        ElementStats &es = t.elements[t.nodes[t.node].eindex];
+        ++es.samples;
+        es.cycles += own;
+        ++es.hist[b];
+        t.nodes[t.node].cycles += own;
+        ++t.edges[edge];
+        t.lock.release();
+    }
+    t.node = s.parent_node;
+    // The parent's own cycles exclude this transfer, including the time
+    // spent recording it.
+    if (moved)
+        t.child_cycles = s.parent_child_cycles + (click_get_cycles() - s.begin);
+    else
+        t.child_cycles = s.parent_child_cycles;
+}
+
+void
+Element::Port::sampled_push(Packet *p) const
+{
+    Profiler *prof = _owner->router()->profiler();
+    Profiler::Sample s;
+    if (!prof || !prof->_period || !(s.thread = prof->thread()))
+        xfer_push(p);
+    else if (!prof->enter(s, _owner, _e)) {
+        xfer_push(p);
+        --s.thread->depth;
+    } else {
+        xfer_push(p);
+        prof->leave(s, reinterpret_cast<uintptr_t>(this), true);
+    }
+}
+
+Packet *
+Element::Port::sampled_pull() const
+{
+    Profiler *prof = _owner->router()->profiler();
+    Profiler::Sample s;
+    Packet *p;
+    if (!prof || !prof->_period || !(s.thread = prof->thread()))
+        p = xfer_pull();
+    else if (!prof->enter(s, _owner, _e)) {
+        p = xfer_pull();
+        --s.thread->depth;
+    } else {
+        p = xfer_pull();
+        prof->leave(s, reinterpret_cast<uintptr_t>(this) | 1, p != 0);
+    }
+    return p;
+}
+
+
+// REPORTING
+
+void
+Profiler::merge_elements(Vector<ElementStats> &stats) const
+{
+    stats.assign(_router->nelements(), ElementStats());
+    for (int i = 0; i < _nthreads; ++i) {
+        Thread &t = _threads[i];
+        t.lock.acquire();
+        for (int e = 0; e < stats.size(); ++e) {
+            stats[e].samples += t.elements[e].samples;
+            stats[e].cycles += t.elements[e].cycles;
+            for (int b = 0; b < nbuckets; ++b)
+                stats[e].hist[b] += t.elements[e].hist[b];
+        }
+        t.lock.release();
+    }
+}
+
+String
+Profiler::unparse_elements() const
+{
+    Vector<ElementStats> stats;
+    merge_elements(stats);
+    StringAccum sa;
+    for (int e = 0; e < stats.size(); ++e)
+        if (stats[e].samples)
+            sa << _router->ename(e) << ' ' << _router->element(e)->class_name()
+               << ' ' << stats[e].samples << ' ' << stats[e].cycles << ' '
+               << int_divide(stats[e].cycles, stats[e].samples) << '\n';
+    return sa.take_string();
+}
+
+String
+Profiler::unparse_histograms() const
+{
+    Vector<ElementStats> stats;
+    merge_elements(stats);
+    StringAccum sa;
+    for (int e = 0; e < stats.size(); ++e)
+        if (stats[e].samples) {
+            sa << _router->ename(e);
+            for (int b = 0; b < nbuckets; ++b)
+                if (stats[e].hist[b])
+                    sa << ' ' << (b ? (uint64_t) 1 << b : 0)
+                       << ':' << stats[e].hist[b];
+            sa << '\n';
+        }
+    return sa.take_string();
+}
+
+namespace {
+struct PortInfo {
+    int eindex;
+    int port;
+};
+
+int
+string_compar(const void *ap, const void *bp, void *user_data)
+{
+    const String *strs = static_cast<const String *>(user_data);
+    return String::compare(strs[*static_cast<const int *>(ap)],
+                           strs[*static_cast<const int *>(bp)]);
+}
+
+String
+sorted_lines(const Vector<String> &lines)
+{
+    Vector<int> order;
+    for (int i = 0; i < lines.size(); ++i)
+        order.push_back(i);
+    click_qsort(order.begin(), order.size(), sizeof(int), string_compar,
+                const_cast<String *>(lines.begin()));
+    StringAccum sa;
+    for (int i = 0; i < order.size(); ++i)
+        sa << lines[order[i]] << '\n';
+    return sa.take_string();
+}
+}
+
+String
+Profiler::unparse_edges() const
+{
+    // Push samples are keyed by output port, pull samples by input port.
+    HashTable<uintptr_t, PortInfo> ports;
+    for (int e = 0; e < _router->nelements(); ++e) {
+        Element *elt = _router->element(e);
+        for (int i = 0; i < elt->noutputs(); ++i) {
+            PortInfo pi = { e, i };
+            ports[reinterpret_cast<uintptr_t>(&elt->output(i))] = pi;
+        }
+        for (int i = 0; i < elt->ninputs(); ++i) {
+            PortInfo pi = { e, i };
+            ports[reinterpret_cast<uintptr_t>(&elt->input(i)) | 1] = pi;
+        }
+    }
+
+    HashTable<uintptr_t, uint32_t> edges;
+    for (int i = 0; i < _nthreads; ++i) {
+        Thread &t = _threads[i];
+        t.lock.acquire();
+        for (HashTable<uintptr_t, uint32_t>::const_iterator it = t.edges.begin();
+             it.live(); ++it)
+            edges[it.key()] += it.value();
+        t.lock.release();
+    }
+
+    Vector<String> lines;
+    for (HashTable<uintptr_t, uint32_t>::iterator it = edges.begin();
+         it.live(); ++it) {
+        PortInfo pi = ports.get(it.key());
+        if (!it.value())
+            continue;
+        Element *owner = _router->element(pi.eindex);
+        const Element::Port &port = it.key() & 1 ? owner->input(pi.port)
+            : owner->output(pi.port);
+        StringAccum sa;
+        if (it.key() & 1)
+            sa << port.element()->name() << " [" << port.port() << "] -> ["
+               << pi.port << "] " << owner->name();
+        else
+            sa << owner->name() << " [" << pi.port << "] -> ["
+               << port.port() << "] " << port.element()->name();
+        sa << ' ' << it.value();
+        lines.push_back(sa.take_string());
+    }
+    return sorted_lines(lines);
+}
+
+String
+Profiler::unparse_folded() const
+{
+    HashTable<String, click_cycles_t> stacks;
+    for (int i = 0; i < _nthreads; ++i) {
+        Thread &t = _threads[i];
+        t.lock.acquire();
+        // Parents precede their children.
+        Vector<String> paths(t.nodes.size(), String());
+        for (int n = 1; n < t.nodes.size(); ++n) {
+            const Node &node = t.nodes[n];
+            String frame = _router->ename(node.eindex);
+            paths[n] = node.parent ? paths[node.parent] + ";" + frame : frame;
+            if (node.cycles)
+                stacks[paths[n]] += node.cycles;
+        }
+        t.lock.release();
+    }
+
+    Vector<String> lines;
+    for (HashTable<String, click_cycles_t>::iterator it = stacks.begin();
+         it.live(); ++it)
+        lines.push_back(it.key() + " " + String(it.value()));
+    return sorted_lines(lines);
+}
+
+enum { h_sample, h_elements, h_histograms, h_edges, h_folded, h_reset };
+
+String
+Profiler::read_handler(Element *e, void *thunk)
+{
+    Router *r = (e ? e->router() : 0);
+    Profiler *prof = (r ? r->profiler() : 0);
+    if (!prof)
+        return (intptr_t) thunk == h_sample ? String("0") : String();
+    switch ((intptr_t) thunk) {
+    case h_sample:
+        return String(prof->_period);
+    case h_elements:
+        return prof->unparse_elements();
+    case h_histograms:
+        return prof->unparse_histograms();
+    case h_edges:
+        return prof->unparse_edges();
+    case h_folded:
+        return prof->unparse_folded();
+    default:
+        return String();
+    }
+}
+
+int
+Profiler::write_handler(const String &str, Element *e, void *thunk, ErrorHandler *errh)
+{
+    Router *r = (e ? e->router() : 0);
+    if (!r)
+        return 0;
+    switch ((intptr_t) thunk) {
+    case h_sample: {
+        uint32_t period;
+        if (!IntArg().parse(cp_uncomment(str), period))
+            return errh->error("syntax error");
+        if (period || r->profiler())
+            r->force_profiler()->set_period(period);
+        return 0;
+    }
+    case h_reset:
+        if (Profiler *prof = r->profiler())
+            prof->reset();
+        return 0;
+    default:
+        return 0;
+    }
+}
+
+void
+Profiler::static_initialize()
+{
+    Router::add_read_handler(0, "profile_sample", read_handler, (void *) h_sample);
+    Router::add_write_handler(0, "profile_sample", write_handler, (void *) h_sample);
+    Router::add_read_handler(0, "profile_elements", read_handler, (void *) h_elements);
+    Router::add_read_handler(0, "profile_histograms", read_handler, (void *) h_histograms);
+    Router::add_read_handler(0, "profile_edges", read_handler, (void *) h_edges);
+    Router::add_read_handler(0, "profile_folded", read_handler, (void *) h_folded);
+    Router::add_write_handler(0, "profile_reset", write_handler, (void *) h_reset, Handler::BUTTON);
+}
+
+CLICK_ENDDECLS
+#endif
@@ -28,15 +28,16 @@
 #include <click/straccum.hh>
 #include <click/elemfilter.hh>
 #include <click/routervisitor.hh>
+#if CLICK_PROFILE
+# include <click/profiler.hh>
+#endif
 #include <click/confparse.hh>
 #include <click/timer.hh>
 #include <click/master.hh>
 #include <click/notifier.hh>
 #include <click/nameinfo.hh>
 #include <click/bighashmap_arena.hh>
-#if CLICK_STATS >= 2
-# include <click/hashtable.hh>
-#endif
+#include <click/hashtable.hh>
 #include <click/standard/errorelement.hh>
 #include <click/standard/threadsched.hh>
 #if CLICK_BSDMODULE
@@ -87,6 +88,9 @@ Router::Router(const String &configuration, Master *master)
 {
     _refcount = 0;
     _runcount = 0;
+#if CLICK_PROFILE
+    _profiler = 0;
+#endif
     _root_element = new ErrorElement;
     _root_element->attach_router(this, -1);
     master->register_router(this);
@@ -151,6 +155,9 @@ Router::~Router()
         delete ns;
     }
     delete _name_info;
+#if CLICK_PROFILE
+    delete _profiler;
+#endif
     if (_master)
         _master->unregister_router(this);
 }
@@ -1098,6 +1105,7 @@ Router::initialize(ErrorHandler *errh)
     _attachment_names.clear();
     _attachments.clear();
 
+    Timestamp phase_start = Timestamp::now();
     if (check_hookup_elements(errh) < 0)
         return -1;
 
@@ -1128,6 +1136,8 @@ Router::initialize(ErrorHandler *errh)
             all_ok = true;
         }
     }
+    Timestamp now = Timestamp::now();
+    add_startup_phase("hookup", now - phase_start);
 
     // prepare master
     _runcount = 1;
@@ -1137,10 +1147,13 @@ Router::initialize(ErrorHandler *errh)
 #endif
 
     // Configure all elements in configure order. Remember the ones that failed
+    Vector<Timestamp> configure_time(nelements(), Timestamp());
+    Vector<Timestamp> initialize_time(nelements(), Timestamp());
     if (all_ok) {
         Vector<String> conf;
         // Set the random seed to a "truly random" value by default.
         click_random_srandom();
+        phase_start = now = Timestamp::now();
         for (int ord = 0; ord < _elements.size(); ord++) {
             int i = _element_configure_order[ord], r;
 #if CLICK_DMALLOC
@@ -1151,7 +1164,11 @@ Router::initialize(ErrorHandler *errh)
             assert(!cerrh.nerrors());
             conf.clear();
             cp_argvec(_element_configurations[i], conf);
-            if ((r = _elements[i]->configure(conf, &cerrh)) < 0) {
+            r = _elements[i]->configure(conf, &cerrh);
+            Timestamp done = Timestamp::now();
+            configure_time[i] = done - now;
+            now = done;
+            if (r < 0) {
                 element_stage[i] = Element::CLEANUP_CONFIGURE_FAILED;
                 all_ok = false;
                 if (!cerrh.nerrors()) {
@@ -1171,10 +1188,15 @@ Router::initialize(ErrorHandler *errh)
 
     // Initialize elements if OK so far.
     if (all_ok) {
+        add_startup_phase("configure", now - phase_start);
         _state = ROUTER_PREINITIALIZE;
+        phase_start = now;
         initialize_handlers(true, true);
+        now = Timestamp::now();
+        add_startup_phase("handlers", now - phase_start);
+        phase_start = now;
         for (int ord = 0; all_ok && ord < _elements.size(); ord++) {
-            int i = _element_configure_order[ord];
+            int i = _element_configure_order[ord], r;
             assert(element_stage[i] == Element::CLEANUP_CONFIGURED);
 #if CLICK_DMALLOC
             sprintf(dmalloc_buf, "i%d  ", i);
@@ -1182,7 +1204,11 @@ Router::initialize(ErrorHandler *errh)
 #endif
             RouterContextErrh cerrh(errh, "While initializing", element(i));
             assert(!cerrh.nerrors());
-            if (_elements[i]->initialize(&cerrh) >= 0)
+            r = _elements[i]->initialize(&cerrh);
+            Timestamp done = Timestamp::now();
+            initialize_time[i] = done - now;
+            now = done;
+            if (r >= 0)
                 element_stage[i] = Element::CLEANUP_INITIALIZED;
             else {
                 // don't report 'unspecified error' for ErrorElements:
@@ -1193,12 +1219,15 @@ Router::initialize(ErrorHandler *errh)
                 all_ok = false;
             }
         }
+        add_startup_phase("initialize", now - phase_start);
     }
 
 #if CLICK_DMALLOC
     CLICK_DMALLOC_REG("iXXX");
 #endif
 
+    record_startup_classes(configure_time, initialize_time);
+
     // If there were errors, uninitialize any elements that we initialized
     // successfully and return -1 (error). Otherwise, we're all set!
     if (all_ok) {
@@ -1236,6 +1265,42 @@ Router::initialize(ErrorHandler *errh)
     }
 }
 
+/** @brief  Record the duration of a startup phase.
+ *  @param  name      phase name
+ *  @param  duration  time spent in the phase
+ *
+ *  The router records its own configure, handler, and initialize phases.
+ *  Drivers may add others, such as parsing.  The results are reported by
+ *  the global "startup_profile" handler. */
+void
+Router::add_startup_phase(const String &name, const Timestamp &duration)
+{
+    _startup_phase_names.push_back(name);
+    _startup_phase_times.push_back(duration);
+}
+
+void
+Router::record_startup_classes(const Vector<Timestamp> &configure_time,
+                               const Vector<Timestamp> &initialize_time)
+{
+    HashTable<String, int> class_map(-1);
+    _startup_classes.clear();
+    for (int i = 0; i < _elements.size(); ++i) {
+        String cname = String::make_stable(_elements[i]->class_name());
+        int &x = class_map[cname];
+        if (x < 0) {
+            x = _startup_classes.size();
+            _startup_classes.push_back(startup_class_t());
+            _startup_classes[x].name = cname;
+            _startup_classes[x].nelements = 0;
+        }
+        startup_class_t &sc = _startup_classes[x];
+        ++sc.nelements;
+        sc.configure_time += configure_time[i];
+        sc.initialize_time += initialize_time[i];
+    }
+}
+
 void
 Router::activate(bool foreground, ErrorHandler *errh)
 {
@@ -1406,7 +1471,11 @@ Router::find_ehandler(int eindex, const String &hname, bool allow_star) const
     while (eh >= 0) {
         int h = _ehandler_to_handler[eh];
         const String &hn = xhandler(h)->name();
-        if (hn == hname)
+        // Stored handler names are interned by store_local_handler(), so
+        // compare lengths and data pointers before falling back to memcmp.
+        if (hn.length() == hname.length()
+            && (hn.data() == hname.data()
+                || memcmp(hn.data(), hname.data(), hn.length()) == 0))
             return eh;
         else if (hn.length() == 1 && hn[0] == '*')
             star_h = h;
@@ -1434,14 +1503,7 @@ Router::fetch_handler(const Element* e, const String& name)
 void
 Router::store_local_handler(int eindex, Handler &to_store)
 {
-    int old_eh = find_ehandler(eindex, to_store.name(), false);
-    if (old_eh >= 0) {
-        Handler *old_h = xhandler(_ehandler_to_handler[old_eh]);
-        to_store.combine(*old_h);
-        old_h->_use_count--;
-    }
-
-    // find the offset in _name_handlers
+    // find the offset in _name_handlers, interning the handler's name
     int name_index;
     {
         int *l = _handler_first_by_name.begin();
@@ -1465,6 +1527,13 @@ Router::store_local_handler(int eindex, Handler &to_store)
         name_index = l - _handler_first_by_name.begin();
     }
 
+    int old_eh = find_ehandler(eindex, to_store.name(), false);
+    if (old_eh >= 0) {
+        Handler *old_h = xhandler(_ehandler_to_handler[old_eh]);
+        to_store.combine(*old_h);
+        old_h->_use_count--;
+    }
+
     // find a similar handler, if any exists
     int* prev_h = &_handler_first_by_name[name_index];
     int h = *prev_h;
@@ -1958,6 +2027,17 @@ Router::force_name_info()
 }
 /** @endcond never */
 
+#if CLICK_PROFILE
+/** @brief  Create (if necessary) and return the router's sampling profiler. */
+Profiler*
+Router::force_profiler()
+{
+    if (!_profiler)
+        _profiler = new Profiler(this);
+    return _profiler;
+}
+#endif
+
 
 // PRINTING
 
@@ -2187,7 +2267,8 @@ Router::configuration_string() const
 enum { GH_VERSION, GH_CONFIG, GH_FLATCONFIG, GH_LIST, GH_REQUIREMENTS,
        GH_DRIVER, GH_ACTIVE_PORTS, GH_ACTIVE_PORT_STATS, GH_STRING_PROFILE,
        GH_STRING_PROFILE_LONG, GH_SCHEDULING_PROFILE, GH_STOP,
-       GH_ELEMENT_CYCLES, GH_CLASS_CYCLES, GH_RESET_CYCLES };
+       GH_ELEMENT_CYCLES, GH_CLASS_CYCLES, GH_RESET_CYCLES,
+       GH_STARTUP_PROFILE };
 
 #if CLICK_STATS >= 2
 struct stats_info {
@@ -2245,6 +2326,19 @@ Router::router_read_handler(Element *e, void *thunk)
         break;
 #endif
 
+    case GH_STARTUP_PROFILE:
+        if (!r)
+            break;
+        for (int i = 0; i < r->_startup_phase_names.size(); ++i)
+            sa << "phase " << r->_startup_phase_names[i] << ' '
+               << r->_startup_phase_times[i] << '\n';
+        for (int i = 0; i < r->_startup_classes.size(); ++i) {
+            const startup_class_t &sc = r->_startup_classes[i];
+            sa << "class " << sc.name << ' ' << sc.nelements << ' '
+               << sc.configure_time << ' ' << sc.initialize_time << '\n';
+        }
+        break;
+
 #if CLICK_STATS >= 1
     case GH_ACTIVE_PORTS:
         if (r)
@@ -2419,6 +2513,7 @@ Router::static_initialize()
         add_read_handler(0, "handlers", Element::read_handlers_handler, 0);
         add_read_handler(0, "list", router_read_handler, (void *)GH_LIST);
         add_write_handler(0, "stop", router_write_handler, (void *)GH_STOP);
+        add_read_handler(0, "startup_profile", router_read_handler, (void *)GH_STARTUP_PROFILE);
 #if CLICK_STATS >= 1
         add_read_handler(0, "active_ports", router_read_handler, (void *)GH_ACTIVE_PORTS);
         add_read_handler(0, "active_port_stats", router_read_handler, (void *)GH_ACTIVE_PORT_STATS);
@@ -2436,6 +2531,9 @@ Router::static_initialize()
         add_read_handler(0, "element_cycles.csv", router_read_handler, (void *)GH_ELEMENT_CYCLES);
         add_read_handler(0, "class_cycles.csv", router_read_handler, (void *)GH_CLASS_CYCLES);
         add_write_handler(0, "reset_cycles", router_write_handler, (void *)GH_RESET_CYCLES);
+#endif
+#if CLICK_PROFILE
+        Profiler::static_initialize();
 #endif
     }
 }
@@ -0,0 +1,227 @@
+// -*- related-file-name: "../include/click/routerimage.hh" -*-
+/*
+ * routerimage.{cc,hh} -- precompiled router images
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+
+#include <click/glue.hh>
+#include <click/routerimage.hh>
+#include <click/error.hh>
+#include <click/straccum.hh>
+#include <click/hashtable.hh>
+#include <click/crc32.h>
+#include <stddef.h>
+CLICK_DECLS
+
+/* Image file format, all integers in host byte order:
+
+   header			struct header
+   element records		nelements * struct element_record
+   connection records		nconnections * 4 uint32s
+   requirement records		nrequirements * 4 uint32s (type and value
+				string references)
+   string table			strings_length bytes
+   configuration text		text_length bytes, then a NUL
+
+   The body checksum is the CRC-32 of everything before the configuration
+   text, skipping header.body_checksum itself.  The text checksum is the
+   CRC-32 of the text. */
+
+const char RouterImage::magic[8] = { '\177', 'C', 'L', 'K', 'I', 'M', 'G', '\n' };
+
+bool
+RouterImage::is_image(const String &data)
+{
+    return data.length() >= (int) sizeof(magic)
+	&& memcmp(data.data(), magic, sizeof(magic)) == 0;
+}
+
+uint32_t
+RouterImage::body_checksum(const char *data, uint32_t end)
+{
+    const uint32_t field = offsetof(header, body_checksum);
+    uint32_t crc = update_crc(0xFFFFFFFFU, data, field);
+    return update_crc(crc, data + field + sizeof(uint32_t),
+		      end - field - sizeof(uint32_t));
+}
+
+namespace {
+struct StringTable {
+    StringAccum sa;
+    HashTable<String, uint32_t> offsets;
+
+    void add(const String &s, uint32_t *ref) {
+	HashTable<String, uint32_t>::iterator it = offsets.find(s);
+	if (!it) {
+	    it = offsets.find_insert(s);
+	    it.value() = sa.length();
+	    sa.append(s.data(), s.length());
+	    sa.append('\0');
+	}
+	ref[0] = it.value();
+	ref[1] = s.length();
+    }
+};
+}
+
+String
+RouterImage::unparse() const
+{
+    StringTable strings;
+
+    Vector<element_record> erecs(elements.size(), element_record());
+    for (int i = 0; i < elements.size(); ++i) {
+	const ElementInfo &ei = elements[i];
+	strings.add(ei.name, erecs[i].name);
+	strings.add(ei.class_name, erecs[i].class_name);
+	strings.add(ei.configuration, erecs[i].configuration);
+	strings.add(ei.filename, erecs[i].filename);
+	erecs[i].lineno = ei.lineno;
+    }
+
+    Vector<uint32_t> rrecs(requirements.size() * 2, 0);
+    for (int i = 0; i < requirements.size(); ++i)
+	strings.add(requirements[i], &rrecs[i * 2]);
+
+    header h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, magic, sizeof(magic));
+    h.version = image_version;
+    h.byte_order = byte_order_mark;
+    h.nelements = elements.size();
+    h.nconnections = connections.size();
+    h.nrequirements = requirements.size() / 2;
+    h.strings_offset = sizeof(header)
+	+ elements.size() * sizeof(element_record)
+	+ connections.size() * sizeof(ConnectionInfo)
+	+ rrecs.size() * sizeof(uint32_t);
+    h.strings_length = strings.sa.length();
+    h.text_offset = h.strings_offset + h.strings_length;
+    h.text_length = configuration.length();
+    h.size = h.text_offset + h.text_length + 1;
+    h.text_checksum = update_crc(0xFFFFFFFFU, configuration.data(), configuration.length());
+
+    StringAccum sa;
+    sa.reserve(h.size);
+    sa.append(reinterpret_cast<const char *>(&h), sizeof(h));
+    if (erecs.size())
+	sa.append(reinterpret_cast<const char *>(erecs.begin()), erecs.size() * sizeof(element_record));
+    if (connections.size())
+	sa.append(reinterpret_cast<const char *>(connections.begin()), connections.size() * sizeof(ConnectionInfo));
+    if (rrecs.size())
+	sa.append(reinterpret_cast<const char *>(rrecs.begin()), rrecs.size() * sizeof(uint32_t));
+    sa.append(strings.sa.data(), strings.sa.length());
+    sa.append(configuration.data(), configuration.length());
+    sa.append('\0');
+
+    h.body_checksum = body_checksum(sa.data(), h.text_offset);
+    memcpy(sa.data() + offsetof(header, body_checksum), &h.body_checksum, sizeof(h.body_checksum));
+    return sa.take_string();
+}
+
+static inline bool
+check_range(uint32_t offset, uint32_t length, uint32_t limit)
+{
+    return offset <= limit && length <= limit - offset;
+}
+
+int
+RouterImage::parse(const String &data, ErrorHandler *errh)
+{
+    LocalErrorHandler lerrh(errh);
+    elements.clear();
+    connections.clear();
+    requirements.clear();
+    configuration = String();
+
+    header h;
+    if (!is_image(data) || data.length() < (int) sizeof(header))
+	return lerrh.error("not a router image");
+    memcpy(&h, data.data(), sizeof(header));
+    if (h.byte_order != byte_order_mark)
+	return lerrh.error("router image has the wrong byte order");
+    if (h.version != image_version)
+	return lerrh.error("router image version %u not supported", h.version);
+    if (h.size != (uint32_t) data.length())
+	return lerrh.error("router image truncated");
+
+    // configuration text
+    bool text_ok = h.text_offset >= sizeof(header)
+	&& check_range(h.text_offset, h.text_length, h.size)
+	&& update_crc(0xFFFFFFFFU, data.data() + h.text_offset, h.text_length) == h.text_checksum;
+    if (text_ok)
+	configuration = data.substring(h.text_offset, h.text_length);
+
+    // binary sections
+    uint64_t records_end = (uint64_t) sizeof(header)
+	+ (uint64_t) h.nelements * sizeof(element_record)
+	+ (uint64_t) h.nconnections * sizeof(ConnectionInfo)
+	+ (uint64_t) h.nrequirements * 4 * sizeof(uint32_t);
+    bool body_ok = text_ok
+	&& body_checksum(data.data(), h.text_offset) == h.body_checksum
+	&& records_end == h.strings_offset
+	&& check_range(h.strings_offset, h.strings_length, h.text_offset);
+    if (!body_ok) {
+	if (!text_ok)
+	    return lerrh.error("router image corrupted");
+	lerrh.warning("router image checksum mismatch, parsing configuration text");
+	return parse_text_only;
+    }
+
+    String strings = data.substring(h.strings_offset, h.strings_length);
+    const char *s = data.data() + sizeof(header);
+    elements.resize(h.nelements);
+    for (uint32_t i = 0; i < h.nelements; ++i, s += sizeof(element_record)) {
+	element_record r;
+	memcpy(&r, s, sizeof(r));
+	if (!check_range(r.name[0], r.name[1], h.strings_length)
+	    || !check_range(r.class_name[0], r.class_name[1], h.strings_length)
+	    || !check_range(r.configuration[0], r.configuration[1], h.strings_length)
+	    || !check_range(r.filename[0], r.filename[1], h.strings_length))
+	    goto bad_reference;
+	ElementInfo &ei = elements[i];
+	ei.name = strings.substring(r.name[0], r.name[1]);
+	ei.class_name = strings.substring(r.class_name[0], r.class_name[1]);
+	ei.configuration = strings.substring(r.configuration[0], r.configuration[1]);
+	ei.filename = strings.substring(r.filename[0], r.filename[1]);
+	ei.lineno = r.lineno;
+    }
+
+    connections.resize(h.nconnections);
+    if (h.nconnections)
+	memcpy(connections.begin(), s, h.nconnections * sizeof(ConnectionInfo));
+    s += h.nconnections * sizeof(ConnectionInfo);
+    for (uint32_t i = 0; i < h.nconnections; ++i)
+	if (connections[i].from_idx >= h.nelements || connections[i].to_idx >= h.nelements)
+	    goto bad_reference;
+
+    for (uint32_t i = 0; i < h.nrequirements * 2; ++i, s += 2 * sizeof(uint32_t)) {
+	uint32_t ref[2];
+	memcpy(ref, s, sizeof(ref));
+	if (!check_range(ref[0], ref[1], h.strings_length))
+	    goto bad_reference;
+	requirements.push_back(strings.substring(ref[0], ref[1]));
+    }
+
+    return parse_ok;
+
+  bad_reference:
+    elements.clear();
+    connections.clear();
+    requirements.clear();
+    lerrh.warning("router image has bad references, parsing configuration text");
+    return parse_text_only;
+}
+
+CLICK_ENDDECLS
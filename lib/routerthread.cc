@@ -109,6 +109,13 @@ RouterThread::RouterThread(Master *master, int id)
 #if CLICK_LINUXMODULE
     greedy_schedule_jiffies = jiffies;
 #endif
+#if CLICK_USERLEVEL
+    _backoff = false;
+    _poll_state = POLL_BUSY;
+    _backoff_owner = 0;
+    _util_mark = 0;
+    reset_utilization();
+#endif
 
 #if CLICK_NS
     _ns_scheduled = _ns_last_active = Timestamp(-1, 0);
@@ -331,8 +338,8 @@ RouterThread::task_reheapify_from(int pos, Task* t)
 }
 #endif
 
-/* Run at most 'ntasks' tasks. */
-inline void
+/* Run at most 'ntasks' tasks.  Returns true if any task reported work. */
+inline bool
 RouterThread::run_tasks(int ntasks)
 {
     set_thread_state(S_RUNTASK);
@@ -367,7 +374,7 @@ RouterThread::run_tasks(int ntasks)
 #if HAVE_MULTITHREAD
     int runs;
 #endif
-    bool work_done;
+    bool work_done, any_work = false;
 
     for (; ntasks >= 0; --ntasks) {
         t = task_begin();
@@ -390,6 +397,7 @@ RouterThread::run_tasks(int ntasks)
 
         t->_status.is_scheduled = false;
         work_done = t->fire();
+        any_work |= work_done;
 
 #if HAVE_MULTITHREAD
         if (runs > PROFILE_ELEMENT) {
@@ -458,8 +466,88 @@ RouterThread::run_tasks(int ntasks)
 #if HAVE_ADAPTIVE_SCHEDULER
     client_update_pass(C_CLICK, t_before);
 #endif
+    return any_work;
+}
+
+#if CLICK_USERLEVEL
+/** @brief Turn on idle backoff.
+ * @param busy_poll time to busy-poll after tasks stop doing work
+ * @param pause time to then pause between polls
+ * @param wake_latency maximum time to then sleep between polls
+ * @param owner identifies the caller, such as an element
+ *
+ * Tasks report whether they did work by the return values of their
+ * callbacks.  Once no task has done work for @a busy_poll, the thread
+ * executes pause instructions between polls; after a further @a pause, it
+ * sleeps in the select set between polls, waking for file descriptor
+ * activity, timers, tasks scheduled by other threads, or after @a
+ * wake_latency.  Any task reporting work returns the thread to busy
+ * polling.
+ *
+ * While idle backoff is on, the thread also counts its cycles for
+ * utilization_cycles(). */
+void
+RouterThread::set_idle_backoff(const Timestamp &busy_poll, const Timestamp &pause,
+                               const Timestamp &wake_latency, const void *owner)
+{
+    _busy_poll = busy_poll;
+    _pause_poll = pause;
+    _wake_latency = wake_latency;
+    _idle_start = Timestamp();
+    _poll_state = POLL_BUSY;
+    _backoff_owner = owner;
+    if (!_backoff)
+        _util_mark = click_get_cycles();
+    click_compiler_fence();
+    _backoff = true;
+}
+
+/** @brief Turn off idle backoff if @a owner turned it on.
+ *
+ * A hotswapped router's element may already have taken over the thread's
+ * backoff by the time the old router's element is cleaned up; the old
+ * element's call then does nothing. */
+void
+RouterThread::clear_idle_backoff(const void *owner)
+{
+    if (_backoff_owner == owner) {
+        _backoff = false;
+        _poll_state = POLL_BUSY;
+        _backoff_owner = 0;
+    }
+}
+
+void
+RouterThread::update_idle_backoff(bool worked)
+{
+    if (worked || !active()) {
+        _poll_state = POLL_BUSY;
+        _idle_start = Timestamp();
+        return;
+    }
+    Timestamp now = Timestamp::now_steady();
+    if (!_idle_start)
+        _idle_start = now;
+    Timestamp idle = now - _idle_start;
+    if (idle < _busy_poll)
+        _poll_state = POLL_BUSY;
+    else if (idle < _busy_poll + _pause_poll) {
+        _poll_state = POLL_PAUSE;
+        for (int i = 0; i < 32; ++i)
+            click_relax_fence();
+    } else
+        _poll_state = POLL_SLEEP;
 }
 
+void
+RouterThread::reset_utilization()
+{
+    for (int i = 0; i < NUTIL; ++i)
+        _util_cycles[i] = 0;
+    _idle_sleeps = 0;
+}
+#endif
+
 inline void
 RouterThread::run_os()
 {
@@ -473,6 +561,8 @@ RouterThread::run_os()
 #endif
 
 #if CLICK_USERLEVEL
+    if (_poll_state == POLL_SLEEP)
+        ++_idle_sleeps;
     select_set().run_selects(this);
 #elif CLICK_MINIOS
     /*
@@ -584,6 +674,9 @@ RouterThread::driver()
     _adaptive_restride_timestamp.assign_now();
     _adaptive_restride_iter = 0;
 #endif
+#if CLICK_USERLEVEL
+    _util_mark = click_get_cycles();
+#endif
 
     while (1) {
 #if CLICK_DEBUG_SCHEDULING
@@ -598,6 +691,9 @@ RouterThread::driver()
 
         // run occasional tasks: timers, select, etc.
         iter++;
+#if TIMESTAMP_THREAD_CLOCK
+        Timestamp::refresh_recent();
+#endif
 
         // run task requests
         click_compiler_fence();
@@ -610,7 +706,15 @@ RouterThread::driver()
             if (PASS_GT(_clients[C_CLICK].pass, _clients[C_KERNEL].pass))
                 break;
 #endif
+#if CLICK_USERLEVEL
+            bool worked = run_tasks(_tasks_per_iter);
+            if (_backoff) {
+                update_idle_backoff(worked);
+                account_cycles(worked ? U_WORK : U_IDLE);
+            }
+#else
             run_tasks(_tasks_per_iter);
+#endif
         } while (0);
 
 #if CLICK_USERLEVEL
@@ -630,10 +734,17 @@ RouterThread::driver()
 #endif
             timer_set().run_timers(this, _master);
         } while (0);
+#if CLICK_USERLEVEL
+        if (_backoff)
+            account_cycles(U_WORK);
+#endif
 
         // run operating system
         do {
-#if !HAVE_ADAPTIVE_SCHEDULER && !BSD_NETISRSCHED
+#if CLICK_USERLEVEL && !HAVE_ADAPTIVE_SCHEDULER
+            if (iter % _iters_per_os && _poll_state != POLL_SLEEP)
+                break;
+#elif !HAVE_ADAPTIVE_SCHEDULER && !BSD_NETISRSCHED
             if (iter % _iters_per_os)
                 break;
 #elif HAVE_ADAPTIVE_SCHEDULER
@@ -643,6 +754,13 @@ RouterThread::driver()
             break;
 #endif
             run_os();
+#if CLICK_USERLEVEL
+            if (_backoff)
+                account_cycles(U_OS);
+#endif
+#if TIMESTAMP_THREAD_CLOCK
+            Timestamp::refresh_recent();
+#endif
         } while (0);
 
 #if CLICK_NS || BSD_NETISRSCHED
@@ -653,6 +771,9 @@ RouterThread::driver()
     }
 
     driver_unlock_tasks();
+#if TIMESTAMP_THREAD_CLOCK
+    Timestamp::uncache_recent();
+#endif
 
     _driver_entered = false;
 #if HAVE_ADAPTIVE_SCHEDULER
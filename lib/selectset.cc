@@ -390,7 +390,7 @@ SelectSet::run_selects_kqueue(RouterThread *thread)
     // Decide how long to wait.
     struct timespec wait, *wait_ptr = &wait;
     Timestamp t;
-    int delay_type = thread->timer_set().next_timer_delay(thread->active(), t);
+    int delay_type = thread->next_select_delay(t);
     if (delay_type == 0)
 	wait.tv_sec = wait.tv_nsec = 0;
     else if (delay_type > 0)
@@ -441,11 +441,15 @@ SelectSet::run_selects_poll(RouterThread *thread)
     // Decide how long to wait.
     int timeout;
     Timestamp t;
-    int delay_type = thread->timer_set().next_timer_delay(thread->active(), t);
+    int delay_type = thread->next_select_delay(t);
     if (delay_type == 0)
 	timeout = 0;
-    else if (delay_type > 0)
+    else if (delay_type > 0) {
 	timeout = (t.sec() >= INT_MAX / 1000 ? INT_MAX - 1000 : t.msecval());
+	// poll() sleeps in milliseconds; never spin while backing off.
+	if (timeout == 0 && thread->poll_state() == RouterThread::POLL_SLEEP)
+	    timeout = 1;
+    }
     else
 	timeout = -1;
     thread->set_thread_state_for_blocking(delay_type);
@@ -497,7 +501,7 @@ SelectSet::run_selects_select(RouterThread *thread)
     // Decide how long to wait.
     struct timeval wait, *wait_ptr = &wait;
     Timestamp t;
-    int delay_type = thread->timer_set().next_timer_delay(thread->active(), t);
+    int delay_type = thread->next_select_delay(t);
     if (delay_type == 0)
 	timerclear(&wait);
     else if (delay_type > 0)
@@ -561,7 +565,8 @@ SelectSet::run_selects(RouterThread *thread)
     // Return early (just run signals) if there are no selectors and there are
     // tasks to run.  NB there will always be at least one _pollfd (the
     // _wake_pipe).
-    if (_pollfds.size() < 2 && thread->active()) {
+    if (_pollfds.size() < 2 && thread->active()
+	&& thread->poll_state() != RouterThread::POLL_SLEEP) {
 #if HAVE_MULTITHREAD
 	_select_lock.release();
 #endif
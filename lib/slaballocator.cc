@@ -0,0 +1,379 @@
+// -*- c-basic-offset: 4; related-file-name: "../include/click/slaballocator.hh" -*-
+/*
+ * slaballocator.{cc,hh} -- thread-aware allocator for fixed-size objects
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include <click/glue.hh>
+#include <click/slaballocator.hh>
+#include <click/straccum.hh>
+#if CLICK_USERLEVEL && defined(ALLOW_MMAP)
+# include <sys/mman.h>
+# if defined(MADV_HUGEPAGE) && defined(MAP_ANONYMOUS)
+#  define SLAB_HUGEPAGES 1
+# endif
+#endif
+CLICK_DECLS
+
+namespace {
+enum {
+    slab_size = 65536,
+    min_slab_objects = 16,
+    huge_page_size = 2 << 20,
+    max_cpus = 256,
+    nclasses = 48
+};
+
+SlabAllocator *all_allocators;
+SimpleSpinlock all_lock;
+SlabAllocator *shared_allocators[nclasses];
+SimpleSpinlock shared_lock;
+
+// Return the index of size class @a size, which must be a size class of
+// at most SlabAllocator::max_shared_size.
+int
+class_index(size_t size)
+{
+    if (size <= 256)
+	return size / 16 - 1;
+    int k = 8;
+    while (((size_t) 2 << k) < size)
+	++k;
+    size_t step = ((size_t) 1 << k) / 4;
+    return 16 + (k - 8) * 4 + (size / step - 5);
+}
+}
+
+size_t
+SlabAllocator::size_class(size_t size)
+{
+    if (size <= 256)
+	return size <= 16 ? 16 : (size + 15) & ~(size_t) 15;
+    int k = 8;
+    while (((size_t) 2 << k) < size)
+	++k;
+    size_t step = ((size_t) 1 << k) / 4;
+    return (size + step - 1) & ~(step - 1);
+}
+
+SlabAllocator::SlabAllocator(size_t size, int flags)
+    : _size(size_class(size)), _flags(flags), _cpus(0), _ncpus(0),
+      _cpu_memory(0), _full(0), _empty(0), _nfull(0), _free(0),
+      _nfree_list(0), _depot_nalloc(0), _depot_nfree(0), _slabs(0),
+      _slab_pos(0), _slab_end(0), _capacity(0), _slab_bytes(0),
+      _hugepages(false), _shared(false)
+{
+#if !(CLICK_USERLEVEL && HAVE_MULTITHREAD && !HAVE___THREAD_STORAGE_CLASS)
+    // Without per-thread identifiers, click_current_cpu_id() can name the
+    // same CPU in two threads at once, so every thread uses the depot.
+# if HAVE_MULTITHREAD
+    _ncpus = click_max_cpu_ids();
+# else
+    _ncpus = 1;
+# endif
+    if (_ncpus > max_cpus)
+	_ncpus = max_cpus;
+    _cpu_memory = new char[_ncpus * sizeof(CPU) + CLICK_CACHE_LINE_SIZE - 1];
+    if (_cpu_memory) {
+	uintptr_t x = reinterpret_cast<uintptr_t>(_cpu_memory) + CLICK_CACHE_LINE_SIZE - 1;
+	x -= x % CLICK_CACHE_LINE_SIZE;
+	_cpus = reinterpret_cast<CPU *>(x);
+	memset(_cpus, 0, _ncpus * sizeof(CPU));
+    } else
+	_ncpus = 0;
+#endif
+
+    all_lock.acquire();
+    _next_allocator = all_allocators;
+    _pprev_allocator = &all_allocators;
+    if (all_allocators)
+	all_allocators->_pprev_allocator = &_next_allocator;
+    all_allocators = this;
+    all_lock.release();
+}
+
+SlabAllocator::~SlabAllocator()
+{
+    all_lock.acquire();
+    *_pprev_allocator = _next_allocator;
+    if (_next_allocator)
+	_next_allocator->_pprev_allocator = _pprev_allocator;
+    all_lock.release();
+
+    for (unsigned i = 0; i < _ncpus; ++i) {
+	delete _cpus[i].loaded;
+	delete _cpus[i].previous;
+    }
+    delete[] _cpu_memory;
+    while (Magazine *m = _full) {
+	_full = m->next;
+	delete m;
+    }
+    while (Magazine *m = _empty) {
+	_empty = m->next;
+	delete m;
+    }
+    while (slab *s = _slabs) {
+	_slabs = s->next;
+	free_slab(s);
+    }
+}
+
+SlabAllocator *
+SlabAllocator::shared(size_t size)
+{
+    assert(size <= max_shared_size);
+    int i = class_index(size_class(size));
+    shared_lock.acquire();
+    if (!shared_allocators[i] && (shared_allocators[i] = new SlabAllocator(size)))
+	shared_allocators[i]->_shared = true;
+    SlabAllocator *a = shared_allocators[i];
+    shared_lock.release();
+    return a;
+}
+
+bool
+SlabAllocator::grow()
+{
+    slab *s = 0;
+    size_t size = slab_size;
+    if (size < min_slab_objects * _size + CLICK_CACHE_LINE_SIZE)
+	size = min_slab_objects * _size + CLICK_CACHE_LINE_SIZE;
+#if SLAB_HUGEPAGES
+    if ((_flags & F_HUGEPAGES) && size <= huge_page_size) {
+	// Map twice the huge page size and trim the ends, leaving one
+	// aligned huge page.
+	size_t len = 2 * huge_page_size;
+	void *m = mmap(0, len, PROT_READ | PROT_WRITE,
+		       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (m != MAP_FAILED) {
+	    char *base = reinterpret_cast<char *>(m);
+	    uintptr_t x = reinterpret_cast<uintptr_t>(base) + huge_page_size - 1;
+	    char *a = reinterpret_cast<char *>(x - x % huge_page_size);
+	    if (a > base)
+		munmap(base, a - base);
+	    if (a + huge_page_size < base + len)
+		munmap(a + huge_page_size, base + len - a - huge_page_size);
+	    (void) madvise(a, huge_page_size, MADV_HUGEPAGE);
+	    s = reinterpret_cast<slab *>(a);
+	    s->size = huge_page_size;
+	    s->huge = true;
+	    s->memory = 0;
+	    _hugepages = true;
+	}
+    }
+#endif
+    if (!s) {
+	char *memory = new char[size + CLICK_CACHE_LINE_SIZE - 1];
+	if (!memory)
+	    return false;
+	uintptr_t x = reinterpret_cast<uintptr_t>(memory) + CLICK_CACHE_LINE_SIZE - 1;
+	x -= x % CLICK_CACHE_LINE_SIZE;
+	s = reinterpret_cast<slab *>(x);
+	s->size = size;
+	s->huge = false;
+	s->memory = memory;
+    }
+    s->next = _slabs;
+    _slabs = s;
+    _slab_bytes += s->size;
+    // objects start on a cache line boundary
+    _slab_pos = reinterpret_cast<char *>(s) + CLICK_CACHE_LINE_SIZE;
+    _slab_end = reinterpret_cast<char *>(s) + s->size;
+    return true;
+}
+
+void
+SlabAllocator::free_slab(slab *s)
+{
+#if SLAB_HUGEPAGES
+    if (s->huge) {
+	munmap(s, s->size);
+	return;
+    }
+#endif
+    delete[] s->memory;
+}
+
+void *
+SlabAllocator::carve()
+{
+    if (_slab_pos + _size > _slab_end && !grow())
+	return 0;
+    void *p = _slab_pos;
+    _slab_pos += _size;
+    ++_capacity;
+    return p;
+}
+
+bool
+SlabAllocator::fill(Magazine *m)
+{
+    while (m->n < magazine_size) {
+	void *p;
+	if (link *l = _free) {
+	    _free = l->next;
+	    --_nfree_list;
+	    p = l;
+	} else if (!(p = carve()))
+	    break;
+	m->obj[m->n++] = p;
+    }
+    return m->n != 0;
+}
+
+SlabAllocator::Magazine *
+SlabAllocator::new_magazine()
+{
+    Magazine *m = _empty;
+    if (m)
+	_empty = m->next;
+    else if (!(m = new Magazine))
+	return 0;
+    m->n = 0;
+    return m;
+}
+
+void
+SlabAllocator::install_magazines(CPU &c)
+{
+    if ((c.loaded = new_magazine()) && !(c.previous = new_magazine())) {
+	c.loaded->next = _empty;
+	_empty = c.loaded;
+	c.loaded = 0;
+    }
+}
+
+void *
+SlabAllocator::hard_allocate(unsigned id)
+{
+    CPU *c = (id < _ncpus ? &_cpus[id] : 0);
+    if (c && c->loaded && c->previous->n) {
+	Magazine *m = c->loaded;
+	c->loaded = c->previous;
+	c->previous = m;
+    } else {
+	_lock.acquire();
+	if (c && !c->loaded)
+	    install_magazines(*c);
+	if (!c || !c->loaded) {
+	    void *p;
+	    if (link *l = _free) {
+		_free = l->next;
+		--_nfree_list;
+		p = l;
+	    } else
+		p = carve();
+	    _depot_nalloc += (p != 0);
+	    _lock.release();
+	    return p;
+	}
+	if (Magazine *m = _full) {
+	    // trade our empty previous magazine for a full one
+	    _full = m->next;
+	    --_nfull;
+	    c->previous->next = _empty;
+	    _empty = c->previous;
+	    c->previous = c->loaded;
+	    c->loaded = m;
+	} else
+	    fill(c->loaded);
+	_lock.release();
+	if (!c->loaded->n)
+	    return 0;
+    }
+    ++c->nalloc;
+    return c->loaded->obj[--c->loaded->n];
+}
+
+void
+SlabAllocator::hard_deallocate(unsigned id, void *p)
+{
+    CPU *c = (id < _ncpus ? &_cpus[id] : 0);
+    if (c && c->loaded && c->previous->n < magazine_size) {
+	Magazine *m = c->loaded;
+	c->loaded = c->previous;
+	c->previous = m;
+    } else {
+	_lock.acquire();
+	if (c && !c->loaded)
+	    install_magazines(*c);
+	Magazine *m = 0;
+	if (c && c->loaded && c->loaded->n == magazine_size
+	    && (m = new_magazine())) {
+	    // both magazines are full: hand one to the depot
+	    c->previous->next = _full;
+	    _full = c->previous;
+	    ++_nfull;
+	    c->previous = c->loaded;
+	    c->loaded = m;
+	}
+	if (!c || !c->loaded || c->loaded->n == magazine_size) {
+	    link *l = reinterpret_cast<link *>(p);
+	    l->next = _free;
+	    _free = l;
+	    ++_nfree_list;
+	    ++_depot_nfree;
+	    _lock.release();
+	    return;
+	}
+	_lock.release();
+    }
+    ++c->nfree;
+    c->loaded->obj[c->loaded->n++] = p;
+}
+
+void
+SlabAllocator::stats(Stats &s) const
+{
+    SlabAllocator *a = const_cast<SlabAllocator *>(this);
+    a->_lock.acquire();
+    uint64_t nalloc = _depot_nalloc, nfree = _depot_nfree;
+    size_t cached = _nfull * magazine_size + _nfree_list;
+    for (unsigned i = 0; i < _ncpus; ++i) {
+	nalloc += _cpus[i].nalloc;
+	nfree += _cpus[i].nfree;
+	if (Magazine *m = _cpus[i].loaded)
+	    cached += m->n + _cpus[i].previous->n;
+    }
+    s.size = _size;
+    s.in_use = nalloc - nfree;
+    s.cached = cached;
+    s.capacity = _capacity;
+    s.slab_bytes = _slab_bytes;
+    s.hugepages = _hugepages;
+    a->_lock.release();
+}
+
+String
+SlabAllocator::unparse_all()
+{
+    StringAccum sa;
+    all_lock.acquire();
+    for (SlabAllocator *a = all_allocators; a; a = a->_next_allocator) {
+	Stats s;
+	a->stats(s);
+	sa << "size " << s.size << " in_use " << s.in_use
+	   << " cached " << s.cached << " capacity " << s.capacity
+	   << " bytes " << s.slab_bytes;
+	if (a->_shared)
+	    sa << " shared";
+	if (s.hugepages)
+	    sa << " hugepages";
+	sa << '\n';
+    }
+    all_lock.release();
+    return sa.take_string();
+}
+
+CLICK_ENDDECLS
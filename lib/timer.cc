@@ -255,6 +255,13 @@ Timer::home_thread_id() const
 	return ThreadSched::THREAD_UNKNOWN;
 }
 
+void
+Timer::move_thread(int thread_id)
+{
+    assert(_owner && initialized() && !scheduled());
+    _thread = _owner->master()->thread(thread_id);
+}
+
 void
 Timer::schedule_at_steady(const Timestamp &when)
 {
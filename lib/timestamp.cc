@@ -114,6 +114,9 @@ Timestamp::warp_adjust(bool steady, const Timestamp &t_raw,
         TimestampWarp::flat_offset[steady] = t_warped - t_raw;
     else
         TimestampWarp::offset[steady] = t_warped.doubleval() / TimestampWarp::speed - t_raw.doubleval();
+# if TIMESTAMP_THREAD_CLOCK
+    TimestampClock::flush_recent();
+# endif
 }
 
 void
@@ -146,6 +149,123 @@ Timestamp::warp_jump_steady(const Timestamp &expiry)
 }
 #endif
 
+#if TIMESTAMP_THREAD_CLOCK
+# if HAVE_MULTITHREAD
+__thread TimestampClock::thread_state TimestampClock::thread;
+# else
+TimestampClock::thread_state TimestampClock::thread;
+# endif
+Timestamp::clock_source_type TimestampClock::source = Timestamp::clock_system;
+
+/* Cache recent() and recent_steady() together, reading the other clock now,
+   so that differences between them, which Timer relies on, stay exact. */
+void
+TimestampClock::cache_recent(const Timestamp &t, bool steady)
+{
+    Timestamp other;
+    other.assign_now(false, !steady, false);
+    thread.recent[steady] = t._t;
+    thread.recent[!steady] = other._t;
+    thread.recent_state = 3;
+}
+
+# if TIMESTAMP_TSC_CLOCK
+uint64_t TimestampClock::period_cycles;
+uint64_t TimestampClock::mult;
+uint64_t TimestampClock::calibrate_cycles;
+int64_t TimestampClock::calibrate_nsec;
+
+static inline int64_t
+timespec_nsec(const struct timespec &ts)
+{
+    return ts.tv_sec * (int64_t) 1000000000 + ts.tv_nsec;
+}
+
+/* Read the steady clock, and return the cycle count at the middle of the
+   read. */
+static inline uint64_t
+cycles_steady_nsec(int64_t &nsec)
+{
+    struct timespec ts;
+    uint64_t c0 = click_get_cycles();
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    uint64_t c1 = click_get_cycles();
+    nsec = timespec_nsec(ts);
+    return c0 + (c1 - c0) / 2;
+}
+
+bool
+TimestampClock::calibrate()
+{
+    // The counter must tick at a constant rate in every power state
+    // (CPUID 0x80000007, EDX bit 8, "invariant TSC").
+    uint32_t a, b, c, d;
+    __asm__ __volatile__ ("cpuid" : "=a" (a), "=b" (b), "=c" (c), "=d" (d)
+                          : "a" (0x80000000U), "c" (0));
+    if (a < 0x80000007U)
+        return false;
+    __asm__ __volatile__ ("cpuid" : "=a" (a), "=b" (b), "=c" (c), "=d" (d)
+                          : "a" (0x80000007U), "c" (0));
+    if (!(d & (1U << 8)))
+        return false;
+
+    int64_t nsec;
+    calibrate_cycles = cycles_steady_nsec(calibrate_nsec);
+    usleep(10000);
+    uint64_t cycles = cycles_steady_nsec(nsec);
+    if (cycles <= calibrate_cycles || nsec <= calibrate_nsec)
+        return false;
+    mult = (uint64_t) ((double) (nsec - calibrate_nsec) * 4294967296.0
+                       / (double) (cycles - calibrate_cycles));
+    // 100 milliseconds of cycles; also keeps delta * mult within 64 bits.
+    period_cycles = ((uint64_t) 100000000 << 32) / mult;
+    return mult != 0 && period_cycles != 0;
+}
+
+void
+TimestampClock::rebase(thread_state &t)
+{
+    int64_t steady_nsec;
+    struct timespec ts;
+    uint64_t new_cycles = cycles_steady_nsec(steady_nsec);
+    clock_gettime(CLOCK_REALTIME, &ts);
+    int64_t real_nsec = timespec_nsec(ts);
+
+    // Steady time must not move backwards from what the old base reported.
+    uint64_t old_delta = new_cycles - t.base_cycles;
+    if (t.base_cycles && old_delta < 2 * period_cycles) {
+        int64_t old_nsec = t.base_nsec[1] + (int64_t) ((old_delta * mult) >> 32);
+        if (old_nsec > steady_nsec)
+            steady_nsec = old_nsec;
+    }
+
+    // Refine the rate over the whole time since calibration.
+    if (new_cycles > calibrate_cycles && steady_nsec > calibrate_nsec)
+        mult = (uint64_t) ((double) (steady_nsec - calibrate_nsec) * 4294967296.0
+                           / (double) (new_cycles - calibrate_cycles));
+
+    t.base_cycles = new_cycles;
+    t.base_nsec[0] = real_nsec;
+    t.base_nsec[1] = steady_nsec;
+}
+# endif
+
+int
+Timestamp::set_clock_source(clock_source_type c)
+{
+    if (c == clock_tsc) {
+# if TIMESTAMP_TSC_CLOCK
+        if (TimestampClock::source != clock_tsc && !TimestampClock::calibrate())
+            return -1;
+# else
+        return -1;
+# endif
+    }
+    TimestampClock::source = c;
+    return 0;
+}
+#endif
+
 #if !CLICK_LINUXMODULE && !CLICK_BSDMODULE && !CLICK_MINIOS
 /** @brief Set this timestamp to a timeval obtained by calling ioctl.
     @param fd file descriptor
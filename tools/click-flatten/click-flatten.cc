@@ -21,6 +21,7 @@
 #include <click/error.hh>
 #include <click/driver.hh>
 #include <click/confparse.hh>
+#include <click/routerimage.hh>
 #include "lexert.hh"
 #include "routert.hh"
 #include "toolutils.hh"
@@ -42,6 +43,7 @@
 #define DECLARATIONS_OPT	309
 #define CONFIG_OPT		310
 #define EXPAND_VARS_OPT		311
+#define IMAGE_OPT		312
 
 static const Clp_Option options[] = {
   { "classes", 'c', CLASSES_OPT, 0, 0 },
@@ -54,6 +56,7 @@ static const Clp_Option options[] = {
   { "expression", 'e', EXPRESSION_OPT, Clp_ValString, 0 },
   { "file", 'f', ROUTER_OPT, Clp_ValString, 0 },
   { "help", 0, HELP_OPT, 0, 0 },
+  { "image", 0, IMAGE_OPT, 0, 0 },
   { "names", 'n', ELEMENTS_OPT, 0, 0 },
   { "output", 'o', OUTPUT_OPT, Clp_ValString, 0 },
   { "version", 'v', VERSION_OPT, 0, 0 },
@@ -87,6 +90,7 @@ Options:\n\
   -e, --expression EXPR     Use EXPR as router configuration.\n\
       --config              Output configuration only (not an archive).\n\
       --expand-vars         Expand global variables.\n\
+      --image               Output a precompiled router image.\n\
   -o, --output FILE         Write output configuration to FILE.\n\
   -C, --clickpath PATH      Use PATH for CLICKPATH.\n\
       --help                Print this message and exit.\n\
@@ -104,6 +108,62 @@ extern "C" {
   }
 }
 
+extern "C" {
+  static int
+  image_connection_sorter(const void *va, const void *vb)
+  {
+    const RouterImage::ConnectionInfo *a = (const RouterImage::ConnectionInfo *)va,
+      *b = (const RouterImage::ConnectionInfo *)vb;
+    if (a->to_idx != b->to_idx)
+      return a->to_idx < b->to_idx ? -1 : 1;
+    else if (a->to_port != b->to_port)
+      return a->to_port < b->to_port ? -1 : 1;
+    else if (a->from_idx != b->from_idx)
+      return a->from_idx < b->from_idx ? -1 : 1;
+    else
+      return a->from_port < b->from_port ? -1 : (a->from_port > b->from_port);
+  }
+}
+
+static String
+router_image(RouterT *router)
+{
+  RouterImage image;
+  Vector<int> new_eindex(router->nelements(), -1);
+  for (RouterT::iterator x = router->begin_elements(); x; x++) {
+    new_eindex[x->eindex()] = image.elements.size();
+    image.elements.push_back(RouterImage::ElementInfo());
+    RouterImage::ElementInfo &ei = image.elements.back();
+    ei.name = x->name();
+    ei.class_name = x->type_name();
+    ei.configuration = x->config();
+    // split "FILE:LINE" landmarks
+    ei.filename = x->landmark();
+    ei.lineno = 0;
+    int colon = ei.filename.find_right(':');
+    if (colon >= 0
+	&& cp_integer(ei.filename.substring(colon + 1), &ei.lineno))
+      ei.filename = ei.filename.substring(0, colon);
+  }
+
+  for (RouterT::conn_iterator it = router->begin_connections(); it; ++it) {
+    RouterImage::ConnectionInfo ci;
+    ci.from_idx = new_eindex[it->from_eindex()];
+    ci.from_port = it->from_port();
+    ci.to_idx = new_eindex[it->to_eindex()];
+    ci.to_port = it->to_port();
+    image.connections.push_back(ci);
+  }
+  // the driver adds connections fastest in this order
+  if (image.connections.size())
+    qsort((void *)image.connections.begin(), image.connections.size(),
+	  sizeof(RouterImage::ConnectionInfo), image_connection_sorter);
+
+  image.requirements = router->requirements();
+  image.configuration = router->configuration_string();
+  return image.unparse();
+}
+
 static void
 output_sorted_one_per_line(Vector<String> &v, FILE *out)
 {
@@ -161,6 +221,7 @@ particular purpose.\n");
      case DECLARATIONS_OPT:
      case ELEMENTS_OPT:
      case CONFIG_OPT:
+     case IMAGE_OPT:
       action = opt;
       break;
 
@@ -206,8 +267,9 @@ particular purpose.\n");
 
  done:
   RouterT *router = read_router(router_file, file_is_expr, errh);
+  // images are instantiated without the lexer, so expand variables now
   if (router)
-      router->flatten(errh, expand_vars);
+      router->flatten(errh, expand_vars || action == IMAGE_OPT);
   if (!router || errh->nerrors() > 0)
     exit(1);
 
@@ -231,6 +293,14 @@ particular purpose.\n");
      break;
    }
 
+   case IMAGE_OPT: {
+     if (router->archive().size())
+       errh->warning("router image omits archive members other than the configuration");
+     String s = router_image(router);
+     ignore_result(fwrite(s.data(), 1, s.length(), out));
+     break;
+   }
+
    case CLASSES_OPT: {
      HashTable<ElementClassT *, int> m(-1);
      router->collect_types(m);
@@ -156,9 +156,12 @@ ElementTraits::hard_flag_value(const String &str) const
 		++s;
 	    } while (s != end && isdigit((unsigned char) *s));
 	    return (s == end || isspace((unsigned char) *s) ? i : 1);
-	} else
+	} else {
 	    while (s <= end && !isspace((unsigned char) *s))
 		++s;
+	    while (s <= end && isspace((unsigned char) *s))
+		++s;
+	}
     }
     return -1;
 }
@@ -21,6 +21,7 @@
 
 #include <click/straccum.hh>
 #include <click/bitvector.hh>
+#include <click/routerimage.hh>
 #include "routert.hh"
 #include "lexert.hh"
 #include "toolutils.hh"
@@ -60,6 +61,15 @@ RouterT *
 read_router_string(String text, const String &landmark, bool empty_ok,
 		   ErrorHandler *errh)
 {
+    // check for router image
+    if (RouterImage::is_image(text)) {
+	RouterImage image;
+	ContextErrorHandler cerrh(errh, "While loading router image %<%s%>:", landmark.c_str());
+	if (image.parse(text, &cerrh) < 0)
+	    return 0;
+	text = image.configuration;
+    }
+
     // check for archive
     Vector<ArchiveElement> archive;
     if (text.length() && text[0] == '!') {
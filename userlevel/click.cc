@@ -82,6 +82,7 @@ CLICK_USING_DECLS
 #define SOCKET_OPT              318
 #define THREADS_AFF_OPT         319
 #define DPDK_OPT                320
+#define TSC_CLOCK_OPT           321
 
 static const Clp_Option options[] = {
     { "allow-reconfigure", 'R', ALLOW_RECONFIG_OPT, 0, Clp_Negate },
@@ -101,6 +102,7 @@ static const Clp_Option options[] = {
     { "cpu", 0, THREADS_AFF_OPT, Clp_ValInt, Clp_Optional | Clp_Negate },
     { "affinity", 'a', THREADS_AFF_OPT, Clp_ValInt, Clp_Optional | Clp_Negate },
     { "time", 't', TIME_OPT, 0, 0 },
+    { "tsc-clock", 0, TSC_CLOCK_OPT, 0, Clp_Negate },
     { "unix-socket", 'u', UNIX_SOCKET_OPT, Clp_ValString, 0 },
     { "version", 'v', VERSION_OPT, 0, 0 },
     { "warnings", 0, WARNINGS_OPT, 0, Clp_Negate },
@@ -153,6 +155,7 @@ Options:\n\
   -t, --time                    Print information on how long driver took.\n\
   -w, --no-warnings             Do not print warnings.\n\
       --simtime                 Run in simulation time.\n\
+      --tsc-clock               Read the time from the CPU cycle counter.\n\
   -C, --clickpath PATH          Use PATH for CLICKPATH.\n\
       --help                    Print this message and exit.\n\
   -v, --version                 Print version number and exit.\n\
@@ -460,6 +463,15 @@ timewarp_write_handler(const String &text, Element *, void *, ErrorHandler *errh
 }
 
 
+#if TIMESTAMP_THREAD_CLOCK
+static String
+clocksource_read_handler(Element *, void *)
+{
+    return Timestamp::clock_source() == Timestamp::clock_tsc ? "tsc" : "system";
+}
+#endif
+
+
 // main
 
 static void
@@ -661,6 +673,15 @@ main(int argc, char **argv)
 #endif
       break;
 
+    case TSC_CLOCK_OPT:
+#if TIMESTAMP_THREAD_CLOCK
+        if (Timestamp::set_clock_source(clp->negated ? Timestamp::clock_system : Timestamp::clock_tsc) < 0)
+            errh->warning("no invariant cycle counter, using the system clock");
+#else
+        errh->warning("--tsc-clock is not supported on this platform");
+#endif
+        break;
+
     case SIMTIME_OPT: {
         Timestamp::warp_set_class(Timestamp::warp_simulation);
         Timestamp simbegin(clp->have_val ? clp->val.d : 1000000000);
@@ -724,6 +745,9 @@ particular purpose.\n");
   Router::add_read_handler(0, "timewarp", timewarp_read_handler, 0);
   if (Timestamp::warp_class() != Timestamp::warp_simulation)
       Router::add_write_handler(0, "timewarp", timewarp_write_handler, 0);
+#if TIMESTAMP_THREAD_CLOCK
+  Router::add_read_handler(0, "clocksource", clocksource_read_handler, 0);
+#endif
 
   // parse configuration
   click_master = new Master(click_nthreads);